@@ -2,6 +2,7 @@
 #include <QMessageBox>
 #include <QInputDialog>
 #include <QGridLayout>
+#include <QGroupBox>
 
 ColumnInputWidget::ColumnInputWidget(QWidget *parent)
     : QWidget(parent)
@@ -71,6 +72,69 @@ QString ColumnInputWidget::getDefaultValue() const
     return defaultEdit->text().trimmed();
 }
 
+namespace {
+QStringList splitList(const QString &text)
+{
+    QStringList items;
+    for (const QString &item : text.split(',', Qt::SkipEmptyParts)) {
+        if (!item.trimmed().isEmpty()) items.append(item.trimmed());
+    }
+    return items;
+}
+}
+
+IndexInputWidget::IndexInputWidget(QWidget *parent)
+    : QWidget(parent)
+{
+    QGridLayout *layout = new QGridLayout(this);
+
+    nameEdit = new QLineEdit(this);
+    nameEdit->setPlaceholderText("по умолчанию из столбцов");
+
+    columnsEdit = new QLineEdit(this);
+    columnsEdit->setPlaceholderText("col1, col2 DESC, lower(col3)");
+
+    methodCombo = new QComboBox(this);
+    methodCombo->addItem("btree");
+    methodCombo->addItem("hash");
+    methodCombo->addItem("gin");
+    methodCombo->addItem("gist");
+    methodCombo->addItem("brin");
+    methodCombo->addItem("spgist");
+
+    includeEdit = new QLineEdit(this);
+    includeEdit->setPlaceholderText("столбцы через запятую");
+
+    predicateEdit = new QLineEdit(this);
+    predicateEdit->setPlaceholderText("условие частичного индекса");
+
+    uniqueCheck = new QCheckBox("Unique", this);
+
+    layout->addWidget(new QLabel("Имя:", this), 0, 0);
+    layout->addWidget(nameEdit, 0, 1);
+    layout->addWidget(new QLabel("Столбцы:", this), 0, 2);
+    layout->addWidget(columnsEdit, 0, 3);
+    layout->addWidget(new QLabel("Метод:", this), 0, 4);
+    layout->addWidget(methodCombo, 0, 5);
+    layout->addWidget(uniqueCheck, 0, 6);
+    layout->addWidget(new QLabel("INCLUDE:", this), 1, 0);
+    layout->addWidget(includeEdit, 1, 1);
+    layout->addWidget(new QLabel("WHERE:", this), 1, 2);
+    layout->addWidget(predicateEdit, 1, 3, 1, 4);
+}
+
+DatabaseManager::IndexSpec IndexInputWidget::getSpec() const
+{
+    DatabaseManager::IndexSpec spec;
+    spec.name = nameEdit->text().trimmed();
+    spec.columns = splitList(columnsEdit->text());
+    spec.method = methodCombo->currentText();
+    spec.includeColumns = splitList(includeEdit->text());
+    spec.predicate = predicateEdit->text().trimmed();
+    spec.unique = uniqueCheck->isChecked();
+    return spec;
+}
+
 AddTableDialog::AddTableDialog(QWidget *parent)
     : QDialog(parent)
 {
@@ -112,7 +176,78 @@ void AddTableDialog::setupUI()
     columnsLayout->addStretch();
 
     scrollArea->setWidget(columnsContainer);
-    mainLayout->addWidget(scrollArea);
+    mainLayout->addWidget(scrollArea, 3);
+
+    QGroupBox *partitionGroup = new QGroupBox("Секционирование", this);
+    QGridLayout *partitionLayout = new QGridLayout(partitionGroup);
+
+    partitionStrategyCombo = new QComboBox(partitionGroup);
+    partitionStrategyCombo->addItem("Нет", DatabaseManager::PartitionSpec::None);
+    partitionStrategyCombo->addItem("RANGE", DatabaseManager::PartitionSpec::Range);
+    partitionStrategyCombo->addItem("LIST", DatabaseManager::PartitionSpec::List);
+    partitionStrategyCombo->addItem("HASH", DatabaseManager::PartitionSpec::Hash);
+    partitionKeyEdit = new QLineEdit(partitionGroup);
+    partitionKeyEdit->setPlaceholderText("столбец");
+
+    partitionIntervalCombo = new QComboBox(partitionGroup);
+    partitionIntervalCombo->addItem("день", DatabaseManager::PartitionSpec::Day);
+    partitionIntervalCombo->addItem("месяц", DatabaseManager::PartitionSpec::Month);
+    partitionIntervalCombo->addItem("год", DatabaseManager::PartitionSpec::Year);
+    partitionIntervalCombo->setCurrentIndex(1);
+    partitionStartEdit = new QDateEdit(QDate::currentDate(), partitionGroup);
+    partitionStartEdit->setCalendarPopup(true);
+    partitionPremakeSpin = new QSpinBox(partitionGroup);
+    partitionPremakeSpin->setRange(0, 120);
+    partitionPremakeSpin->setValue(3);
+
+    partitionModulusSpin = new QSpinBox(partitionGroup);
+    partitionModulusSpin->setRange(1, 1024);
+    partitionModulusSpin->setValue(4);
+    partitionListEdit = new QLineEdit(partitionGroup);
+    partitionListEdit->setPlaceholderText("a, b; c; d, e");
+    defaultPartitionCheck = new QCheckBox("Секция по умолчанию", partitionGroup);
+    defaultPartitionCheck->setChecked(true);
+
+    partitionLayout->addWidget(new QLabel("Стратегия:", partitionGroup), 0, 0);
+    partitionLayout->addWidget(partitionStrategyCombo, 0, 1);
+    partitionLayout->addWidget(new QLabel("Ключ:", partitionGroup), 0, 2);
+    partitionLayout->addWidget(partitionKeyEdit, 0, 3);
+    partitionLayout->addWidget(defaultPartitionCheck, 0, 4, 1, 2);
+    partitionLayout->addWidget(new QLabel("Интервал:", partitionGroup), 1, 0);
+    partitionLayout->addWidget(partitionIntervalCombo, 1, 1);
+    partitionLayout->addWidget(new QLabel("Начало:", partitionGroup), 1, 2);
+    partitionLayout->addWidget(partitionStartEdit, 1, 3);
+    partitionLayout->addWidget(new QLabel("Создавать вперёд:", partitionGroup), 1, 4);
+    partitionLayout->addWidget(partitionPremakeSpin, 1, 5);
+    partitionLayout->addWidget(new QLabel("Значения LIST:", partitionGroup), 2, 0);
+    partitionLayout->addWidget(partitionListEdit, 2, 1, 1, 3);
+    partitionLayout->addWidget(new QLabel("Секций HASH:", partitionGroup), 2, 4);
+    partitionLayout->addWidget(partitionModulusSpin, 2, 5);
+
+    connect(partitionStrategyCombo, &QComboBox::currentIndexChanged, this, &AddTableDialog::onPartitionStrategyChanged);
+    onPartitionStrategyChanged(0);
+    mainLayout->addWidget(partitionGroup);
+
+    QHBoxLayout *indexButtonsLayout = new QHBoxLayout();
+    addIndexButton = new QPushButton("Добавить индекс", this);
+    removeIndexButton = new QPushButton("Удалить индекс", this);
+    connect(addIndexButton, &QPushButton::clicked, this, &AddTableDialog::onAddIndex);
+    connect(removeIndexButton, &QPushButton::clicked, this, &AddTableDialog::onRemoveIndex);
+    indexButtonsLayout->addWidget(addIndexButton);
+    indexButtonsLayout->addWidget(removeIndexButton);
+    indexButtonsLayout->addStretch();
+    mainLayout->addLayout(indexButtonsLayout);
+
+    QScrollArea *indexesScrollArea = new QScrollArea(this);
+    indexesScrollArea->setWidgetResizable(true);
+
+    QWidget *indexesContainer = new QWidget();
+    indexesLayout = new QVBoxLayout(indexesContainer);
+    indexesLayout->setSpacing(10);
+    indexesLayout->addStretch();
+
+    indexesScrollArea->setWidget(indexesContainer);
+    mainLayout->addWidget(indexesScrollArea, 1);
 
     confirmButton = new QPushButton("Подтвердить", this);
     connect(confirmButton, &QPushButton::clicked, this, &AddTableDialog::onConfirm);
@@ -142,6 +277,59 @@ void AddTableDialog::onRemoveColumn()
     }
 }
 
+void AddTableDialog::onAddIndex()
+{
+    IndexInputWidget *indexWidget = new IndexInputWidget(this);
+    indexesLayout->insertWidget(indexesLayout->count() - 1, indexWidget);
+    indexWidgets.append(indexWidget);
+}
+
+void AddTableDialog::onRemoveIndex()
+{
+    if (!indexWidgets.isEmpty()) {
+        IndexInputWidget *lastWidget = indexWidgets.takeLast();
+        indexesLayout->removeWidget(lastWidget);
+        lastWidget->deleteLater();
+    }
+}
+
+void AddTableDialog::onPartitionStrategyChanged(int index)
+{
+    auto strategy = DatabaseManager::PartitionSpec::Strategy(partitionStrategyCombo->itemData(index).toInt());
+    bool range = strategy == DatabaseManager::PartitionSpec::Range;
+
+    partitionKeyEdit->setEnabled(strategy != DatabaseManager::PartitionSpec::None);
+    partitionIntervalCombo->setEnabled(range);
+    partitionStartEdit->setEnabled(range);
+    partitionPremakeSpin->setEnabled(range);
+    partitionListEdit->setEnabled(strategy == DatabaseManager::PartitionSpec::List);
+    partitionModulusSpin->setEnabled(strategy == DatabaseManager::PartitionSpec::Hash);
+    defaultPartitionCheck->setEnabled(range || strategy == DatabaseManager::PartitionSpec::List);
+}
+
+// LIST values are entered as "a, b; c": partitions separated by ';',
+// values within a partition by ','.
+DatabaseManager::PartitionSpec AddTableDialog::getPartitionSpec() const
+{
+    DatabaseManager::PartitionSpec spec;
+    spec.strategy = DatabaseManager::PartitionSpec::Strategy(partitionStrategyCombo->currentData().toInt());
+    spec.key = partitionKeyEdit->text().trimmed();
+    spec.interval = DatabaseManager::PartitionSpec::Interval(partitionIntervalCombo->currentData().toInt());
+    spec.start = partitionStartEdit->date();
+    spec.premake = partitionPremakeSpin->value();
+    spec.modulus = partitionModulusSpin->value();
+    spec.defaultPartition = defaultPartitionCheck->isChecked();
+
+    for (const QString &group : partitionListEdit->text().split(';', Qt::SkipEmptyParts)) {
+        QStringList values;
+        for (const QString &value : group.split(',', Qt::SkipEmptyParts)) {
+            if (!value.trimmed().isEmpty()) values.append(value.trimmed());
+        }
+        if (!values.isEmpty()) spec.listValues.append(values);
+    }
+    return spec;
+}
+
 void AddTableDialog::onConfirm()
 {
     QString tableName = tableNameEdit->text().trimmed();
@@ -177,11 +365,47 @@ void AddTableDialog::onConfirm()
         columns.append(col);
     }
 
+    QList<DatabaseManager::IndexSpec> indexes;
+    for (auto widget : indexWidgets) {
+        DatabaseManager::IndexSpec spec = widget->getSpec();
+        if (spec.columns.isEmpty()) {
+            QMessageBox::warning(this, "Ошибка", "Укажите столбцы для каждого индекса");
+            return;
+        }
+        // The table is still empty, so there is nothing to build concurrently.
+        spec.concurrently = false;
+        indexes.append(spec);
+    }
+
+    DatabaseManager::PartitionSpec partitioning = getPartitionSpec();
+    if (partitioning.strategy != DatabaseManager::PartitionSpec::None && partitioning.key.isEmpty()) {
+        QMessageBox::warning(this, "Ошибка", "Укажите ключ секционирования");
+        return;
+    }
+    if (partitioning.strategy == DatabaseManager::PartitionSpec::List && partitioning.listValues.isEmpty()
+        && !partitioning.defaultPartition) {
+        QMessageBox::warning(this, "Ошибка", "Укажите значения для секций LIST");
+        return;
+    }
+
     QString error;
-    if (DatabaseManager::instance().createTable(tableName, columns, &error)) {
+    if (!DatabaseManager::instance().createTable(tableName, columns, partitioning, &error)) {
+        QMessageBox::critical(this, "Ошибка", "Не удалось создать таблицу: " + error);
+        return;
+    }
+
+    QStringList failed;
+    for (const auto &spec : indexes) {
+        if (!DatabaseManager::instance().createIndex(tableName, spec, &error)) {
+            failed.append(spec.columns.join(", ") + ": " + error);
+        }
+    }
+
+    if (failed.isEmpty()) {
         QMessageBox::information(this, "Успех", "Таблица успешно создана");
-        accept();
     } else {
-        QMessageBox::critical(this, "Ошибка", "Не удалось создать таблицу: " + error);
+        QMessageBox::warning(this, "Предупреждение",
+                             "Таблица создана, но не удалось создать индексы:\n" + failed.join("\n"));
     }
+    accept();
 }
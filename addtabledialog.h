@@ -10,6 +10,8 @@
 #include <QScrollArea>
 #include <QVector>
 #include <QCheckBox>
+#include <QDateEdit>
+#include <QSpinBox>
 #include "databasemanager.h"
 
 class ColumnInputWidget : public QWidget
@@ -33,6 +35,22 @@ private:
     QLineEdit *defaultEdit;
 };
 
+class IndexInputWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit IndexInputWidget(QWidget *parent = nullptr);
+    DatabaseManager::IndexSpec getSpec() const;
+
+private:
+    QLineEdit *nameEdit;
+    QLineEdit *columnsEdit;
+    QComboBox *methodCombo;
+    QLineEdit *includeEdit;
+    QLineEdit *predicateEdit;
+    QCheckBox *uniqueCheck;
+};
+
 class AddTableDialog : public QDialog
 {
     Q_OBJECT
@@ -42,10 +60,14 @@ public:
 private slots:
     void onAddColumn();
     void onRemoveColumn();
+    void onAddIndex();
+    void onRemoveIndex();
+    void onPartitionStrategyChanged(int index);
     void onConfirm();
 
 private:
     void setupUI();
+    DatabaseManager::PartitionSpec getPartitionSpec() const;
 
     QLineEdit *tableNameEdit;
     QScrollArea *scrollArea;
@@ -55,6 +77,18 @@ private:
     QPushButton *removeColumnButton;
     QPushButton *confirmButton;
     QVector<ColumnInputWidget*> columnWidgets;
+    QVBoxLayout *indexesLayout;
+    QPushButton *addIndexButton;
+    QPushButton *removeIndexButton;
+    QVector<IndexInputWidget*> indexWidgets;
+    QComboBox *partitionStrategyCombo;
+    QLineEdit *partitionKeyEdit;
+    QComboBox *partitionIntervalCombo;
+    QDateEdit *partitionStartEdit;
+    QSpinBox *partitionPremakeSpin;
+    QSpinBox *partitionModulusSpin;
+    QLineEdit *partitionListEdit;
+    QCheckBox *defaultPartitionCheck;
 };
 
 #endif
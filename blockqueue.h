@@ -0,0 +1,61 @@
+#ifndef BLOCKQUEUE_H
+#define BLOCKQUEUE_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <deque>
+
+// Bounded hand-off between pipeline stages: push() blocks while the queue
+// is full, pop() blocks until an item arrives or the queue is closed.
+template <typename T>
+class BlockQueue
+{
+public:
+    explicit BlockQueue(int capacity)
+        : capacity(capacity)
+    {
+    }
+
+    void push(T item)
+    {
+        QMutexLocker locker(&mutex);
+        while (!closed && int(items.size()) >= capacity) {
+            notFull.wait(&mutex);
+        }
+        if (closed) return;
+        items.push_back(std::move(item));
+        notEmpty.wakeOne();
+    }
+
+    bool pop(T &item)
+    {
+        QMutexLocker locker(&mutex);
+        while (items.empty() && !closed) {
+            notEmpty.wait(&mutex);
+        }
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.wakeOne();
+        return true;
+    }
+
+    // Consumers drain what is queued; later pushes are dropped.
+    void close()
+    {
+        QMutexLocker locker(&mutex);
+        closed = true;
+        notEmpty.wakeAll();
+        notFull.wakeAll();
+    }
+
+private:
+    QMutex mutex;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
+    std::deque<T> items;
+    int capacity;
+    bool closed = false;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "csvreader.h"
+#include <algorithm>
+
+namespace {
+const qint64 readChunkBytes = 256 * 1024;
+}
+
+CsvReader::CsvReader(QIODevice *device, const Dialect &dialect)
+    : device(device), dialect(dialect)
+{
+}
+
+bool CsvReader::fill()
+{
+    if (eof) return false;
+
+    buffer.remove(0, pos);
+    pos = 0;
+
+    QByteArray chunk = device->read(readChunkBytes);
+    if (chunk.isEmpty() && (device->atEnd() || !device->waitForReadyRead(-1))) {
+        eof = true;
+        return false;
+    }
+    buffer.append(chunk);
+    return true;
+}
+
+inline int CsvReader::peek()
+{
+    while (pos >= buffer.size()) {
+        if (!fill()) return -1;
+    }
+    return uchar(buffer[pos]);
+}
+
+inline int CsvReader::next()
+{
+    int c = peek();
+    if (c >= 0) {
+        ++pos;
+        if (c == '\n') ++line;
+    }
+    return c;
+}
+
+bool CsvReader::readRecord(QList<QByteArray> &fields)
+{
+    fields.clear();
+    if (hasError()) return false;
+
+    if (!started) {
+        started = true;
+        if (peek() == 0xEF && buffer.size() - pos < 3) fill();
+        if (buffer.mid(pos, 3) == "\xEF\xBB\xBF") pos += 3;
+    }
+
+    if (peek() < 0) return false;
+    startLine = line;
+
+    QByteArray field;
+    while (true) {
+        int c = peek();
+
+        if (c == dialect.quote && field.isNull()) {
+            next();
+            field = QByteArray("");
+            while (true) {
+                c = peek();
+                if (c < 0) {
+                    error = QString("Unterminated quoted field starting at line %1").arg(startLine);
+                    return false;
+                }
+
+                // Copy everything up to the next quote in one go.
+                qsizetype end = buffer.indexOf(dialect.quote, pos);
+                if (end < 0) end = buffer.size();
+                line += std::count(buffer.constData() + pos, buffer.constData() + end, '\n');
+                field.append(buffer.constData() + pos, end - pos);
+                pos = end;
+                if (end == buffer.size()) continue;
+
+                next();
+                if (peek() != dialect.quote) break;
+                next();
+                field.append(dialect.quote);
+            }
+            continue;
+        }
+
+        if (c < 0 || c == '\n') {
+            next();
+            if (field.endsWith('\r')) field.chop(1);
+            fields.append(field);
+            return true;
+        }
+
+        if (c == dialect.delimiter) {
+            next();
+            fields.append(field);
+            field = QByteArray();
+            continue;
+        }
+
+        qsizetype end = pos;
+        const char *data = buffer.constData();
+        while (end < buffer.size() && data[end] != dialect.delimiter && data[end] != '\n') {
+            ++end;
+        }
+        field.append(data + pos, end - pos);
+        pos = end;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef CSVREADER_H
+#define CSVREADER_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QList>
+
+// Streaming reader for the app's CSV dialect: optional UTF-8 BOM, ';'
+// separated, fields quoted with '"' and quotes doubled inside. Quoted
+// fields may span lines. An unquoted empty field is returned as a null
+// QByteArray, a quoted one as an empty one.
+class CsvReader
+{
+public:
+    struct Dialect {
+        char delimiter = ';';
+        char quote = '"';
+        bool header = true;
+    };
+
+    explicit CsvReader(QIODevice *device, const Dialect &dialect = Dialect());
+
+    bool readRecord(QList<QByteArray> &fields);
+    qint64 recordLine() const { return startLine; }
+    bool hasError() const { return !error.isEmpty(); }
+    QString errorString() const { return error; }
+
+private:
+    int next();
+    int peek();
+    bool fill();
+
+    QIODevice *device;
+    Dialect dialect;
+    QByteArray buffer;
+    qsizetype pos = 0;
+    bool eof = false;
+    bool started = false;
+    qint64 line = 1;
+    qint64 startLine = 0;
+    QString error;
+};
+
+#endif
@@ -0,0 +1,299 @@
+#include "csvwriter.h"
+#include <QThread>
+#include <QFile>
+#include <QtAlgorithms>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define CSV_HAVE_SSE2
+#if defined(__GNUC__)
+#define CSV_HAVE_AVX2_DISPATCH
+#endif
+#endif
+
+std::atomic<bool> CsvWriter::simdEnabled(qEnvironmentVariable("LIBRARY_CSV_SIMD") != "0");
+
+namespace {
+const int queuedBlocks = 4;
+const qint64 dropCacheBytes = qint64(64) << 20;
+
+// With LIBRARY_CSV_DROP_CACHE=1 the written range is flushed and dropped
+// from the page cache, so multi-gigabyte exports do not evict everything else.
+bool dropPageCache()
+{
+    static const bool drop = qEnvironmentVariableIntValue("LIBRARY_CSV_DROP_CACHE") != 0;
+    return drop;
+}
+
+// The scanners return the offset of the first byte that needs attention:
+// ';', '"' or '\n' when looking for a reason to quote, only '"' when
+// escaping. Multi-byte UTF-8 sequences never contain ASCII bytes, so a
+// byte-wise scan is safe.
+template <bool QuoteOnly>
+inline bool isSpecial(char c)
+{
+    return c == '"' || (!QuoteOnly && (c == ';' || c == '\n'));
+}
+
+template <bool QuoteOnly>
+qsizetype findScalar(const char *p, qsizetype from, qsizetype n)
+{
+    for (qsizetype i = from; i < n; ++i) {
+        if (isSpecial<QuoteOnly>(p[i])) return i;
+    }
+    return n;
+}
+
+#ifdef CSV_HAVE_SSE2
+template <bool QuoteOnly>
+qsizetype findSse2(const char *p, qsizetype n)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i semicolon = _mm_set1_epi8(';');
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    qsizetype i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        __m128i hits = _mm_cmpeq_epi8(v, quote);
+        if (!QuoteOnly) {
+            hits = _mm_or_si128(hits, _mm_or_si128(_mm_cmpeq_epi8(v, semicolon), _mm_cmpeq_epi8(v, newline)));
+        }
+        uint mask = uint(_mm_movemask_epi8(hits));
+        if (mask) return i + qCountTrailingZeroBits(mask);
+    }
+    return findScalar<QuoteOnly>(p, i, n);
+}
+#endif
+
+#ifdef CSV_HAVE_AVX2_DISPATCH
+template <bool QuoteOnly>
+__attribute__((target("avx2"))) qsizetype findAvx2(const char *p, qsizetype n)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i semicolon = _mm256_set1_epi8(';');
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    qsizetype i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+        __m256i hits = _mm256_cmpeq_epi8(v, quote);
+        if (!QuoteOnly) {
+            hits = _mm256_or_si256(hits, _mm256_or_si256(_mm256_cmpeq_epi8(v, semicolon),
+                                                         _mm256_cmpeq_epi8(v, newline)));
+        }
+        uint mask = uint(_mm256_movemask_epi8(hits));
+        if (mask) return i + qCountTrailingZeroBits(mask);
+    }
+    return i + findSse2<QuoteOnly>(p + i, n - i);
+}
+
+bool hasAvx2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+template <bool QuoteOnly>
+qsizetype find(const char *p, qsizetype n, bool simd)
+{
+#ifdef CSV_HAVE_SSE2
+    if (simd) {
+#ifdef CSV_HAVE_AVX2_DISPATCH
+        if (n >= 32 && hasAvx2()) return findAvx2<QuoteOnly>(p, n);
+#endif
+        return findSse2<QuoteOnly>(p, n);
+    }
+#else
+    Q_UNUSED(simd);
+#endif
+    return findScalar<QuoteOnly>(p, 0, n);
+}
+
+void adviseSequential(QIODevice *device)
+{
+#if defined(Q_OS_UNIX) && defined(POSIX_FADV_SEQUENTIAL)
+    if (QFile *file = qobject_cast<QFile *>(device)) {
+        if (file->handle() >= 0) posix_fadvise(file->handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#else
+    Q_UNUSED(device);
+#endif
+}
+
+void adviseDontNeed(QIODevice *device, qint64 offset, qint64 length)
+{
+#if defined(Q_OS_UNIX) && defined(POSIX_FADV_DONTNEED)
+    if (QFile *file = qobject_cast<QFile *>(device)) {
+        if (file->handle() >= 0 && file->flush()) {
+            posix_fadvise(file->handle(), offset, length, POSIX_FADV_DONTNEED);
+        }
+    }
+#else
+    Q_UNUSED(device);
+    Q_UNUSED(offset);
+    Q_UNUSED(length);
+#endif
+}
+}
+
+CsvWriter::CsvWriter(QIODevice *device)
+    : device(device), formatQueue(queuedBlocks), writeQueue(queuedBlocks),
+      failed(false), written(0)
+{
+    adviseSequential(device);
+    formatter = QThread::create([this] { formatLoop(); });
+    writer = QThread::create([this] { writeLoop(); });
+    formatter->start();
+    writer->start();
+}
+
+CsvWriter::~CsvWriter()
+{
+    finish();
+    delete formatter;
+    delete writer;
+}
+
+void CsvWriter::writeHeader(const QStringList &headers)
+{
+    QByteArray bytes("\xEF\xBB\xBF");
+    bytes.append(headers.join(";").toUtf8());
+    bytes.append('\n');
+    addEncoded(std::move(bytes));
+}
+
+void CsvWriter::addRows(QList<QVariantList> rows)
+{
+    if (rows.isEmpty() || hasFailed()) return;
+    formatQueue.push({std::move(rows), QByteArray()});
+}
+
+void CsvWriter::addEncoded(QByteArray bytes)
+{
+    if (bytes.isEmpty() || hasFailed()) return;
+    formatQueue.push({QList<QVariantList>(), std::move(bytes)});
+}
+
+bool CsvWriter::finish(QString *error)
+{
+    if (!finished) {
+        finished = true;
+        formatQueue.close();
+        formatter->wait();
+        writer->wait();
+    }
+
+    if (hasFailed()) {
+        if (error) *error = "Failed to write CSV";
+        return false;
+    }
+    return true;
+}
+
+// One pass finds the first byte that forces quoting; everything before it
+// is copied as is and only quotes are searched for after it.
+void CsvWriter::appendField(QByteArray &out, QByteArrayView value)
+{
+    const char *p = value.data();
+    qsizetype n = value.size();
+    bool simd = isSimdEnabled();
+
+    qsizetype special = find<false>(p, n, simd);
+    if (special == n) {
+        out.append(value);
+        return;
+    }
+
+    out.reserve(out.size() + n + 8);
+    out.append('"');
+    out.append(p, special);
+
+    qsizetype from = special;
+    while (from < n) {
+        qsizetype quote = from + find<true>(p + from, n - from, simd);
+        out.append(p + from, quote - from);
+        if (quote == n) break;
+        out.append("\"\"", 2);
+        from = quote + 1;
+    }
+    out.append('"');
+}
+
+void CsvWriter::setSimdEnabled(bool on)
+{
+    simdEnabled.store(on, std::memory_order_relaxed);
+}
+
+void CsvWriter::appendRow(QByteArray &out, const QVariantList &row)
+{
+    for (int i = 0; i < row.size(); ++i) {
+        if (i > 0) out.append(';');
+        appendField(out, row[i].toString().toUtf8());
+    }
+    out.append('\n');
+}
+
+// Encoded blocks pass through in order, so headers and pre-encoded chunks
+// can be mixed with row blocks.
+void CsvWriter::formatLoop()
+{
+    QByteArray buffer;
+    buffer.reserve(bufferBytes + 64 * 1024);
+
+    auto flush = [&]() {
+        if (buffer.isEmpty()) return;
+        writeQueue.push(std::move(buffer));
+        buffer = QByteArray();
+        buffer.reserve(bufferBytes + 64 * 1024);
+    };
+
+    Block block;
+    while (formatQueue.pop(block)) {
+        if (hasFailed()) continue;
+
+        if (!block.encoded.isEmpty()) {
+            if (buffer.size() + block.encoded.size() > bufferBytes) flush();
+            if (block.encoded.size() >= bufferBytes) {
+                writeQueue.push(std::move(block.encoded));
+            } else {
+                buffer.append(block.encoded);
+            }
+        }
+
+        for (const QVariantList &row : block.rows) {
+            appendRow(buffer, row);
+            if (buffer.size() >= bufferBytes) flush();
+        }
+        block = Block();
+    }
+
+    if (!hasFailed()) flush();
+    writeQueue.close();
+}
+
+void CsvWriter::writeLoop()
+{
+    qint64 droppedUpTo = 0;
+
+    QByteArray buffer;
+    while (writeQueue.pop(buffer)) {
+        if (hasFailed()) continue;
+
+        if (device->write(buffer) != buffer.size()) {
+            failed.store(true, std::memory_order_relaxed);
+            continue;
+        }
+
+        qint64 total = written.load(std::memory_order_relaxed) + buffer.size();
+        written.store(total, std::memory_order_relaxed);
+
+        if (dropPageCache() && total - droppedUpTo >= dropCacheBytes) {
+            adviseDontNeed(device, droppedUpTo, total - droppedUpTo);
+            droppedUpTo = total;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef CSVWRITER_H
+#define CSVWRITER_H
+
+#include "blockqueue.h"
+#include <QIODevice>
+#include <QStringList>
+#include <QVariantList>
+#include <atomic>
+
+class QThread;
+
+// Three-stage CSV export: the caller queues row blocks, a formatting thread
+// encodes them into large UTF-8 buffers and a writer thread issues big
+// sequential writes. Fields use today's format: ';' separated, quoted when
+// they contain ';', '"' or a newline.
+class CsvWriter
+{
+public:
+    static const int bufferBytes = 4 << 20;
+
+    explicit CsvWriter(QIODevice *device);
+    ~CsvWriter();
+    CsvWriter(const CsvWriter&) = delete;
+    CsvWriter &operator=(const CsvWriter&) = delete;
+
+    void writeHeader(const QStringList &headers);
+    void addRows(QList<QVariantList> rows);
+    void addEncoded(QByteArray bytes);
+    bool finish(QString *error = nullptr);
+
+    bool hasFailed() const { return failed.load(std::memory_order_relaxed); }
+    qint64 bytesWritten() const { return written.load(std::memory_order_relaxed); }
+
+    static void appendField(QByteArray &out, QByteArrayView value);
+    static void appendRow(QByteArray &out, const QVariantList &row);
+
+    static bool isSimdEnabled() { return simdEnabled.load(std::memory_order_relaxed); }
+    static void setSimdEnabled(bool on);
+
+private:
+    struct Block {
+        QList<QVariantList> rows;
+        QByteArray encoded;
+    };
+
+    void formatLoop();
+    void writeLoop();
+
+    QIODevice *device;
+    BlockQueue<Block> formatQueue;
+    BlockQueue<QByteArray> writeQueue;
+    QThread *formatter;
+    QThread *writer;
+    std::atomic<bool> failed;
+    std::atomic<qint64> written;
+    bool finished = false;
+
+    static std::atomic<bool> simdEnabled;
+};
+
+#endif
@@ -1,17 +1,577 @@
 #include "databasemanager.h"
+#include "dbmetrics.h"
+#include "tracer.h"
+#include "replicacache.h"
+#include "pgnative.h"
+#include "pgpipeline.h"
+#include "csvwriter.h"
+#include "sqlscriptreader.h"
 #include <QSqlRecord>
 #include <QFile>
 #include <QTextStream>
 #include <QJsonDocument>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace {
+const int csvFlushBytes = 1 << 20;
+const int nativeChunkRows = 10000;
+const int csvBlockRows = 10000;
+const int csvImportChunkRows = 5000;
+const int maxReportedRejects = 1000;
+const int restoreBatchStatements = 500;
+const qsizetype restoreBatchBytes = 4 << 20;
+const int indexProgressIntervalMs = 250;
+const int maxIdentifierLength = 63;
+const int preparedCacheSize = qEnvironmentVariableIsSet("LIBRARY_PREPARED_CACHE")
+                                  ? qMax(1, qEnvironmentVariableIntValue("LIBRARY_PREPARED_CACHE")) : 64;
+
+QString defaultIndexName(const QString &tableName, const DatabaseManager::IndexSpec &spec)
+{
+    static const QRegularExpression nonWord("\\W+");
+    QStringList parts = {tableName};
+    for (const QString &column : spec.columns) {
+        QString part = QString(column).replace(nonWord, "_");
+        while (part.endsWith('_')) part.chop(1);
+        parts.append(part);
+    }
+    QString suffix = spec.unique ? "_key" : "_idx";
+    return parts.join("_").left(maxIdentifierLength - suffix.size()) + suffix;
+}
+
+// Builds CREATE INDEX for the spec, or returns an empty string and sets
+// error when the access method does not support the requested options.
+QString indexStatement(const QString &tableName, const DatabaseManager::IndexSpec &spec, QString *error)
+{
+    static const QStringList methods = {"btree", "hash", "gin", "gist", "brin", "spgist"};
+    QString method = spec.method.toLower();
+
+    QString failure;
+    if (spec.columns.isEmpty()) {
+        failure = "Index needs at least one column";
+    } else if (!methods.contains(method)) {
+        failure = "Unknown index method: " + spec.method;
+    } else if (spec.unique && method != "btree") {
+        failure = "Only btree indexes can be unique";
+    } else if (method == "hash" && spec.columns.size() > 1) {
+        failure = "Hash indexes support a single column";
+    } else if (!spec.includeColumns.isEmpty() && method != "btree" && method != "gist" && method != "spgist") {
+        failure = "INCLUDE is supported by btree, GiST and SP-GiST indexes only";
+    }
+    if (!failure.isEmpty()) {
+        if (error) *error = failure;
+        return QString();
+    }
+
+    QString statement = QString("CREATE %1INDEX %2%3 ON %4 USING %5 (%6)")
+                            .arg(spec.unique ? "UNIQUE " : "",
+                                 spec.concurrently ? "CONCURRENTLY " : "",
+                                 spec.name.isEmpty() ? defaultIndexName(tableName, spec) : spec.name,
+                                 tableName, method, spec.columns.join(", "));
+    if (!spec.includeColumns.isEmpty()) {
+        statement += QString(" INCLUDE (%1)").arg(spec.includeColumns.join(", "));
+    }
+    if (!spec.predicate.trimmed().isEmpty()) {
+        statement += " WHERE " + spec.predicate.trimmed();
+    }
+    return statement;
+}
+
+struct CsvImportRow {
+    qint64 line;
+    QList<QByteArray> values;
+};
+
+void appendCopyText(QByteArray &out, QByteArrayView value)
+{
+    for (char c : value) {
+        switch (c) {
+        case '\\': out.append("\\\\"); break;
+        case '\t': out.append("\\t"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        default: out.append(c); break;
+        }
+    }
+}
+
+void appendSqlLiteral(QByteArray &out, QByteArrayView value)
+{
+    out.append('\'');
+    for (char c : value) {
+        if (c == '\'') out.append('\'');
+        out.append(c);
+    }
+    out.append('\'');
+}
+
+// Appends one row of a dump data section: a COPY line or one tuple of a
+// multi-row INSERT. Integer columns are written bare, everything else as
+// a literal the server casts to the column type.
+template <typename IsNull, typename Text>
+void appendDumpRow(QByteArray &out, const QList<DatabaseManager::ColumnInfo> &columns,
+                   DatabaseManager::SqlDumpOptions::DataFormat format, IsNull isNull, Text text)
+{
+    bool copy = format == DatabaseManager::SqlDumpOptions::Copy;
+    if (!copy) out.append('(');
+
+    for (int c = 0; c < columns.size(); ++c) {
+        if (c > 0) out.append(copy ? "\t" : ", ");
+        if (isNull(c)) {
+            out.append(copy ? "\\N" : "NULL");
+        } else if (copy) {
+            appendCopyText(out, text(c));
+        } else if (columns[c].type == "int") {
+            out.append(text(c));
+        } else {
+            appendSqlLiteral(out, text(c));
+        }
+    }
+
+    out.append(copy ? "\n" : ")");
+}
+
+QString columnsQuery(const QString &schemaName, const QString &tableName)
+{
+    return QString(
+                           "SELECT "
+                           "    c.column_name, "
+                           "    c.data_type, "
+                           "    c.udt_name, "
+                           "    c.is_nullable, "
+                           "    c.column_default, "
+                           "    CASE WHEN pk.column_name IS NOT NULL THEN true ELSE false END AS is_primary, "
+                           "    CASE "
+                           "        WHEN c.column_default LIKE 'nextval%%' THEN true "
+                           "        WHEN c.is_identity = 'YES' THEN true "
+                           "        ELSE false "
+                           "    END AS is_identity "
+                           "FROM information_schema.columns c "
+                           "LEFT JOIN ( "
+                           "    SELECT ku.column_name "
+                           "    FROM information_schema.table_constraints tc "
+                           "    JOIN information_schema.key_column_usage ku "
+                           "        ON tc.constraint_name = ku.constraint_name "
+                           "        AND tc.table_schema = ku.table_schema "
+                           "    WHERE tc.constraint_type = 'PRIMARY KEY' "
+                           "        AND tc.table_schema = '%1' "
+                           "        AND tc.table_name = '%2' "
+                           ") pk ON c.column_name = pk.column_name "
+                           "WHERE c.table_schema = '%1' AND c.table_name = '%2' "
+                           "ORDER BY c.ordinal_position"
+                           ).arg(schemaName, tableName);
+}
+
+template <typename ValueAt>
+DatabaseManager::ColumnInfo columnFromValues(ValueAt value)
+{
+    DatabaseManager::ColumnInfo col;
+    col.name = value(0).toString();
+    QString dataType = value(1).toString();
+    QString udtName = value(2).toString();
+    col.fullType = (dataType == "USER-DEFINED") ? udtName : dataType;
+    if (col.fullType == "int8") col.fullType = "bigint";
+    if (col.fullType == "int4") col.fullType = "integer";
+    col.type = col.fullType.contains("int") ? "int" : "text";
+    col.isNullable = value(3).toString() == "YES";
+    col.defaultValue = value(4).toString();
+    col.isPrimaryKey = value(5).toBool();
+    col.isIdentity = value(6).toBool();
+    return col;
+}
+
+QString foreignKeysQuery(const QString &schemaName, const QString &tableName)
+{
+    return QString(
+                           "SELECT "
+                           "    tc.constraint_name, "
+                           "    kcu.column_name, "
+                           "    ccu.table_name AS foreign_table_name, "
+                           "    ccu.column_name AS foreign_column_name, "
+                           "    rc.delete_rule, "
+                           "    rc.update_rule "
+                           "FROM information_schema.table_constraints AS tc "
+                           "JOIN information_schema.key_column_usage AS kcu "
+                           "    ON tc.constraint_name = kcu.constraint_name "
+                           "    AND tc.table_schema = kcu.table_schema "
+                           "JOIN information_schema.constraint_column_usage AS ccu "
+                           "    ON ccu.constraint_name = tc.constraint_name "
+                           "    AND ccu.table_schema = tc.table_schema "
+                           "JOIN information_schema.referential_constraints AS rc "
+                           "    ON rc.constraint_name = tc.constraint_name "
+                           "    AND rc.constraint_schema = tc.table_schema "
+                           "WHERE tc.constraint_type = 'FOREIGN KEY' "
+                           "    AND tc.table_schema = '%1' "
+                           "    AND tc.table_name = '%2'"
+                           ).arg(schemaName, tableName);
+}
+
+template <typename ValueAt>
+DatabaseManager::ForeignKeyInfo foreignKeyFromValues(ValueAt value)
+{
+    DatabaseManager::ForeignKeyInfo fk;
+    fk.constraintName = value(0).toString();
+    fk.columnName = value(1).toString();
+    fk.refTable = value(2).toString();
+    fk.refColumn = value(3).toString();
+    fk.onDelete = value(4).toString();
+    fk.onUpdate = value(5).toString();
+    return fk;
+}
+
+QString constraintsQuery(const QString &schemaName, const QString &tableName)
+{
+    return QString(
+                           "SELECT "
+                           "    con.conname AS constraint_name, "
+                           "    CASE con.contype "
+                           "        WHEN 'c' THEN 'CHECK' "
+                           "        WHEN 'u' THEN 'UNIQUE' "
+                           "        ELSE con.contype::text "
+                           "    END AS constraint_type, "
+                           "    pg_get_constraintdef(con.oid) AS definition "
+                           "FROM pg_constraint con "
+                           "JOIN pg_class cls ON con.conrelid = cls.oid "
+                           "JOIN pg_namespace nsp ON cls.relnamespace = nsp.oid "
+                           "WHERE nsp.nspname = '%1' "
+                           "    AND cls.relname = '%2' "
+                           "    AND con.contype IN ('c', 'u')"
+                           ).arg(schemaName, tableName);
+}
+
+template <typename ValueAt>
+DatabaseManager::ConstraintInfo constraintFromValues(ValueAt value)
+{
+    DatabaseManager::ConstraintInfo c;
+    c.constraintName = value(0).toString();
+    c.constraintType = value(1).toString();
+    c.definition = value(2).toString();
+    return c;
+}
+
+// One row per direct partition; a partitioned table without partitions
+// gives one row with a NULL name, a plain table no rows.
+QString partitionsQuery(const QString &schemaName, const QString &tableName)
+{
+    return QString(
+               "SELECT pg_get_partkeydef(p.oid), c.relname, pg_get_expr(c.relpartbound, c.oid), "
+               "    c.reltuples::float8, pg_total_relation_size(c.oid) "
+               "FROM pg_class p "
+               "JOIN pg_namespace n ON n.oid = p.relnamespace "
+               "LEFT JOIN pg_inherits i ON i.inhparent = p.oid "
+               "LEFT JOIN pg_class c ON c.oid = i.inhrelid "
+               "WHERE n.nspname = '%1' AND p.relname = '%2' AND p.relkind = 'p' "
+               "ORDER BY c.relname"
+               ).arg(schemaName, tableName);
+}
+
+template <typename ValueAt>
+void addPartitionRow(DatabaseManager::PartitionLayout &layout, ValueAt value)
+{
+    layout.key = value(0).toString();
+    if (value(1).isNull()) return;
+
+    DatabaseManager::PartitionInfo partition;
+    partition.name = value(1).toString();
+    partition.bound = value(2).toString();
+    partition.estimatedRows = value(3).toDouble();
+    partition.totalBytes = value(4).toLongLong();
+    layout.partitions.append(partition);
+}
+
+QDate intervalStart(const QDate &date, DatabaseManager::PartitionSpec::Interval interval)
+{
+    switch (interval) {
+    case DatabaseManager::PartitionSpec::Day: return date;
+    case DatabaseManager::PartitionSpec::Month: return QDate(date.year(), date.month(), 1);
+    case DatabaseManager::PartitionSpec::Year: return QDate(date.year(), 1, 1);
+    }
+    return date;
+}
+
+QDate nextInterval(const QDate &date, DatabaseManager::PartitionSpec::Interval interval)
+{
+    switch (interval) {
+    case DatabaseManager::PartitionSpec::Day: return date.addDays(1);
+    case DatabaseManager::PartitionSpec::Month: return date.addMonths(1);
+    case DatabaseManager::PartitionSpec::Year: return date.addYears(1);
+    }
+    return date.addDays(1);
+}
+
+// Partitions for the intervals starting at from through until, named
+// <table>_pYYYY, _pYYYYMM or _pYYYYMMDD.
+QStringList rangePartitionStatements(const QString &tableName, QDate from, const QDate &until,
+                                     DatabaseManager::PartitionSpec::Interval interval)
+{
+    const char *nameFormat = interval == DatabaseManager::PartitionSpec::Day ? "yyyyMMdd"
+                             : interval == DatabaseManager::PartitionSpec::Month ? "yyyyMM" : "yyyy";
+    QStringList statements;
+    for (; from <= until; from = nextInterval(from, interval)) {
+        statements.append(QString("CREATE TABLE IF NOT EXISTS %1_p%2 PARTITION OF %1 FOR VALUES FROM ('%3') TO ('%4')")
+                              .arg(tableName, from.toString(nameFormat), from.toString(Qt::ISODate),
+                                   nextInterval(from, interval).toString(Qt::ISODate)));
+    }
+    return statements;
+}
+
+QString createTableStatement(const QString &tableName, const QList<DatabaseManager::ColumnInfo> &columns)
+{
+    QStringList columnDefs;
+    QStringList primaryKeys;
+
+    for (const auto &col : columns) {
+        QString colDef;
+        if (col.isIdentity) {
+            colDef = QString("%1 BIGSERIAL").arg(col.name);
+        } else {
+            QString colType = col.fullType.isEmpty() ?
+                                  (col.type.toUpper() == "INT" ? "BIGINT" : "TEXT") :
+                                  col.fullType.toUpper();
+            colDef = QString("%1 %2").arg(col.name, colType);
+        }
+
+        if (!col.isNullable && !col.isIdentity) {
+            colDef += " NOT NULL";
+        }
+
+        if (!col.defaultValue.isEmpty() && !col.isIdentity) {
+            colDef += " DEFAULT " + col.defaultValue;
+        }
+
+        columnDefs.append(colDef);
+
+        if (col.isPrimaryKey) {
+            primaryKeys.append(col.name);
+        }
+    }
+
+    QString queryStr = QString("CREATE TABLE %1 (%2").arg(tableName, columnDefs.join(", "));
+
+    if (!primaryKeys.isEmpty()) {
+        queryStr += QString(", PRIMARY KEY (%1)").arg(primaryKeys.join(", "));
+    }
+
+    queryStr += ")";
+    return queryStr;
+}
+
+// Cluster-wide WAL insert position in bytes, or -1 where it cannot be
+// read (e.g. on a standby). Must not run inside a transaction that has
+// to survive an error.
+qint64 walInsertPosition(const QSqlDatabase &connection)
+{
+    QSqlQuery query(connection);
+    if (!DbMetrics::exec(query, "SELECT (pg_current_wal_insert_lsn() - '0/0'::pg_lsn)::bigint") || !query.next()) {
+        return -1;
+    }
+    return query.value(0).toLongLong();
+}
+
+// Resets every sequence owned by a column (serial or identity) in the
+// schema, optionally limited to some tables, in one server-side block.
+// Sequences come from pg_depend, so renamed columns and identity
+// sequences are found too. After the reset nextval returns MAX + 1, or 1
+// for an empty table.
+QString sequenceSyncBlock(const QString &schemaName, const QStringList &tables)
+{
+    QString tableFilter;
+    if (!tables.isEmpty()) {
+        QStringList names;
+        for (QString name : tables) {
+            names.append("'" + name.replace("'", "''") + "'");
+        }
+        tableFilter = QString("          AND tbl.relname = ANY (ARRAY[%1]::text[]) ").arg(names.join(", "));
+    }
+
+    return QString(
+               "DO $sync$ "
+               "DECLARE "
+               "    seq record; "
+               "BEGIN "
+               "    FOR seq IN "
+               "        SELECT format('%I.%I', sn.nspname, s.relname) AS name, "
+               "               format('%I.%I', tn.nspname, tbl.relname) AS table_name, "
+               "               quote_ident(a.attname) AS column_name "
+               "        FROM pg_depend d "
+               "        JOIN pg_class s ON s.oid = d.objid AND s.relkind = 'S' "
+               "        JOIN pg_namespace sn ON sn.oid = s.relnamespace "
+               "        JOIN pg_class tbl ON tbl.oid = d.refobjid "
+               "        JOIN pg_namespace tn ON tn.oid = tbl.relnamespace "
+               "        JOIN pg_attribute a ON a.attrelid = tbl.oid AND a.attnum = d.refobjsubid "
+               "        WHERE d.classid = 'pg_class'::regclass "
+               "          AND d.refclassid = 'pg_class'::regclass "
+               "          AND d.deptype IN ('a', 'i') "
+               "          AND tn.nspname = '%1' "
+               "%2"
+               "    LOOP "
+               "        EXECUTE format('SELECT setval(%L, COALESCE(MAX(%s), 1), MAX(%s) IS NOT NULL) FROM %s', "
+               "                       seq.name, seq.column_name, seq.column_name, seq.table_name); "
+               "    END LOOP; "
+               "END "
+               "$sync$"
+               ).arg(QString(schemaName).replace("'", "''"), tableFilter);
+}
+
+// Writes PostgreSQL's text representation straight from the PGresult;
+// booleans are spelled out to match the QVariant-based export. Encoding
+// stays on this thread, the CsvWriter thread does the writes.
+bool exportQueryToCsvNative(const QSqlDatabase &connection, const QString &queryStr,
+                            QIODevice *device, QString *error)
+{
+    CsvWriter writer(device);
+    QByteArray buffer;
+    buffer.reserve(csvFlushBytes + 64 * 1024);
+
+    bool headerWritten = false;
+    qint64 rows = 0;
+
+    bool ok = PgNativeResult::stream(connection, queryStr, nativeChunkRows, [&](const PgNativeResult &chunk) {
+        int columnCount = chunk.columnCount();
+
+        if (!headerWritten) {
+            QStringList headers;
+            for (int c = 0; c < columnCount; ++c) {
+                headers.append(chunk.columnName(c));
+            }
+            writer.writeHeader(headers);
+            headerWritten = true;
+        }
+
+        int rowCount = chunk.rowCount();
+        for (int r = 0; r < rowCount; ++r) {
+            for (int c = 0; c < columnCount; ++c) {
+                if (c > 0) buffer.append(';');
+                if (chunk.isNull(r, c)) continue;
+                if (chunk.columnKind(c) == PgNativeResult::Boolean) {
+                    buffer.append(chunk.text(r, c).startsWith('t') ? "true" : "false");
+                } else {
+                    CsvWriter::appendField(buffer, chunk.text(r, c));
+                }
+            }
+            buffer.append('\n');
+
+            if (buffer.size() >= csvFlushBytes) {
+                writer.addEncoded(std::move(buffer));
+                buffer = QByteArray();
+                buffer.reserve(csvFlushBytes + 64 * 1024);
+                if (writer.hasFailed()) return false;
+            }
+        }
+
+        rows += rowCount;
+        return true;
+    }, error);
+
+    writer.addEncoded(std::move(buffer));
+    QString writeError;
+    if (!writer.finish(&writeError)) {
+        if (error) *error = writeError;
+        ok = false;
+    }
+
+    DbMetrics::addTransfer(rows, 0);
+    return ok;
+}
+
+bool dumpTableData(const QSqlDatabase &connection, const QString &tableName,
+                   const QList<DatabaseManager::ColumnInfo> &columns,
+                   const DatabaseManager::SqlDumpOptions &options, QIODevice *device, QString *error)
+{
+    QStringList columnNames;
+    for (const auto &col : columns) {
+        columnNames.append(col.name);
+    }
+    QString selectSql = QString("SELECT %1 FROM %2").arg(columnNames.join(", "), tableName);
+    QByteArray insertHead = QString("INSERT INTO %1 (%2) VALUES\n").arg(tableName, columnNames.join(", ")).toUtf8();
+
+    bool copy = options.format == DatabaseManager::SqlDumpOptions::Copy;
+    int rowsPerInsert = qMax(1, options.rowsPerInsert);
+    QByteArray buffer;
+    buffer.reserve(csvFlushBytes + 64 * 1024);
+    qint64 rows = 0;
+    bool writeFailed = false;
+
+    auto flush = [&]() {
+        if (!buffer.isEmpty() && device->write(buffer) != buffer.size()) writeFailed = true;
+        buffer.truncate(0);
+        return !writeFailed;
+    };
+
+    if (copy) {
+        buffer.append(QString("COPY %1 (%2) FROM stdin;\n").arg(tableName, columnNames.join(", ")).toUtf8());
+    }
+
+    auto addRow = [&](auto isNull, auto text) {
+        if (!copy) {
+            buffer.append(rows % rowsPerInsert == 0 ? insertHead : QByteArray(",\n"));
+        }
+        appendDumpRow(buffer, columns, options.format, isNull, text);
+        ++rows;
+        if (!copy && rows % rowsPerInsert == 0) buffer.append(";\n");
+        return buffer.size() < csvFlushBytes || flush();
+    };
+
+    bool ok;
+    if (PgNativeResult::isAvailable(connection)) {
+        ok = PgNativeResult::stream(connection, selectSql, nativeChunkRows, [&](const PgNativeResult &chunk) {
+            for (int r = 0; r < chunk.rowCount(); ++r) {
+                if (!addRow([&](int c) { return chunk.isNull(r, c); },
+                            [&](int c) { return chunk.text(r, c); })) {
+                    return false;
+                }
+            }
+            return true;
+        }, error);
+    } else {
+        QSqlQuery query(connection);
+        query.setForwardOnly(true);
+        ok = DbMetrics::exec(query, selectSql);
+        if (!ok && error) *error = query.lastError().text();
+        while (ok && query.next()) {
+            QList<QByteArray> values;
+            for (int c = 0; c < columns.size(); ++c) {
+                QVariant value = query.value(c);
+                if (value.isNull()) {
+                    values.append(QByteArray());
+                } else if (value.typeId() == QMetaType::QDateTime) {
+                    values.append(value.toDateTime().toString(Qt::ISODateWithMs).toUtf8());
+                } else {
+                    values.append(value.toString().toUtf8());
+                }
+            }
+            ok = addRow([&](int c) { return values[c].isNull(); },
+                        [&](int c) { return QByteArrayView(values[c]); });
+        }
+    }
+
+    if (copy) {
+        buffer.append("\\.\n\n");
+    } else if (rows % rowsPerInsert != 0) {
+        buffer.append(";\n\n");
+    } else if (rows > 0) {
+        buffer.append("\n");
+    }
+    if (!flush()) ok = false;
+
+    if (writeFailed && error) *error = "Failed to write SQL dump";
+    DbMetrics::addTransfer(rows, 0);
+    return ok;
+}
+}
 
 DatabaseManager::DatabaseManager()
-    : schemaName("libraryschema")
+    : schemaName(settings.schemaName), replica(new ReplicaCache(*this))
 {
 }
 
 DatabaseManager::~DatabaseManager()
 {
+    delete replica;
     disconnectFromDatabase();
 }
 
@@ -21,17 +581,40 @@ DatabaseManager& DatabaseManager::instance()
     return instance;
 }
 
+void DatabaseManager::setConnectionSettings(const ConnectionSettings &settings)
+{
+    disconnectFromDatabase();
+    this->settings = settings;
+    schemaName = settings.schemaName;
+}
+
+DatabaseManager::ConnectionSettings DatabaseManager::connectionSettings() const
+{
+    return settings;
+}
+
 bool DatabaseManager::connectToDatabase()
 {
+    DbMetrics::Scope metricsScope(DbMetrics::Connect);
+
     if (db.isOpen()) {
         return true;
     }
 
+    QString replicaPath = qEnvironmentVariable("LIBRARY_REPLICA");
+    if (!replicaPath.isEmpty() && !replica->isOpen()) {
+        QString replicaError;
+        if (!replica->open(replicaPath, &replicaError)) {
+            qDebug() << "Replica cache error:" << replicaError;
+        }
+    }
+
     db = QSqlDatabase::addDatabase("QPSQL");
-    db.setHostName("localhost");
-    db.setDatabaseName("library");
-    db.setUserName("roflan");
-    db.setPassword("Begemot12345");
+    db.setHostName(settings.hostName);
+    db.setPort(settings.port);
+    db.setDatabaseName(settings.databaseName);
+    db.setUserName(settings.userName);
+    db.setPassword(settings.password);
 
     if (!db.open()) {
         qDebug() << "Database connection error:" << db.lastError().text();
@@ -39,13 +622,14 @@ bool DatabaseManager::connectToDatabase()
     }
 
     QSqlQuery query(db);
-    query.exec(QString("SET search_path TO %1").arg(schemaName));
+    DbMetrics::exec(query, QString("SET search_path TO %1").arg(schemaName));
 
     return true;
 }
 
 void DatabaseManager::disconnectFromDatabase()
 {
+    clearPreparedStatements();
     if (db.isOpen()) {
         db.close();
     }
@@ -58,16 +642,24 @@ bool DatabaseManager::isConnected() const
 
 QStringList DatabaseManager::getTableNames()
 {
+    DbMetrics::Scope metricsScope(DbMetrics::GetTableNames);
+
+    if (!db.isOpen() && replica->isOpen()) {
+        return replica->mirroredTables();
+    }
+
     QStringList tables;
 
     QSqlQuery query(db);
+    // Partitions are reached through their parent table.
     QString queryStr = QString(
-                           "SELECT table_name FROM information_schema.tables "
-                           "WHERE table_schema = '%1' AND table_type = 'BASE TABLE' "
-                           "ORDER BY table_name"
+                           "SELECT c.relname FROM pg_class c "
+                           "JOIN pg_namespace n ON n.oid = c.relnamespace "
+                           "WHERE n.nspname = '%1' AND c.relkind IN ('r', 'p') AND NOT c.relispartition "
+                           "ORDER BY c.relname"
                            ).arg(schemaName);
 
-    if (query.exec(queryStr)) {
+    if (DbMetrics::exec(query, queryStr)) {
         while (query.next()) {
             tables.append(query.value(0).toString());
         }
@@ -78,22 +670,27 @@ QStringList DatabaseManager::getTableNames()
 
 bool DatabaseManager::changeColumnType(const QString &tableName, const QString &columnName, const QString &newType, QString *error)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::ChangeColumnType);
+
     QString queryStr = QString("ALTER TABLE %1 ALTER COLUMN %2 TYPE %3")
     .arg(tableName, columnName, newType);
 
     QSqlQuery query(db);
-    if (!query.exec(queryStr)) {
+    if (!DbMetrics::exec(query, queryStr)) {
         if (error) *error = query.lastError().text();
         return false;
     }
 
+    replica->invalidate(tableName, true);
     return true;
 }
 
 QSqlQuery DatabaseManager::executeQuery(const QString &queryStr, bool *ok, QString *error)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::ExecuteQuery);
+
     QSqlQuery query(db);
-    bool success = query.exec(queryStr);
+    bool success = DbMetrics::exec(query, queryStr);
 
     if (ok) {
         *ok = success;
@@ -103,14 +700,20 @@ QSqlQuery DatabaseManager::executeQuery(const QString &queryStr, bool *ok, QStri
         *error = query.lastError().text();
     }
 
+    if (success && !query.isSelect()) {
+        replica->invalidateAll();
+    }
+
     return query;
 }
 
 int DatabaseManager::executeNonQuery(const QString &queryStr, QString *error)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::ExecuteNonQuery);
+
     QSqlQuery query(db);
 
-    if (!query.exec(queryStr)) {
+    if (!DbMetrics::exec(query, queryStr)) {
         if (error) {
             *error = query.lastError().text();
         }
@@ -120,56 +723,134 @@ int DatabaseManager::executeNonQuery(const QString &queryStr, QString *error)
     return query.numRowsAffected();
 }
 
+bool DatabaseManager::executePrepared(const QString &queryStr, const QVariantList &params, QueryResult &result,
+                                      QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::ExecutePrepared);
+
+    result = QueryResult();
+
+    preparedOrder.removeOne(queryStr);
+    preparedOrder.append(queryStr);
+    while (preparedOrder.size() > preparedCacheSize) {
+        QString evicted = preparedOrder.takeFirst();
+        QString name = preparedNames.take(evicted);
+        if (!name.isEmpty()) {
+            PgNativeResult::exec(db, "DEALLOCATE " + name);
+        }
+        preparedQueries.remove(evicted);
+    }
+
+    if (PgNativeResult::isAvailable(db)) {
+        QString name = preparedNames.value(queryStr);
+        if (name.isEmpty()) {
+            name = QString("library_stmt_%1").arg(++preparedSerial);
+            if (!PgNativeResult::prepare(db, name, queryStr, error)) {
+                preparedOrder.removeOne(queryStr);
+                return false;
+            }
+            preparedNames.insert(queryStr, name);
+        }
+
+        PgNativeResult native = PgNativeResult::execPrepared(db, name, params);
+        if (!native.isValid()) {
+            if (error) *error = native.errorMessage();
+            return false;
+        }
+
+        for (int c = 0; c < native.columnCount(); ++c) {
+            result.headers.append(native.columnName(c));
+        }
+        result.rows.reserve(native.rowCount());
+        for (int r = 0; r < native.rowCount(); ++r) {
+            QVariantList row;
+            row.reserve(native.columnCount());
+            for (int c = 0; c < native.columnCount(); ++c) {
+                row.append(native.value(r, c));
+            }
+            if (DbMetrics::isEnabled()) {
+                DbMetrics::addTransfer(0, DbMetrics::rowBytes(row));
+            }
+            result.rows.append(row);
+        }
+        result.rowsAffected = native.rowsAffected();
+        if (result.headers.isEmpty()) {
+            replica->invalidateAll();
+        }
+        return true;
+    }
+
+    // QPSQL keeps $n as is and runs PREPARE once per QSqlQuery, then
+    // EXECUTE with the bound values.
+    auto it = preparedQueries.find(queryStr);
+    if (it == preparedQueries.end()) {
+        QSqlQuery query(db);
+        if (!query.prepare(queryStr)) {
+            if (error) *error = query.lastError().text();
+            preparedOrder.removeOne(queryStr);
+            return false;
+        }
+        it = preparedQueries.insert(queryStr, query);
+    }
+
+    QSqlQuery &query = *it;
+    for (int i = 0; i < params.size(); ++i) {
+        query.bindValue(i, params[i]);
+    }
+    if (!DbMetrics::exec(query)) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+
+    if (query.isSelect()) {
+        QSqlRecord record = query.record();
+        for (int i = 0; i < record.count(); ++i) {
+            result.headers.append(record.fieldName(i));
+        }
+        while (query.next()) {
+            QVariantList row;
+            row.reserve(record.count());
+            for (int i = 0; i < record.count(); ++i) {
+                row.append(query.value(i));
+            }
+            if (DbMetrics::isEnabled()) {
+                DbMetrics::addTransfer(0, DbMetrics::rowBytes(row));
+            }
+            result.rows.append(row);
+        }
+    } else {
+        result.rowsAffected = query.numRowsAffected();
+        replica->invalidateAll();
+    }
+    return true;
+}
+
+// Statements die with the session, so only the bookkeeping is dropped.
+void DatabaseManager::clearPreparedStatements()
+{
+    preparedNames.clear();
+    preparedQueries.clear();
+    preparedOrder.clear();
+}
+
 QList<DatabaseManager::ColumnInfo> DatabaseManager::getTableColumns(const QString &tableName)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::GetTableColumns);
+
+    // Writes and DDL build their statements from this metadata, so the
+    // replica only stands in when the server is unreachable.
+    if (!db.isOpen() && replica->ensureFreshSchema(tableName)) {
+        return replica->tableColumns(tableName);
+    }
+
     QList<ColumnInfo> columns;
 
     QSqlQuery query(db);
-    QString queryStr = QString(
-                           "SELECT "
-                           "    c.column_name, "
-                           "    c.data_type, "
-                           "    c.udt_name, "
-                           "    c.is_nullable, "
-                           "    c.column_default, "
-                           "    CASE WHEN pk.column_name IS NOT NULL THEN true ELSE false END AS is_primary, "
-                           "    CASE "
-                           "        WHEN c.column_default LIKE 'nextval%%' THEN true "
-                           "        WHEN c.is_identity = 'YES' THEN true "
-                           "        ELSE false "
-                           "    END AS is_identity "
-                           "FROM information_schema.columns c "
-                           "LEFT JOIN ( "
-                           "    SELECT ku.column_name "
-                           "    FROM information_schema.table_constraints tc "
-                           "    JOIN information_schema.key_column_usage ku "
-                           "        ON tc.constraint_name = ku.constraint_name "
-                           "        AND tc.table_schema = ku.table_schema "
-                           "    WHERE tc.constraint_type = 'PRIMARY KEY' "
-                           "        AND tc.table_schema = '%1' "
-                           "        AND tc.table_name = '%2' "
-                           ") pk ON c.column_name = pk.column_name "
-                           "WHERE c.table_schema = '%1' AND c.table_name = '%2' "
-                           "ORDER BY c.ordinal_position"
-                           ).arg(schemaName, tableName);
+    QString queryStr = columnsQuery(schemaName, tableName);
 
-    if (query.exec(queryStr)) {
+    if (DbMetrics::exec(query, queryStr)) {
         while (query.next()) {
-            ColumnInfo col;
-            col.name = query.value(0).toString();
-            QString dataType = query.value(1).toString();
-            QString udtName = query.value(2).toString();
-
-            col.fullType = (dataType == "USER-DEFINED") ? udtName : dataType;
-            if (col.fullType == "int8") col.fullType = "bigint";
-            if (col.fullType == "int4") col.fullType = "integer";
-
-            col.type = col.fullType.contains("int") ? "int" : "text";
-            col.isNullable = query.value(3).toString() == "YES";
-            col.defaultValue = query.value(4).toString();
-            col.isPrimaryKey = query.value(5).toBool();
-            col.isIdentity = query.value(6).toBool();
-            columns.append(col);
+            columns.append(columnFromValues([&](int i) { return query.value(i); }));
         }
     }
 
@@ -178,174 +859,604 @@ QList<DatabaseManager::ColumnInfo> DatabaseManager::getTableColumns(const QStrin
 
 QList<DatabaseManager::ForeignKeyInfo> DatabaseManager::getTableForeignKeys(const QString &tableName)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::GetTableForeignKeys);
+
     QList<ForeignKeyInfo> fks;
 
     QSqlQuery query(db);
-    QString queryStr = QString(
-                           "SELECT "
-                           "    tc.constraint_name, "
-                           "    kcu.column_name, "
-                           "    ccu.table_name AS foreign_table_name, "
-                           "    ccu.column_name AS foreign_column_name, "
-                           "    rc.delete_rule, "
-                           "    rc.update_rule "
-                           "FROM information_schema.table_constraints AS tc "
-                           "JOIN information_schema.key_column_usage AS kcu "
-                           "    ON tc.constraint_name = kcu.constraint_name "
-                           "    AND tc.table_schema = kcu.table_schema "
-                           "JOIN information_schema.constraint_column_usage AS ccu "
-                           "    ON ccu.constraint_name = tc.constraint_name "
-                           "    AND ccu.table_schema = tc.table_schema "
-                           "JOIN information_schema.referential_constraints AS rc "
-                           "    ON rc.constraint_name = tc.constraint_name "
-                           "    AND rc.constraint_schema = tc.table_schema "
-                           "WHERE tc.constraint_type = 'FOREIGN KEY' "
-                           "    AND tc.table_schema = '%1' "
-                           "    AND tc.table_name = '%2'"
-                           ).arg(schemaName, tableName);
+    QString queryStr = foreignKeysQuery(schemaName, tableName);
+
+    if (DbMetrics::exec(query, queryStr)) {
+        while (query.next()) {
+            fks.append(foreignKeyFromValues([&](int i) { return query.value(i); }));
+        }
+    }
+
+    return fks;
+}
+
+QList<DatabaseManager::ConstraintInfo> DatabaseManager::getTableConstraints(const QString &tableName)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::GetTableConstraints);
+
+    QList<ConstraintInfo> constraints;
+
+    QSqlQuery query(db);
+    QString queryStr = constraintsQuery(schemaName, tableName);
+
+    if (DbMetrics::exec(query, queryStr)) {
+        while (query.next()) {
+            constraints.append(constraintFromValues([&](int i) { return query.value(i); }));
+        }
+    }
+
+    return constraints;
+}
+
+QMap<QString, DatabaseManager::TableSchema> DatabaseManager::getTableSchemas(const QStringList &tables, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::GetTableSchemas);
+
+    QMap<QString, TableSchema> schemas;
+    PgPipeline pipeline(db);
+
+    for (const QString &tableName : tables) {
+        pipeline.add(columnsQuery(schemaName, tableName));
+        pipeline.add(foreignKeysQuery(schemaName, tableName));
+        pipeline.add(constraintsQuery(schemaName, tableName));
+        pipeline.add(partitionsQuery(schemaName, tableName));
+    }
+
+    if (!pipeline.run(error)) {
+        return schemas;
+    }
+
+    for (int t = 0; t < tables.size(); ++t) {
+        TableSchema &schema = schemas[tables[t]];
+
+        for (const QVariantList &row : pipeline.result(t * 4).rows) {
+            schema.columns.append(columnFromValues([&](int i) { return row.value(i); }));
+        }
+        for (const QVariantList &row : pipeline.result(t * 4 + 1).rows) {
+            schema.foreignKeys.append(foreignKeyFromValues([&](int i) { return row.value(i); }));
+        }
+        for (const QVariantList &row : pipeline.result(t * 4 + 2).rows) {
+            schema.constraints.append(constraintFromValues([&](int i) { return row.value(i); }));
+        }
+        for (const QVariantList &row : pipeline.result(t * 4 + 3).rows) {
+            addPartitionRow(schema.partitioning, [&](int i) { return row.value(i); });
+        }
+    }
+
+    return schemas;
+}
+
+QList<QVariantList> DatabaseManager::getTableData(const QString &tableName)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::GetTableData);
+
+    if (replica->ensureFresh(tableName)) {
+        bool ok = false;
+        QList<QVariantList> replicaData = replica->tableData(tableName, &ok);
+        if (ok) return replicaData;
+    }
+
+    return readTableData(tableName);
+}
+
+QList<QVariantList> DatabaseManager::readTableData(const QString &tableName)
+{
+    QList<QVariantList> data;
+
+    auto columns = getTableColumns(tableName);
+    QStringList columnNames;
+    for (const auto &col : columns) {
+        columnNames.append(col.name);
+    }
+
+    QString queryStr = QString("SELECT %1 FROM %2").arg(columnNames.join(", "), tableName);
+
+    if (PgNativeResult::isAvailable(db)) {
+        PgNativeResult::Format format = PgNativeResult::TextFormat;
+        if (PgNativeResult::isBinaryEnabled()) {
+            // Binary is all-or-nothing per query, so columns without a
+            // decoder are sent as text.
+            QStringList selectList;
+            for (const auto &col : columns) {
+                selectList.append(PgNativeResult::hasBinaryDecoder(col.fullType)
+                                      ? col.name
+                                      : QString("%1::text AS %1").arg(col.name));
+            }
+            queryStr = QString("SELECT %1 FROM %2").arg(selectList.join(", "), tableName);
+            format = PgNativeResult::BinaryFormat;
+        }
+
+        PgNativeResult result = PgNativeResult::exec(db, queryStr, format);
+        if (result.isValid()) {
+            int rowCount = result.rowCount();
+            int columnCount = result.columnCount();
+            data.reserve(rowCount);
+            for (int r = 0; r < rowCount; ++r) {
+                QVariantList row;
+                row.reserve(columnCount);
+                for (int c = 0; c < columnCount; ++c) {
+                    row.append(result.value(r, c));
+                }
+                if (DbMetrics::isEnabled()) {
+                    DbMetrics::addTransfer(0, DbMetrics::rowBytes(row));
+                }
+                data.append(row);
+            }
+        }
+        return data;
+    }
+
+    QSqlQuery query(db);
+    if (DbMetrics::exec(query, queryStr)) {
+        while (query.next()) {
+            QVariantList row;
+            for (int i = 0; i < columns.size(); ++i) {
+                row.append(query.value(i));
+            }
+            if (DbMetrics::isEnabled()) {
+                DbMetrics::addTransfer(0, DbMetrics::rowBytes(row));
+            }
+            data.append(row);
+        }
+    }
+
+    return data;
+}
+
+QList<QVariantList> DatabaseManager::getTableDataPage(const QString &tableName, int limit,
+                                                      TablePageCursor *cursor, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::GetTableDataPage);
+
+    QList<QVariantList> data;
+    if (cursor->atEnd) return data;
+
+    auto columns = getTableColumns(tableName);
+    QStringList columnNames;
+    QStringList keyColumns;
+    QList<int> keyIndexes;
+    for (int i = 0; i < columns.size(); ++i) {
+        columnNames.append(columns[i].name);
+        if (columns[i].isPrimaryKey) {
+            keyColumns.append(columns[i].name);
+            keyIndexes.append(i);
+        }
+    }
+
+    if (keyColumns.isEmpty()) {
+        return readTableBlocks(tableName, columnNames, limit, cursor, error);
+    }
+
+    QString queryStr = QString("SELECT %1 FROM %2").arg(columnNames.join(", "), tableName);
+    if (!cursor->lastKey.isEmpty()) {
+        QStringList placeholders;
+        for (int i = 0; i < keyColumns.size(); ++i) placeholders.append("?");
+        queryStr += QString(" WHERE (%1) > (%2)").arg(keyColumns.join(", "), placeholders.join(", "));
+    }
+    queryStr += QString(" ORDER BY %1 LIMIT %2").arg(keyColumns.join(", ")).arg(limit);
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(queryStr);
+    for (const QVariant &value : cursor->lastKey) {
+        query.addBindValue(value);
+    }
+    if (!DbMetrics::exec(query)) {
+        if (error) *error = query.lastError().text();
+        return data;
+    }
+
+    QVariantList lastKey;
+    while (query.next()) {
+        QVariantList row;
+        row.reserve(columns.size());
+        for (int i = 0; i < columns.size(); ++i) {
+            row.append(query.value(i));
+        }
+        if (DbMetrics::isEnabled()) {
+            DbMetrics::addTransfer(0, DbMetrics::rowBytes(row));
+        }
+        data.append(row);
 
-    if (query.exec(queryStr)) {
-        while (query.next()) {
-            ForeignKeyInfo fk;
-            fk.constraintName = query.value(0).toString();
-            fk.columnName = query.value(1).toString();
-            fk.refTable = query.value(2).toString();
-            fk.refColumn = query.value(3).toString();
-            fk.onDelete = query.value(4).toString();
-            fk.onUpdate = query.value(5).toString();
-            fks.append(fk);
+        lastKey.clear();
+        for (int index : keyIndexes) {
+            lastKey.append(query.value(index));
         }
     }
 
-    return fks;
+    cursor->atEnd = data.size() < limit;
+    if (!data.isEmpty()) {
+        cursor->lastKey = lastKey;
+    }
+    return data;
 }
 
-QList<DatabaseManager::ConstraintInfo> DatabaseManager::getTableConstraints(const QString &tableName)
+// Without a primary key there is nothing cheap to sort on, so the heap is
+// read in physical order: each query is a TID range scan over whole blocks
+// of one leaf relation, sized from the rows-per-block estimate. The last
+// range of a relation is left open so rows appended meanwhile are included.
+QList<QVariantList> DatabaseManager::readTableBlocks(const QString &tableName, const QStringList &columnNames,
+                                                     int limit, TablePageCursor *cursor, QString *error)
 {
-    QList<ConstraintInfo> constraints;
+    const double defaultRowsPerBlock = 32;
 
+    QList<QVariantList> data;
     QSqlQuery query(db);
-    QString queryStr = QString(
-                           "SELECT "
-                           "    con.conname AS constraint_name, "
-                           "    CASE con.contype "
-                           "        WHEN 'c' THEN 'CHECK' "
-                           "        WHEN 'u' THEN 'UNIQUE' "
-                           "        ELSE con.contype::text "
-                           "    END AS constraint_type, "
-                           "    pg_get_constraintdef(con.oid) AS definition "
-                           "FROM pg_constraint con "
-                           "JOIN pg_class cls ON con.conrelid = cls.oid "
-                           "JOIN pg_namespace nsp ON cls.relnamespace = nsp.oid "
-                           "WHERE nsp.nspname = '%1' "
-                           "    AND cls.relname = '%2' "
-                           "    AND con.contype IN ('c', 'u')"
-                           ).arg(schemaName, tableName);
-
-    if (query.exec(queryStr)) {
+    query.setForwardOnly(true);
+
+    if (cursor->relations.isEmpty()) {
+        // For a plain table pg_partition_tree returns just the table itself.
+        query.prepare("SELECT t.relid::regclass::text FROM pg_partition_tree(CAST(? AS regclass)) t "
+                      "JOIN pg_class c ON c.oid = t.relid WHERE c.relkind = 'r' ORDER BY t.relid");
+        query.addBindValue(tableName);
+        if (!DbMetrics::exec(query)) {
+            if (error) *error = query.lastError().text();
+            return data;
+        }
         while (query.next()) {
-            ConstraintInfo c;
-            c.constraintName = query.value(0).toString();
-            c.constraintType = query.value(1).toString();
-            c.definition = query.value(2).toString();
-            constraints.append(c);
+            cursor->relations.append(query.value(0).toString());
         }
     }
 
-    return constraints;
+    while (data.size() < limit && cursor->relationIndex < cursor->relations.size()) {
+        const QString relation = cursor->relations[cursor->relationIndex];
+
+        query.prepare("SELECT pg_relation_size(c.oid) / current_setting('block_size')::int8, "
+                      "CASE WHEN c.relpages > 0 AND c.reltuples > 0 "
+                      "     THEN c.reltuples / c.relpages ELSE 0 END "
+                      "FROM pg_class c WHERE c.oid = CAST(? AS regclass)");
+        query.addBindValue(relation);
+        if (!DbMetrics::exec(query) || !query.next()) {
+            if (error) *error = query.lastError().text();
+            return data;
+        }
+        qint64 blocks = query.value(0).toLongLong();
+        double rowsPerBlock = query.value(1).toDouble();
+        if (rowsPerBlock <= 0) rowsPerBlock = defaultRowsPerBlock;
+
+        while (data.size() < limit && cursor->nextBlock < blocks) {
+            qint64 span = std::max<qint64>(1, qint64(std::ceil((limit - data.size()) / rowsPerBlock)));
+            qint64 endBlock = cursor->nextBlock + span;
+
+            QString queryStr = QString("SELECT %1 FROM %2 WHERE ctid >= '(%3,0)'::tid")
+                                   .arg(columnNames.join(", "), relation).arg(cursor->nextBlock);
+            if (endBlock < blocks) {
+                queryStr += QString(" AND ctid < '(%1,0)'::tid").arg(endBlock);
+            }
+            if (!DbMetrics::exec(query, queryStr)) {
+                if (error) *error = query.lastError().text();
+                return data;
+            }
+            while (query.next()) {
+                QVariantList row;
+                row.reserve(columnNames.size());
+                for (int i = 0; i < columnNames.size(); ++i) {
+                    row.append(query.value(i));
+                }
+                if (DbMetrics::isEnabled()) {
+                    DbMetrics::addTransfer(0, DbMetrics::rowBytes(row));
+                }
+                data.append(row);
+            }
+            cursor->nextBlock = std::min(endBlock, blocks);
+        }
+
+        if (cursor->nextBlock >= blocks) {
+            ++cursor->relationIndex;
+            cursor->nextBlock = 0;
+        }
+    }
+
+    cursor->atEnd = cursor->relationIndex >= cursor->relations.size();
+    return data;
 }
 
-QList<QVariantList> DatabaseManager::getTableData(const QString &tableName)
+// One catalog query for all tables of the schema: reltuples instead of
+// count(*), sizes from the relation forks and counters from pg_stat.
+// Partitioned tables report the sum over their leaf partitions.
+QList<DatabaseManager::TableStats> DatabaseManager::getTableStats(QString *error)
 {
-    QList<QVariantList> data;
+    DbMetrics::Scope metricsScope(DbMetrics::GetTableStats);
 
-    auto columns = getTableColumns(tableName);
-    QStringList columnNames;
-    for (const auto &col : columns) {
-        columnNames.append(col.name);
-    }
+    QList<TableStats> stats;
+
+    QString queryStr = QString(
+                           "SELECT c.relname, agg.reltuples, agg.total_bytes, agg.heap_bytes, agg.index_bytes, "
+                           "    agg.toast_bytes, agg.dead_tuples, agg.last_vacuum, agg.last_analyze, "
+                           "    agg.seq_scan, agg.idx_scan "
+                           "FROM pg_class c "
+                           "JOIN pg_namespace n ON n.oid = c.relnamespace "
+                           "CROSS JOIN LATERAL ( "
+                           "    SELECT CASE WHEN bool_or(l.reltuples < 0) THEN -1 "
+                           "                ELSE COALESCE(SUM(l.reltuples), 0) END::float8 AS reltuples, "
+                           "        COALESCE(SUM(pg_total_relation_size(l.oid)), 0)::bigint AS total_bytes, "
+                           "        COALESCE(SUM(pg_relation_size(l.oid)), 0)::bigint AS heap_bytes, "
+                           "        COALESCE(SUM(pg_indexes_size(l.oid)), 0)::bigint AS index_bytes, "
+                           "        COALESCE(SUM(pg_total_relation_size(NULLIF(l.reltoastrelid, 0))), 0)::bigint AS toast_bytes, "
+                           "        COALESCE(SUM(s.n_dead_tup), 0)::bigint AS dead_tuples, "
+                           "        MAX(GREATEST(s.last_vacuum, s.last_autovacuum)) AS last_vacuum, "
+                           "        MAX(GREATEST(s.last_analyze, s.last_autoanalyze)) AS last_analyze, "
+                           "        COALESCE(SUM(s.seq_scan), 0)::bigint AS seq_scan, "
+                           "        COALESCE(SUM(s.idx_scan), 0)::bigint AS idx_scan "
+                           "    FROM pg_partition_tree(c.oid) t "
+                           "    JOIN pg_class l ON l.oid = t.relid "
+                           "    LEFT JOIN pg_stat_all_tables s ON s.relid = l.oid "
+                           "    WHERE t.isleaf "
+                           ") agg "
+                           "WHERE n.nspname = '%1' AND c.relkind IN ('r', 'p') AND NOT c.relispartition "
+                           "ORDER BY c.relname"
+                           ).arg(schemaName);
 
     QSqlQuery query(db);
-    QString queryStr = QString("SELECT %1 FROM %2").arg(columnNames.join(", "), tableName);
+    if (!DbMetrics::exec(query, queryStr)) {
+        if (error) *error = query.lastError().text();
+        return stats;
+    }
 
-    if (query.exec(queryStr)) {
-        while (query.next()) {
-            QVariantList row;
-            for (int i = 0; i < columns.size(); ++i) {
-                row.append(query.value(i));
-            }
-            data.append(row);
+    while (query.next()) {
+        TableStats table;
+        table.tableName = query.value(0).toString();
+        table.estimatedRows = query.value(1).toDouble();
+        table.totalBytes = query.value(2).toLongLong();
+        table.heapBytes = query.value(3).toLongLong();
+        table.indexBytes = query.value(4).toLongLong();
+        table.toastBytes = query.value(5).toLongLong();
+        table.deadTuples = query.value(6).toLongLong();
+        table.lastVacuum = query.value(7).toDateTime();
+        table.lastAnalyze = query.value(8).toDateTime();
+        table.seqScans = query.value(9).toLongLong();
+        table.indexScans = query.value(10).toLongLong();
+
+        // Before PostgreSQL 14 an unanalyzed table reports 0 rows; a
+        // table with pages but no rows is treated as unknown.
+        if (table.estimatedRows == 0 && table.heapBytes > 0 && !table.lastAnalyze.isValid()
+            && !table.lastVacuum.isValid()) {
+            table.estimatedRows = -1;
         }
+        if (table.estimatedRows < 0) table.estimatedRows = -1;
+        stats.append(table);
     }
 
-    return data;
+    return stats;
 }
 
 bool DatabaseManager::createTable(const QString &tableName, const QList<ColumnInfo> &columns, QString *error)
 {
+    return createTable(tableName, columns, PartitionSpec(), error);
+}
+
+bool DatabaseManager::createTable(const QString &tableName, const QList<ColumnInfo> &columns,
+                                  const PartitionSpec &partitioning, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::CreateTable);
+
     if (columns.isEmpty()) {
         if (error) *error = "No columns specified";
         return false;
     }
 
-    QStringList columnDefs;
-    QStringList primaryKeys;
+    QString queryStr = createTableStatement(tableName, columns);
+
+    if (partitioning.strategy == PartitionSpec::None) {
+        QSqlQuery query(db);
+        if (!DbMetrics::exec(query, queryStr)) {
+            if (error) *error = query.lastError().text();
+            return false;
+        }
+        return true;
+    }
 
+    QString key = partitioning.key.trimmed();
+    QStringList primaryKeys;
+    bool dateKey = false;
     for (const auto &col : columns) {
-        QString colDef;
-        if (col.isIdentity) {
-            colDef = QString("%1 BIGSERIAL").arg(col.name);
-        } else {
-            QString colType = col.fullType.isEmpty() ?
-                                  (col.type.toUpper() == "INT" ? "BIGINT" : "TEXT") :
-                                  col.fullType.toUpper();
-            colDef = QString("%1 %2").arg(col.name, colType);
+        if (col.isPrimaryKey) primaryKeys.append(col.name);
+        if (col.name == key) {
+            QString type = col.fullType.toLower();
+            dateKey = type.startsWith("date") || type.startsWith("timestamp");
         }
+    }
 
-        if (!col.isNullable && !col.isIdentity) {
-            colDef += " NOT NULL";
+    QString failure;
+    if (key.isEmpty()) {
+        failure = "Partition key is required";
+    } else if (!primaryKeys.isEmpty() && !primaryKeys.contains(key)) {
+        failure = QString("Primary key of a partitioned table must include the partition key %1").arg(key);
+    } else if (partitioning.strategy == PartitionSpec::Hash && partitioning.modulus < 1) {
+        failure = "Hash partitioning needs at least one partition";
+    }
+    if (!failure.isEmpty()) {
+        if (error) *error = failure;
+        return false;
+    }
+
+    static const char *const strategies[] = {"", "RANGE", "LIST", "HASH"};
+    QStringList statements = {queryStr + QString(" PARTITION BY %1 (%2)").arg(strategies[partitioning.strategy], key)};
+
+    if (partitioning.strategy == PartitionSpec::Range && dateKey) {
+        QDate today = QDate::currentDate();
+        QDate from = intervalStart(partitioning.start.isValid() ? partitioning.start : today, partitioning.interval);
+        QDate until = intervalStart(today, partitioning.interval);
+        for (int i = 0; i < partitioning.premake; ++i) {
+            until = nextInterval(until, partitioning.interval);
+        }
+        statements += rangePartitionStatements(tableName, from, until, partitioning.interval);
+    } else if (partitioning.strategy == PartitionSpec::List) {
+        for (int i = 0; i < partitioning.listValues.size(); ++i) {
+            QStringList literals;
+            for (const QString &value : partitioning.listValues[i]) {
+                literals.append("'" + QString(value).replace("'", "''") + "'");
+            }
+            statements.append(QString("CREATE TABLE %1_p%2 PARTITION OF %1 FOR VALUES IN (%3)")
+                                  .arg(tableName, QString::number(i), literals.join(", ")));
+        }
+    } else if (partitioning.strategy == PartitionSpec::Hash) {
+        for (int i = 0; i < partitioning.modulus; ++i) {
+            statements.append(QString("CREATE TABLE %1_p%2 PARTITION OF %1 FOR VALUES WITH (MODULUS %3, REMAINDER %2)")
+                                  .arg(tableName, QString::number(i), QString::number(partitioning.modulus)));
         }
+    }
 
-        if (!col.defaultValue.isEmpty() && !col.isIdentity) {
-            colDef += " DEFAULT " + col.defaultValue;
+    if (partitioning.defaultPartition && partitioning.strategy != PartitionSpec::Hash) {
+        statements.append(QString("CREATE TABLE %1_default PARTITION OF %1 DEFAULT").arg(tableName));
+    }
+
+    // Pipelined, the parent and its partitions share one implicit
+    // transaction; run one by one, a half-created table is dropped.
+    PgPipeline pipeline(db);
+    for (const QString &statement : statements) {
+        pipeline.add(statement);
+    }
+    if (!pipeline.run(error)) {
+        if (pipeline.failedIndex() > 0) {
+            QSqlQuery cleanup(db);
+            DbMetrics::exec(cleanup, QString("DROP TABLE IF EXISTS %1 CASCADE").arg(tableName));
         }
+        return false;
+    }
 
-        columnDefs.append(colDef);
+    return true;
+}
 
-        if (col.isPrimaryKey) {
-            primaryKeys.append(col.name);
+DatabaseManager::PartitionLayout DatabaseManager::getTablePartitioning(const QString &tableName, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::GetTablePartitioning);
+
+    PartitionLayout layout;
+
+    QSqlQuery query(db);
+    if (!DbMetrics::exec(query, partitionsQuery(schemaName, tableName))) {
+        if (error) *error = query.lastError().text();
+        return layout;
+    }
+
+    while (query.next()) {
+        addPartitionRow(layout, [&](int i) { return query.value(i); });
+    }
+
+    return layout;
+}
+
+// Continues the latest date range partition of the table through premake
+// intervals past the current one. The interval is taken from that
+// partition's bounds; tables with other range keys are left alone.
+bool DatabaseManager::ensurePartitions(const QString &tableName, int premake, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::MaintainPartitions);
+    static const QRegularExpression rangeBound(
+        "FROM \\('(\\d{4}-\\d{2}-\\d{2})[^']*'\\) TO \\('(\\d{4}-\\d{2}-\\d{2})[^']*'\\)");
+
+    QString layoutError;
+    PartitionLayout layout = getTablePartitioning(tableName, &layoutError);
+    if (!layoutError.isEmpty()) {
+        if (error) *error = layoutError;
+        return false;
+    }
+    if (!layout.key.startsWith("RANGE")) return true;
+
+    QDate lastFrom;
+    QDate lastTo;
+    for (const auto &partition : layout.partitions) {
+        auto match = rangeBound.match(partition.bound);
+        if (!match.hasMatch()) continue;
+        QDate to = QDate::fromString(match.captured(2), Qt::ISODate);
+        if (!lastTo.isValid() || to > lastTo) {
+            lastFrom = QDate::fromString(match.captured(1), Qt::ISODate);
+            lastTo = to;
         }
     }
+    if (!lastTo.isValid()) return true;
+
+    PartitionSpec::Interval interval;
+    if (lastFrom.addDays(1) == lastTo) {
+        interval = PartitionSpec::Day;
+    } else if (lastFrom.addMonths(1) == lastTo) {
+        interval = PartitionSpec::Month;
+    } else if (lastFrom.addYears(1) == lastTo) {
+        interval = PartitionSpec::Year;
+    } else {
+        return true;
+    }
 
-    QString queryStr = QString("CREATE TABLE %1 (%2").arg(tableName, columnDefs.join(", "));
+    QDate until = intervalStart(QDate::currentDate(), interval);
+    for (int i = 0; i < premake; ++i) {
+        until = nextInterval(until, interval);
+    }
 
-    if (!primaryKeys.isEmpty()) {
-        queryStr += QString(", PRIMARY KEY (%1)").arg(primaryKeys.join(", "));
+    QStringList statements = rangePartitionStatements(tableName, lastTo, until, interval);
+    if (statements.isEmpty()) return true;
+
+    TraceSpan traceSpan("db", "ensurePartitions");
+    traceSpan.addArg("table", tableName);
+    traceSpan.addArg("partitions", statements.size());
+
+    PgPipeline pipeline(db);
+    for (const QString &statement : statements) {
+        pipeline.add(statement);
     }
+    return pipeline.run(error);
+}
 
-    queryStr += ")";
+bool DatabaseManager::maintainPartitions(int premake, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::MaintainPartitions);
+
+    QString queryStr = QString(
+                           "SELECT c.relname FROM pg_partitioned_table pt "
+                           "JOIN pg_class c ON c.oid = pt.partrelid "
+                           "JOIN pg_namespace n ON n.oid = c.relnamespace "
+                           "WHERE n.nspname = '%1' AND pt.partstrat = 'r' AND NOT c.relispartition "
+                           "ORDER BY c.relname"
+                           ).arg(schemaName);
 
     QSqlQuery query(db);
-    if (!query.exec(queryStr)) {
+    if (!DbMetrics::exec(query, queryStr)) {
         if (error) *error = query.lastError().text();
         return false;
     }
 
+    QStringList tables;
+    while (query.next()) {
+        tables.append(query.value(0).toString());
+    }
+
+    QStringList failures;
+    for (const QString &tableName : tables) {
+        QString tableError;
+        if (!ensurePartitions(tableName, premake, &tableError)) {
+            failures.append(tableName + ": " + tableError);
+        }
+    }
+
+    if (!failures.isEmpty()) {
+        if (error) *error = failures.join("\n");
+        return false;
+    }
     return true;
 }
 
 bool DatabaseManager::dropTable(const QString &tableName, QString *error)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::DropTable);
+
     QSqlQuery query(db);
-    if (!query.exec(QString("DROP TABLE IF EXISTS %1 CASCADE").arg(tableName))) {
+    if (!DbMetrics::exec(query, QString("DROP TABLE IF EXISTS %1 CASCADE").arg(tableName))) {
         if (error) *error = query.lastError().text();
         return false;
     }
+    replica->invalidate(tableName, true);
     return true;
 }
 
 bool DatabaseManager::insertRow(const QString &tableName, const QVariantList &values, QString *error)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::InsertRow);
+
     auto columns = getTableColumns(tableName);
 
     if (values.size() != columns.size()) {
@@ -385,41 +1496,50 @@ bool DatabaseManager::insertRow(const QString &tableName, const QVariantList &va
 
     for (const auto &val : bindValues) query.addBindValue(val);
 
-    if (!query.exec()) {
+    if (!DbMetrics::exec(query)) {
         if (error) *error = query.lastError().text();
         return false;
     }
 
+    replica->invalidate(tableName);
     return true;
 }
 
 bool DatabaseManager::syncSequence(const QString &tableName, QString *error)
 {
-    auto columns = getTableColumns(tableName);
+    return syncSequences({tableName}, error);
+}
 
-    for (const auto &col : columns) {
-        if (col.isIdentity) {
-            QString seqName = QString("%1_%2_seq").arg(tableName, col.name);
+bool DatabaseManager::syncSequences(const QStringList &tables, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::SyncSequence);
 
-            QString queryStr = QString(
-                                   "SELECT setval('%1', "
-                                   "   COALESCE((SELECT MAX(%2) FROM %3), 1), "
-                                   "   false)"
-                                   ).arg(seqName, col.name, tableName);
+    if (tables.isEmpty()) return true;
 
-            QSqlQuery query(db);
-            if (!query.exec(queryStr)) {
-                if (error) *error = query.lastError().text();
-                return false;
-            }
-        }
+    QSqlQuery query(db);
+    if (!DbMetrics::exec(query, sequenceSyncBlock(schemaName, tables))) {
+        if (error) *error = query.lastError().text();
+        return false;
     }
+    return true;
+}
+
+bool DatabaseManager::syncAllSequences(QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::SyncSequence);
 
+    QSqlQuery query(db);
+    if (!DbMetrics::exec(query, sequenceSyncBlock(schemaName, QStringList()))) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
     return true;
 }
 
 bool DatabaseManager::deleteRow(const QString &tableName, const QVariantList &primaryKeyValues, QString *error)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::DeleteRow);
+
     auto columns = getTableColumns(tableName);
     QStringList pkColumns;
 
@@ -454,11 +1574,12 @@ bool DatabaseManager::deleteRow(const QString &tableName, const QVariantList &pr
         query.addBindValue(value);
     }
 
-    if (!query.exec()) {
+    if (!DbMetrics::exec(query)) {
         if (error) *error = query.lastError().text();
         return false;
     }
 
+    replica->invalidate(tableName);
     return true;
 }
 
@@ -468,6 +1589,8 @@ bool DatabaseManager::updateCell(const QString &tableName,
                                  const QVariantList &primaryKeyValues,
                                  QString *error)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::UpdateCell);
+
     auto columns = getTableColumns(tableName);
     QList<ColumnInfo> pkColumns;
     for (const auto &col : columns) {
@@ -493,16 +1616,19 @@ bool DatabaseManager::updateCell(const QString &tableName,
     query.addBindValue(value);
     for (const auto &val : primaryKeyValues) query.addBindValue(val);
 
-    if (!query.exec()) {
+    if (!DbMetrics::exec(query)) {
         if (error) *error = query.lastError().text();
         return false;
     }
 
+    replica->invalidate(tableName);
     return true;
 }
 
 bool DatabaseManager::addColumn(const QString &tableName, const ColumnInfo &column, QString *error)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::AddColumn);
+
     QString dataType;
     if (column.isIdentity) {
         dataType = "BIGSERIAL";
@@ -514,24 +1640,28 @@ bool DatabaseManager::addColumn(const QString &tableName, const ColumnInfo &colu
                            .arg(tableName, column.name, dataType);
 
     QSqlQuery query(db);
-    if (!query.exec(queryStr)) {
+    if (!DbMetrics::exec(query, queryStr)) {
         if (error) *error = query.lastError().text();
         return false;
     }
 
+    replica->invalidate(tableName, true);
     return true;
 }
 
 bool DatabaseManager::dropColumn(const QString &tableName, const QString &columnName, QString *error)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::DropColumn);
+
     QString queryStr = QString("ALTER TABLE %1 DROP COLUMN %2").arg(tableName, columnName);
 
     QSqlQuery query(db);
-    if (!query.exec(queryStr)) {
+    if (!DbMetrics::exec(query, queryStr)) {
         if (error) *error = query.lastError().text();
         return false;
     }
 
+    replica->invalidate(tableName, true);
     return true;
 }
 
@@ -542,11 +1672,174 @@ QSqlDatabase& DatabaseManager::getDatabase()
 
 bool DatabaseManager::renameColumn(const QString &tableName, const QString &oldName, const QString &newName, QString *error)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::RenameColumn);
+
     QString queryStr = QString("ALTER TABLE %1 RENAME COLUMN %2 TO %3")
     .arg(tableName, oldName, newName);
 
     QSqlQuery query(db);
-    if (!query.exec(queryStr)) {
+    if (!DbMetrics::exec(query, queryStr)) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+
+    replica->invalidate(tableName, true);
+    return true;
+}
+
+QList<DatabaseManager::IndexInfo> DatabaseManager::getTableIndexes(const QString &tableName, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::GetTableIndexes);
+
+    QList<IndexInfo> indexes;
+
+    // Key columns come first in the index, INCLUDE columns after indnkeyatts.
+    QString queryStr = QString(
+                           "SELECT ic.relname, am.amname, i.indisunique, i.indisprimary, i.indisvalid, "
+                           "    i.indnkeyatts, "
+                           "    array_to_json(ARRAY(SELECT pg_get_indexdef(i.indexrelid, k, true) "
+                           "                        FROM generate_series(1, i.indnatts) k ORDER BY k))::text, "
+                           "    pg_get_expr(i.indpred, i.indrelid, true), "
+                           "    pg_relation_size(i.indexrelid), "
+                           "    COALESCE(s.idx_scan, 0), COALESCE(s.idx_tup_read, 0), "
+                           "    pg_get_indexdef(i.indexrelid) "
+                           "FROM pg_index i "
+                           "JOIN pg_class t ON t.oid = i.indrelid "
+                           "JOIN pg_namespace n ON n.oid = t.relnamespace "
+                           "JOIN pg_class ic ON ic.oid = i.indexrelid "
+                           "JOIN pg_am am ON am.oid = ic.relam "
+                           "LEFT JOIN pg_stat_all_indexes s ON s.indexrelid = i.indexrelid "
+                           "WHERE n.nspname = '%1' AND t.relname = '%2' "
+                           "ORDER BY i.indisprimary DESC, ic.relname"
+                           ).arg(schemaName, tableName);
+
+    QSqlQuery query(db);
+    if (!DbMetrics::exec(query, queryStr)) {
+        if (error) *error = query.lastError().text();
+        return indexes;
+    }
+
+    while (query.next()) {
+        IndexInfo index;
+        index.name = query.value(0).toString();
+        index.method = query.value(1).toString();
+        index.isUnique = query.value(2).toBool();
+        index.isPrimary = query.value(3).toBool();
+        index.isValid = query.value(4).toBool();
+        int keyColumns = query.value(5).toInt();
+        QJsonArray columns = QJsonDocument::fromJson(query.value(6).toString().toUtf8()).array();
+        for (int i = 0; i < columns.size(); ++i) {
+            (i < keyColumns ? index.columns : index.includeColumns).append(columns[i].toString());
+        }
+        index.predicate = query.value(7).toString();
+        index.sizeBytes = query.value(8).toLongLong();
+        index.scans = query.value(9).toLongLong();
+        index.tuplesRead = query.value(10).toLongLong();
+        index.definition = query.value(11).toString();
+        indexes.append(index);
+    }
+
+    return indexes;
+}
+
+bool DatabaseManager::createIndex(const QString &tableName, const IndexSpec &spec, QString *error)
+{
+    return createIndex(tableName, spec, IndexBuildProgressCallback(), error);
+}
+
+// With a progress callback the build runs asynchronously on the main
+// connection while a second connection polls pg_stat_progress_create_index.
+bool DatabaseManager::createIndex(const QString &tableName, const IndexSpec &requested,
+                                  const IndexBuildProgressCallback &progress, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::CreateIndex);
+
+    // Partitioned tables do not support concurrent builds; the index is
+    // created on the parent and cascades to every partition.
+    IndexSpec spec = requested;
+    if (spec.concurrently && getTablePartitioning(tableName).isPartitioned()) {
+        spec.concurrently = false;
+    }
+
+    QString queryStr = indexStatement(tableName, spec, error);
+    if (queryStr.isEmpty()) return false;
+    QString indexName = spec.name.isEmpty() ? defaultIndexName(tableName, spec) : spec.name;
+
+    TraceSpan traceSpan("db", "createIndex");
+    traceSpan.addArg("index", indexName);
+    traceSpan.addArg("concurrently", spec.concurrently);
+
+    bool ok = false;
+    QString buildError;
+    QSqlQuery query(db);
+
+    if (progress && PgNativeResult::isAvailable(db)) {
+        int pid = DbMetrics::exec(query, "SELECT pg_backend_pid()") && query.next() ? query.value(0).toInt() : 0;
+
+        const QString connectionName = "library_index_progress";
+        {
+            QSqlDatabase monitor = openWorkerConnection(connectionName);
+            QSqlQuery progressQuery(monitor);
+            QString progressStr = QString(
+                                      "SELECT phase, blocks_done, blocks_total, tuples_done, tuples_total "
+                                      "FROM pg_stat_progress_create_index WHERE pid = %1"
+                                      ).arg(pid);
+
+            ok = PgNativeResult::execWaiting(db, queryStr, indexProgressIntervalMs, [&]() {
+                IndexBuildProgress state;
+                if (monitor.isOpen() && DbMetrics::exec(progressQuery, progressStr) && progressQuery.next()) {
+                    state.phase = progressQuery.value(0).toString();
+                    state.blocksDone = progressQuery.value(1).toLongLong();
+                    state.blocksTotal = progressQuery.value(2).toLongLong();
+                    state.tuplesDone = progressQuery.value(3).toLongLong();
+                    state.tuplesTotal = progressQuery.value(4).toLongLong();
+                }
+                return progress(state);
+            }, &buildError);
+        }
+        closeWorkerConnection(connectionName);
+    } else {
+        ok = DbMetrics::exec(query, queryStr);
+        if (!ok) buildError = query.lastError().text();
+    }
+
+    if (!ok) {
+        // A failed concurrent build leaves an invalid index behind.
+        if (spec.concurrently) {
+            QSqlQuery cleanup(db);
+            QString invalidStr = QString(
+                                     "SELECT NOT i.indisvalid FROM pg_index i "
+                                     "WHERE i.indexrelid = to_regclass('%1.%2')"
+                                     ).arg(schemaName, indexName);
+            if (DbMetrics::exec(cleanup, invalidStr) && cleanup.next() && cleanup.value(0).toBool()) {
+                DbMetrics::exec(cleanup, QString("DROP INDEX CONCURRENTLY IF EXISTS %1").arg(indexName));
+            }
+        }
+        if (error) *error = buildError;
+        return false;
+    }
+
+    return true;
+}
+
+bool DatabaseManager::dropIndex(const QString &indexName, bool concurrently, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::DropIndex);
+
+    QSqlQuery query(db);
+
+    // Nor can an index of a partitioned table be dropped concurrently.
+    if (concurrently) {
+        QString kindStr = QString("SELECT relkind FROM pg_class WHERE oid = to_regclass('%1.%2')")
+                              .arg(schemaName, indexName);
+        if (DbMetrics::exec(query, kindStr) && query.next() && query.value(0).toString() == "I") {
+            concurrently = false;
+        }
+    }
+
+    QString queryStr = QString("DROP INDEX %1%2").arg(concurrently ? "CONCURRENTLY " : "", indexName);
+
+    if (!DbMetrics::exec(query, queryStr)) {
         if (error) *error = query.lastError().text();
         return false;
     }
@@ -556,6 +1849,8 @@ bool DatabaseManager::renameColumn(const QString &tableName, const QString &oldN
 
 QJsonObject DatabaseManager::exportTableToJson(const QString &tableName)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::ExportTableToJson);
+
     QJsonObject tableObj;
     tableObj["name"] = tableName;
 
@@ -599,7 +1894,22 @@ QJsonObject DatabaseManager::exportTableToJson(const QString &tableName)
     }
     tableObj["constraints"] = constraintsArray;
 
-    auto data = getTableData(tableName);
+    auto partitioning = getTablePartitioning(tableName);
+    if (partitioning.isPartitioned()) {
+        QJsonArray partitionsArray;
+        for (const auto &partition : partitioning.partitions) {
+            QJsonObject partitionObj;
+            partitionObj["name"] = partition.name;
+            partitionObj["bound"] = partition.bound;
+            partitionsArray.append(partitionObj);
+        }
+        QJsonObject partitioningObj;
+        partitioningObj["key"] = partitioning.key;
+        partitioningObj["partitions"] = partitionsArray;
+        tableObj["partitioning"] = partitioningObj;
+    }
+
+    auto data = readTableData(tableName);
     QJsonArray dataArray;
     for (const auto &row : data) {
         QJsonArray rowArray;
@@ -615,6 +1925,8 @@ QJsonObject DatabaseManager::exportTableToJson(const QString &tableName)
 
 bool DatabaseManager::importTableFromJson(const QJsonObject &json, QString *error)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::ImportTableFromJson);
+
     QString tableName = json["name"].toString();
 
     if (getTableNames().contains(tableName)) {
@@ -639,8 +1951,25 @@ bool DatabaseManager::importTableFromJson(const QJsonObject &json, QString *erro
         columns.append(col);
     }
 
-    if (!createTable(tableName, columns, error)) {
-        return false;
+    // The partition layout is recreated as exported rather than from a
+    // PartitionSpec, so bounds and names survive the round trip.
+    QJsonObject partitioningObj = json["partitioning"].toObject();
+    QString partitionKey = partitioningObj["key"].toString();
+    if (partitionKey.isEmpty()) {
+        if (!createTable(tableName, columns, error)) {
+            return false;
+        }
+    } else {
+        PgPipeline pipeline(db);
+        pipeline.add(createTableStatement(tableName, columns) + " PARTITION BY " + partitionKey);
+        for (const auto &partitionValue : partitioningObj["partitions"].toArray()) {
+            QJsonObject partitionObj = partitionValue.toObject();
+            pipeline.add(QString("CREATE TABLE %1 PARTITION OF %2 %3")
+                             .arg(partitionObj["name"].toString(), tableName, partitionObj["bound"].toString()));
+        }
+        if (!pipeline.run(error)) {
+            return false;
+        }
     }
 
     QJsonArray fksArray = json["foreignKeys"].toArray();
@@ -668,7 +1997,7 @@ bool DatabaseManager::importTableFromJson(const QJsonObject &json, QString *erro
         }
 
         QSqlQuery query(db);
-        if (!query.exec(fkQuery)) {
+        if (!DbMetrics::exec(query, fkQuery)) {
             if (error) *error = "FK constraint error: " + query.lastError().text();
             return false;
         }
@@ -685,7 +2014,7 @@ bool DatabaseManager::importTableFromJson(const QJsonObject &json, QString *erro
                                            cObj["definition"].toString());
 
         QSqlQuery query(db);
-        if (!query.exec(constraintQuery)) {
+        if (!DbMetrics::exec(query, constraintQuery)) {
             if (error) *error = "Constraint error: " + query.lastError().text();
             return false;
         }
@@ -714,6 +2043,8 @@ bool DatabaseManager::importTableFromJson(const QJsonObject &json, QString *erro
 
 QJsonArray DatabaseManager::exportDatabaseToJson()
 {
+    DbMetrics::Scope metricsScope(DbMetrics::ExportDatabaseToJson);
+
     QJsonArray dbArray;
 
     QStringList tables = getTableNames();
@@ -726,13 +2057,40 @@ QJsonArray DatabaseManager::exportDatabaseToJson()
 
 bool DatabaseManager::importDatabaseFromJson(const QJsonArray &json, QString *error)
 {
+    return importDatabaseFromJson(json, RestoreOptions(), nullptr, error);
+}
+
+// Fast mode loads into UNLOGGED tables and switches them to LOGGED before
+// the constraint phase, so rows are not WAL-logged one by one (SET LOGGED
+// still logs each table in full unless wal_level is minimal). All of it
+// runs in one transaction, so a crash mid-restore still leaves nothing.
+bool DatabaseManager::importDatabaseFromJson(const QJsonArray &json, const RestoreOptions &options,
+                                             RestoreReport *report, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::ImportDatabaseFromJson);
+    TraceSpan restoreSpan("restore", "import database");
+    restoreSpan.addArg("fast", options.fast);
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 walStart = report ? walInsertPosition(db) : -1;
+
     QSqlQuery query(db);
 
-    if (!query.exec("BEGIN")) {
+    if (!DbMetrics::exec(query, "BEGIN")) {
         if (error) *error = "Failed to begin transaction";
         return false;
     }
 
+    if (options.fast) {
+        if (!DbMetrics::exec(query, "SET LOCAL synchronous_commit = off")
+            || !DbMetrics::exec(query, QString("SET LOCAL maintenance_work_mem = '%1'").arg(options.maintenanceWorkMem))) {
+            if (error) *error = query.lastError().text();
+            DbMetrics::exec(query, "ROLLBACK");
+            return false;
+        }
+    }
+
     QMap<QString, QJsonObject> tableData;
     QMap<QString, QStringList> tableDependencies;
 
@@ -778,13 +2136,15 @@ bool DatabaseManager::importDatabaseFromJson(const QJsonArray &json, QString *er
 
     for (const QString &tableName : tableData.keys()) {
         if (!addTableWithDeps(tableName)) {
-            query.exec("ROLLBACK");
+            DbMetrics::exec(query, "ROLLBACK");
             if (error) *error = "Circular dependency detected";
             return false;
         }
     }
 
     for (const QString &tableName : sortedTables) {
+        TraceSpan traceSpan("restore", "create table");
+        traceSpan.addArg("table", tableName);
         QJsonObject tableObj = tableData[tableName];
 
         QJsonObject tableObjWithoutData = tableObj;
@@ -792,15 +2152,45 @@ bool DatabaseManager::importDatabaseFromJson(const QJsonArray &json, QString *er
         tableObjWithoutData["foreignKeys"] = QJsonArray();
         tableObjWithoutData["constraints"] = QJsonArray();
 
-        if (!importTableFromJson(tableObjWithoutData, error)) {
-            query.exec("ROLLBACK");
-            return false;
+        if (!importTableFromJson(tableObjWithoutData, error)) {
+            DbMetrics::exec(query, "ROLLBACK");
+            return false;
+        }
+    }
+
+    // The tables are still empty here, so switching them is cheap.
+    // Partitioned tables have no storage of their own; their partitions
+    // are switched instead.
+    QStringList storageTables;
+    for (const QString &tableName : sortedTables) {
+        QJsonObject partitioningObj = tableData[tableName]["partitioning"].toObject();
+        if (partitioningObj["key"].toString().isEmpty()) {
+            storageTables.append(tableName);
+        }
+        for (const auto &partitionValue : partitioningObj["partitions"].toArray()) {
+            storageTables.append(partitionValue.toObject()["name"].toString());
+        }
+    }
+
+    auto setPersistence = [&](const char *persistence) {
+        PgPipeline pipeline(db);
+        for (const QString &tableName : storageTables) {
+            pipeline.add(QString("ALTER TABLE %1 SET %2").arg(tableName, persistence));
         }
+        return pipeline.run(error);
+    };
+
+    if (options.fast && !setPersistence("UNLOGGED")) {
+        DbMetrics::exec(query, "ROLLBACK");
+        return false;
     }
 
     for (const QString &tableName : sortedTables) {
         QJsonObject tableObj = tableData[tableName];
         QJsonArray dataArray = tableObj["data"].toArray();
+        TraceSpan traceSpan("restore", "load data");
+        traceSpan.addArg("table", tableName);
+        traceSpan.addArg("rows", dataArray.size());
 
         for (const auto &rowValue : dataArray) {
             QJsonArray rowArray = rowValue.toArray();
@@ -811,18 +2201,31 @@ bool DatabaseManager::importDatabaseFromJson(const QJsonArray &json, QString *er
             }
 
             if (!insertRow(tableName, row, error)) {
-                query.exec("ROLLBACK");
+                DbMetrics::exec(query, "ROLLBACK");
                 return false;
             }
         }
+    }
 
-        if (!syncSequence(tableName, error)) {
-            query.exec("ROLLBACK");
+    if (options.fast) {
+        TraceSpan traceSpan("restore", "set logged");
+        if (!setPersistence("LOGGED")) {
+            DbMetrics::exec(query, "ROLLBACK");
             return false;
         }
     }
 
+    if (!syncAllSequences(error)) {
+        DbMetrics::exec(query, "ROLLBACK");
+        return false;
+    }
+
+    PgPipeline constraintPipeline(db);
+    QList<bool> isForeignKey;
+
     for (const QString &tableName : sortedTables) {
+        TraceSpan traceSpan("restore", "constraints");
+        traceSpan.addArg("table", tableName);
         QJsonObject tableObj = tableData[tableName];
 
         QJsonArray fksArray = tableObj["foreignKeys"].toArray();
@@ -849,11 +2252,8 @@ bool DatabaseManager::importDatabaseFromJson(const QJsonArray &json, QString *er
                 fkQuery += " ON UPDATE " + onUpdate.replace("_", " ");
             }
 
-            if (!query.exec(fkQuery)) {
-                if (error) *error = "FK constraint error: " + query.lastError().text();
-                query.exec("ROLLBACK");
-                return false;
-            }
+            constraintPipeline.add(fkQuery);
+            isForeignKey.append(true);
         }
 
         QJsonArray constraintsArray = tableObj["constraints"].toArray();
@@ -866,35 +2266,294 @@ bool DatabaseManager::importDatabaseFromJson(const QJsonArray &json, QString *er
                                                cObj["constraintName"].toString(),
                                                cObj["definition"].toString());
 
-            if (!query.exec(constraintQuery)) {
-                if (error) *error = "Constraint error: " + query.lastError().text();
-                query.exec("ROLLBACK");
-                return false;
+            constraintPipeline.add(constraintQuery);
+            isForeignKey.append(false);
+        }
+    }
+
+    QString constraintError;
+    if (!constraintPipeline.run(&constraintError)) {
+        int failed = constraintPipeline.failedIndex();
+        if (error) {
+            if (failed >= 0) {
+                *error = (isForeignKey[failed] ? "FK constraint error: " : "Constraint error: ")
+                         + constraintError + "\n" + constraintPipeline.statement(failed);
+            } else {
+                *error = constraintError;
             }
         }
+        DbMetrics::exec(query, "ROLLBACK");
+        return false;
     }
 
-    if (!query.exec("COMMIT")) {
+    if (!DbMetrics::exec(query, "COMMIT")) {
         if (error) *error = "Failed to commit transaction";
         return false;
     }
 
+    if (report) {
+        report->elapsedMs = timer.elapsed();
+        qint64 walEnd = walStart >= 0 ? walInsertPosition(db) : -1;
+        report->walBytes = walEnd >= 0 ? walEnd - walStart : -1;
+        if (DbMetrics::exec(query, "SHOW wal_level") && query.next()) {
+            report->walLevel = query.value(0).toString();
+        }
+    }
     return true;
 }
 
 bool DatabaseManager::exportTableToCsv(const QString &tableName, const QString &filePath, QString *error)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::ExportTableToCsv);
+
     auto columns = getTableColumns(tableName);
-    auto data = getTableData(tableName);
-    QStringList headers;
+    QStringList columnNames;
     for (const auto &col : columns) {
-        headers.append(col.name);
+        columnNames.append(col.name);
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Unbuffered)) {
+        if (error) *error = "Cannot open file for writing";
+        return false;
+    }
+
+    bool ok = exportQueryToCsv(db, QString("SELECT %1 FROM %2").arg(columnNames.join(", "), tableName), &file, error);
+    file.close();
+    return ok;
+}
+
+bool DatabaseManager::importTableFromCsv(const QString &tableName, QIODevice *device,
+                                         const CsvReader::Dialect &dialect,
+                                         CsvImportReport *report, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::ImportTableFromCsv);
+    TraceSpan traceSpan("restore", "import CSV");
+    traceSpan.addArg("table", tableName);
+
+    CsvImportReport localReport;
+    CsvImportReport &result = report ? *report : localReport;
+    result = CsvImportReport();
+
+    auto columns = getTableColumns(tableName);
+    if (columns.isEmpty()) {
+        if (error) *error = "Table not found: " + tableName;
+        return false;
+    }
+
+    CsvReader reader(device, dialect);
+    QList<QByteArray> fields;
+
+    // fieldColumn[i] is the table column for CSV field i, or -1 if ignored.
+    QList<int> fieldColumn;
+    if (dialect.header) {
+        if (!reader.readRecord(fields)) {
+            if (error) *error = reader.hasError() ? reader.errorString() : "CSV file is empty";
+            return false;
+        }
+        for (const QByteArray &name : fields) {
+            QString header = QString::fromUtf8(name).trimmed();
+            int index = -1;
+            for (int c = 0; c < columns.size(); ++c) {
+                if (columns[c].name.compare(header, Qt::CaseInsensitive) == 0) {
+                    index = c;
+                    break;
+                }
+            }
+            if (index >= 0 && fieldColumn.contains(index)) {
+                if (error) *error = "Duplicate column in CSV header: " + header;
+                return false;
+            }
+            if (index < 0) result.ignoredColumns.append(header);
+            fieldColumn.append(index);
+        }
+    } else {
+        for (int c = 0; c < columns.size(); ++c) {
+            fieldColumn.append(c);
+        }
+    }
+
+    QStringList copyColumns;
+    QList<int> mapped;
+    for (int f = 0; f < fieldColumn.size(); ++f) {
+        if (fieldColumn[f] < 0) continue;
+        copyColumns.append(columns[fieldColumn[f]].name);
+        mapped.append(f);
+    }
+
+    for (int c = 0; c < columns.size(); ++c) {
+        const auto &col = columns[c];
+        if (!col.isNullable && !col.isIdentity && col.defaultValue.isEmpty() && !fieldColumn.contains(c)) {
+            if (error) *error = "Missing required column: " + col.name;
+            return false;
+        }
+    }
+    if (copyColumns.isEmpty()) {
+        if (error) *error = "No CSV columns match table " + tableName;
+        return false;
+    }
+
+    auto reject = [&](qint64 line, const QString &reason) {
+        ++result.rowsRejected;
+        if (result.rejected.size() < maxReportedRejects) {
+            result.rejected.append({line, reason});
+        }
+    };
+
+    bool useCopy = PgNativeResult::isAvailable(db);
+    QString copyStatement = QString("COPY %1 (%2) FROM STDIN").arg(tableName, copyColumns.join(", "));
+    QSqlQuery insert(db);
+    if (!useCopy) {
+        QStringList placeholders;
+        for (int i = 0; i < copyColumns.size(); ++i) placeholders.append("?");
+        insert.prepare(QString("INSERT INTO %1 (%2) VALUES (%3)")
+                           .arg(tableName, copyColumns.join(", "), placeholders.join(", ")));
+    }
+
+    auto load = [&](const QList<CsvImportRow> &rows, int from, int to, QString *loadError) {
+        if (useCopy) {
+            QByteArray data;
+            for (int r = from; r < to; ++r) {
+                const auto &values = rows[r].values;
+                for (int v = 0; v < values.size(); ++v) {
+                    if (v > 0) data.append('\t');
+                    if (values[v].isNull()) {
+                        data.append("\\N");
+                    } else {
+                        appendCopyText(data, values[v]);
+                    }
+                }
+                data.append('\n');
+            }
+            return PgNativeResult::copyIn(db, copyStatement, data, loadError);
+        }
+
+        for (int r = from; r < to; ++r) {
+            for (const QByteArray &value : rows[r].values) {
+                insert.addBindValue(value.isNull() ? QVariant() : QVariant(QString::fromUtf8(value)));
+            }
+            if (!DbMetrics::exec(insert)) {
+                if (loadError) *loadError = insert.lastError().text();
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Each attempt runs under a savepoint; a failing chunk is split in
+    // half until the offending rows are isolated and rejected.
+    QSqlQuery query(db);
+    std::function<void(const QList<CsvImportRow> &, int, int)> loadChunk =
+        [&](const QList<CsvImportRow> &rows, int from, int to) {
+            DbMetrics::exec(query, "SAVEPOINT csv_import");
+            QString loadError;
+            if (load(rows, from, to, &loadError)) {
+                DbMetrics::exec(query, "RELEASE SAVEPOINT csv_import");
+                result.rowsImported += to - from;
+                return;
+            }
+            DbMetrics::exec(query, "ROLLBACK TO SAVEPOINT csv_import");
+            DbMetrics::exec(query, "RELEASE SAVEPOINT csv_import");
+
+            if (to - from == 1) {
+                reject(rows[from].line, loadError);
+                return;
+            }
+            int middle = from + (to - from) / 2;
+            loadChunk(rows, from, middle);
+            loadChunk(rows, middle, to);
+        };
+
+    if (!DbMetrics::exec(query, "BEGIN")) {
+        if (error) *error = "Failed to begin transaction";
+        return false;
+    }
+
+    QList<CsvImportRow> pending;
+    pending.reserve(csvImportChunkRows);
+
+    while (reader.readRecord(fields)) {
+        ++result.rowsRead;
+        qint64 line = reader.recordLine();
+
+        if (fields.size() == 1 && fields[0].isNull() && fieldColumn.size() > 1) {
+            --result.rowsRead;
+            continue;
+        }
+        if (fields.size() != fieldColumn.size()) {
+            reject(line, QString("Expected %1 fields, got %2").arg(fieldColumn.size()).arg(fields.size()));
+            continue;
+        }
+
+        CsvImportRow row{line, {}};
+        row.values.reserve(mapped.size());
+        QString invalid;
+        for (int f : mapped) {
+            const auto &col = columns[fieldColumn[f]];
+            QByteArray value = fields[f];
+
+            // The exporter writes NULL and '' alike; NOT NULL text columns get ''.
+            if (value.isEmpty() && (col.isNullable || col.type == "int")) {
+                value = QByteArray();
+            } else if (value.isNull()) {
+                value = QByteArray("");
+            }
+
+            if (col.type == "int" && !value.isNull()) {
+                bool ok = false;
+                value.trimmed().toLongLong(&ok);
+                if (!ok) {
+                    invalid = QString("Invalid integer in column %1: %2").arg(col.name, QString::fromUtf8(value));
+                    break;
+                }
+            }
+            row.values.append(value);
+        }
+        if (!invalid.isEmpty()) {
+            reject(line, invalid);
+            continue;
+        }
+
+        pending.append(std::move(row));
+        if (pending.size() >= csvImportChunkRows) {
+            loadChunk(pending, 0, pending.size());
+            pending.clear();
+        }
+    }
+
+    if (reader.hasError()) {
+        DbMetrics::exec(query, "ROLLBACK");
+        if (error) *error = reader.errorString();
+        return false;
+    }
+
+    if (!pending.isEmpty()) {
+        loadChunk(pending, 0, pending.size());
+    }
+
+    if (!syncSequences({tableName}, error)) {
+        DbMetrics::exec(query, "ROLLBACK");
+        return false;
     }
 
-    return exportQueryResultToCsv(data, headers, filePath, error);
+    if (!DbMetrics::exec(query, "COMMIT")) {
+        if (error) *error = "Failed to commit transaction";
+        return false;
+    }
+
+    DbMetrics::addTransfer(result.rowsImported, device->pos());
+    traceSpan.addArg("rows", result.rowsImported);
+    traceSpan.addArg("rejected", result.rowsRejected);
+    replica->invalidate(tableName);
+    return true;
 }
 
 bool DatabaseManager::exportDatabaseToSql(const QString &filePath, QString *error)
+{
+    return exportDatabaseToSql(filePath, SqlDumpOptions(), error);
+}
+
+bool DatabaseManager::exportDatabaseToSql(const QString &filePath, const SqlDumpOptions &options, QString *error)
 {
     QFile file(filePath);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
@@ -902,15 +2561,39 @@ bool DatabaseManager::exportDatabaseToSql(const QString &filePath, QString *erro
         return false;
     }
 
-    QTextStream stream(&file);
+    bool ok = exportDatabaseToSql(&file, options, error);
+    file.close();
+    return ok;
+}
+
+bool DatabaseManager::exportDatabaseToSql(QIODevice *device, QString *error)
+{
+    return exportDatabaseToSql(device, SqlDumpOptions(), error);
+}
+
+// Same order as pg_dump: tables, data, sequence positions, then foreign
+// keys and constraints, so the data loads without constraint checks.
+bool DatabaseManager::exportDatabaseToSql(QIODevice *device, const SqlDumpOptions &options, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::ExportDatabaseToSql);
+
+    QTextStream stream(device);
     stream.setEncoding(QStringConverter::Utf8);
 
+    stream << "SET client_encoding = 'UTF8';\n";
+    stream << "SET standard_conforming_strings = on;\n";
     stream << "SET search_path TO " << schemaName << ";\n\n";
 
     QStringList tables = getTableNames();
+    auto schemas = getTableSchemas(tables, error);
+    if (schemas.size() != tables.size()) {
+        return false;
+    }
 
     for (const QString &tableName : tables) {
-        auto columns = getTableColumns(tableName);
+        TraceSpan traceSpan("export", "schema");
+        traceSpan.addArg("table", tableName);
+        const auto &columns = schemas[tableName].columns;
 
         stream << "DROP TABLE IF EXISTS " << tableName << " CASCADE;\n";
         stream << "CREATE TABLE " << tableName << " (\n";
@@ -950,11 +2633,58 @@ bool DatabaseManager::exportDatabaseToSql(const QString &filePath, QString *erro
             stream << ",\n    PRIMARY KEY (" << primaryKeys.join(", ") << ")";
         }
 
-        stream << "\n);\n\n";
+        const auto &partitioning = schemas[tableName].partitioning;
+        if (!partitioning.isPartitioned()) {
+            stream << "\n);\n\n";
+            continue;
+        }
+
+        stream << "\n) PARTITION BY " << partitioning.key << ";\n";
+        for (const auto &partition : partitioning.partitions) {
+            stream << "CREATE TABLE " << partition.name << " PARTITION OF " << tableName
+                   << " " << partition.bound << ";\n";
+        }
+        stream << "\n";
+    }
+
+    // Partitioned tables are dumped partition by partition, so each COPY
+    // block goes straight to its partition on restore.
+    for (const QString &tableName : tables) {
+        TraceSpan traceSpan("export", "data");
+        traceSpan.addArg("table", tableName);
+        const auto &schema = schemas[tableName];
+
+        QStringList sources;
+        for (const auto &partition : schema.partitioning.partitions) {
+            sources.append(partition.name);
+        }
+        if (!schema.partitioning.isPartitioned()) {
+            sources.append(tableName);
+        }
+
+        for (const QString &source : sources) {
+            stream.flush();
+            if (!dumpTableData(db, source, schema.columns, options, device, error)) {
+                return false;
+            }
+        }
+    }
+
+    for (const QString &tableName : tables) {
+        for (const auto &col : schemas[tableName].columns) {
+            if (col.isIdentity) {
+                stream << QString("SELECT setval(pg_get_serial_sequence('%1', '%2'), "
+                                  "COALESCE(MAX(%2), 1), MAX(%2) IS NOT NULL) FROM %1;\n")
+                              .arg(tableName, col.name);
+            }
+        }
     }
+    stream << "\n";
 
     for (const QString &tableName : tables) {
-        auto fks = getTableForeignKeys(tableName);
+        TraceSpan traceSpan("export", "constraints");
+        traceSpan.addArg("table", tableName);
+        const auto &fks = schemas[tableName].foreignKeys;
 
         for (const auto &fk : fks) {
             QString onDelete = fk.onDelete.toUpper();
@@ -975,7 +2705,7 @@ bool DatabaseManager::exportDatabaseToSql(const QString &filePath, QString *erro
             stream << ";\n";
         }
 
-        auto constraints = getTableConstraints(tableName);
+        const auto &constraints = schemas[tableName].constraints;
         for (const auto &c : constraints) {
             stream << "ALTER TABLE " << tableName << " ADD CONSTRAINT " << c.constraintName
                    << " " << c.definition << ";\n";
@@ -986,46 +2716,130 @@ bool DatabaseManager::exportDatabaseToSql(const QString &filePath, QString *erro
         }
     }
 
-    for (const QString &tableName : tables) {
-        auto columns = getTableColumns(tableName);
-        auto data = getTableData(tableName);
-
-        if (!data.isEmpty()) {
-            for (const auto &row : data) {
-                QStringList columnNames;
-                QStringList values;
-
-                for (int i = 0; i < row.size(); ++i) {
-                    if (!columns[i].isIdentity) {
-                        columnNames.append(columns[i].name);
-
-                        if (row[i].isNull()) {
-                            values.append("NULL");
-                        } else {
-                            QString val = row[i].toString();
-                            val.replace("'", "''");
-
-                            if (columns[i].type.toUpper() == "INT") {
-                                values.append(val);
-                            } else {
-                                values.append("'" + val + "'");
-                            }
-                        }
-                    }
-                }
+    stream.flush();
+    if (stream.status() != QTextStream::Ok) {
+        if (error) *error = "Failed to write SQL dump";
+        return false;
+    }
+    return true;
+}
 
-                if (!columnNames.isEmpty()) {
-                    stream << "INSERT INTO " << tableName << " (" << columnNames.join(", ")
-                    << ") VALUES (" << values.join(", ") << ");\n";
-                } else {
-                    stream << "INSERT INTO " << tableName << " DEFAULT VALUES;\n";
-                }
+// Statements are sent through a pipeline in bounded batches and COPY data
+// is forwarded chunk by chunk, so memory use does not grow with the script.
+bool DatabaseManager::restoreDatabaseFromSql(QIODevice *device, const SqlRestoreOptions &options,
+                                             const SqlRestoreProgressCallback &progress, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::RestoreDatabaseFromSql);
+    TraceSpan traceSpan("restore", "SQL script");
+
+    SqlScriptReader reader(device);
+    SqlScriptReader::Statement statement;
+    SqlRestoreProgress state;
+    state.totalBytes = device->isSequential() ? -1 : device->size();
+
+    QSqlQuery query(db);
+    if (options.singleTransaction && !DbMetrics::exec(query, "BEGIN")) {
+        if (error) *error = "Failed to begin transaction";
+        return false;
+    }
+
+    PgPipeline pipeline(db);
+    QList<qint64> lines;
+    qsizetype pendingBytes = 0;
+    QString failure;
+
+    auto report = [&]() {
+        state.bytesRead = reader.bytesRead();
+        if (progress && !progress(state)) {
+            failure = "Restore cancelled";
+            return false;
+        }
+        return true;
+    };
+
+    auto flush = [&]() {
+        if (pipeline.size() == 0) return true;
+        QString runError;
+        bool ok = pipeline.run(&runError);
+        if (!ok) {
+            int failed = pipeline.failedIndex();
+            failure = QString("Line %1: %2").arg(failed >= 0 ? lines[failed] : 0).arg(runError);
+        }
+        state.statements += pipeline.size();
+        pipeline.clear();
+        lines.clear();
+        pendingBytes = 0;
+        return ok;
+    };
+
+    bool ok = true;
+    while (ok && reader.readStatement(statement)) {
+        if (!statement.copyFromStdin) {
+            lines.append(statement.line);
+            pendingBytes += statement.sql.size();
+            pipeline.add(QString::fromUtf8(statement.sql));
+            if (pipeline.size() >= restoreBatchStatements || pendingBytes >= restoreBatchBytes) {
+                ok = flush() && report();
             }
-            stream << "\n";
+            continue;
+        }
+
+        ok = flush() && report();
+        if (!ok) break;
+
+        if (!PgNativeResult::isAvailable(db)) {
+            failure = QString("Line %1: COPY FROM stdin needs the native libpq connection").arg(statement.line);
+            ok = false;
+            break;
+        }
+
+        QString copyError;
+        bool copied = PgNativeResult::copyIn(db, QString::fromUtf8(statement.sql), [&](QByteArray &data, QString *abort) {
+            if (!reader.readCopyData(data)) {
+                if (reader.hasError()) *abort = reader.errorString();
+                return false;
+            }
+            if (!report()) {
+                *abort = failure;
+                return false;
+            }
+            return true;
+        }, &copyError);
+        ++state.statements;
+
+        if (!copied) {
+            failure = QString("Line %1: %2").arg(statement.line).arg(copyError);
+            ok = false;
+        } else if (!failure.isEmpty()) {
+            ok = false;
         }
     }
 
-    file.close();
+    if (ok && reader.hasError()) {
+        failure = reader.errorString();
+        ok = false;
+    }
+    if (ok) {
+        ok = flush() && report();
+    }
+
+    traceSpan.addArg("statements", state.statements);
+    traceSpan.addArg("bytes", reader.bytesRead());
+    DbMetrics::addTransfer(0, reader.bytesRead());
+
+    if (!ok) {
+        if (options.singleTransaction) DbMetrics::exec(query, "ROLLBACK");
+        if (error) *error = failure;
+        replica->invalidateAll();
+        return false;
+    }
+
+    if (options.singleTransaction && !DbMetrics::exec(query, "COMMIT")) {
+        if (error) *error = "Failed to commit transaction";
+        return false;
+    }
+
+    replica->invalidateAll();
     return true;
 }
 
@@ -1034,32 +2848,147 @@ bool DatabaseManager::exportQueryResultToCsv(const QList<QVariantList> &data,
                                              const QString &filePath,
                                              QString *error)
 {
+    DbMetrics::Scope metricsScope(DbMetrics::ExportQueryResultToCsv);
+
     QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Unbuffered)) {
         if (error) *error = "Cannot open file for writing";
         return false;
     }
 
-    file.write("\xEF\xBB\xBF");
+    bool ok;
+    {
+        CsvWriter writer(&file);
+        writer.writeHeader(headers);
+        for (int first = 0; first < data.size() && !writer.hasFailed(); first += csvBlockRows) {
+            writer.addRows(data.mid(first, csvBlockRows));
+        }
+        ok = writer.finish(error);
+    }
 
-    QTextStream stream(&file);
-    stream.setEncoding(QStringConverter::Utf8);
+    file.close();
+    return ok;
+}
 
-    stream << headers.join(";") << "\n";
+bool DatabaseManager::exportQueryToCsv(QSqlDatabase connection, const QString &queryStr,
+                                       QIODevice *device, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::ExportQueryResultToCsv);
 
-    for (const auto &row : data) {
-        QStringList rowStrings;
-        for (const auto &cell : row) {
-            QString cellStr = cell.toString();
-            if (cellStr.contains(';') || cellStr.contains('"') || cellStr.contains('\n')) {
-                cellStr.replace("\"", "\"\"");
-                cellStr = "\"" + cellStr + "\"";
-            }
-            rowStrings.append(cellStr);
+    if (PgNativeResult::isAvailable(connection)) {
+        return exportQueryToCsvNative(connection, queryStr, device, error);
+    }
+
+    QSqlQuery query(connection);
+    query.setForwardOnly(true);
+    if (!DbMetrics::exec(query, queryStr)) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+
+    CsvWriter writer(device);
+
+    QSqlRecord record = query.record();
+    QStringList headers;
+    for (int i = 0; i < record.count(); ++i) {
+        headers.append(record.fieldName(i));
+    }
+    writer.writeHeader(headers);
+
+    qint64 rows = 0;
+    QList<QVariantList> block;
+    block.reserve(csvBlockRows);
+    while (!writer.hasFailed() && query.next()) {
+        QVariantList row;
+        row.reserve(record.count());
+        for (int i = 0; i < record.count(); ++i) {
+            row.append(query.value(i));
+        }
+        block.append(std::move(row));
+        ++rows;
+
+        if (block.size() >= csvBlockRows) {
+            writer.addRows(std::move(block));
+            block = QList<QVariantList>();
+            block.reserve(csvBlockRows);
         }
-        stream << rowStrings.join(";") << "\n";
     }
+    writer.addRows(std::move(block));
 
-    file.close();
-    return true;
+    DbMetrics::addTransfer(rows, 0);
+
+    bool ok = writer.finish(error);
+    if (ok && query.lastError().isValid()) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+    return ok;
+}
+
+QSqlDatabase DatabaseManager::openWorkerConnection(const QString &connectionName, QString *error)
+{
+    QSqlDatabase connection = QSqlDatabase::addDatabase("QPSQL", connectionName);
+    connection.setHostName(settings.hostName);
+    connection.setPort(settings.port);
+    connection.setDatabaseName(settings.databaseName);
+    connection.setUserName(settings.userName);
+    connection.setPassword(settings.password);
+
+    if (!connection.open()) {
+        if (error) *error = connection.lastError().text();
+        return connection;
+    }
+
+    QSqlQuery query(connection);
+    DbMetrics::exec(query, QString("SET search_path TO %1").arg(schemaName));
+
+    return connection;
+}
+
+void DatabaseManager::closeWorkerConnection(const QString &connectionName)
+{
+    {
+        QSqlDatabase connection = QSqlDatabase::database(connectionName, false);
+        if (connection.isOpen()) {
+            connection.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+ReplicaCache *DatabaseManager::replicaCache()
+{
+    return replica;
+}
+
+QJsonObject DatabaseManager::explainAnalyze(const QString &queryStr, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::ExplainAnalyze);
+
+    QString statement = queryStr.trimmed();
+    while (statement.endsWith(';')) {
+        statement.chop(1);
+        statement = statement.trimmed();
+    }
+
+    QSqlQuery query(db);
+    if (!DbMetrics::exec(query, "BEGIN")) {
+        if (error) *error = "Failed to begin transaction";
+        return QJsonObject();
+    }
+
+    QJsonObject result;
+    if (DbMetrics::exec(query, "EXPLAIN (ANALYZE, BUFFERS, FORMAT JSON) " + statement) && query.next()) {
+        QJsonDocument doc = QJsonDocument::fromJson(query.value(0).toString().toUtf8());
+        if (doc.isArray() && !doc.array().isEmpty()) {
+            result = doc.array().first().toObject();
+        } else if (error) {
+            *error = "Invalid plan format";
+        }
+    } else if (error) {
+        *error = query.lastError().text();
+    }
+
+    DbMetrics::exec(query, "ROLLBACK");
+    return result;
 }
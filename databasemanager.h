@@ -8,11 +8,30 @@
 #include <QVariantList>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QIODevice>
+#include <QMap>
+#include <QHash>
+#include <QDateTime>
+#include "csvreader.h"
+#include <functional>
+
+class ReplicaCache;
 
 class DatabaseManager
 {
 public:
+    struct ConnectionSettings {
+        QString hostName = "localhost";
+        int port = 5432;
+        QString databaseName = "library";
+        QString userName = "roflan";
+        QString password = "Begemot12345";
+        QString schemaName = "libraryschema";
+    };
+
     static DatabaseManager& instance();
+    void setConnectionSettings(const ConnectionSettings &settings);
+    ConnectionSettings connectionSettings() const;
     bool connectToDatabase();
     void disconnectFromDatabase();
     bool isConnected() const;
@@ -46,12 +65,193 @@ public:
         QString definition;
     };
 
+    struct PartitionInfo {
+        QString name;
+        QString bound;
+        double estimatedRows = -1;
+        qint64 totalBytes = 0;
+    };
+
+    // key is the pg_get_partkeydef() text, e.g. "RANGE (issue_date)";
+    // empty for a plain table. bound is "FOR VALUES ..." or "DEFAULT".
+    struct PartitionLayout {
+        QString key;
+        QList<PartitionInfo> partitions;
+        bool isPartitioned() const { return !key.isEmpty(); }
+    };
+
+    // Range partitions on a date or timestamp key are created one per
+    // interval from start (the current interval when null) through premake
+    // intervals ahead. Other range keys only get the default partition.
+    struct PartitionSpec {
+        enum Strategy {
+            None,
+            Range,
+            List,
+            Hash
+        };
+        enum Interval {
+            Day,
+            Month,
+            Year
+        };
+        Strategy strategy = None;
+        QString key;
+        Interval interval = Month;
+        QDate start;
+        int premake = 3;
+        int modulus = 4;
+        QList<QStringList> listValues;
+        bool defaultPartition = true;
+    };
+
+    struct TableSchema {
+        QList<ColumnInfo> columns;
+        QList<ForeignKeyInfo> foreignKeys;
+        QList<ConstraintInfo> constraints;
+        PartitionLayout partitioning;
+    };
+
+    // Planner estimates and cumulative statistics, not exact counts.
+    // estimatedRows is -1 for a table that was never vacuumed or analyzed.
+    struct TableStats {
+        QString tableName;
+        double estimatedRows = -1;
+        qint64 totalBytes = 0;
+        qint64 heapBytes = 0;
+        qint64 indexBytes = 0;
+        qint64 toastBytes = 0;
+        qint64 deadTuples = 0;
+        QDateTime lastVacuum;
+        QDateTime lastAnalyze;
+        qint64 seqScans = 0;
+        qint64 indexScans = 0;
+    };
+
+    // Position after the last page read. With a primary key this is the key
+    // of the last row. Without one, pages are ranges of heap blocks scanned
+    // in physical order, leaf partition by leaf partition. That scan does not
+    // sort, but it is not a snapshot either: a row updated between pages gets
+    // a new ctid, so it can show up twice or be skipped.
+    struct TablePageCursor {
+        QVariantList lastKey;
+        QStringList relations;
+        int relationIndex = 0;
+        qint64 nextBlock = 0;
+        bool atEnd = false;
+    };
+
+    // columns are the key columns (or expressions), includeColumns the
+    // INCLUDE payload; sizeBytes and scans come from the statistics views.
+    struct IndexInfo {
+        QString name;
+        QString method;
+        QStringList columns;
+        QStringList includeColumns;
+        QString predicate;
+        bool isUnique = false;
+        bool isPrimary = false;
+        bool isValid = true;
+        qint64 sizeBytes = 0;
+        qint64 scans = 0;
+        qint64 tuplesRead = 0;
+        QString definition;
+    };
+
+    // An empty name is generated from the table and columns.
+    struct IndexSpec {
+        QString name;
+        QString method = "btree";
+        QStringList columns;
+        QStringList includeColumns;
+        QString predicate;
+        bool unique = false;
+        bool concurrently = true;
+    };
+
+    struct IndexBuildProgress {
+        QString phase;
+        qint64 blocksDone = 0;
+        qint64 blocksTotal = 0;
+        qint64 tuplesDone = 0;
+        qint64 tuplesTotal = 0;
+    };
+
+    // Returning false from the callback cancels the build.
+    using IndexBuildProgressCallback = std::function<bool(const IndexBuildProgress &)>;
+
+    struct CsvImportReport {
+        struct RejectedRow {
+            qint64 line;
+            QString reason;
+        };
+        qint64 rowsRead = 0;
+        qint64 rowsImported = 0;
+        qint64 rowsRejected = 0;
+        QList<RejectedRow> rejected;
+        QStringList ignoredColumns;
+    };
+
+    struct SqlDumpOptions {
+        enum DataFormat {
+            Copy,
+            Inserts
+        };
+        DataFormat format = Copy;
+        int rowsPerInsert = 1000;
+    };
+
+    // fast skips WAL only while loading: with wal_level replica or logical,
+    // switching the tables to LOGGED at the end writes their whole contents
+    // to WAL in one go, so replicas and archives still receive every row.
+    // With wal_level minimal a plain restore already skips WAL for tables
+    // created in its transaction.
+    struct RestoreOptions {
+        bool fast = false;
+        QString maintenanceWorkMem = "1GB";
+    };
+
+    // walBytes is the cluster-wide WAL written during the restore, or -1
+    // if the server does not report it; walLevel is the server's wal_level.
+    struct RestoreReport {
+        qint64 elapsedMs = 0;
+        qint64 walBytes = -1;
+        QString walLevel;
+    };
+
+    // Without a single transaction, statements are sent in pipeline
+    // batches (up to 500 statements or 4 MB) and each batch commits on
+    // its own: a failure rolls back only the batch it occurred in, while
+    // earlier batches stay committed. COPY sections always commit alone.
+    struct SqlRestoreOptions {
+        bool singleTransaction = true;
+    };
+
+    struct SqlRestoreProgress {
+        qint64 bytesRead = 0;
+        qint64 totalBytes = -1;
+        qint64 statements = 0;
+    };
+
+    // Returning false from the callback cancels the restore.
+    using SqlRestoreProgressCallback = std::function<bool(const SqlRestoreProgress &)>;
+
     QSqlDatabase& getDatabase();
     QList<ColumnInfo> getTableColumns(const QString &tableName);
     QList<ForeignKeyInfo> getTableForeignKeys(const QString &tableName);
     QList<ConstraintInfo> getTableConstraints(const QString &tableName);
+    QMap<QString, TableSchema> getTableSchemas(const QStringList &tables, QString *error = nullptr);
+    // Served from the local replica when the table is mirrored and current.
     QList<QVariantList> getTableData(const QString &tableName);
+    QList<QVariantList> getTableDataPage(const QString &tableName, int limit, TablePageCursor *cursor,
+                                         QString *error = nullptr);
+    QList<TableStats> getTableStats(QString *error = nullptr);
     bool createTable(const QString &tableName, const QList<ColumnInfo> &columns, QString *error = nullptr);
+    bool createTable(const QString &tableName, const QList<ColumnInfo> &columns,
+                     const PartitionSpec &partitioning, QString *error = nullptr);
+    PartitionLayout getTablePartitioning(const QString &tableName, QString *error = nullptr);
+    bool ensurePartitions(const QString &tableName, int premake, QString *error = nullptr);
+    bool maintainPartitions(int premake, QString *error = nullptr);
     bool dropTable(const QString &tableName, QString *error = nullptr);
     bool insertRow(const QString &tableName, const QVariantList &values, QString *error = nullptr);
     bool deleteRow(const QString &tableName, const QVariantList &primaryKeyValues, QString *error = nullptr);
@@ -64,23 +264,72 @@ public:
     bool addColumn(const QString &tableName, const ColumnInfo &column, QString *error = nullptr);
     bool dropColumn(const QString &tableName, const QString &columnName, QString *error = nullptr);
     bool renameColumn(const QString &tableName, const QString &oldName, const QString &newName, QString *error = nullptr);
+    QList<IndexInfo> getTableIndexes(const QString &tableName, QString *error = nullptr);
+    bool createIndex(const QString &tableName, const IndexSpec &spec, QString *error = nullptr);
+    bool createIndex(const QString &tableName, const IndexSpec &spec,
+                     const IndexBuildProgressCallback &progress, QString *error = nullptr);
+    bool dropIndex(const QString &indexName, bool concurrently = true, QString *error = nullptr);
     QJsonObject exportTableToJson(const QString &tableName);
     bool importTableFromJson(const QJsonObject &json, QString *error = nullptr);
     QJsonArray exportDatabaseToJson();
     bool importDatabaseFromJson(const QJsonArray &json, QString *error = nullptr);
+    bool importDatabaseFromJson(const QJsonArray &json, const RestoreOptions &options,
+                                RestoreReport *report, QString *error = nullptr);
     bool exportTableToCsv(const QString &tableName, const QString &filePath, QString *error = nullptr);
+    bool importTableFromCsv(const QString &tableName, QIODevice *device,
+                            const CsvReader::Dialect &dialect = CsvReader::Dialect(),
+                            CsvImportReport *report = nullptr, QString *error = nullptr);
     bool exportDatabaseToSql(const QString &filePath, QString *error = nullptr);
+    bool exportDatabaseToSql(const QString &filePath, const SqlDumpOptions &options, QString *error = nullptr);
+    bool exportDatabaseToSql(QIODevice *device, QString *error = nullptr);
+    bool exportDatabaseToSql(QIODevice *device, const SqlDumpOptions &options, QString *error = nullptr);
+    bool restoreDatabaseFromSql(QIODevice *device, const SqlRestoreOptions &options,
+                                const SqlRestoreProgressCallback &progress, QString *error = nullptr);
     bool exportQueryResultToCsv(const QList<QVariantList> &data, const QStringList &headers,
                                 const QString &filePath, QString *error = nullptr);
+    bool exportQueryToCsv(QSqlDatabase connection, const QString &queryStr,
+                          QIODevice *device, QString *error = nullptr);
     bool syncSequence(const QString &tableName, QString *error = nullptr);
+    bool syncSequences(const QStringList &tables, QString *error = nullptr);
+    bool syncAllSequences(QString *error = nullptr);
+    QJsonObject explainAnalyze(const QString &queryStr, QString *error = nullptr);
+
+    struct QueryResult {
+        QStringList headers;
+        QList<QVariantList> rows;
+        int rowsAffected = 0;
+    };
+
+    // Runs a statement with $1, $2, ... placeholders as a server-side
+    // prepared statement of the main connection. Statements are prepared on
+    // first use and kept for the most recently used LIBRARY_PREPARED_CACHE
+    // (default 64) distinct texts.
+    bool executePrepared(const QString &queryStr, const QVariantList &params, QueryResult &result,
+                         QString *error = nullptr);
+    void clearPreparedStatements();
+
+    QSqlDatabase openWorkerConnection(const QString &connectionName, QString *error = nullptr);
+    static void closeWorkerConnection(const QString &connectionName);
+
+    ReplicaCache *replicaCache();
 
 private:
     DatabaseManager();
     ~DatabaseManager();
     DatabaseManager(const DatabaseManager&) = delete;
     DatabaseManager& operator=(const DatabaseManager&) = delete;
+    QList<QVariantList> readTableData(const QString &tableName);
+    QList<QVariantList> readTableBlocks(const QString &tableName, const QStringList &columnNames, int limit,
+                                        TablePageCursor *cursor, QString *error);
+
     QSqlDatabase db;
+    ConnectionSettings settings;
     QString schemaName;
+    ReplicaCache *replica;
+    QHash<QString, QString> preparedNames;
+    QHash<QString, QSqlQuery> preparedQueries;
+    QStringList preparedOrder;
+    int preparedSerial = 0;
 };
 
 #endif
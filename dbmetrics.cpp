@@ -0,0 +1,373 @@
+#include "dbmetrics.h"
+#include <QSqlQuery>
+#include <QMutex>
+#include <QJsonArray>
+#include <QtAlgorithms>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+std::atomic<bool> DbMetrics::enabled(!qEnvironmentVariableIsEmpty("LIBRARY_METRICS"));
+
+namespace {
+const int bucketCount = 160;
+const int maxTracedSqlLength = 512;
+
+const char *const operationNames[DbMetrics::OperationCount] = {
+    "unattributed",
+    "QSqlQuery::exec",
+    "connectToDatabase",
+    "getTableNames",
+    "executeQuery",
+    "executeNonQuery",
+    "executePrepared",
+    "getTableColumns",
+    "getTableForeignKeys",
+    "getTableConstraints",
+    "getTableSchemas",
+    "getTableData",
+    "getTableDataPage",
+    "getTableStats",
+    "createTable",
+    "dropTable",
+    "getTablePartitioning",
+    "maintainPartitions",
+    "insertRow",
+    "deleteRow",
+    "updateCell",
+    "changeColumnType",
+    "addColumn",
+    "dropColumn",
+    "renameColumn",
+    "getTableIndexes",
+    "createIndex",
+    "dropIndex",
+    "exportTableToJson",
+    "importTableFromJson",
+    "exportDatabaseToJson",
+    "importDatabaseFromJson",
+    "exportTableToCsv",
+    "importTableFromCsv",
+    "exportDatabaseToSql",
+    "restoreDatabaseFromSql",
+    "exportQueryResultToCsv",
+    "syncSequence",
+    "explainAnalyze",
+    "adviseIndexes",
+    "materializeReport",
+    "refreshReport",
+    "batchQuery",
+    "replicaSync",
+    "replicaQuery",
+    "streamQuery",
+    "timeToFirstRow",
+    "resultConversion",
+    "widgetPopulation"
+};
+
+// Each thread writes only to its own shard, so plain load/store pairs are
+// enough; readers may observe a slightly stale but never torn value.
+struct Shard {
+    std::atomic<quint64> roundTrips[DbMetrics::OperationCount];
+    std::atomic<quint64> rows[DbMetrics::OperationCount];
+    std::atomic<quint64> bytes[DbMetrics::OperationCount];
+    std::atomic<quint64> totalNs[DbMetrics::OperationCount];
+    std::atomic<quint64> histogram[DbMetrics::OperationCount][bucketCount];
+};
+
+struct Totals {
+    quint64 roundTrips[DbMetrics::OperationCount] = {};
+    quint64 rows[DbMetrics::OperationCount] = {};
+    quint64 bytes[DbMetrics::OperationCount] = {};
+    quint64 totalNs[DbMetrics::OperationCount] = {};
+    quint64 histogram[DbMetrics::OperationCount][bucketCount] = {};
+};
+
+QMutex registryMutex;
+std::vector<Shard*> registeredShards;
+Totals retired;
+Totals baseline;
+
+void addShard(Totals &totals, const Shard &s)
+{
+    for (int op = 0; op < DbMetrics::OperationCount; ++op) {
+        totals.roundTrips[op] += s.roundTrips[op].load(std::memory_order_relaxed);
+        totals.rows[op] += s.rows[op].load(std::memory_order_relaxed);
+        totals.bytes[op] += s.bytes[op].load(std::memory_order_relaxed);
+        totals.totalNs[op] += s.totalNs[op].load(std::memory_order_relaxed);
+        for (int b = 0; b < bucketCount; ++b) {
+            totals.histogram[op][b] += s.histogram[op][b].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Owns the calling thread's shard. When the thread exits (pool workers,
+// batch slots) its counters are folded into `retired` and the shard is
+// unregistered, so short-lived threads do not accumulate forever.
+struct LocalShard {
+    Shard *shard = nullptr;
+
+    ~LocalShard()
+    {
+        if (!shard) return;
+        QMutexLocker locker(&registryMutex);
+        addShard(retired, *shard);
+        registeredShards.erase(std::remove(registeredShards.begin(), registeredShards.end(), shard),
+                               registeredShards.end());
+        delete shard;
+    }
+};
+
+thread_local LocalShard localShard;
+thread_local DbMetrics::Operation currentOperation = DbMetrics::Unattributed;
+
+Shard &shard()
+{
+    if (!localShard.shard) {
+        localShard.shard = new Shard();
+        QMutexLocker locker(&registryMutex);
+        registeredShards.push_back(localShard.shard);
+    }
+    return *localShard.shard;
+}
+
+void bump(std::atomic<quint64> &counter, quint64 value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+qint64 nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int bucketFor(quint64 ns)
+{
+    quint64 us = ns / 1000;
+    if (us < 4) return int(us);
+    int msb = 63 - qCountLeadingZeroBits(us);
+    int sub = int((us >> (msb - 2)) & 3);
+    return std::min((msb - 1) * 4 + sub, bucketCount - 1);
+}
+
+double bucketMidpointMs(int bucket)
+{
+    if (bucket < 4) return (bucket + 0.5) / 1000.0;
+    int msb = bucket / 4 + 1;
+    int sub = bucket % 4;
+    double width = double(quint64(1) << (msb - 2));
+    double lower = (4 + sub) * width;
+    return (lower + width / 2) / 1000.0;
+}
+
+void record(DbMetrics::Operation operation, quint64 ns)
+{
+    Shard &s = shard();
+    bump(s.totalNs[operation], ns);
+    bump(s.histogram[operation][bucketFor(ns)], 1);
+}
+
+std::unique_ptr<Totals> collect()
+{
+    std::unique_ptr<Totals> totals(new Totals(retired));
+    for (const Shard *s : registeredShards) {
+        addShard(*totals, *s);
+    }
+    return totals;
+}
+
+double percentileMs(const quint64 *histogram, quint64 count, double fraction)
+{
+    if (count == 0) return 0;
+    quint64 target = std::max<quint64>(1, quint64(std::ceil(count * fraction)));
+    quint64 seen = 0;
+    for (int b = 0; b < bucketCount; ++b) {
+        seen += histogram[b];
+        if (seen >= target) return bucketMidpointMs(b);
+    }
+    return bucketMidpointMs(bucketCount - 1);
+}
+
+void recordQueryRoundTrip(const QSqlQuery &query, bool ok, qint64 sentBytes, qint64 elapsedNs)
+{
+    int rows = 0;
+    if (ok) {
+        rows = query.isSelect() ? query.size() : query.numRowsAffected();
+    }
+    DbMetrics::recordRoundTrip(rows, sentBytes, elapsedNs);
+}
+}
+
+DbMetrics::Scope::Scope(Operation operation)
+    : operation(operation), previous(currentOperation), startNs(0), active(DbMetrics::isEnabled())
+{
+    if (Tracer::isEnabled()) {
+        span.emplace("db", operationName(operation));
+    }
+    if (!active) return;
+    currentOperation = operation;
+    startNs = nowNs();
+}
+
+DbMetrics::Scope::~Scope()
+{
+    if (!active) return;
+    record(operation, quint64(nowNs() - startNs));
+    currentOperation = previous;
+}
+
+void DbMetrics::setEnabled(bool on)
+{
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+bool DbMetrics::exec(QSqlQuery &query, const QString &queryStr)
+{
+    if (!isEnabled() && !Tracer::isEnabled()) return query.exec(queryStr);
+
+    TraceSpan span("sql", "QSqlQuery::exec");
+    span.addArg("sql", queryStr.left(maxTracedSqlLength));
+
+    qint64 start = nowNs();
+    bool ok = query.exec(queryStr);
+    if (isEnabled()) {
+        recordQueryRoundTrip(query, ok, queryStr.size(), nowNs() - start);
+    }
+    return ok;
+}
+
+bool DbMetrics::exec(QSqlQuery &query)
+{
+    if (!isEnabled() && !Tracer::isEnabled()) return query.exec();
+
+    TraceSpan span("sql", "QSqlQuery::exec");
+    span.addArg("sql", query.lastQuery().left(maxTracedSqlLength));
+
+    qint64 start = nowNs();
+    bool ok = query.exec();
+    if (!isEnabled()) return ok;
+
+    qint64 sentBytes = query.lastQuery().size();
+    for (const QVariant &value : query.boundValues()) {
+        sentBytes += rowBytes({value});
+    }
+    recordQueryRoundTrip(query, ok, sentBytes, nowNs() - start);
+    return ok;
+}
+
+void DbMetrics::addTransfer(qint64 rows, qint64 bytes)
+{
+    if (!isEnabled()) return;
+    Shard &s = shard();
+    bump(s.rows[currentOperation], quint64(rows));
+    bump(s.bytes[currentOperation], quint64(bytes));
+}
+
+void DbMetrics::recordRoundTrip(qint64 rows, qint64 sentBytes, qint64 elapsedNs)
+{
+    if (!isEnabled()) return;
+    Shard &s = shard();
+    Operation operation = currentOperation;
+    bump(s.roundTrips[operation], 1);
+    bump(s.bytes[operation], quint64(sentBytes));
+    if (rows > 0) bump(s.rows[operation], quint64(rows));
+
+    record(SqlExec, quint64(elapsedNs));
+    bump(s.roundTrips[SqlExec], 1);
+}
+
+void DbMetrics::recordLatency(Operation operation, qint64 elapsedNs)
+{
+    if (!isEnabled()) return;
+    record(operation, quint64(elapsedNs));
+}
+
+qint64 DbMetrics::rowBytes(const QVariantList &row)
+{
+    qint64 bytes = 0;
+    for (const QVariant &value : row) {
+        switch (value.typeId()) {
+        case QMetaType::QString:
+            bytes += value.toString().size();
+            break;
+        case QMetaType::QByteArray:
+            bytes += value.toByteArray().size();
+            break;
+        default:
+            bytes += value.isNull() ? 0 : 8;
+            break;
+        }
+    }
+    return bytes;
+}
+
+QString DbMetrics::operationName(Operation operation)
+{
+    return QString::fromLatin1(operationNames[operation]);
+}
+
+QList<DbMetrics::OperationStats> DbMetrics::snapshot()
+{
+    QMutexLocker locker(&registryMutex);
+    std::unique_ptr<Totals> totals = collect();
+
+    QList<OperationStats> result;
+    for (int op = 0; op < OperationCount; ++op) {
+        quint64 histogram[bucketCount];
+        quint64 calls = 0;
+        for (int b = 0; b < bucketCount; ++b) {
+            histogram[b] = totals->histogram[op][b] - baseline.histogram[op][b];
+            calls += histogram[b];
+        }
+
+        OperationStats stats;
+        stats.name = operationName(Operation(op));
+        stats.calls = calls;
+        stats.roundTrips = totals->roundTrips[op] - baseline.roundTrips[op];
+        stats.rows = totals->rows[op] - baseline.rows[op];
+        stats.bytes = totals->bytes[op] - baseline.bytes[op];
+        stats.totalMs = (totals->totalNs[op] - baseline.totalNs[op]) / 1e6;
+        stats.p50Ms = percentileMs(histogram, calls, 0.50);
+        stats.p95Ms = percentileMs(histogram, calls, 0.95);
+        stats.p99Ms = percentileMs(histogram, calls, 0.99);
+
+        if (stats.calls > 0 || stats.roundTrips > 0) {
+            result.append(stats);
+        }
+    }
+
+    return result;
+}
+
+QJsonObject DbMetrics::toJson()
+{
+    QJsonArray operations;
+    for (const auto &stats : snapshot()) {
+        QJsonObject obj;
+        obj["name"] = stats.name;
+        obj["calls"] = qint64(stats.calls);
+        obj["roundTrips"] = qint64(stats.roundTrips);
+        obj["rows"] = qint64(stats.rows);
+        obj["bytes"] = qint64(stats.bytes);
+        obj["totalMs"] = stats.totalMs;
+        obj["p50Ms"] = stats.p50Ms;
+        obj["p95Ms"] = stats.p95Ms;
+        obj["p99Ms"] = stats.p99Ms;
+        operations.append(obj);
+    }
+
+    QJsonObject json;
+    json["enabled"] = isEnabled();
+    json["operations"] = operations;
+    return json;
+}
+
+void DbMetrics::reset()
+{
+    QMutexLocker locker(&registryMutex);
+    std::unique_ptr<Totals> totals = collect();
+    baseline = *totals;
+}
@@ -0,0 +1,117 @@
+#ifndef DBMETRICS_H
+#define DBMETRICS_H
+
+#include <QString>
+#include <QList>
+#include <QVariantList>
+#include <QJsonObject>
+#include "tracer.h"
+#include <atomic>
+#include <optional>
+
+class QSqlQuery;
+
+class DbMetrics
+{
+public:
+    enum Operation {
+        Unattributed,
+        SqlExec,
+        Connect,
+        GetTableNames,
+        ExecuteQuery,
+        ExecuteNonQuery,
+        ExecutePrepared,
+        GetTableColumns,
+        GetTableForeignKeys,
+        GetTableConstraints,
+        GetTableSchemas,
+        GetTableData,
+        GetTableDataPage,
+        GetTableStats,
+        CreateTable,
+        DropTable,
+        GetTablePartitioning,
+        MaintainPartitions,
+        InsertRow,
+        DeleteRow,
+        UpdateCell,
+        ChangeColumnType,
+        AddColumn,
+        DropColumn,
+        RenameColumn,
+        GetTableIndexes,
+        CreateIndex,
+        DropIndex,
+        ExportTableToJson,
+        ImportTableFromJson,
+        ExportDatabaseToJson,
+        ImportDatabaseFromJson,
+        ExportTableToCsv,
+        ImportTableFromCsv,
+        ExportDatabaseToSql,
+        RestoreDatabaseFromSql,
+        ExportQueryResultToCsv,
+        SyncSequence,
+        ExplainAnalyze,
+        AdviseIndexes,
+        MaterializeReport,
+        RefreshReport,
+        BatchQuery,
+        ReplicaSync,
+        ReplicaQuery,
+        StreamQuery,
+        TimeToFirstRow,
+        ResultConversion,
+        WidgetPopulation,
+        OperationCount
+    };
+
+    struct OperationStats {
+        QString name;
+        quint64 calls = 0;
+        quint64 roundTrips = 0;
+        quint64 rows = 0;
+        quint64 bytes = 0;
+        double totalMs = 0;
+        double p50Ms = 0;
+        double p95Ms = 0;
+        double p99Ms = 0;
+    };
+
+    class Scope
+    {
+    public:
+        explicit Scope(Operation operation);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Operation operation;
+        Operation previous;
+        qint64 startNs;
+        bool active;
+        std::optional<TraceSpan> span;
+    };
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool on);
+
+    static bool exec(QSqlQuery &query, const QString &queryStr);
+    static bool exec(QSqlQuery &query);
+    static void addTransfer(qint64 rows, qint64 bytes);
+    static void recordRoundTrip(qint64 rows, qint64 sentBytes, qint64 elapsedNs);
+    static void recordLatency(Operation operation, qint64 elapsedNs);
+    static qint64 rowBytes(const QVariantList &row);
+
+    static QString operationName(Operation operation);
+    static QList<OperationStats> snapshot();
+    static QJsonObject toJson();
+    static void reset();
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+#endif
@@ -0,0 +1,414 @@
+#include "indexadvisor.h"
+#include "dbmetrics.h"
+#include "pgpipeline.h"
+#include "tracer.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QCryptographicHash>
+#include <QRegularExpression>
+#include <algorithm>
+
+namespace {
+const int maxIndexColumns = 3;
+const int maxNameLength = 63;
+
+QString statementOf(const QString &sql)
+{
+    QString statement = sql.trimmed();
+    while (statement.endsWith(';')) {
+        statement.chop(1);
+        statement = statement.trimmed();
+    }
+    return statement;
+}
+
+bool isSelect(const QString &sql)
+{
+    QString upper = sql.trimmed().toUpper();
+    return upper.startsWith("SELECT") || upper.startsWith("WITH");
+}
+
+QJsonObject planFromText(const QString &text)
+{
+    QJsonDocument doc = QJsonDocument::fromJson(text.toUtf8());
+    if (!doc.isArray() || doc.array().isEmpty()) return QJsonObject();
+    return doc.array().first().toObject()["Plan"].toObject();
+}
+}
+
+// Names longer than PostgreSQL keeps end in a hash of the full name, so
+// candidates that only differ after the cut do not collide.
+QString IndexAdvisor::Candidate::indexName() const
+{
+    QString suffix = opclass == "gin_trgm_ops" ? "_trgm" : opclass.isEmpty() ? "" : "_pattern";
+    QString name = QString("idx_%1_%2%3").arg(table, columns.join("_"), suffix);
+    if (name.toUtf8().size() <= maxNameLength) return name;
+
+    QByteArray digest = QCryptographicHash::hash(name.toUtf8(), QCryptographicHash::Md5);
+    QString hash = QString::fromLatin1(digest.toHex().left(8));
+    QString prefix = name.left(maxNameLength - hash.size() - 1);
+    while (prefix.toUtf8().size() > maxNameLength - hash.size() - 1) prefix.chop(1);
+    return prefix + "_" + hash;
+}
+
+QStringList IndexAdvisor::Candidate::keys() const
+{
+    QStringList keys;
+    for (const QString &column : columns) {
+        keys.append(opclass.isEmpty() ? column : column + " " + opclass);
+    }
+    return keys;
+}
+
+QString IndexAdvisor::Candidate::definition() const
+{
+    return QString("%1 USING %2 (%3)").arg(table, method, keys().join(", "));
+}
+
+QString IndexAdvisor::Candidate::createStatement() const
+{
+    return QString("CREATE INDEX CONCURRENTLY IF NOT EXISTS %1 ON %2").arg(indexName(), definition());
+}
+
+IndexAdvisor::IndexAdvisor(DatabaseManager &manager)
+    : manager(manager)
+{
+}
+
+bool IndexAdvisor::loadCatalog(QString *error)
+{
+    QString schemaName = manager.connectionSettings().schemaName;
+
+    PgPipeline pipeline(manager.getDatabase());
+    pipeline.add(QString(
+                     "SELECT c.relname, c.reltuples::float8 "
+                     "FROM pg_class c "
+                     "JOIN pg_namespace n ON n.oid = c.relnamespace "
+                     "WHERE n.nspname = '%1' AND c.relkind IN ('r', 'p')"
+                     ).arg(schemaName));
+    pipeline.add(QString(
+                     "SELECT c.relname, a.attname "
+                     "FROM pg_attribute a "
+                     "JOIN pg_class c ON c.oid = a.attrelid "
+                     "JOIN pg_namespace n ON n.oid = c.relnamespace "
+                     "WHERE n.nspname = '%1' AND c.relkind IN ('r', 'p') "
+                     "    AND a.attnum > 0 AND NOT a.attisdropped "
+                     "ORDER BY c.relname, a.attnum"
+                     ).arg(schemaName));
+    pipeline.add(QString(
+                     "SELECT t.relname, a.attname, am.amname, opc.opcname "
+                     "FROM pg_index i "
+                     "JOIN pg_class t ON t.oid = i.indrelid "
+                     "JOIN pg_namespace n ON n.oid = t.relnamespace "
+                     "JOIN pg_class ic ON ic.oid = i.indexrelid "
+                     "JOIN pg_am am ON am.oid = ic.relam "
+                     "JOIN pg_opclass opc ON opc.oid = i.indclass[0] "
+                     "JOIN pg_attribute a ON a.attrelid = t.oid AND a.attnum = i.indkey[0] "
+                     "WHERE n.nspname = '%1'"
+                     ).arg(schemaName));
+    pipeline.add("SELECT extname FROM pg_extension WHERE extname IN ('hypopg', 'pg_trgm')");
+
+    if (!pipeline.run(error)) return false;
+
+    tableRows.clear();
+    tableColumns.clear();
+    indexedColumns.clear();
+    hypoPG = false;
+    trigram = false;
+
+    for (const QVariantList &row : pipeline.result(0).rows) {
+        tableRows[row[0].toString()] = row[1].toDouble();
+    }
+    for (const QVariantList &row : pipeline.result(1).rows) {
+        tableColumns[row[0].toString()].append(row[1].toString());
+    }
+    for (const QVariantList &row : pipeline.result(2).rows) {
+        QString key = row[0].toString() + "." + row[1].toString() + "." + row[2].toString();
+        indexedColumns.insert(key);
+        indexedColumns.insert(key + ":" + row[3].toString());
+    }
+    for (const QVariantList &row : pipeline.result(3).rows) {
+        if (row[0].toString() == "hypopg") hypoPG = true;
+        if (row[0].toString() == "pg_trgm") trigram = true;
+    }
+    return true;
+}
+
+// A failing EXPLAIN aborts the rest of its pipeline batch, so the batch is
+// resent from the statement after the failure.
+bool IndexAdvisor::explain(const QList<Query> &queries, QList<PlanInfo> &plans, QString *error)
+{
+    plans = QList<PlanInfo>(queries.size());
+
+    int begin = 0;
+    while (begin < queries.size()) {
+        PgPipeline pipeline(manager.getDatabase());
+        for (int i = begin; i < queries.size(); ++i) {
+            pipeline.add("EXPLAIN (FORMAT JSON) " + statementOf(queries[i].sql));
+        }
+
+        QString runError;
+        bool ok = pipeline.run(&runError);
+        int failed = pipeline.failedIndex();
+        if (!ok && failed < 0) {
+            if (error) *error = runError;
+            return false;
+        }
+
+        int end = ok ? pipeline.size() : failed;
+        for (int i = 0; i < end; ++i) {
+            const auto &result = pipeline.result(i);
+            if (result.rows.isEmpty()) continue;
+            QJsonObject plan = planFromText(result.rows.first().value(0).toString());
+            plans[begin + i].totalCost = plan["Total Cost"].toDouble();
+            collectPlan(plan, plans[begin + i]);
+        }
+
+        if (ok) break;
+        skipped.append(queries[begin + failed].description + ": " + pipeline.result(failed).error);
+        begin += failed + 1;
+    }
+    return true;
+}
+
+void IndexAdvisor::collectPlan(const QJsonObject &node, PlanInfo &info)
+{
+    static const QRegularExpression equality(
+        "(\\w+)\\.\"?(\\w+)\"?\\)?(?:::\\w+)?\\s*=\\s*\\(?(\\w+)\\.\"?(\\w+)\"?");
+
+    QString relation = node["Relation Name"].toString();
+    if (!relation.isEmpty()) {
+        info.aliases[node["Alias"].toString(relation)] = relation;
+        if (node["Node Type"].toString() == "Seq Scan") {
+            info.seqScans.append({relation, node["Filter"].toString()});
+        }
+    }
+
+    for (const char *key : {"Hash Cond", "Merge Cond", "Join Filter"}) {
+        auto matches = equality.globalMatch(node[key].toString());
+        while (matches.hasNext()) {
+            auto match = matches.next();
+            info.joinKeys.append({{match.captured(1), match.captured(2)},
+                                  {match.captured(3), match.captured(4)}});
+        }
+    }
+
+    for (const auto &child : node["Plans"].toArray()) {
+        collectPlan(child.toObject(), info);
+    }
+}
+
+bool IndexAdvisor::isIndexed(const Candidate &candidate) const
+{
+    QString key = candidate.table + "." + candidate.columns.first() + "." + candidate.method;
+    return indexedColumns.contains(candidate.opclass.isEmpty() ? key : key + ":" + candidate.opclass);
+}
+
+void IndexAdvisor::addCandidate(Candidate candidate, const Query &query, double cost)
+{
+    if (isIndexed(candidate)) return;
+
+    for (Candidate &existing : proposals) {
+        if (existing.table == candidate.table && existing.columns == candidate.columns
+            && existing.method == candidate.method && existing.opclass == candidate.opclass) {
+            if (!existing.queries.contains(query.description)) {
+                existing.queries.append(query.description);
+                existing.costBefore += cost;
+            }
+            return;
+        }
+    }
+
+    candidate.queries = {query.description};
+    candidate.costBefore = cost;
+    proposals.append(candidate);
+}
+
+void IndexAdvisor::propose(const Query &query, const PlanInfo &plan)
+{
+    // "(name)::text ~~ '%Pr%'::text"; ~~* is ILIKE.
+    static const QRegularExpression likeFilter(
+        "\\(?\"?(\\w+)\"?\\)?(?:::\\w+(?: varying)?)?\\s+~~(\\*?)\\s+'((?:[^']|'')*)'");
+    static const QRegularExpression stringLiteral("'(?:[^']|'')*'");
+    static const QRegularExpression identifier("(?<!::)\\b([A-Za-z_]\\w*)\\b(?!\\s*\\()");
+
+    QSet<QString> scanned;
+    for (const Scan &scan : plan.seqScans) {
+        scanned.insert(scan.relation);
+
+        double rows = tableRows.value(scan.relation);
+        if (rows < minRows || scan.filter.isEmpty()) continue;
+        const QStringList &columns = tableColumns[scan.relation];
+
+        QSet<QString> likeColumns;
+        auto likes = likeFilter.globalMatch(scan.filter);
+        while (likes.hasNext()) {
+            auto match = likes.next();
+            QString column = match.captured(1);
+            if (!columns.contains(column)) continue;
+            likeColumns.insert(column);
+
+            QString pattern = match.captured(3);
+            Candidate candidate;
+            candidate.table = scan.relation;
+            candidate.columns = {column};
+            candidate.tableRows = rows;
+            if (!match.captured(2).isEmpty() || pattern.startsWith('%') || pattern.startsWith('_')) {
+                candidate.method = "gin";
+                candidate.opclass = "gin_trgm_ops";
+                candidate.reason = QString("Seq Scan с LIKE '%1'").arg(pattern);
+                if (!trigram) candidate.reason += " (нужно расширение pg_trgm)";
+            } else {
+                candidate.opclass = "text_pattern_ops";
+                candidate.reason = QString("Seq Scan с LIKE по префиксу '%1'").arg(pattern);
+            }
+            addCandidate(candidate, query, plan.totalCost);
+        }
+
+        QString rest = scan.filter;
+        rest.replace(stringLiteral, "''");
+        QStringList filterColumns;
+        auto words = identifier.globalMatch(rest);
+        while (words.hasNext() && filterColumns.size() < maxIndexColumns) {
+            QString word = words.next().captured(1);
+            if (columns.contains(word) && !likeColumns.contains(word) && !filterColumns.contains(word)) {
+                filterColumns.append(word);
+            }
+        }
+        if (!filterColumns.isEmpty()) {
+            Candidate candidate;
+            candidate.table = scan.relation;
+            candidate.columns = filterColumns;
+            candidate.tableRows = rows;
+            candidate.reason = "Seq Scan с фильтром " + scan.filter.left(120);
+            addCandidate(candidate, query, plan.totalCost);
+        }
+    }
+
+    for (const auto &pair : plan.joinKeys) {
+        for (const JoinKey &key : {pair.first, pair.second}) {
+            QString relation = plan.aliases.value(key.alias);
+            double rows = tableRows.value(relation);
+            if (!scanned.contains(relation) || rows < minRows) continue;
+            if (!tableColumns[relation].contains(key.column)) continue;
+
+            Candidate candidate;
+            candidate.table = relation;
+            candidate.columns = {key.column};
+            candidate.tableRows = rows;
+            candidate.reason = QString("Ключ соединения %1.%2 = %3.%4")
+                                   .arg(pair.first.alias, pair.first.column, pair.second.alias, pair.second.column);
+            addCandidate(candidate, query, plan.totalCost);
+        }
+    }
+}
+
+// Each candidate is costed alone: create it as a hypothetical index,
+// re-plan the queries it was proposed for, then drop it again.
+void IndexAdvisor::estimateWithHypoPG(const QList<Query> &queries)
+{
+    QHash<QString, QString> sqlByDescription;
+    for (const Query &query : queries) {
+        sqlByDescription[query.description] = query.sql;
+    }
+
+    QSqlQuery query(manager.getDatabase());
+    for (Candidate &candidate : proposals) {
+        if (candidate.opclass == "gin_trgm_ops" && !trigram) continue;
+
+        QString hypothetical = "CREATE INDEX ON " + candidate.definition();
+        hypothetical.replace("'", "''");
+        if (!DbMetrics::exec(query, QString("SELECT * FROM hypopg_create_index('%1')").arg(hypothetical))) continue;
+
+        double after = 0;
+        bool ok = true;
+        for (const QString &description : candidate.queries) {
+            if (!DbMetrics::exec(query, "EXPLAIN (FORMAT JSON) " + statementOf(sqlByDescription[description]))
+                || !query.next()) {
+                ok = false;
+                break;
+            }
+            after += planFromText(query.value(0).toString())["Total Cost"].toDouble();
+        }
+        if (ok) candidate.costAfter = after;
+
+        DbMetrics::exec(query, "SELECT hypopg_reset()");
+    }
+}
+
+bool IndexAdvisor::analyze(const QList<Query> &queries, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::AdviseIndexes);
+    TraceSpan traceSpan("advisor", "analyze");
+    traceSpan.addArg("queries", queries.size());
+
+    proposals.clear();
+    skipped.clear();
+
+    if (!loadCatalog(error)) return false;
+
+    QList<Query> selects;
+    for (const Query &query : queries) {
+        if (isSelect(query.sql)) selects.append(query);
+    }
+
+    QList<PlanInfo> plans;
+    if (!explain(selects, plans, error)) return false;
+
+    for (int i = 0; i < selects.size(); ++i) {
+        propose(selects[i], plans[i]);
+    }
+
+    if (hypoPG) {
+        estimateWithHypoPG(selects);
+    }
+
+    std::stable_sort(proposals.begin(), proposals.end(), [](const Candidate &a, const Candidate &b) {
+        if (a.benefit() != b.benefit()) return a.benefit() > b.benefit();
+        return a.costBefore > b.costBefore;
+    });
+
+    traceSpan.addArg("candidates", proposals.size());
+    return true;
+}
+
+bool IndexAdvisor::apply(const QList<Candidate> &selected, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::AdviseIndexes);
+    QSqlQuery query(manager.getDatabase());
+
+    bool needsTrigram = std::any_of(selected.begin(), selected.end(), [](const Candidate &candidate) {
+        return candidate.opclass == "gin_trgm_ops";
+    });
+    if (needsTrigram && !trigram) {
+        if (!DbMetrics::exec(query, "CREATE EXTENSION IF NOT EXISTS pg_trgm")) {
+            if (error) *error = "pg_trgm: " + query.lastError().text();
+            return false;
+        }
+        trigram = true;
+    }
+
+    // Built concurrently through DatabaseManager so writes to the table go
+    // on during the build; an index that already exists is left alone.
+    QString schemaName = manager.connectionSettings().schemaName;
+    for (const Candidate &candidate : selected) {
+        TraceSpan traceSpan("advisor", "create index");
+        traceSpan.addArg("index", candidate.indexName());
+
+        QString existsStr = QString("SELECT to_regclass('%1.%2') IS NOT NULL").arg(schemaName, candidate.indexName());
+        if (DbMetrics::exec(query, existsStr) && query.next() && query.value(0).toBool()) continue;
+
+        DatabaseManager::IndexSpec spec;
+        spec.name = candidate.indexName();
+        spec.method = candidate.method;
+        spec.columns = candidate.keys();
+        spec.concurrently = true;
+
+        QString createError;
+        if (!manager.createIndex(candidate.table, spec, &createError)) {
+            if (error) *error = candidate.indexName() + ": " + createError;
+            return false;
+        }
+    }
+    return true;
+}
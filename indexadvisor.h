@@ -0,0 +1,89 @@
+#ifndef INDEXADVISOR_H
+#define INDEXADVISOR_H
+
+#include "databasemanager.h"
+#include <QHash>
+#include <QSet>
+#include <QJsonObject>
+
+// Looks for sequential scans on large tables in the EXPLAIN plans of saved
+// queries and proposes indexes for their filter columns and join keys.
+// With the HypoPG extension each proposal is costed on a hypothetical
+// index; otherwise only the current plan cost is known.
+class IndexAdvisor
+{
+public:
+    struct Query {
+        QString description;
+        QString sql;
+    };
+
+    struct Candidate {
+        QString table;
+        QStringList columns;
+        QString method = "btree";
+        QString opclass;
+        QString reason;
+        QStringList queries;
+        double tableRows = 0;
+        double costBefore = 0;
+        double costAfter = -1;
+
+        QString indexName() const;
+        QStringList keys() const;
+        QString definition() const;
+        QString createStatement() const;
+        double benefit() const { return costAfter < 0 ? -1 : costBefore - costAfter; }
+    };
+
+    explicit IndexAdvisor(DatabaseManager &manager);
+
+    double minTableRows() const { return minRows; }
+    void setMinTableRows(double rows) { minRows = rows; }
+
+    bool analyze(const QList<Query> &queries, QString *error = nullptr);
+    const QList<Candidate> &candidates() const { return proposals; }
+    QStringList skippedQueries() const { return skipped; }
+    bool hasHypoPG() const { return hypoPG; }
+    bool hasTrigram() const { return trigram; }
+
+    bool apply(const QList<Candidate> &selected, QString *error = nullptr);
+
+private:
+    struct Scan {
+        QString relation;
+        QString filter;
+    };
+
+    struct JoinKey {
+        QString alias;
+        QString column;
+    };
+
+    struct PlanInfo {
+        double totalCost = 0;
+        QHash<QString, QString> aliases;
+        QList<Scan> seqScans;
+        QList<QPair<JoinKey, JoinKey>> joinKeys;
+    };
+
+    bool loadCatalog(QString *error);
+    bool explain(const QList<Query> &queries, QList<PlanInfo> &plans, QString *error);
+    static void collectPlan(const QJsonObject &node, PlanInfo &info);
+    void propose(const Query &query, const PlanInfo &plan);
+    void addCandidate(Candidate candidate, const Query &query, double cost);
+    bool isIndexed(const Candidate &candidate) const;
+    void estimateWithHypoPG(const QList<Query> &queries);
+
+    DatabaseManager &manager;
+    double minRows = 10000;
+    bool hypoPG = false;
+    bool trigram = false;
+    QHash<QString, double> tableRows;
+    QHash<QString, QStringList> tableColumns;
+    QSet<QString> indexedColumns;
+    QList<Candidate> proposals;
+    QStringList skipped;
+};
+
+#endif
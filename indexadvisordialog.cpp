@@ -0,0 +1,154 @@
+#include "indexadvisordialog.h"
+#include <QMessageBox>
+#include <QHeaderView>
+#include <QApplication>
+
+namespace {
+QString formatCost(double cost)
+{
+    return cost < 0 ? QString("—") : QString::number(cost, 'f', 0);
+}
+}
+
+IndexAdvisorDialog::IndexAdvisorDialog(const QList<IndexAdvisor::Query> &queries, QWidget *parent)
+    : QDialog(parent), advisor(DatabaseManager::instance()), queries(queries)
+{
+    setupUI();
+}
+
+void IndexAdvisorDialog::setupUI()
+{
+    setWindowTitle("Советник индексов");
+    setMinimumSize(1000, 450);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QHBoxLayout *optionsLayout = new QHBoxLayout();
+    optionsLayout->addWidget(new QLabel("Мин. строк в таблице:", this));
+    minRowsSpin = new QSpinBox(this);
+    minRowsSpin->setRange(0, 1000000000);
+    minRowsSpin->setSingleStep(1000);
+    minRowsSpin->setValue(int(advisor.minTableRows()));
+    optionsLayout->addWidget(minRowsSpin);
+    optionsLayout->addWidget(new QLabel(QString("Сохранённых запросов: %1").arg(queries.size()), this));
+    optionsLayout->addStretch();
+    mainLayout->addLayout(optionsLayout);
+
+    candidatesTable = new QTableWidget(this);
+    candidatesTable->setColumnCount(9);
+    candidatesTable->setHorizontalHeaderLabels({"Таблица", "Столбцы", "Метод", "Причина", "Запросы",
+                                                "Строк", "Стоимость до", "Стоимость после", "Выигрыш"});
+    candidatesTable->setSelectionMode(QAbstractItemView::NoSelection);
+    candidatesTable->horizontalHeader()->setStretchLastSection(true);
+    mainLayout->addWidget(candidatesTable);
+
+    statusLabel = new QLabel(this);
+    statusLabel->setWordWrap(true);
+    mainLayout->addWidget(statusLabel);
+
+    QHBoxLayout *buttonsLayout = new QHBoxLayout();
+    analyzeButton = new QPushButton("Анализировать", this);
+    applyButton = new QPushButton("Применить выбранные", this);
+    applyButton->setEnabled(false);
+    QPushButton *closeButton = new QPushButton("Закрыть", this);
+    connect(analyzeButton, &QPushButton::clicked, this, &IndexAdvisorDialog::onAnalyze);
+    connect(applyButton, &QPushButton::clicked, this, &IndexAdvisorDialog::onApply);
+    connect(closeButton, &QPushButton::clicked, this, &QDialog::close);
+    buttonsLayout->addWidget(analyzeButton);
+    buttonsLayout->addWidget(applyButton);
+    buttonsLayout->addStretch();
+    buttonsLayout->addWidget(closeButton);
+    mainLayout->addLayout(buttonsLayout);
+}
+
+void IndexAdvisorDialog::onAnalyze()
+{
+    advisor.setMinTableRows(minRowsSpin->value());
+
+    QString error;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool ok = advisor.analyze(queries, &error);
+    QApplication::restoreOverrideCursor();
+
+    if (!ok) {
+        QMessageBox::critical(this, "Ошибка", "Не удалось проанализировать запросы: " + error);
+        return;
+    }
+
+    showCandidates();
+}
+
+void IndexAdvisorDialog::showCandidates()
+{
+    const QList<IndexAdvisor::Candidate> &candidates = advisor.candidates();
+    candidatesTable->setRowCount(candidates.size());
+
+    for (int row = 0; row < candidates.size(); ++row) {
+        const IndexAdvisor::Candidate &candidate = candidates[row];
+
+        QTableWidgetItem *tableItem = new QTableWidgetItem(candidate.table);
+        tableItem->setFlags(Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
+        tableItem->setCheckState(candidate.benefit() != 0 ? Qt::Checked : Qt::Unchecked);
+        tableItem->setToolTip(candidate.createStatement());
+        candidatesTable->setItem(row, 0, tableItem);
+
+        QString method = candidate.opclass.isEmpty() ? candidate.method
+                                                     : candidate.method + " " + candidate.opclass;
+        QStringList cells = {
+            candidate.columns.join(", "),
+            method,
+            candidate.reason,
+            candidate.queries.join(", "),
+            QString::number(candidate.tableRows, 'f', 0),
+            formatCost(candidate.costBefore),
+            formatCost(candidate.costAfter),
+            formatCost(candidate.benefit())
+        };
+        for (int col = 0; col < cells.size(); ++col) {
+            QTableWidgetItem *item = new QTableWidgetItem(cells[col]);
+            item->setFlags(Qt::ItemIsEnabled);
+            candidatesTable->setItem(row, col + 1, item);
+        }
+    }
+    candidatesTable->resizeColumnsToContents();
+
+    QStringList status;
+    status.append(candidates.isEmpty() ? "Предложений нет." : QString("Предложено индексов: %1.").arg(candidates.size()));
+    status.append(advisor.hasHypoPG() ? "Стоимость после оценена через HypoPG."
+                                      : "Расширение HypoPG не установлено: стоимость после не оценивается.");
+    if (!advisor.skippedQueries().isEmpty()) {
+        status.append("Пропущены запросы:\n" + advisor.skippedQueries().join("\n"));
+    }
+    statusLabel->setText(status.join(" "));
+    applyButton->setEnabled(!candidates.isEmpty());
+}
+
+void IndexAdvisorDialog::onApply()
+{
+    QList<IndexAdvisor::Candidate> selected;
+    QStringList statements;
+    for (int row = 0; row < candidatesTable->rowCount(); ++row) {
+        if (candidatesTable->item(row, 0)->checkState() != Qt::Checked) continue;
+        selected.append(advisor.candidates()[row]);
+        statements.append(selected.last().createStatement() + ";");
+    }
+    if (selected.isEmpty()) return;
+
+    if (QMessageBox::question(this, "Создание индексов",
+                              "Будут выполнены команды:\n\n" + statements.join("\n")) != QMessageBox::Yes) {
+        return;
+    }
+
+    QString error;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool ok = advisor.apply(selected, &error);
+    QApplication::restoreOverrideCursor();
+
+    if (!ok) {
+        QMessageBox::critical(this, "Ошибка", "Не удалось создать индекс " + error);
+        return;
+    }
+
+    QMessageBox::information(this, "Готово", QString("Создано индексов: %1").arg(selected.size()));
+    onAnalyze();
+}
@@ -0,0 +1,36 @@
+#ifndef INDEXADVISORDIALOG_H
+#define INDEXADVISORDIALOG_H
+
+#include "indexadvisor.h"
+#include <QDialog>
+#include <QTableWidget>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QLabel>
+#include <QVBoxLayout>
+
+class IndexAdvisorDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit IndexAdvisorDialog(const QList<IndexAdvisor::Query> &queries, QWidget *parent = nullptr);
+
+private slots:
+    void onAnalyze();
+    void onApply();
+
+private:
+    void setupUI();
+    void showCandidates();
+
+    IndexAdvisor advisor;
+    QList<IndexAdvisor::Query> queries;
+    QSpinBox *minRowsSpin;
+    QTableWidget *candidatesTable;
+    QLabel *statusLabel;
+    QPushButton *analyzeButton;
+    QPushButton *applyButton;
+};
+
+#endif
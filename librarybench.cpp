@@ -0,0 +1,775 @@
+#include "databasemanager.h"
+#include "pgnative.h"
+#include "csvwriter.h"
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QSqlDatabase>
+
+class LibraryBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void getTableColumns();
+    void getTableData_data();
+    void getTableData();
+    void insertRow_data();
+    void insertRow();
+    void updateCell_data();
+    void updateCell();
+    void deleteRow_data();
+    void deleteRow();
+    void exportTableToJson_data();
+    void exportTableToJson();
+    void exportDatabaseToSql_data();
+    void exportDatabaseToSql();
+    void exportTableToCsv_data();
+    void exportTableToCsv();
+    void exportQueryResultToCsv_data();
+    void exportQueryResultToCsv();
+    void importTableFromCsv_data();
+    void importTableFromCsv();
+    void importTableFromJson_data();
+    void importTableFromJson();
+    void importDatabaseFromJson_data();
+    void importDatabaseFromJson();
+    void restoreDatabaseFromSql_data();
+    void restoreDatabaseFromSql();
+    void readResult_data();
+    void readResult();
+    void exportQueryToCsv_data();
+    void exportQueryToCsv();
+    void decodeResult_data();
+    void decodeResult();
+    void encodeCsvField_data();
+    void encodeCsvField();
+    void encodeCsvFieldMatchesScalar();
+
+private:
+    QString pgBinary(const QString &name) const;
+    bool runPgTool(const QString &name, const QStringList &arguments);
+    void addSizes();
+    void addSizesPerPath();
+    void prepareTables(int rows);
+    void prepareIssueTable(int rows);
+
+    QTemporaryDir clusterDir;
+    QTemporaryDir outputDir;
+    bool ownsCluster = false;
+    int preparedRows = -1;
+    int preparedIssueRows = -1;
+};
+
+QString LibraryBench::pgBinary(const QString &name) const
+{
+    QString binDir = qEnvironmentVariable("LIBRARY_BENCH_PGBIN");
+    if (binDir.isEmpty()) {
+        QProcess pgConfig;
+        pgConfig.start("pg_config", {"--bindir"});
+        if (pgConfig.waitForFinished() && pgConfig.exitCode() == 0) {
+            binDir = QString::fromLocal8Bit(pgConfig.readAllStandardOutput()).trimmed();
+        }
+    }
+
+    if (!binDir.isEmpty() && QFile::exists(binDir + "/" + name)) {
+        return binDir + "/" + name;
+    }
+    return QStandardPaths::findExecutable(name);
+}
+
+bool LibraryBench::runPgTool(const QString &name, const QStringList &arguments)
+{
+    QProcess process;
+    process.start(pgBinary(name), arguments);
+    if (!process.waitForFinished(120000) || process.exitCode() != 0) {
+        qWarning() << name << "failed:" << process.readAllStandardError();
+        return false;
+    }
+    return true;
+}
+
+void LibraryBench::initTestCase()
+{
+    DatabaseManager::ConnectionSettings settings;
+    settings.databaseName = "library";
+    settings.schemaName = "libraryschema";
+
+    if (!qEnvironmentVariableIsEmpty("LIBRARY_BENCH_HOST")) {
+        settings.hostName = qEnvironmentVariable("LIBRARY_BENCH_HOST");
+        settings.port = qEnvironmentVariableIntValue("LIBRARY_BENCH_PORT");
+        settings.userName = qEnvironmentVariable("LIBRARY_BENCH_USER");
+        settings.password = qEnvironmentVariable("LIBRARY_BENCH_PASSWORD");
+        if (settings.port == 0) settings.port = 5432;
+    } else {
+        QVERIFY(clusterDir.isValid());
+        QString dataDir = clusterDir.filePath("data");
+        int port = qEnvironmentVariableIntValue("LIBRARY_BENCH_PORT");
+        if (port == 0) port = 54329;
+
+        QVERIFY2(runPgTool("initdb", {"-D", dataDir, "-U", "bench", "-A", "trust", "-E", "UTF8", "--no-sync"}),
+                 "initdb failed");
+        QVERIFY2(runPgTool("pg_ctl", {"-D", dataDir, "-l", clusterDir.filePath("server.log"), "-w",
+                                      "-o", QString("-p %1 -k %2 -c listen_addresses='' -c fsync=off "
+                                                    "-c synchronous_commit=off -c full_page_writes=off")
+                                                .arg(port).arg(clusterDir.path()),
+                                      "start"}),
+                 "pg_ctl start failed");
+        ownsCluster = true;
+
+        {
+            QSqlDatabase admin = QSqlDatabase::addDatabase("QPSQL", "bench_admin");
+            admin.setHostName(clusterDir.path());
+            admin.setPort(port);
+            admin.setDatabaseName("postgres");
+            admin.setUserName("bench");
+            QVERIFY2(admin.open(), qPrintable(admin.lastError().text()));
+            QSqlQuery query(admin);
+            QVERIFY2(query.exec("CREATE DATABASE library"), qPrintable(query.lastError().text()));
+            admin.close();
+        }
+        QSqlDatabase::removeDatabase("bench_admin");
+
+        settings.hostName = clusterDir.path();
+        settings.port = port;
+        settings.userName = "bench";
+        settings.password.clear();
+    }
+
+    DatabaseManager::instance().setConnectionSettings(settings);
+
+    {
+        QSqlDatabase setup = QSqlDatabase::addDatabase("QPSQL", "bench_setup");
+        setup.setHostName(settings.hostName);
+        setup.setPort(settings.port);
+        setup.setDatabaseName(settings.databaseName);
+        setup.setUserName(settings.userName);
+        setup.setPassword(settings.password);
+        QVERIFY2(setup.open(), qPrintable(setup.lastError().text()));
+        QSqlQuery query(setup);
+        QVERIFY2(query.exec("CREATE SCHEMA IF NOT EXISTS " + settings.schemaName), qPrintable(query.lastError().text()));
+        setup.close();
+    }
+    QSqlDatabase::removeDatabase("bench_setup");
+
+    QVERIFY(DatabaseManager::instance().connectToDatabase());
+    QVERIFY(outputDir.isValid());
+}
+
+void LibraryBench::cleanupTestCase()
+{
+    DatabaseManager::instance().disconnectFromDatabase();
+
+    if (ownsCluster) {
+        runPgTool("pg_ctl", {"-D", clusterDir.filePath("data"), "-m", "immediate", "-w", "stop"});
+    }
+}
+
+void LibraryBench::addSizes()
+{
+    QTest::addColumn<int>("rows");
+
+    QList<int> sizes = {100, 1000, 10000};
+    int extra = qEnvironmentVariableIntValue("LIBRARY_BENCH_ROWS");
+    if (extra > 0 && !sizes.contains(extra)) {
+        sizes.append(extra);
+    }
+
+    for (int rows : sizes) {
+        QTest::newRow(qPrintable(QString("rows=%1").arg(rows))) << rows;
+    }
+}
+
+void LibraryBench::addSizesPerPath()
+{
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<bool>("native");
+
+    QList<int> sizes = {1000, 10000, 100000};
+    int extra = qEnvironmentVariableIntValue("LIBRARY_BENCH_ROWS");
+    if (extra > 0 && !sizes.contains(extra)) {
+        sizes.append(extra);
+    }
+
+    for (int rows : sizes) {
+        QTest::newRow(qPrintable(QString("qsqlquery rows=%1").arg(rows))) << rows << false;
+        QTest::newRow(qPrintable(QString("native rows=%1").arg(rows))) << rows << true;
+    }
+}
+
+void LibraryBench::prepareTables(int rows)
+{
+    if (preparedRows == rows) return;
+
+    DatabaseManager &dm = DatabaseManager::instance();
+    QString error;
+
+    dm.dropTable("bench_book", &error);
+    dm.dropTable("bench_publisher", &error);
+
+    QVERIFY2(dm.executeNonQuery("CREATE TABLE bench_publisher ("
+                                "id BIGSERIAL PRIMARY KEY, name TEXT NOT NULL, country TEXT, "
+                                "foundation_year INTEGER)", &error) >= 0, qPrintable(error));
+    QVERIFY2(dm.executeNonQuery("CREATE TABLE bench_book ("
+                                "id BIGSERIAL PRIMARY KEY, title TEXT NOT NULL, isbn TEXT, "
+                                "year INTEGER, pages INTEGER, published DATE, price NUMERIC, "
+                                "publisher_id BIGINT REFERENCES bench_publisher(id))", &error) >= 0, qPrintable(error));
+
+    QVERIFY2(dm.executeNonQuery("INSERT INTO bench_publisher (name, country, foundation_year) "
+                                "SELECT 'Publisher ' || g, 'Country ' || (g % 20), 1800 + g % 200 "
+                                "FROM generate_series(1, 50) g", &error) >= 0, qPrintable(error));
+    QVERIFY2(dm.executeNonQuery(QString("INSERT INTO bench_book (title, isbn, year, pages, published, price, publisher_id) "
+                                        "SELECT 'Книга; \"том\" ' || g, '978-' || lpad(g::text, 10, '0'), "
+                                        "1950 + g % 75, 50 + g % 900, DATE '1950-01-01' + g % 27000, "
+                                        "(g % 10000) / 100.0, 1 + g % 50 "
+                                        "FROM generate_series(1, %1) g").arg(rows), &error) >= 0, qPrintable(error));
+    QVERIFY2(dm.executeNonQuery("ANALYZE bench_book", &error) >= 0, qPrintable(error));
+
+    preparedRows = rows;
+}
+
+// book_issue shaped: mostly bigint, date, timestamp and numeric columns.
+void LibraryBench::prepareIssueTable(int rows)
+{
+    if (preparedIssueRows == rows) return;
+
+    DatabaseManager &dm = DatabaseManager::instance();
+    QString error;
+
+    dm.dropTable("bench_issue", &error);
+    QVERIFY2(dm.executeNonQuery("CREATE TABLE bench_issue ("
+                                "id BIGSERIAL PRIMARY KEY, book_id BIGINT NOT NULL, reader_id BIGINT NOT NULL, "
+                                "issue_date DATE NOT NULL, due_date DATE NOT NULL, return_date DATE, "
+                                "issued_at TIMESTAMP NOT NULL, returned_at TIMESTAMPTZ, "
+                                "fine NUMERIC(10,2), returned BOOLEAN NOT NULL)", &error) >= 0, qPrintable(error));
+    QVERIFY2(dm.executeNonQuery(QString("INSERT INTO bench_issue (book_id, reader_id, issue_date, due_date, "
+                                        "return_date, issued_at, returned_at, fine, returned) "
+                                        "SELECT 1 + g % 100000, 1 + g % 5000, DATE '2000-01-01' + g % 9000, "
+                                        "DATE '2000-01-15' + g % 9000, "
+                                        "CASE WHEN g % 7 = 0 THEN NULL ELSE DATE '2000-01-10' + g % 9000 END, "
+                                        "TIMESTAMP '2000-01-01 09:00' + (g % 9000) * INTERVAL '1 day' + (g % 3600) * INTERVAL '1 second', "
+                                        "CASE WHEN g % 7 = 0 THEN NULL ELSE TIMESTAMPTZ '2000-01-10 18:00+03' + (g % 9000) * INTERVAL '1 day' END, "
+                                        "(g % 5000) / 100.0, g % 7 <> 0 "
+                                        "FROM generate_series(1, %1) g").arg(rows), &error) >= 0, qPrintable(error));
+    QVERIFY2(dm.executeNonQuery("ANALYZE bench_issue", &error) >= 0, qPrintable(error));
+
+    preparedIssueRows = rows;
+}
+
+void LibraryBench::getTableColumns()
+{
+    prepareTables(100);
+
+    QBENCHMARK {
+        auto columns = DatabaseManager::instance().getTableColumns("bench_book");
+        QCOMPARE(columns.size(), 8);
+    }
+}
+
+void LibraryBench::getTableData_data()
+{
+    addSizes();
+}
+
+void LibraryBench::getTableData()
+{
+    QFETCH(int, rows);
+    prepareTables(rows);
+
+    QBENCHMARK {
+        auto data = DatabaseManager::instance().getTableData("bench_book");
+        QCOMPARE(data.size(), rows);
+    }
+}
+
+void LibraryBench::insertRow_data()
+{
+    addSizes();
+}
+
+void LibraryBench::insertRow()
+{
+    QFETCH(int, rows);
+    prepareTables(rows);
+    preparedRows = -1;
+
+    QVariantList values = {QVariant(), "Новая книга", "978-0000000000", 2024, 320,
+                           QDate(2024, 1, 1), "12.50", 1};
+    QString error;
+
+    QBENCHMARK {
+        QVERIFY2(DatabaseManager::instance().insertRow("bench_book", values, &error), qPrintable(error));
+    }
+}
+
+void LibraryBench::updateCell_data()
+{
+    addSizes();
+}
+
+void LibraryBench::updateCell()
+{
+    QFETCH(int, rows);
+    prepareTables(rows);
+
+    QString error;
+    int iteration = 0;
+
+    QBENCHMARK {
+        QVariantList pk = {1 + iteration % rows};
+        QVERIFY2(DatabaseManager::instance().updateCell("bench_book", "title", QString("Title %1").arg(iteration),
+                                                        pk, &error), qPrintable(error));
+        ++iteration;
+    }
+}
+
+void LibraryBench::deleteRow_data()
+{
+    addSizes();
+}
+
+void LibraryBench::deleteRow()
+{
+    QFETCH(int, rows);
+    prepareTables(rows);
+    preparedRows = -1;
+
+    QString error;
+    int nextId = 1;
+
+    QBENCHMARK {
+        QVariantList pk = {nextId++};
+        QVERIFY2(DatabaseManager::instance().deleteRow("bench_book", pk, &error), qPrintable(error));
+    }
+}
+
+void LibraryBench::exportTableToJson_data()
+{
+    addSizes();
+}
+
+void LibraryBench::exportTableToJson()
+{
+    QFETCH(int, rows);
+    prepareTables(rows);
+
+    QBENCHMARK {
+        QJsonObject json = DatabaseManager::instance().exportTableToJson("bench_book");
+        QCOMPARE(json["data"].toArray().size(), rows);
+    }
+}
+
+void LibraryBench::exportDatabaseToSql_data()
+{
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<int>("format");
+    for (int rows : {1000, 10000, 100000}) {
+        QTest::newRow(qPrintable(QString("copy rows=%1").arg(rows))) << rows << int(DatabaseManager::SqlDumpOptions::Copy);
+        QTest::newRow(qPrintable(QString("inserts rows=%1").arg(rows))) << rows << int(DatabaseManager::SqlDumpOptions::Inserts);
+    }
+}
+
+void LibraryBench::exportDatabaseToSql()
+{
+    QFETCH(int, rows);
+    QFETCH(int, format);
+    prepareTables(rows);
+
+    DatabaseManager::SqlDumpOptions options;
+    options.format = DatabaseManager::SqlDumpOptions::DataFormat(format);
+    QString filePath = outputDir.filePath("dump.sql");
+    QString error;
+
+    QBENCHMARK {
+        QVERIFY2(DatabaseManager::instance().exportDatabaseToSql(filePath, options, &error), qPrintable(error));
+    }
+}
+
+void LibraryBench::exportTableToCsv_data()
+{
+    addSizes();
+}
+
+void LibraryBench::exportTableToCsv()
+{
+    QFETCH(int, rows);
+    prepareTables(rows);
+
+    QString filePath = outputDir.filePath("bench_book.csv");
+    QString error;
+
+    QBENCHMARK {
+        QVERIFY2(DatabaseManager::instance().exportTableToCsv("bench_book", filePath, &error), qPrintable(error));
+    }
+}
+
+void LibraryBench::exportQueryResultToCsv_data()
+{
+    addSizes();
+}
+
+void LibraryBench::exportQueryResultToCsv()
+{
+    QFETCH(int, rows);
+    prepareTables(rows);
+
+    DatabaseManager &dm = DatabaseManager::instance();
+    auto data = dm.getTableData("bench_book");
+    QStringList headers;
+    for (const auto &col : dm.getTableColumns("bench_book")) {
+        headers.append(col.name);
+    }
+    QString filePath = outputDir.filePath("bench_result.csv");
+    QString error;
+
+    QBENCHMARK {
+        QVERIFY2(dm.exportQueryResultToCsv(data, headers, filePath, &error), qPrintable(error));
+    }
+}
+
+void LibraryBench::importTableFromCsv_data()
+{
+    addSizes();
+}
+
+void LibraryBench::importTableFromCsv()
+{
+    QFETCH(int, rows);
+    prepareTables(rows);
+
+    DatabaseManager &dm = DatabaseManager::instance();
+    QString error;
+    QString filePath = outputDir.filePath("bench_import.csv");
+    QVERIFY2(dm.exportTableToCsv("bench_book", filePath, &error), qPrintable(error));
+
+    dm.dropTable("bench_book_import", &error);
+    QVERIFY2(dm.executeNonQuery("CREATE TABLE bench_book_import (LIKE bench_book INCLUDING DEFAULTS)", &error) >= 0,
+             qPrintable(error));
+
+    QBENCHMARK {
+        QVERIFY2(dm.executeNonQuery("TRUNCATE bench_book_import", &error) >= 0, qPrintable(error));
+        QFile file(filePath);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        DatabaseManager::CsvImportReport report;
+        QVERIFY2(dm.importTableFromCsv("bench_book_import", &file, CsvReader::Dialect(), &report, &error),
+                 qPrintable(error));
+        QCOMPARE(report.rowsImported, qint64(rows));
+    }
+}
+
+void LibraryBench::importTableFromJson_data()
+{
+    addSizes();
+}
+
+void LibraryBench::importTableFromJson()
+{
+    QFETCH(int, rows);
+    prepareTables(rows);
+
+    QJsonObject json = DatabaseManager::instance().exportTableToJson("bench_book");
+    json["name"] = "bench_book_copy";
+    json["foreignKeys"] = QJsonArray();
+    preparedRows = -1;
+
+    QString error;
+
+    QBENCHMARK {
+        QVERIFY2(DatabaseManager::instance().importTableFromJson(json, &error), qPrintable(error));
+    }
+
+    DatabaseManager::instance().dropTable("bench_book_copy", &error);
+}
+
+void LibraryBench::importDatabaseFromJson_data()
+{
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<bool>("fast");
+    for (int rows : {100, 1000, 10000}) {
+        QTest::newRow(qPrintable(QString("normal rows=%1").arg(rows))) << rows << false;
+        QTest::newRow(qPrintable(QString("fast rows=%1").arg(rows))) << rows << true;
+    }
+}
+
+void LibraryBench::importDatabaseFromJson()
+{
+    QFETCH(int, rows);
+    QFETCH(bool, fast);
+    prepareTables(rows);
+
+    QJsonArray json = DatabaseManager::instance().exportDatabaseToJson();
+    preparedRows = -1;
+
+    DatabaseManager::RestoreOptions options;
+    options.fast = fast;
+    DatabaseManager::RestoreReport report;
+    QString error;
+
+    QBENCHMARK {
+        QVERIFY2(DatabaseManager::instance().importDatabaseFromJson(json, options, &report, &error), qPrintable(error));
+    }
+    qInfo("WAL per restore: %lld bytes", report.walBytes);
+}
+
+void LibraryBench::restoreDatabaseFromSql_data()
+{
+    exportDatabaseToSql_data();
+}
+
+void LibraryBench::restoreDatabaseFromSql()
+{
+    QFETCH(int, rows);
+    QFETCH(int, format);
+    prepareTables(rows);
+
+    DatabaseManager &dm = DatabaseManager::instance();
+    DatabaseManager::SqlDumpOptions dumpOptions;
+    dumpOptions.format = DatabaseManager::SqlDumpOptions::DataFormat(format);
+    QString filePath = outputDir.filePath("restore.sql");
+    QString error;
+    QVERIFY2(dm.exportDatabaseToSql(filePath, dumpOptions, &error), qPrintable(error));
+    preparedRows = -1;
+
+    QBENCHMARK {
+        QFile file(filePath);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QVERIFY2(dm.restoreDatabaseFromSql(&file, DatabaseManager::SqlRestoreOptions(), nullptr, &error),
+                 qPrintable(error));
+    }
+}
+
+void LibraryBench::readResult_data()
+{
+    addSizesPerPath();
+}
+
+void LibraryBench::readResult()
+{
+    QFETCH(int, rows);
+    QFETCH(bool, native);
+    prepareTables(rows);
+
+    QSqlDatabase &db = DatabaseManager::instance().getDatabase();
+    QVERIFY(!native || PgNativeResult::isAvailable(db));
+    const QString queryStr = "SELECT * FROM bench_book";
+
+    QBENCHMARK {
+        qint64 bytes = 0;
+        int count = 0;
+        if (native) {
+            PgNativeResult result = PgNativeResult::exec(db, queryStr);
+            QVERIFY2(result.isValid(), qPrintable(result.errorMessage()));
+            for (int r = 0; r < result.rowCount(); ++r) {
+                for (int c = 0; c < result.columnCount(); ++c) {
+                    bytes += result.text(r, c).size();
+                }
+                ++count;
+            }
+        } else {
+            QSqlQuery query(db);
+            query.setForwardOnly(true);
+            QVERIFY(query.exec(queryStr));
+            while (query.next()) {
+                for (int c = 0; c < 8; ++c) {
+                    bytes += query.value(c).toString().size();
+                }
+                ++count;
+            }
+        }
+        QCOMPARE(count, rows);
+        QVERIFY(bytes > 0);
+    }
+}
+
+void LibraryBench::exportQueryToCsv_data()
+{
+    addSizesPerPath();
+}
+
+void LibraryBench::exportQueryToCsv()
+{
+    QFETCH(int, rows);
+    QFETCH(bool, native);
+    prepareTables(rows);
+
+    bool wasEnabled = PgNativeResult::isEnabled();
+    PgNativeResult::setEnabled(native);
+
+    DatabaseManager &dm = DatabaseManager::instance();
+    QString error;
+
+    QBENCHMARK {
+        QFile file(outputDir.filePath("bench_query.csv"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QVERIFY2(dm.exportQueryToCsv(dm.getDatabase(), "SELECT * FROM bench_book", &file, &error), qPrintable(error));
+    }
+
+    PgNativeResult::setEnabled(wasEnabled);
+}
+
+void LibraryBench::decodeResult_data()
+{
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<bool>("binary");
+
+    QList<int> sizes = {100000, 1000000};
+    int extra = qEnvironmentVariableIntValue("LIBRARY_BENCH_ROWS");
+    if (extra > 0 && !sizes.contains(extra)) {
+        sizes.append(extra);
+    }
+
+    for (int rows : sizes) {
+        QTest::newRow(qPrintable(QString("text rows=%1").arg(rows))) << rows << false;
+        QTest::newRow(qPrintable(QString("binary rows=%1").arg(rows))) << rows << true;
+    }
+}
+
+void LibraryBench::decodeResult()
+{
+    QFETCH(int, rows);
+    QFETCH(bool, binary);
+    prepareIssueTable(rows);
+
+    QSqlDatabase &db = DatabaseManager::instance().getDatabase();
+    QVERIFY(PgNativeResult::isAvailable(db));
+    const QString queryStr = "SELECT * FROM bench_issue";
+    auto format = binary ? PgNativeResult::BinaryFormat : PgNativeResult::TextFormat;
+
+    QBENCHMARK {
+        PgNativeResult result = PgNativeResult::exec(db, queryStr, format);
+        QVERIFY2(result.isValid(), qPrintable(result.errorMessage()));
+        QCOMPARE(result.rowCount(), rows);
+
+        int nonNull = 0;
+        for (int r = 0; r < result.rowCount(); ++r) {
+            for (int c = 0; c < result.columnCount(); ++c) {
+                if (!result.value(r, c).isNull()) ++nonNull;
+            }
+        }
+        QVERIFY(nonNull > 0);
+    }
+}
+
+void LibraryBench::encodeCsvField_data()
+{
+    QTest::addColumn<QString>("column");
+    QTest::addColumn<bool>("simd");
+
+    for (const QString &column : {QString("book.title"), QString("reader.email")}) {
+        QTest::newRow(qPrintable(column + " scalar")) << column << false;
+        QTest::newRow(qPrintable(column + " simd")) << column << true;
+    }
+}
+
+// 100k values shaped like the real columns: Cyrillic titles where a few
+// carry quotes or semicolons, and short ASCII e-mail addresses.
+void LibraryBench::encodeCsvField()
+{
+    QFETCH(QString, column);
+    QFETCH(bool, simd);
+
+    static const QStringList words = {"Война", "и", "мир", "Преступление", "наказание", "Мастер",
+                                      "Маргарита", "Отцы", "дети", "Идиот", "Герой", "нашего",
+                                      "времени", "Мёртвые", "души", "Тихий", "Дон", "том"};
+    QList<QByteArray> values;
+    values.reserve(100000);
+    for (int i = 0; i < 100000; ++i) {
+        QString value;
+        if (column == "book.title") {
+            int wordCount = 2 + i % 6;
+            for (int w = 0; w < wordCount; ++w) {
+                if (w > 0) value += ' ';
+                value += words[(i * 7 + w * 13) % words.size()];
+            }
+            if (i % 20 == 0) value = "\"" + value + "\"; " + QString("том %1").arg(i % 5 + 1);
+        } else {
+            value = QString("reader%1.%2@library-mail.example").arg(i).arg(words[i % words.size()].size());
+        }
+        values.append(value.toUtf8());
+    }
+
+    bool wasEnabled = CsvWriter::isSimdEnabled();
+    CsvWriter::setSimdEnabled(simd);
+
+    QByteArray out;
+    out.reserve(8 << 20);
+    QBENCHMARK {
+        out.truncate(0);
+        for (const QByteArray &value : values) {
+            CsvWriter::appendField(out, value);
+            out.append(';');
+        }
+    }
+    QVERIFY(out.size() > 0);
+
+    CsvWriter::setSimdEnabled(wasEnabled);
+}
+
+// Not a benchmark: the vector paths must quote exactly like the scalar one
+// and the plain CSV rules. Specials sit around the 16- and 32-byte block
+// edges, at the end of the value and between multibyte UTF-8 sequences.
+void LibraryBench::encodeCsvFieldMatchesScalar()
+{
+    auto expected = [](const QByteArray &value) -> QByteArray {
+        if (!value.contains('"') && !value.contains(';') && !value.contains('\n')) return value;
+        QByteArray quoted = value;
+        quoted.replace("\"", "\"\"");
+        return "\"" + quoted + "\"";
+    };
+    auto encode = [](const QByteArray &value, bool simd) {
+        CsvWriter::setSimdEnabled(simd);
+        QByteArray out;
+        CsvWriter::appendField(out, value);
+        return out;
+    };
+
+    const QList<QByteArray> fillers = {QByteArray("a"), QString("ё").toUtf8(), QString("€").toUtf8(),
+                                       QString("𝄞").toUtf8()};
+    const QList<char> specials = {'"', ';', '\n'};
+    const QList<int> offsets = {0, 1, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65};
+
+    bool wasEnabled = CsvWriter::isSimdEnabled();
+    for (const QByteArray &filler : fillers) {
+        for (int length = 0; length <= 80; ++length) {
+            QByteArray base;
+            while (base.size() < length) base.append(filler);
+            base.truncate(length);
+
+            QList<QByteArray> values = {base};
+            for (char special : specials) {
+                for (int offset : offsets) {
+                    if (offset >= length) continue;
+                    // Overwritten bytes may split a sequence, inserted
+                    // ones keep the UTF-8 valid.
+                    QByteArray value = base;
+                    value[offset] = special;
+                    values.append(value);
+                    values.append(QByteArray(base).insert(offset, special));
+                }
+                if (length > 0) {
+                    QByteArray value = base;
+                    value[length - 1] = special;
+                    values.append(value);
+                    values.append(base + special);
+                    values.append(QByteArray(1, special) + base + special);
+                }
+            }
+
+            for (const QByteArray &value : values) {
+                QByteArray scalar = encode(value, false);
+                QByteArray vector = encode(value, true);
+                QVERIFY2(scalar == expected(value), value.toHex().constData());
+                QVERIFY2(vector == scalar, value.toHex().constData());
+            }
+        }
+    }
+    CsvWriter::setSimdEnabled(wasEnabled);
+}
+
+QTEST_GUILESS_MAIN(LibraryBench)
+
+#include "librarybench.moc"
@@ -0,0 +1,566 @@
+#include "databasemanager.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QDir>
+#include <QJsonDocument>
+#include <QThreadPool>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QRegularExpression>
+#include <functional>
+#include <cstdio>
+
+namespace {
+enum ExitCode {
+    ExitOk = 0,
+    ExitFailure = 1,
+    ExitUsage = 2,
+    ExitConnection = 3
+};
+
+struct JobResult {
+    QString name;
+    bool ok = false;
+    QString error;
+    qint64 elapsedMs = 0;
+};
+
+using Job = std::function<bool(int index, QSqlDatabase connection, QString *error)>;
+
+QTextStream &err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+bool openOutput(QFile &file, const QString &path)
+{
+    if (path.isEmpty() || path == "-") {
+        return file.open(stdout, QIODevice::WriteOnly);
+    }
+    return file.open(QIODevice::WriteOnly);
+}
+
+bool openInput(QFile &file, const QString &path)
+{
+    if (path.isEmpty() || path == "-") {
+        return file.open(stdin, QIODevice::ReadOnly);
+    }
+    return file.open(QIODevice::ReadOnly);
+}
+
+// JSON dumps start with '[' or '{'; anything else is treated as a SQL script.
+bool isSqlScript(QFile &file, const QString &path)
+{
+    if (path.endsWith(".sql", Qt::CaseInsensitive)) return true;
+    if (path.endsWith(".json", Qt::CaseInsensitive)) return false;
+
+    QByteArray head = file.peek(4096);
+    if (head.startsWith("\xEF\xBB\xBF")) head.remove(0, 3);
+    head = head.trimmed();
+    return !head.startsWith('[') && !head.startsWith('{');
+}
+
+bool isSelectStatement(const QString &sql)
+{
+    QString upper = sql.trimmed().toUpper();
+    return upper.startsWith("SELECT") || upper.startsWith("WITH");
+}
+
+QString safeFileName(const QString &name)
+{
+    QString result = name;
+    result.replace(QRegularExpression("[^\\w\\-]+"), "_");
+    return result.left(80);
+}
+
+QList<JobResult> runJobs(const QStringList &names, int jobs, const Job &job)
+{
+    QList<JobResult> results(names.size());
+    QMutex mutex;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(jobs);
+
+    for (int i = 0; i < names.size(); ++i) {
+        pool.start([&, i]() {
+            QString connectionName = QString("libraryctl_job_%1").arg(i);
+            JobResult result;
+            result.name = names[i];
+
+            QElapsedTimer timer;
+            timer.start();
+            {
+                QSqlDatabase connection = DatabaseManager::instance().openWorkerConnection(connectionName, &result.error);
+                result.ok = connection.isOpen() && job(i, connection, &result.error);
+            }
+            DatabaseManager::closeWorkerConnection(connectionName);
+            result.elapsedMs = timer.elapsed();
+
+            QMutexLocker locker(&mutex);
+            results[i] = result;
+        });
+    }
+
+    pool.waitForDone();
+    return results;
+}
+
+int reportJobs(const QList<JobResult> &results)
+{
+    int failed = 0;
+    for (const auto &result : results) {
+        err() << (result.ok ? "ok    " : "FAILED") << "  " << result.elapsedMs << " ms  " << result.name;
+        if (!result.ok) {
+            err() << ": " << result.error;
+            ++failed;
+        }
+        err() << "\n";
+    }
+    err().flush();
+    return failed == 0 ? ExitOk : ExitFailure;
+}
+
+int exportCommand(const QCommandLineParser &parser, int jobs)
+{
+    DatabaseManager &dm = DatabaseManager::instance();
+    QString format = parser.value("format").toLower();
+    QString output = parser.value("output");
+    QString table = parser.value("table");
+    QString error;
+
+    if (format == "sql") {
+        DatabaseManager::SqlDumpOptions options;
+        QString data = parser.value("sql-data").toLower();
+        if (data == "inserts") {
+            options.format = DatabaseManager::SqlDumpOptions::Inserts;
+        } else if (data != "copy") {
+            err() << "--sql-data must be copy or inserts\n";
+            return ExitUsage;
+        }
+        bool rowsOk = false;
+        options.rowsPerInsert = parser.value("rows-per-insert").toInt(&rowsOk);
+        if (!rowsOk || options.rowsPerInsert < 1) {
+            err() << "--rows-per-insert must be a positive number\n";
+            return ExitUsage;
+        }
+
+        QFile file;
+        if (!openOutput(file, output)) {
+            err() << "Cannot open output: " << output << "\n";
+            return ExitFailure;
+        }
+        if (!dm.exportDatabaseToSql(&file, options, &error)) {
+            err() << "Export failed: " << error << "\n";
+            return ExitFailure;
+        }
+        return ExitOk;
+    }
+
+    if (format == "json") {
+        QFile file;
+        if (!openOutput(file, output)) {
+            err() << "Cannot open output: " << output << "\n";
+            return ExitFailure;
+        }
+        QJsonDocument doc = table.isEmpty() ? QJsonDocument(dm.exportDatabaseToJson())
+                                            : QJsonDocument(dm.exportTableToJson(table));
+        if (file.write(doc.toJson()) < 0) {
+            err() << "Export failed: " << file.errorString() << "\n";
+            return ExitFailure;
+        }
+        return ExitOk;
+    }
+
+    if (format == "csv") {
+        if (!table.isEmpty()) {
+            QFile file;
+            if (!openOutput(file, output)) {
+                err() << "Cannot open output: " << output << "\n";
+                return ExitFailure;
+            }
+            if (!dm.exportQueryToCsv(dm.getDatabase(), "SELECT * FROM " + table, &file, &error)) {
+                err() << "Export failed: " << error << "\n";
+                return ExitFailure;
+            }
+            return ExitOk;
+        }
+
+        QString outputDir = output.isEmpty() ? "." : output;
+        if (!QDir().mkpath(outputDir)) {
+            err() << "Cannot create output directory: " << outputDir << "\n";
+            return ExitFailure;
+        }
+
+        // Partitioned tables are exported one file per partition, so the
+        // partitions of one large table are spread over the jobs as well.
+        QStringList tableNames = dm.getTableNames();
+        auto schemas = dm.getTableSchemas(tableNames, &error);
+        if (schemas.size() != tableNames.size()) {
+            err() << "Export failed: " << error << "\n";
+            return ExitFailure;
+        }
+
+        QStringList tables;
+        for (const QString &tableName : tableNames) {
+            const auto &partitioning = schemas[tableName].partitioning;
+            if (!partitioning.isPartitioned()) {
+                tables.append(tableName);
+            }
+            for (const auto &partition : partitioning.partitions) {
+                tables.append(partition.name);
+            }
+        }
+
+        QList<JobResult> results = runJobs(tables, jobs, [&](int index, QSqlDatabase connection, QString *jobError) {
+            QFile file(QDir(outputDir).filePath(tables[index] + ".csv"));
+            if (!file.open(QIODevice::WriteOnly)) {
+                if (jobError) *jobError = "Cannot open file for writing";
+                return false;
+            }
+            return dm.exportQueryToCsv(connection, "SELECT * FROM " + tables[index], &file, jobError);
+        });
+        return reportJobs(results);
+    }
+
+    err() << "Unknown export format: " << format << " (expected sql, json or csv)\n";
+    return ExitUsage;
+}
+
+int maintainPartitionsCommand(const QCommandLineParser &parser)
+{
+    bool premakeOk = false;
+    int premake = parser.value("premake").toInt(&premakeOk);
+    if (!premakeOk || premake < 0) {
+        err() << "--premake must be a non-negative number\n";
+        return ExitUsage;
+    }
+
+    QString error;
+    if (!DatabaseManager::instance().maintainPartitions(premake, &error)) {
+        err() << "Partition maintenance failed:\n" << error << "\n";
+        return ExitFailure;
+    }
+    return ExitOk;
+}
+
+int restoreCommand(const QCommandLineParser &parser)
+{
+    QString input = parser.value("input");
+    QFile file;
+    if (!openInput(file, input)) {
+        err() << "Cannot open input: " << input << "\n";
+        return ExitFailure;
+    }
+
+    if (isSqlScript(file, input)) {
+        if (parser.isSet("fast")) {
+            err() << "--fast applies to JSON restores only\n";
+            return ExitUsage;
+        }
+
+        DatabaseManager::SqlRestoreOptions options;
+        if (parser.isSet("single-transaction") && parser.isSet("batch-commit")) {
+            err() << "--single-transaction and --batch-commit are mutually exclusive\n";
+            return ExitUsage;
+        }
+        options.singleTransaction = !parser.isSet("batch-commit");
+
+        QElapsedTimer timer;
+        timer.start();
+        qint64 statements = 0;
+        QString error;
+        bool ok = DatabaseManager::instance().restoreDatabaseFromSql(&file, options,
+            [&](const DatabaseManager::SqlRestoreProgress &progress) {
+                statements = progress.statements;
+                return true;
+            }, &error);
+        if (!ok) {
+            err() << "Restore failed: " << error << "\n";
+            return ExitFailure;
+        }
+        err() << "restored " << statements << " statements in " << timer.elapsed() << " ms\n";
+        return ExitOk;
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        err() << "Invalid JSON: " << parseError.errorString() << "\n";
+        return ExitFailure;
+    }
+
+    QString error;
+    bool ok = false;
+    if (doc.isArray()) {
+        DatabaseManager::RestoreOptions options;
+        options.fast = parser.isSet("fast");
+        DatabaseManager::RestoreReport report;
+        ok = DatabaseManager::instance().importDatabaseFromJson(doc.array(), options, &report, &error);
+        if (ok) {
+            err() << "restored in " << report.elapsedMs << " ms, WAL "
+                  << (report.walBytes >= 0 ? QString::number(report.walBytes) + " bytes" : QString("unknown"))
+                  << (report.walLevel.isEmpty() ? QString() : " (wal_level " + report.walLevel + ")")
+                  << (options.fast ? " (fast)" : "") << "\n";
+        }
+    } else if (doc.isObject()) {
+        ok = DatabaseManager::instance().importTableFromJson(doc.object(), &error);
+    } else {
+        error = "Unexpected JSON document";
+    }
+
+    if (!ok) {
+        err() << "Restore failed: " << error << "\n";
+        return ExitFailure;
+    }
+    return ExitOk;
+}
+
+int importCsvCommand(const QCommandLineParser &parser)
+{
+    QString table = parser.value("table");
+    if (table.isEmpty()) {
+        err() << "import-csv needs --table\n";
+        return ExitUsage;
+    }
+
+    CsvReader::Dialect dialect;
+    QString delimiter = parser.value("delimiter");
+    if (delimiter == "\\t" || delimiter == "tab") {
+        dialect.delimiter = '\t';
+    } else if (delimiter.size() == 1 && delimiter[0].unicode() < 128) {
+        dialect.delimiter = char(delimiter[0].unicode());
+    } else {
+        err() << "--delimiter must be a single ASCII character or 'tab'\n";
+        return ExitUsage;
+    }
+    dialect.header = !parser.isSet("no-header");
+
+    QString input = parser.value("input");
+    QFile file;
+    if (!openInput(file, input)) {
+        err() << "Cannot open input: " << input << "\n";
+        return ExitFailure;
+    }
+
+    DatabaseManager::CsvImportReport report;
+    QString error;
+    if (!DatabaseManager::instance().importTableFromCsv(table, &file, dialect, &report, &error)) {
+        err() << "Import failed: " << error << "\n";
+        return ExitFailure;
+    }
+
+    for (const auto &rejected : report.rejected) {
+        err() << "rejected line " << rejected.line << ": " << rejected.reason << "\n";
+    }
+    if (!report.ignoredColumns.isEmpty()) {
+        err() << "ignored columns: " << report.ignoredColumns.join(", ") << "\n";
+    }
+    err() << "read " << report.rowsRead << ", imported " << report.rowsImported
+          << ", rejected " << report.rowsRejected << "\n";
+    return ExitOk;
+}
+
+int runQueryCommand(const QCommandLineParser &parser, const QStringList &arguments)
+{
+    DatabaseManager &dm = DatabaseManager::instance();
+    QString sql = arguments.join(" ");
+
+    if (parser.isSet("file")) {
+        QFile sqlFile;
+        if (!openInput(sqlFile, parser.value("file"))) {
+            err() << "Cannot open SQL file: " << parser.value("file") << "\n";
+            return ExitFailure;
+        }
+        sql = QString::fromUtf8(sqlFile.readAll());
+    }
+
+    if (sql.trimmed().isEmpty()) {
+        err() << "No SQL given\n";
+        return ExitUsage;
+    }
+
+    QString error;
+    if (isSelectStatement(sql)) {
+        QFile file;
+        if (!openOutput(file, parser.value("output"))) {
+            err() << "Cannot open output: " << parser.value("output") << "\n";
+            return ExitFailure;
+        }
+        if (!dm.exportQueryToCsv(dm.getDatabase(), sql, &file, &error)) {
+            err() << "Query failed: " << error << "\n";
+            return ExitFailure;
+        }
+        return ExitOk;
+    }
+
+    int rowsAffected = dm.executeNonQuery(sql, &error);
+    if (rowsAffected < 0) {
+        err() << "Query failed: " << error << "\n";
+        return ExitFailure;
+    }
+    err() << "Rows affected: " << rowsAffected << "\n";
+    return ExitOk;
+}
+
+int runSavedCommand(const QCommandLineParser &parser, const QStringList &arguments, int jobs)
+{
+    if (arguments.isEmpty()) {
+        err() << "Usage: libraryctl run-saved <queries.json>\n";
+        return ExitUsage;
+    }
+
+    QFile file(arguments.first());
+    if (!file.open(QIODevice::ReadOnly)) {
+        err() << "Cannot open " << arguments.first() << "\n";
+        return ExitFailure;
+    }
+
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    if (!doc.isArray()) {
+        err() << "Invalid saved queries file\n";
+        return ExitFailure;
+    }
+
+    QStringList descriptions;
+    QStringList scripts;
+    for (const auto &value : doc.array()) {
+        QJsonObject obj = value.toObject();
+        descriptions.append(obj["description"].toString());
+        scripts.append(obj["sql"].toString());
+    }
+
+    QString outputDir = parser.value("output").isEmpty() ? "." : parser.value("output");
+    if (!QDir().mkpath(outputDir)) {
+        err() << "Cannot create output directory: " << outputDir << "\n";
+        return ExitFailure;
+    }
+
+    DatabaseManager &dm = DatabaseManager::instance();
+    QList<JobResult> results = runJobs(descriptions, jobs, [&](int index, QSqlDatabase connection, QString *jobError) {
+        if (!isSelectStatement(scripts[index])) {
+            QSqlQuery query(connection);
+            if (!query.exec(scripts[index])) {
+                if (jobError) *jobError = query.lastError().text();
+                return false;
+            }
+            return true;
+        }
+
+        QString fileName = QString("%1_%2.csv").arg(index + 1, 2, 10, QChar('0')).arg(safeFileName(descriptions[index]));
+        QFile output(QDir(outputDir).filePath(fileName));
+        if (!output.open(QIODevice::WriteOnly)) {
+            if (jobError) *jobError = "Cannot open file for writing";
+            return false;
+        }
+        return dm.exportQueryToCsv(connection, scripts[index], &output, jobError);
+    });
+
+    return reportJobs(results);
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("libraryctl");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless export, restore and query runner for the library database.\n\n"
+                                     "Commands:\n"
+                                     "  export --format sql|json|csv [--table T] [--output PATH]\n"
+                                     "         [--sql-data copy|inserts] [--rows-per-insert N]\n"
+                                     "  restore --input FILE [--single-transaction | --batch-commit] [--fast]\n"
+                                     "  import-csv --table T --input FILE [--delimiter C] [--no-header]\n"
+                                     "  run-query <SQL> | --file FILE [--output PATH]\n"
+                                     "  run-saved <queries.json> [--output DIR]\n"
+                                     "  maintain-partitions [--premake N]");
+    parser.addHelpOption();
+    parser.addPositionalArgument("command", "export, restore, import-csv, run-query, run-saved or maintain-partitions");
+
+    DatabaseManager::ConnectionSettings defaults;
+    parser.addOptions({
+        {"host", "Database host or socket directory.", "host", defaults.hostName},
+        {"port", "Database port.", "port", QString::number(defaults.port)},
+        {"dbname", "Database name.", "name", defaults.databaseName},
+        {"user", "Database user.", "user", defaults.userName},
+        {"password", "Database password (defaults to $PGPASSWORD).", "password"},
+        {"schema", "Schema to work in.", "schema", defaults.schemaName},
+        {"format", "Export format: sql, json or csv.", "format", "sql"},
+        {"sql-data", "Table data in SQL dumps: copy (COPY blocks) or inserts (multi-row INSERT).", "mode", "copy"},
+        {"rows-per-insert", "Rows per INSERT statement with --sql-data inserts.", "N",
+         QString::number(DatabaseManager::SqlDumpOptions().rowsPerInsert)},
+        {"table", "Restrict export to a single table, or the target table for import-csv.", "table"},
+        {"delimiter", "CSV field delimiter for import-csv ('tab' for tabs).", "char", ";"},
+        {"single-transaction", "Run a SQL script restore as one transaction (the default)."},
+        {"batch-commit", "Commit a SQL script restore in batches of statements; a failure keeps the batches before it."},
+        {"fast", "JSON restore: load into UNLOGGED tables with synchronous_commit off. With wal_level "
+                 "replica or logical, the tables are written to WAL in full when they are switched back to LOGGED."},
+        {"no-header", "The CSV file for import-csv has no header row."},
+        {"premake", "Range partitions to create ahead of the current interval.", "N", "3"},
+        {{"o", "output"}, "Output file ('-' for stdout) or directory for per-table/per-query CSV.", "path"},
+        {{"i", "input"}, "Input file ('-' for stdin).", "file", "-"},
+        {{"f", "file"}, "Read SQL for run-query from a file.", "file"},
+        {{"j", "jobs"}, "Number of parallel jobs.", "N", "1"}
+    });
+
+    parser.process(app);
+
+    QStringList positional = parser.positionalArguments();
+    if (positional.isEmpty()) {
+        parser.showHelp(ExitUsage);
+    }
+
+    QString command = positional.takeFirst();
+
+    bool jobsOk = false;
+    int jobs = parser.value("jobs").toInt(&jobsOk);
+    if (!jobsOk || jobs < 1) {
+        err() << "--jobs must be a positive number\n";
+        return ExitUsage;
+    }
+
+    DatabaseManager::ConnectionSettings settings;
+    settings.hostName = parser.value("host");
+    settings.port = parser.value("port").toInt();
+    settings.databaseName = parser.value("dbname");
+    settings.userName = parser.value("user");
+    settings.password = parser.isSet("password") ? parser.value("password")
+                                                 : qEnvironmentVariable("PGPASSWORD", defaults.password);
+    settings.schemaName = parser.value("schema");
+
+    DatabaseManager &dm = DatabaseManager::instance();
+    dm.setConnectionSettings(settings);
+
+    if (command != "export" && command != "restore" && command != "import-csv" &&
+        command != "run-query" && command != "run-saved" && command != "maintain-partitions") {
+        err() << "Unknown command: " << command << "\n";
+        return ExitUsage;
+    }
+
+    if (!dm.connectToDatabase()) {
+        err() << "Cannot connect to database: " << dm.getDatabase().lastError().text() << "\n";
+        return ExitConnection;
+    }
+
+    int result = ExitUsage;
+    if (command == "export") {
+        result = exportCommand(parser, jobs);
+    } else if (command == "restore") {
+        result = restoreCommand(parser);
+    } else if (command == "import-csv") {
+        result = importCsvCommand(parser);
+    } else if (command == "run-query") {
+        result = runQueryCommand(parser, positional);
+    } else if (command == "run-saved") {
+        result = runSavedCommand(parser, positional, jobs);
+    } else if (command == "maintain-partitions") {
+        result = maintainPartitionsCommand(parser);
+    }
+
+    err().flush();
+    dm.disconnectFromDatabase();
+    return result;
+}
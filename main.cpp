@@ -1,13 +1,18 @@
 #include "mainwindow.h"
-
-#include <QApplication>
+#include "tracingapplication.h"
+#include "tracer.h"
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    TracingApplication a(argc, argv);
     MainWindow w;
     w.show();
-    return a.exec();
-}
+    int result = a.exec();
 
+    QString tracePath = qEnvironmentVariable("LIBRARY_TRACE");
+    if (!tracePath.isEmpty()) {
+        Tracer::writeToFile(tracePath);
+    }
 
+    return result;
+}
@@ -1,6 +1,8 @@
 #include "mainwindow.h"
 #include "tablemanagementwindow.h"
 #include "querymanagementwindow.h"
+#include "metricsdialog.h"
+#include "replicacachedialog.h"
 #include <QWidget>
 
 MainWindow::MainWindow(QWidget *parent)
@@ -47,6 +49,18 @@ void MainWindow::setupUI()
     connect(workWithQueriesButton, &QPushButton::clicked, this, &MainWindow::onWorkWithQueriesClicked);
     mainLayout->addWidget(workWithQueriesButton);
 
+    metricsButton = new QPushButton("Метрики производительности", this);
+    metricsButton->setMinimumHeight(50);
+    metricsButton->setStyleSheet("QPushButton { font-size: 14px; }");
+    connect(metricsButton, &QPushButton::clicked, this, &MainWindow::onMetricsClicked);
+    mainLayout->addWidget(metricsButton);
+
+    replicaButton = new QPushButton("Локальная копия данных", this);
+    replicaButton->setMinimumHeight(50);
+    replicaButton->setStyleSheet("QPushButton { font-size: 14px; }");
+    connect(replicaButton, &QPushButton::clicked, this, &MainWindow::onReplicaClicked);
+    mainLayout->addWidget(replicaButton);
+
     mainLayout->addStretch();
 }
 
@@ -63,3 +77,17 @@ void MainWindow::onWorkWithQueriesClicked()
     queryWindow->setAttribute(Qt::WA_DeleteOnClose);
     queryWindow->show();
 }
+
+void MainWindow::onMetricsClicked()
+{
+    MetricsDialog *metricsDialog = new MetricsDialog(this);
+    metricsDialog->setAttribute(Qt::WA_DeleteOnClose);
+    metricsDialog->show();
+}
+
+void MainWindow::onReplicaClicked()
+{
+    ReplicaCacheDialog *replicaDialog = new ReplicaCacheDialog(this);
+    replicaDialog->setAttribute(Qt::WA_DeleteOnClose);
+    replicaDialog->show();
+}
@@ -17,12 +17,16 @@ public:
 private slots:
     void onWorkWithTablesClicked();
     void onWorkWithQueriesClicked();
+    void onMetricsClicked();
+    void onReplicaClicked();
 
 private:
     void setupUI();
 
     QPushButton *workWithTablesButton;
     QPushButton *workWithQueriesButton;
+    QPushButton *metricsButton;
+    QPushButton *replicaButton;
 };
 
 #endif
@@ -0,0 +1,153 @@
+#include "metricsdialog.h"
+#include "dbmetrics.h"
+#include "tracer.h"
+#include <QMessageBox>
+#include <QFileDialog>
+#include <QFile>
+#include <QJsonDocument>
+#include <QHeaderView>
+
+MetricsDialog::MetricsDialog(QWidget *parent)
+    : QDialog(parent)
+{
+    setupUI();
+    onRefresh();
+}
+
+void MetricsDialog::setupUI()
+{
+    setWindowTitle("Метрики производительности");
+    setMinimumSize(900, 500);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    enabledCheck = new QCheckBox("Сбор метрик включён", this);
+    enabledCheck->setChecked(DbMetrics::isEnabled());
+    connect(enabledCheck, &QCheckBox::toggled, this, &MetricsDialog::onEnabledToggled);
+    mainLayout->addWidget(enabledCheck);
+
+    tracingCheck = new QCheckBox("Трассировка (Chrome trace / Perfetto)", this);
+    tracingCheck->setChecked(Tracer::isEnabled());
+    connect(tracingCheck, &QCheckBox::toggled, this, &MetricsDialog::onTracingToggled);
+    mainLayout->addWidget(tracingCheck);
+
+    firstRowLabel = new QLabel(this);
+    mainLayout->addWidget(firstRowLabel);
+
+    metricsTable = new QTableWidget(this);
+    metricsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    metricsTable->setColumnCount(9);
+    metricsTable->setHorizontalHeaderLabels({"Операция", "Вызовы", "Round trips", "Строки", "Байты",
+                                             "Всего, мс", "p50, мс", "p95, мс", "p99, мс"});
+    mainLayout->addWidget(metricsTable);
+
+    QHBoxLayout *buttonsLayout = new QHBoxLayout();
+    refreshButton = new QPushButton("Обновить", this);
+    resetButton = new QPushButton("Сбросить", this);
+    exportButton = new QPushButton("Экспорт JSON", this);
+    exportTraceButton = new QPushButton("Экспорт трассы", this);
+
+    connect(refreshButton, &QPushButton::clicked, this, &MetricsDialog::onRefresh);
+    connect(resetButton, &QPushButton::clicked, this, &MetricsDialog::onReset);
+    connect(exportButton, &QPushButton::clicked, this, &MetricsDialog::onExportJson);
+    connect(exportTraceButton, &QPushButton::clicked, this, &MetricsDialog::onExportTrace);
+
+    buttonsLayout->addWidget(refreshButton);
+    buttonsLayout->addWidget(resetButton);
+    buttonsLayout->addWidget(exportButton);
+    buttonsLayout->addWidget(exportTraceButton);
+    buttonsLayout->addStretch();
+    mainLayout->addLayout(buttonsLayout);
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(1000);
+    connect(refreshTimer, &QTimer::timeout, this, &MetricsDialog::onRefresh);
+    refreshTimer->start();
+}
+
+void MetricsDialog::onRefresh()
+{
+    auto stats = DbMetrics::snapshot();
+
+    QString firstRowName = DbMetrics::operationName(DbMetrics::TimeToFirstRow);
+    firstRowLabel->setText("Время до первых строк результата: нет данных");
+    for (const auto &s : stats) {
+        if (s.name == firstRowName) {
+            firstRowLabel->setText(QString("Время до первых строк результата: p50 %1 мс, p95 %2 мс, p99 %3 мс (%4 запросов)")
+                                       .arg(s.p50Ms, 0, 'f', 1)
+                                       .arg(s.p95Ms, 0, 'f', 1)
+                                       .arg(s.p99Ms, 0, 'f', 1)
+                                       .arg(s.calls));
+            break;
+        }
+    }
+
+    metricsTable->setRowCount(stats.size());
+    for (int row = 0; row < stats.size(); ++row) {
+        const auto &s = stats[row];
+        QStringList cells = {
+            s.name,
+            QString::number(s.calls),
+            QString::number(s.roundTrips),
+            QString::number(s.rows),
+            QString::number(s.bytes),
+            QString::number(s.totalMs, 'f', 2),
+            QString::number(s.p50Ms, 'f', 3),
+            QString::number(s.p95Ms, 'f', 3),
+            QString::number(s.p99Ms, 'f', 3)
+        };
+        for (int col = 0; col < cells.size(); ++col) {
+            metricsTable->setItem(row, col, new QTableWidgetItem(cells[col]));
+        }
+    }
+
+    metricsTable->resizeColumnsToContents();
+}
+
+void MetricsDialog::onReset()
+{
+    DbMetrics::reset();
+    onRefresh();
+}
+
+void MetricsDialog::onExportJson()
+{
+    QString filePath = QFileDialog::getSaveFileName(this, "Экспорт метрик", "", "JSON Files (*.json)");
+
+    if (filePath.isEmpty()) return;
+
+    QFile file(filePath);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(DbMetrics::toJson()).toJson());
+        file.close();
+        QMessageBox::information(this, "Успех", "Метрики успешно экспортированы");
+    } else {
+        QMessageBox::critical(this, "Ошибка", "Не удалось сохранить файл");
+    }
+}
+
+void MetricsDialog::onEnabledToggled(bool checked)
+{
+    DbMetrics::setEnabled(checked);
+}
+
+void MetricsDialog::onTracingToggled(bool checked)
+{
+    Tracer::setEnabled(checked);
+}
+
+void MetricsDialog::onExportTrace()
+{
+    QString filePath = QFileDialog::getSaveFileName(this, "Экспорт трассы", "", "JSON Files (*.json)");
+
+    if (filePath.isEmpty()) return;
+
+    QString error;
+    if (Tracer::writeToFile(filePath, &error)) {
+        QMessageBox::information(this, "Успех",
+                                 QString("Трасса сохранена (%1 событий). Откройте файл в ui.perfetto.dev")
+                                     .arg(Tracer::eventCount()));
+    } else {
+        QMessageBox::critical(this, "Ошибка", "Не удалось сохранить трассу: " + error);
+    }
+}
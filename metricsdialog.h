@@ -0,0 +1,41 @@
+#ifndef METRICSDIALOG_H
+#define METRICSDIALOG_H
+
+#include <QDialog>
+#include <QTableWidget>
+#include <QPushButton>
+#include <QCheckBox>
+#include <QLabel>
+#include <QVBoxLayout>
+#include <QTimer>
+
+class MetricsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsDialog(QWidget *parent = nullptr);
+
+private slots:
+    void onRefresh();
+    void onReset();
+    void onExportJson();
+    void onEnabledToggled(bool checked);
+    void onTracingToggled(bool checked);
+    void onExportTrace();
+
+private:
+    void setupUI();
+
+    QCheckBox *enabledCheck;
+    QCheckBox *tracingCheck;
+    QLabel *firstRowLabel;
+    QTableWidget *metricsTable;
+    QPushButton *refreshButton;
+    QPushButton *resetButton;
+    QPushButton *exportButton;
+    QPushButton *exportTraceButton;
+    QTimer *refreshTimer;
+};
+
+#endif
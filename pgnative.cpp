@@ -0,0 +1,930 @@
+#include "pgnative.h"
+#include "dbmetrics.h"
+#include <QSqlDriver>
+#include <QDateTime>
+#include <QTimeZone>
+#include <QtEndian>
+#include <libpq-fe.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+std::atomic<bool> PgNativeResult::enabled(qEnvironmentVariable("LIBRARY_NATIVE_PQ") != "0");
+std::atomic<bool> PgNativeResult::binaryEnabled(qEnvironmentVariable("LIBRARY_NATIVE_BINARY") != "0");
+
+namespace {
+const qint64 invalidValue = std::numeric_limits<qint64>::min();
+const qint64 unixEpochJulianDay = 2440588;
+const qint64 usPerSecond = 1000000;
+const qint64 usPerDay = 86400 * usPerSecond;
+const qint64 postgresEpochJulianDay = 2451545;
+const qint64 postgresEpochUs = (postgresEpochJulianDay - unixEpochJulianDay) * usPerDay;
+const int maxTracedSqlLength = 512;
+
+void cancelQuery(PGconn *conn)
+{
+    PGcancel *cancel = PQgetCancel(conn);
+    if (cancel) {
+        char message[256];
+        PQcancel(cancel, message, sizeof(message));
+        PQfreeCancel(cancel);
+    }
+}
+
+// Appends the only row of a single-row-mode result to batch.
+bool appendRow(PGresult *batch, const PGresult *row)
+{
+    int target = PQntuples(batch);
+    for (int c = 0; c < PQnfields(row); ++c) {
+        bool null = PQgetisnull(row, 0, c);
+        if (!PQsetvalue(batch, target, c, null ? nullptr : PQgetvalue(row, 0, c),
+                        null ? -1 : PQgetlength(row, 0, c))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+enum TypeOid : unsigned int {
+    BoolOid = 16,
+    NameOid = 19,
+    Int8Oid = 20,
+    Int2Oid = 21,
+    Int4Oid = 23,
+    TextOid = 25,
+    OidOid = 26,
+    Float4Oid = 700,
+    Float8Oid = 701,
+    BpcharOid = 1042,
+    VarcharOid = 1043,
+    DateOid = 1082,
+    TimestampOid = 1114,
+    TimestampTzOid = 1184,
+    NumericOid = 1700
+};
+
+PgNativeResult::Kind kindFor(unsigned int type)
+{
+    switch (type) {
+    case BoolOid: return PgNativeResult::Boolean;
+    case Int8Oid:
+    case Int2Oid:
+    case Int4Oid:
+    case OidOid: return PgNativeResult::Integer;
+    case Float4Oid:
+    case Float8Oid: return PgNativeResult::Real;
+    case NumericOid: return PgNativeResult::Numeric;
+    case DateOid: return PgNativeResult::Date;
+    case TimestampOid: return PgNativeResult::Timestamp;
+    case TimestampTzOid: return PgNativeResult::TimestampTz;
+    default: return PgNativeResult::Text;
+    }
+}
+
+// Binary send format of these types is the raw UTF-8 text.
+bool isTextual(unsigned int type)
+{
+    return type == TextOid || type == VarcharOid || type == BpcharOid || type == NameOid;
+}
+
+qint64 elapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+qint64 floorDiv(qint64 value, qint64 divisor)
+{
+    qint64 result = value / divisor;
+    return (value % divisor < 0) ? result - 1 : result;
+}
+
+bool parseDigits(const char *&p, const char *end, int count, int &value)
+{
+    value = 0;
+    for (int i = 0; i < count; ++i, ++p) {
+        if (p >= end || *p < '0' || *p > '9') return false;
+        value = value * 10 + (*p - '0');
+    }
+    return true;
+}
+
+bool parseInteger(const char *p, int length, qint64 &value)
+{
+    const char *end = p + length;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+    if (p == end) return false;
+
+    quint64 result = 0;
+    for (; p < end; ++p) {
+        if (*p < '0' || *p > '9') return false;
+        result = result * 10 + quint64(*p - '0');
+    }
+    value = negative ? qint64(0 - result) : qint64(result);
+    return true;
+}
+
+// Text output is ISO because QPSQL sets DateStyle on connect; anything else
+// (BC dates, infinity, five-digit years) falls back to the text value.
+bool parseDate(const char *&p, const char *end, qint64 &julianDay)
+{
+    int year, month, day;
+    if (!parseDigits(p, end, 4, year) || p >= end || *p++ != '-' ||
+        !parseDigits(p, end, 2, month) || p >= end || *p++ != '-' ||
+        !parseDigits(p, end, 2, day)) {
+        return false;
+    }
+
+    QDate date(year, month, day);
+    if (!date.isValid()) return false;
+    julianDay = date.toJulianDay();
+    return true;
+}
+
+bool parseTimestamp(const char *p, const char *end, bool withZone, qint64 &usSinceEpoch)
+{
+    qint64 julianDay;
+    int hours, minutes, seconds;
+    if (!parseDate(p, end, julianDay) || p >= end || *p++ != ' ' ||
+        !parseDigits(p, end, 2, hours) || p >= end || *p++ != ':' ||
+        !parseDigits(p, end, 2, minutes) || p >= end || *p++ != ':' ||
+        !parseDigits(p, end, 2, seconds)) {
+        return false;
+    }
+
+    qint64 fraction = 0;
+    if (p < end && *p == '.') {
+        ++p;
+        int digits = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+            if (digits < 6) {
+                fraction = fraction * 10 + (*p - '0');
+                ++digits;
+            }
+        }
+        for (; digits < 6; ++digits) fraction *= 10;
+    }
+
+    qint64 offsetSeconds = 0;
+    if (withZone) {
+        if (p >= end || (*p != '+' && *p != '-')) return false;
+        int sign = (*p++ == '-') ? -1 : 1;
+        int offsetHours, offsetMinutes = 0, offsetSecs = 0;
+        if (!parseDigits(p, end, 2, offsetHours)) return false;
+        if (p < end && *p == ':' && !parseDigits(++p, end, 2, offsetMinutes)) return false;
+        if (p < end && *p == ':' && !parseDigits(++p, end, 2, offsetSecs)) return false;
+        offsetSeconds = sign * (offsetHours * 3600 + offsetMinutes * 60 + offsetSecs);
+    }
+
+    if (p != end) return false;
+
+    qint64 secondsOfDay = qint64(hours) * 3600 + minutes * 60 + seconds - offsetSeconds;
+    usSinceEpoch = (julianDay - unixEpochJulianDay) * usPerDay + secondsOfDay * usPerSecond + fraction;
+    return true;
+}
+
+qint64 binaryInteger(const char *p, int length)
+{
+    switch (length) {
+    case 2: return qFromBigEndian<qint16>(p);
+    case 4: return qFromBigEndian<qint32>(p);
+    case 8: return qFromBigEndian<qint64>(p);
+    default: return invalidValue;
+    }
+}
+
+double binaryReal(const char *p, int length)
+{
+    if (length == 4) {
+        quint32 bits = qFromBigEndian<quint32>(p);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    if (length == 8) {
+        quint64 bits = qFromBigEndian<quint64>(p);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    return qQNaN();
+}
+
+// numeric_send: ndigits, weight, sign, dscale, then base-10000 digits with
+// the first digit scaled by 10000^weight.
+double binaryNumeric(const char *p, int length)
+{
+    if (length < 8) return qQNaN();
+
+    int ndigits = qFromBigEndian<qint16>(p);
+    int weight = qFromBigEndian<qint16>(p + 2);
+    quint16 sign = qFromBigEndian<quint16>(p + 4);
+    if (sign == 0xC000) return qQNaN();
+    if (sign == 0xD000) return qInf();
+    if (sign == 0xF000) return -qInf();
+    if (length < 8 + ndigits * 2) return qQNaN();
+
+    double value = 0;
+    for (int i = 0; i < ndigits; ++i) {
+        value = value * 10000 + qFromBigEndian<quint16>(p + 8 + i * 2);
+    }
+
+    int exponent = weight - ndigits + 1;
+    if (exponent > 0) {
+        value *= std::pow(10000.0, exponent);
+    } else if (exponent < 0) {
+        value /= std::pow(10000.0, -exponent);
+    }
+    return sign == 0x4000 ? -value : value;
+}
+
+QString infinityText(const char *p)
+{
+    return (uchar(*p) & 0x80) ? QStringLiteral("-infinity") : QStringLiteral("infinity");
+}
+
+QString connectionError(PGconn *conn)
+{
+    return QString::fromUtf8(PQerrorMessage(conn)).trimmed();
+}
+}
+
+PgNativeResult::PgNativeResult()
+    : result(nullptr)
+{
+}
+
+PgNativeResult::PgNativeResult(pg_result *result)
+    : result(result)
+{
+    if (!result) {
+        error = "Out of memory";
+        return;
+    }
+
+    ExecStatusType status = PQresultStatus(result);
+    bool hasTuples = status == PGRES_TUPLES_OK || status == PGRES_SINGLE_TUPLE;
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    hasTuples = hasTuples || status == PGRES_TUPLES_CHUNK;
+#endif
+    if (!hasTuples && status != PGRES_COMMAND_OK) {
+        error = QString::fromUtf8(PQresultErrorMessage(result)).trimmed();
+        return;
+    }
+
+    int count = PQnfields(result);
+    columns.resize(count);
+    for (int i = 0; i < count; ++i) {
+        columns[i].name = QString::fromUtf8(PQfname(result, i));
+        columns[i].type = PQftype(result, i);
+        columns[i].kind = kindFor(columns[i].type);
+        columns[i].binary = PQfformat(result, i) == 1;
+    }
+}
+
+PgNativeResult::~PgNativeResult()
+{
+    if (result) PQclear(result);
+}
+
+PgNativeResult::PgNativeResult(PgNativeResult &&other) noexcept
+    : result(other.result), error(std::move(other.error)), columns(std::move(other.columns))
+{
+    other.result = nullptr;
+}
+
+PgNativeResult &PgNativeResult::operator=(PgNativeResult &&other) noexcept
+{
+    std::swap(result, other.result);
+    std::swap(error, other.error);
+    std::swap(columns, other.columns);
+    return *this;
+}
+
+bool PgNativeResult::isValid() const
+{
+    return result && error.isEmpty();
+}
+
+QString PgNativeResult::errorMessage() const
+{
+    return error;
+}
+
+int PgNativeResult::rowCount() const
+{
+    return isValid() ? PQntuples(result) : 0;
+}
+
+int PgNativeResult::columnCount() const
+{
+    return int(columns.size());
+}
+
+int PgNativeResult::rowsAffected() const
+{
+    return isValid() ? QByteArray(PQcmdTuples(result)).toInt() : 0;
+}
+
+QString PgNativeResult::columnName(int column) const
+{
+    return columns[column].name;
+}
+
+PgNativeResult::Kind PgNativeResult::columnKind(int column) const
+{
+    return columns[column].kind;
+}
+
+bool PgNativeResult::isBinary(int column) const
+{
+    return columns[column].binary;
+}
+
+bool PgNativeResult::isNull(int row, int column) const
+{
+    return PQgetisnull(result, row, column);
+}
+
+QByteArrayView PgNativeResult::text(int row, int column) const
+{
+    return QByteArrayView(PQgetvalue(result, row, column), PQgetlength(result, row, column));
+}
+
+const std::vector<qint64> &PgNativeResult::integers(int column) const
+{
+    decode(column);
+    return columns[column].integers;
+}
+
+const std::vector<double> &PgNativeResult::reals(int column) const
+{
+    decode(column);
+    return columns[column].reals;
+}
+
+void PgNativeResult::decode(int column) const
+{
+    const Column &col = columns[column];
+    if (col.decoded) return;
+    col.decoded = true;
+
+    if (col.binary) {
+        decodeBinary(column);
+        return;
+    }
+
+    int rows = rowCount();
+
+    if (col.kind == Real || col.kind == Numeric) {
+        col.reals.resize(rows);
+        for (int row = 0; row < rows; ++row) {
+            if (PQgetisnull(result, row, column)) continue;
+            bool ok = false;
+            double value = QByteArray::fromRawData(PQgetvalue(result, row, column),
+                                                   PQgetlength(result, row, column)).toDouble(&ok);
+            col.reals[row] = ok ? value : qQNaN();
+        }
+        return;
+    }
+
+    if (col.kind == Text) return;
+
+    col.integers.resize(rows);
+    for (int row = 0; row < rows; ++row) {
+        qint64 value = invalidValue;
+        if (!PQgetisnull(result, row, column)) {
+            const char *p = PQgetvalue(result, row, column);
+            int length = PQgetlength(result, row, column);
+            const char *end = p + length;
+
+            switch (col.kind) {
+            case Boolean:
+                value = (length > 0 && *p == 't') ? 1 : 0;
+                break;
+            case Integer:
+                if (!parseInteger(p, length, value)) value = invalidValue;
+                break;
+            case Date:
+                if (!parseDate(p, end, value) || p != end) value = invalidValue;
+                break;
+            case Timestamp:
+            case TimestampTz:
+                if (!parseTimestamp(p, end, col.kind == TimestampTz, value)) value = invalidValue;
+                break;
+            default:
+                break;
+            }
+        }
+        col.integers[row] = value;
+    }
+}
+
+void PgNativeResult::decodeBinary(int column) const
+{
+    const Column &col = columns[column];
+    int rows = rowCount();
+
+    if (col.kind == Real || col.kind == Numeric) {
+        col.reals.resize(rows);
+        for (int row = 0; row < rows; ++row) {
+            if (PQgetisnull(result, row, column)) continue;
+            const char *p = PQgetvalue(result, row, column);
+            int length = PQgetlength(result, row, column);
+            col.reals[row] = col.kind == Real ? binaryReal(p, length) : binaryNumeric(p, length);
+        }
+        return;
+    }
+
+    if (col.kind == Text) return;
+
+    col.integers.resize(rows);
+    for (int row = 0; row < rows; ++row) {
+        qint64 value = invalidValue;
+        if (!PQgetisnull(result, row, column)) {
+            const char *p = PQgetvalue(result, row, column);
+            int length = PQgetlength(result, row, column);
+
+            switch (col.kind) {
+            case Boolean:
+                value = (length > 0 && *p) ? 1 : 0;
+                break;
+            case Integer:
+                value = col.type == OidOid && length == 4 ? qint64(qFromBigEndian<quint32>(p))
+                                                          : binaryInteger(p, length);
+                break;
+            case Date:
+                if (length == 4) {
+                    qint32 days = qFromBigEndian<qint32>(p);
+                    if (days != std::numeric_limits<qint32>::min() && days != std::numeric_limits<qint32>::max()) {
+                        value = days + postgresEpochJulianDay;
+                    }
+                }
+                break;
+            case Timestamp:
+            case TimestampTz:
+                if (length == 8) {
+                    qint64 us = qFromBigEndian<qint64>(p);
+                    if (us != std::numeric_limits<qint64>::min() && us != std::numeric_limits<qint64>::max()) {
+                        value = us + postgresEpochUs;
+                    }
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        col.integers[row] = value;
+    }
+}
+
+QVariant PgNativeResult::value(int row, int column) const
+{
+    if (isNull(row, column)) return QVariant();
+
+    const Column &col = columns[column];
+    switch (col.kind) {
+    case Boolean:
+        return bool(integers(column)[row]);
+    case Integer: {
+        qint64 value = integers(column)[row];
+        if (value == invalidValue) break;
+        return col.type == Int8Oid ? QVariant(qlonglong(value)) : QVariant(int(value));
+    }
+    case Real:
+    case Numeric:
+        return reals(column)[row];
+    case Date: {
+        qint64 value = integers(column)[row];
+        if (value == invalidValue) break;
+        return QDate::fromJulianDay(value);
+    }
+    case Timestamp: {
+        qint64 value = integers(column)[row];
+        if (value == invalidValue) break;
+        QDateTime utc = QDateTime::fromMSecsSinceEpoch(floorDiv(value, 1000), QTimeZone::utc());
+        return QDateTime(utc.date(), utc.time());
+    }
+    case TimestampTz: {
+        qint64 value = integers(column)[row];
+        if (value == invalidValue) break;
+        return QDateTime::fromMSecsSinceEpoch(floorDiv(value, 1000), QTimeZone::utc()).toLocalTime();
+    }
+    case Text:
+        if (col.binary && !isTextual(col.type)) return text(row, column).toByteArray();
+        break;
+    }
+
+    if (col.binary && col.kind != Text) {
+        return infinityText(PQgetvalue(result, row, column));
+    }
+    return QString::fromUtf8(text(row, column));
+}
+
+void PgNativeResult::setEnabled(bool on)
+{
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+void PgNativeResult::setBinaryEnabled(bool on)
+{
+    binaryEnabled.store(on, std::memory_order_relaxed);
+}
+
+// Takes information_schema type names as reported by getTableColumns.
+bool PgNativeResult::hasBinaryDecoder(const QString &sqlType)
+{
+    static const QStringList supported = {
+        "boolean", "smallint", "integer", "bigint", "oid", "real", "double precision",
+        "numeric", "date", "timestamp without time zone", "timestamp with time zone",
+        "text", "character varying", "character", "name"
+    };
+    return supported.contains(sqlType.toLower());
+}
+
+// Text form of a bound parameter value.
+QByteArray PgNativeResult::parameterText(const QVariant &value)
+{
+    switch (value.typeId()) {
+    case QMetaType::Bool:
+        return value.toBool() ? "t" : "f";
+    case QMetaType::QDate:
+        return value.toDate().toString(Qt::ISODate).toUtf8();
+    case QMetaType::QDateTime:
+        return value.toDateTime().toString("yyyy-MM-dd HH:mm:ss.zzz").toUtf8();
+    default:
+        return value.toString().toUtf8();
+    }
+}
+
+pg_conn *PgNativeResult::connectionHandle(const QSqlDatabase &db)
+{
+    if (!db.isOpen() || !db.driver()) return nullptr;
+
+    QVariant handle = db.driver()->handle();
+    if (!handle.isValid() || qstrcmp(handle.typeName(), "PGconn*") != 0) return nullptr;
+    return *static_cast<PGconn *const *>(handle.constData());
+}
+
+bool PgNativeResult::isAvailable(const QSqlDatabase &db)
+{
+    return isEnabled() && connectionHandle(db) != nullptr;
+}
+
+PgNativeResult PgNativeResult::exec(const QSqlDatabase &db, const QString &queryStr, Format format)
+{
+    PGconn *conn = connectionHandle(db);
+    if (!conn) {
+        PgNativeResult invalid;
+        invalid.error = "No libpq connection";
+        return invalid;
+    }
+
+    TraceSpan span("sql", "PQexec");
+    span.addArg("sql", queryStr.left(maxTracedSqlLength));
+
+    QByteArray sql = queryStr.toUtf8();
+    auto start = std::chrono::steady_clock::now();
+    PgNativeResult native(format == BinaryFormat
+                              ? PQexecParams(conn, sql.constData(), 0, nullptr, nullptr, nullptr, nullptr, 1)
+                              : PQexec(conn, sql.constData()));
+    if (DbMetrics::isEnabled()) {
+        DbMetrics::recordRoundTrip(native.rowCount(), sql.size(), elapsedNs(start));
+    }
+    return native;
+}
+
+// Parameter types are left to the server, so casts in the statement
+// (e.g. $1::integer) decide them.
+bool PgNativeResult::prepare(const QSqlDatabase &db, const QString &statementName, const QString &queryStr,
+                             QString *error)
+{
+    PGconn *conn = connectionHandle(db);
+    if (!conn) {
+        if (error) *error = "No libpq connection";
+        return false;
+    }
+
+    TraceSpan span("sql", "PQprepare");
+    span.addArg("sql", queryStr.left(maxTracedSqlLength));
+
+    QByteArray name = statementName.toUtf8();
+    QByteArray sql = queryStr.toUtf8();
+    auto start = std::chrono::steady_clock::now();
+    PgNativeResult native(PQprepare(conn, name.constData(), sql.constData(), 0, nullptr));
+    if (DbMetrics::isEnabled()) {
+        DbMetrics::recordRoundTrip(0, sql.size(), elapsedNs(start));
+    }
+    if (!native.isValid()) {
+        if (error) *error = native.errorMessage();
+        return false;
+    }
+    return true;
+}
+
+PgNativeResult PgNativeResult::execPrepared(const QSqlDatabase &db, const QString &statementName,
+                                            const QVariantList &params)
+{
+    PGconn *conn = connectionHandle(db);
+    if (!conn) {
+        PgNativeResult invalid;
+        invalid.error = "No libpq connection";
+        return invalid;
+    }
+
+    TraceSpan span("sql", "PQexecPrepared");
+    span.addArg("statement", statementName);
+
+    std::vector<QByteArray> storage;
+    std::vector<const char *> values;
+    storage.reserve(params.size());
+    qint64 sentBytes = 0;
+    for (const QVariant &param : params) {
+        if (param.isNull()) {
+            values.push_back(nullptr);
+        } else {
+            storage.push_back(parameterText(param));
+            values.push_back(storage.back().constData());
+            sentBytes += storage.back().size();
+        }
+    }
+
+    QByteArray name = statementName.toUtf8();
+    auto start = std::chrono::steady_clock::now();
+    PgNativeResult native(PQexecPrepared(conn, name.constData(), int(values.size()),
+                                         values.empty() ? nullptr : values.data(), nullptr, nullptr, 0));
+    if (DbMetrics::isEnabled()) {
+        DbMetrics::recordRoundTrip(native.rowCount(), sentBytes, elapsedNs(start));
+    }
+    return native;
+}
+
+// With libpq 17+ rows arrive in chunks of chunkRows; older libraries hand
+// over the whole result at once.
+bool PgNativeResult::stream(const QSqlDatabase &db, const QString &queryStr, int chunkRows,
+                            const std::function<bool(const PgNativeResult &)> &consumer, QString *error)
+{
+    PGconn *conn = connectionHandle(db);
+    if (!conn) {
+        if (error) *error = "No libpq connection";
+        return false;
+    }
+
+    TraceSpan span("sql", "PQsendQuery");
+    span.addArg("sql", queryStr.left(maxTracedSqlLength));
+
+    QByteArray sql = queryStr.toUtf8();
+    auto start = std::chrono::steady_clock::now();
+
+    if (!PQsendQuery(conn, sql.constData())) {
+        if (error) *error = connectionError(conn);
+        return false;
+    }
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    PQsetChunkedRowsMode(conn, chunkRows);
+#else
+    // Older libpq hands out one row per result; rows are gathered into
+    // chunks here so the first block still arrives before the rest.
+    PQsetSingleRowMode(conn);
+#endif
+
+    bool ok = true;
+    qint64 rows = 0;
+    PGresult *pending = nullptr;
+
+    auto deliver = [&](const PgNativeResult &chunk) {
+        rows += chunk.rowCount();
+        if (consumer(chunk)) return;
+
+        if (error && error->isEmpty()) *error = "Cancelled";
+        ok = false;
+        cancelQuery(conn);
+    };
+
+    while (PGresult *raw = PQgetResult(conn)) {
+        if (ok && PQresultStatus(raw) == PGRES_SINGLE_TUPLE) {
+            if (!pending) pending = PQcopyResult(raw, PG_COPYRES_ATTRS);
+            bool appended = pending && appendRow(pending, raw);
+            PQclear(raw);
+            if (!appended) {
+                if (error) *error = "Out of memory";
+                ok = false;
+            } else if (PQntuples(pending) >= chunkRows) {
+                PgNativeResult chunk(pending);
+                pending = nullptr;
+                deliver(chunk);
+            }
+            continue;
+        }
+
+        PgNativeResult chunk(raw);
+        if (!ok) continue;
+
+        if (!chunk.isValid()) {
+            if (error) *error = chunk.errorMessage();
+            ok = false;
+            continue;
+        }
+
+        if (pending) {
+            PgNativeResult rest(pending);
+            pending = nullptr;
+            deliver(rest);
+            if (!ok) continue;
+        }
+        deliver(chunk);
+    }
+    if (pending) PQclear(pending);
+
+    if (DbMetrics::isEnabled()) {
+        DbMetrics::recordRoundTrip(rows, sql.size(), elapsedNs(start));
+    }
+    return ok;
+}
+
+// Sends COPY ... FROM STDIN data (text format, one row per line).
+bool PgNativeResult::copyIn(const QSqlDatabase &db, const QString &copyStatement,
+                            const QByteArray &data, QString *error)
+{
+    bool done = false;
+    return copyIn(db, copyStatement, [&](QByteArray &chunk, QString *) {
+        if (done) return false;
+        chunk = data;
+        done = true;
+        return true;
+    }, error);
+}
+
+bool PgNativeResult::copyIn(const QSqlDatabase &db, const QString &copyStatement,
+                            const std::function<bool(QByteArray &chunk, QString *abort)> &producer,
+                            QString *error)
+{
+    PGconn *conn = connectionHandle(db);
+    if (!conn) {
+        if (error) *error = "No libpq connection";
+        return false;
+    }
+
+    TraceSpan span("sql", "COPY FROM STDIN");
+    span.addArg("sql", copyStatement.left(maxTracedSqlLength));
+
+    QByteArray sql = copyStatement.toUtf8();
+    auto start = std::chrono::steady_clock::now();
+
+    PGresult *begin = PQexec(conn, sql.constData());
+    if (PQresultStatus(begin) != PGRES_COPY_IN) {
+        if (error) *error = QString::fromUtf8(PQresultErrorMessage(begin)).trimmed();
+        PQclear(begin);
+        return false;
+    }
+    PQclear(begin);
+
+    const qsizetype pieceBytes = 1 << 20;
+    qint64 bytes = 0;
+    bool sent = true;
+    QString abort;
+    QByteArray chunk;
+    while (sent && producer(chunk, &abort)) {
+        for (qsizetype offset = 0; offset < chunk.size() && sent; offset += pieceBytes) {
+            int length = int(std::min<qsizetype>(pieceBytes, chunk.size() - offset));
+            sent = PQputCopyData(conn, chunk.constData() + offset, length) == 1;
+        }
+        bytes += chunk.size();
+    }
+    span.addArg("bytes", bytes);
+
+    // A non-null message makes the server fail the COPY, so a partial
+    // stream is never committed.
+    QString failure;
+    if (!sent) {
+        failure = connectionError(conn);
+        abort = "client error";
+    } else if (!abort.isEmpty()) {
+        failure = abort;
+    }
+    QByteArray abortMessage = abort.toUtf8();
+    if (PQputCopyEnd(conn, abort.isEmpty() ? nullptr : abortMessage.constData()) != 1 && failure.isEmpty()) {
+        failure = connectionError(conn);
+    }
+
+    qint64 rows = 0;
+    while (PGresult *raw = PQgetResult(conn)) {
+        if (PQresultStatus(raw) == PGRES_COMMAND_OK) {
+            rows = QByteArray(PQcmdTuples(raw)).toLongLong();
+        } else if (failure.isEmpty()) {
+            failure = QString::fromUtf8(PQresultErrorMessage(raw)).trimmed();
+        }
+        PQclear(raw);
+    }
+
+    if (DbMetrics::isEnabled()) {
+        DbMetrics::recordRoundTrip(rows, sql.size() + bytes, elapsedNs(start));
+    }
+
+    if (!failure.isEmpty()) {
+        if (error) *error = failure;
+        return false;
+    }
+    return true;
+}
+
+// Runs a long statement (e.g. CREATE INDEX CONCURRENTLY) without blocking
+// in libpq, calling poll every pollIntervalMs while the server works.
+// Returning false from poll cancels the statement.
+bool PgNativeResult::execWaiting(const QSqlDatabase &db, const QString &statement, int pollIntervalMs,
+                                 const std::function<bool()> &poll, QString *error)
+{
+    PGconn *conn = connectionHandle(db);
+    if (!conn) {
+        if (error) *error = "No libpq connection";
+        return false;
+    }
+
+    TraceSpan span("sql", "PQsendQuery");
+    span.addArg("sql", statement.left(maxTracedSqlLength));
+
+    QByteArray sql = statement.toUtf8();
+    auto start = std::chrono::steady_clock::now();
+
+    if (!PQsendQuery(conn, sql.constData())) {
+        if (error) *error = connectionError(conn);
+        return false;
+    }
+
+    const auto sleepStep = std::chrono::milliseconds(std::min(pollIntervalMs, 20));
+    auto nextPoll = start + std::chrono::milliseconds(pollIntervalMs);
+    QString failure;
+    bool cancelled = false;
+    while (true) {
+        if (!PQconsumeInput(conn)) {
+            failure = connectionError(conn);
+            break;
+        }
+        if (!PQisBusy(conn)) break;
+
+        if (!cancelled && std::chrono::steady_clock::now() >= nextPoll) {
+            nextPoll += std::chrono::milliseconds(pollIntervalMs);
+            if (!poll()) {
+                cancelled = true;
+                cancelQuery(conn);
+            }
+        }
+        std::this_thread::sleep_for(sleepStep);
+    }
+
+    while (PGresult *raw = PQgetResult(conn)) {
+        ExecStatusType status = PQresultStatus(raw);
+        if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK && failure.isEmpty()) {
+            failure = QString::fromUtf8(PQresultErrorMessage(raw)).trimmed();
+        }
+        PQclear(raw);
+    }
+
+    if (DbMetrics::isEnabled()) {
+        DbMetrics::recordRoundTrip(0, sql.size(), elapsedNs(start));
+    }
+
+    if (cancelled) failure = "Cancelled";
+    if (!failure.isEmpty()) {
+        if (error) *error = failure;
+        return false;
+    }
+    return true;
+}
+
+PgCancelHandle::~PgCancelHandle()
+{
+    detach();
+}
+
+void PgCancelHandle::attach(const QSqlDatabase &db)
+{
+    PGconn *conn = PgNativeResult::connectionHandle(db);
+    PGcancel *cancel = conn ? PQgetCancel(conn) : nullptr;
+
+    QMutexLocker locker(&mutex);
+    if (handle) PQfreeCancel(handle);
+    handle = cancel;
+}
+
+void PgCancelHandle::detach()
+{
+    QMutexLocker locker(&mutex);
+    if (handle) PQfreeCancel(handle);
+    handle = nullptr;
+}
+
+void PgCancelHandle::cancel()
+{
+    QMutexLocker locker(&mutex);
+    if (handle) {
+        char message[256];
+        PQcancel(handle, message, sizeof(message));
+    }
+}
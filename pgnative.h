@@ -0,0 +1,134 @@
+#ifndef PGNATIVE_H
+#define PGNATIVE_H
+
+#include <QSqlDatabase>
+#include <QByteArrayView>
+#include <QVariant>
+#include <QMutex>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+struct pg_conn;
+struct pg_result;
+struct pg_cancel;
+
+// Reads libpq results directly: text values are views into the PGresult and
+// typed columns are decoded once into flat buffers on first access.
+// Binary results skip text formatting and parsing; there text() is only
+// meaningful for textual columns.
+class PgNativeResult
+{
+public:
+    enum Format {
+        TextFormat,
+        BinaryFormat
+    };
+
+    enum Kind {
+        Text,
+        Boolean,
+        Integer,
+        Real,
+        Numeric,
+        Date,
+        Timestamp,
+        TimestampTz
+    };
+
+    PgNativeResult();
+    ~PgNativeResult();
+    PgNativeResult(PgNativeResult &&other) noexcept;
+    PgNativeResult &operator=(PgNativeResult &&other) noexcept;
+    PgNativeResult(const PgNativeResult&) = delete;
+    PgNativeResult &operator=(const PgNativeResult&) = delete;
+
+    bool isValid() const;
+    QString errorMessage() const;
+    int rowCount() const;
+    int columnCount() const;
+    int rowsAffected() const;
+    QString columnName(int column) const;
+    Kind columnKind(int column) const;
+    bool isBinary(int column) const;
+
+    bool isNull(int row, int column) const;
+    QByteArrayView text(int row, int column) const;
+    const std::vector<qint64> &integers(int column) const;
+    const std::vector<double> &reals(int column) const;
+    QVariant value(int row, int column) const;
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool on);
+    static pg_conn *connectionHandle(const QSqlDatabase &db);
+    static bool isAvailable(const QSqlDatabase &db);
+    static bool isBinaryEnabled() { return binaryEnabled.load(std::memory_order_relaxed); }
+    static void setBinaryEnabled(bool on);
+    static bool hasBinaryDecoder(const QString &sqlType);
+    static QByteArray parameterText(const QVariant &value);
+
+    static PgNativeResult exec(const QSqlDatabase &db, const QString &queryStr,
+                               Format format = TextFormat);
+    static bool stream(const QSqlDatabase &db, const QString &queryStr, int chunkRows,
+                       const std::function<bool(const PgNativeResult &)> &consumer,
+                       QString *error = nullptr);
+    static bool copyIn(const QSqlDatabase &db, const QString &copyStatement,
+                       const QByteArray &data, QString *error = nullptr);
+    // The producer fills the next chunk and returns false once there is no
+    // more data; setting *abort before that makes the server discard the
+    // COPY instead of committing the rows sent so far.
+    static bool copyIn(const QSqlDatabase &db, const QString &copyStatement,
+                       const std::function<bool(QByteArray &chunk, QString *abort)> &producer,
+                       QString *error = nullptr);
+    static bool prepare(const QSqlDatabase &db, const QString &statementName, const QString &queryStr,
+                        QString *error = nullptr);
+    static PgNativeResult execPrepared(const QSqlDatabase &db, const QString &statementName,
+                                       const QVariantList &params);
+    static bool execWaiting(const QSqlDatabase &db, const QString &statement, int pollIntervalMs,
+                            const std::function<bool()> &poll, QString *error = nullptr);
+
+private:
+    friend class PgPipeline;
+
+    struct Column {
+        QString name;
+        unsigned int type = 0;
+        Kind kind = Text;
+        bool binary = false;
+        mutable bool decoded = false;
+        mutable std::vector<qint64> integers;
+        mutable std::vector<double> reals;
+    };
+
+    explicit PgNativeResult(pg_result *result);
+    void decode(int column) const;
+    void decodeBinary(int column) const;
+
+    pg_result *result;
+    QString error;
+    std::vector<Column> columns;
+
+    static std::atomic<bool> enabled;
+    static std::atomic<bool> binaryEnabled;
+};
+
+// Cancels whatever statement the attached connection is running; cancel()
+// may be called from any thread, also when the connection is idle.
+class PgCancelHandle
+{
+public:
+    PgCancelHandle() = default;
+    ~PgCancelHandle();
+    PgCancelHandle(const PgCancelHandle&) = delete;
+    PgCancelHandle &operator=(const PgCancelHandle&) = delete;
+
+    void attach(const QSqlDatabase &db);
+    void detach();
+    void cancel();
+
+private:
+    QMutex mutex;
+    pg_cancel *handle = nullptr;
+};
+
+#endif
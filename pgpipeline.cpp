@@ -0,0 +1,257 @@
+#include "pgpipeline.h"
+#include "pgnative.h"
+#include "dbmetrics.h"
+#include "tracer.h"
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+#include <QDateTime>
+#include <QRegularExpression>
+#include <libpq-fe.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace {
+const int maxStatementsPerSync = 500;
+
+qint64 elapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+}
+
+PgPipeline::PgPipeline(const QSqlDatabase &db)
+    : db(db)
+{
+}
+
+int PgPipeline::add(const QString &sql, const QVariantList &params)
+{
+    statements.append({sql, params});
+    return statements.size() - 1;
+}
+
+int PgPipeline::size() const
+{
+    return statements.size();
+}
+
+void PgPipeline::clear()
+{
+    statements.clear();
+    results.clear();
+    failed = -1;
+}
+
+const PgPipeline::Result &PgPipeline::result(int index) const
+{
+    return results[index];
+}
+
+QString PgPipeline::statement(int index) const
+{
+    return statements[index].sql;
+}
+
+int PgPipeline::failedIndex() const
+{
+    return failed;
+}
+
+bool PgPipeline::isAvailable(const QSqlDatabase &db)
+{
+#ifdef LIBPQ_HAS_PIPELINING
+    return PgNativeResult::isAvailable(db);
+#else
+    Q_UNUSED(db);
+    return false;
+#endif
+}
+
+bool PgPipeline::run(QString *error)
+{
+    results.clear();
+    results.resize(statements.size());
+    failed = -1;
+
+    if (statements.isEmpty()) return true;
+
+    TraceSpan span("sql", "pipeline");
+    span.addArg("statements", statements.size());
+
+    bool ok = isAvailable(db) ? runPipelined(PgNativeResult::connectionHandle(db)) : runSequential();
+    if (!ok && error) {
+        *error = failed >= 0 ? results[failed].error : QString("Pipeline failed");
+    }
+    return ok;
+}
+
+void PgPipeline::skipFrom(int index)
+{
+    for (int i = index; i < results.size(); ++i) {
+        if (results[i].ok || !results[i].error.isEmpty()) continue;
+        results[i].skipped = true;
+        results[i].error = "Skipped after an earlier error";
+    }
+}
+
+bool PgPipeline::runPipelined(pg_conn *conn)
+{
+#ifdef LIBPQ_HAS_PIPELINING
+    if (!PQenterPipelineMode(conn)) {
+        failed = 0;
+        results[0].error = QString::fromUtf8(PQerrorMessage(conn)).trimmed();
+        skipFrom(1);
+        return false;
+    }
+
+    bool ok = true;
+    for (int begin = 0; begin < statements.size() && ok; begin += maxStatementsPerSync) {
+        int end = std::min<int>(begin + maxStatementsPerSync, statements.size());
+        auto start = std::chrono::steady_clock::now();
+        qint64 sentBytes = 0;
+
+        int sent = begin;
+        for (; sent < end; ++sent) {
+            const Statement &s = statements[sent];
+            QByteArray sql = s.sql.toUtf8();
+
+            std::vector<QByteArray> storage;
+            std::vector<const char *> values;
+            storage.reserve(s.params.size());
+            for (const QVariant &param : s.params) {
+                if (param.isNull()) {
+                    values.push_back(nullptr);
+                } else {
+                    storage.push_back(PgNativeResult::parameterText(param));
+                    values.push_back(storage.back().constData());
+                    sentBytes += storage.back().size();
+                }
+            }
+
+            if (!PQsendQueryParams(conn, sql.constData(), int(values.size()), nullptr,
+                                   values.empty() ? nullptr : values.data(), nullptr, nullptr, 0)) {
+                results[sent].error = QString::fromUtf8(PQerrorMessage(conn)).trimmed();
+                if (failed < 0) failed = sent;
+                ok = false;
+                break;
+            }
+            sentBytes += sql.size();
+        }
+
+        PQpipelineSync(conn);
+
+        for (int i = begin; i < sent; ++i) {
+            PGresult *raw = PQgetResult(conn);
+            Result &r = results[i];
+
+            if (!raw) {
+                r.error = QString::fromUtf8(PQerrorMessage(conn)).trimmed();
+                if (failed < 0) failed = i;
+                ok = false;
+                continue;
+            }
+
+            if (PQresultStatus(raw) == PGRES_PIPELINE_ABORTED) {
+                PQclear(raw);
+            } else {
+                PgNativeResult native(raw);
+                if (native.isValid()) {
+                    r.ok = true;
+                    r.rowsAffected = QByteArray(PQcmdTuples(raw)).toInt();
+                    for (int row = 0; row < native.rowCount(); ++row) {
+                        QVariantList values;
+                        for (int c = 0; c < native.columnCount(); ++c) {
+                            values.append(native.value(row, c));
+                        }
+                        r.rows.append(values);
+                    }
+                } else {
+                    r.error = native.errorMessage();
+                    if (failed < 0) failed = i;
+                    ok = false;
+                }
+            }
+
+            while (PGresult *extra = PQgetResult(conn)) {
+                PQclear(extra);
+            }
+        }
+
+        while (PGresult *raw = PQgetResult(conn)) {
+            bool synced = PQresultStatus(raw) == PGRES_PIPELINE_SYNC;
+            PQclear(raw);
+            if (synced) break;
+        }
+
+        if (DbMetrics::isEnabled()) {
+            DbMetrics::recordRoundTrip(0, sentBytes, elapsedNs(start));
+        }
+    }
+
+    PQexitPipelineMode(conn);
+
+    if (!ok) skipFrom(0);
+    return ok;
+#else
+    Q_UNUSED(conn);
+    return runSequential();
+#endif
+}
+
+bool PgPipeline::runSequential()
+{
+    static const QRegularExpression placeholder("\\$(\\d+)");
+
+    for (int i = 0; i < statements.size(); ++i) {
+        const Statement &s = statements[i];
+        Result &r = results[i];
+        QSqlQuery query(db);
+        bool ok;
+
+        if (s.params.isEmpty()) {
+            ok = DbMetrics::exec(query, s.sql);
+        } else {
+            QString sql;
+            QVariantList bound;
+            int last = 0;
+            auto matches = placeholder.globalMatch(s.sql);
+            while (matches.hasNext()) {
+                auto match = matches.next();
+                sql += s.sql.mid(last, match.capturedStart() - last) + "?";
+                bound.append(s.params.value(match.captured(1).toInt() - 1));
+                last = match.capturedEnd();
+            }
+            sql += s.sql.mid(last);
+
+            query.prepare(sql);
+            for (const QVariant &value : bound) {
+                query.addBindValue(value);
+            }
+            ok = DbMetrics::exec(query);
+        }
+
+        if (!ok) {
+            r.error = query.lastError().text();
+            failed = i;
+            skipFrom(i + 1);
+            return false;
+        }
+
+        r.ok = true;
+        r.rowsAffected = query.numRowsAffected();
+        if (query.isSelect()) {
+            int columnCount = query.record().count();
+            while (query.next()) {
+                QVariantList values;
+                for (int c = 0; c < columnCount; ++c) {
+                    values.append(query.value(c));
+                }
+                r.rows.append(values);
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef PGPIPELINE_H
+#define PGPIPELINE_H
+
+#include <QSqlDatabase>
+#include <QVariantList>
+#include <QList>
+
+struct pg_conn;
+
+// Queues independent statements and sends them with libpq pipeline mode,
+// so N statements cost about one round trip. Parameters use $1, $2, ...
+// Without pipeline support the statements run one by one via QSqlQuery.
+class PgPipeline
+{
+public:
+    struct Result {
+        bool ok = false;
+        bool skipped = false;
+        QString error;
+        int rowsAffected = 0;
+        QList<QVariantList> rows;
+    };
+
+    explicit PgPipeline(const QSqlDatabase &db);
+
+    int add(const QString &sql, const QVariantList &params = QVariantList());
+    int size() const;
+    void clear();
+
+    bool run(QString *error = nullptr);
+    const Result &result(int index) const;
+    QString statement(int index) const;
+    int failedIndex() const;
+
+    static bool isAvailable(const QSqlDatabase &db);
+
+private:
+    struct Statement {
+        QString sql;
+        QVariantList params;
+    };
+
+    bool runPipelined(pg_conn *conn);
+    bool runSequential();
+    void skipFrom(int index);
+
+    QSqlDatabase db;
+    QList<Statement> statements;
+    QList<Result> results;
+    int failed = -1;
+};
+
+#endif
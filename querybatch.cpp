@@ -0,0 +1,210 @@
+#include "querybatch.h"
+#include "databasemanager.h"
+#include "dbmetrics.h"
+#include "pgnative.h"
+#include "queryhistory.h"
+#include "tracer.h"
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+#include <QElapsedTimer>
+
+namespace {
+const int maxParallelism = 32;
+const int cancelRetryMs = 200;
+
+std::atomic<int> nextBatchId(0);
+}
+
+int QueryBatch::defaultParallelism()
+{
+    int value = qEnvironmentVariableIntValue("LIBRARY_QUERY_PARALLELISM");
+    return value > 0 ? qMin(value, maxParallelism) : 4;
+}
+
+QueryBatch::QueryBatch(const QList<Query> &queries, int parallelism, QObject *parent)
+    : QObject(parent), queries(queries),
+      parallelism(qBound(1, parallelism, qMin<int>(maxParallelism, qMax<int>(1, queries.size())))),
+      remaining(queries.size()), nextIndex(0), stopped(false)
+{
+    for (int slot = 0; slot < this->parallelism; ++slot) {
+        cancellers.push_back(std::make_unique<PgCancelHandle>());
+    }
+    pool.setMaxThreadCount(this->parallelism);
+
+    cancelTimer.setInterval(cancelRetryMs);
+    connect(&cancelTimer, &QTimer::timeout, this, &QueryBatch::cancelRunning);
+}
+
+// Running statements are cancelled, so the wait only covers the time the
+// server takes to abort them.
+QueryBatch::~QueryBatch()
+{
+    stop();
+    while (!pool.waitForDone(cancelRetryMs)) {
+        cancelRunning();
+    }
+}
+
+void QueryBatch::start()
+{
+    if (queries.isEmpty()) {
+        emit finished();
+        return;
+    }
+
+    int batchId = nextBatchId.fetch_add(1);
+    for (int slot = 0; slot < parallelism; ++slot) {
+        pool.start([this, batchId, slot]() {
+            Tracer::nameCurrentThread(QString("QueryBatch %1").arg(slot));
+            runSlot(slot, QString("library_batch_%1_%2").arg(batchId).arg(slot));
+        });
+    }
+}
+
+void QueryBatch::stop()
+{
+    stopped.store(true, std::memory_order_relaxed);
+    cancelRunning();
+    if (remaining > 0) cancelTimer.start();
+}
+
+void QueryBatch::cancelRunning()
+{
+    for (const auto &canceller : cancellers) {
+        canceller->cancel();
+    }
+}
+
+void QueryBatch::runSlot(int slot, const QString &connectionName)
+{
+    PgCancelHandle &canceller = *cancellers[slot];
+    QString connectError;
+    {
+        QSqlDatabase connection = DatabaseManager::instance().openWorkerConnection(connectionName, &connectError);
+        if (connection.isOpen()) canceller.attach(connection);
+
+        for (int index = nextIndex.fetch_add(1); index < queries.size(); index = nextIndex.fetch_add(1)) {
+            Result result;
+            if (stopped.load(std::memory_order_relaxed)) {
+                result.stopped = true;
+            } else if (!connection.isOpen()) {
+                result.error = connectError;
+            } else {
+                QMetaObject::invokeMethod(this, [this, index]() { emit queryStarted(index); }, Qt::QueuedConnection);
+                result = runQuery(connection, queries[index]);
+                if (!result.ok && stopped.load(std::memory_order_relaxed)) {
+                    result.stopped = true;
+                }
+            }
+            deliver(index, result);
+        }
+        canceller.detach();
+    }
+    DatabaseManager::closeWorkerConnection(connectionName);
+}
+
+QueryBatch::Result QueryBatch::runQuery(const QSqlDatabase &connection, const Query &query)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::BatchQuery);
+    TraceSpan traceSpan("query", "batch");
+    traceSpan.addArg("sql", query.sql.left(200));
+
+    Result result;
+    qint64 bytes = 0;
+    QElapsedTimer timer;
+    timer.start();
+
+    auto addRow = [&](QVariantList row) {
+        qint64 rowBytes = DbMetrics::rowBytes(row);
+        DbMetrics::addTransfer(1, rowBytes);
+        bytes += rowBytes;
+        result.rows.append(std::move(row));
+    };
+
+    if (PgNativeResult::isAvailable(connection)) {
+        // The unnamed statement is replaced by the next prepare, so nothing
+        // accumulates on the connection between queries.
+        PgNativeResult native;
+        if (query.params.isEmpty()) {
+            native = PgNativeResult::exec(connection, query.sql);
+        } else if (PgNativeResult::prepare(connection, QString(), query.sql, &result.error)) {
+            native = PgNativeResult::execPrepared(connection, QString(), query.params);
+        }
+
+        if (!native.isValid()) {
+            if (result.error.isEmpty()) result.error = native.errorMessage();
+        } else {
+            for (int c = 0; c < native.columnCount(); ++c) {
+                result.headers.append(native.columnName(c));
+            }
+            result.rows.reserve(native.rowCount());
+            for (int r = 0; r < native.rowCount(); ++r) {
+                QVariantList row;
+                row.reserve(native.columnCount());
+                for (int c = 0; c < native.columnCount(); ++c) {
+                    row.append(native.value(r, c));
+                }
+                addRow(std::move(row));
+            }
+            result.rowsAffected = native.rowsAffected();
+            result.ok = true;
+        }
+    } else {
+        QSqlQuery sqlQuery(connection);
+        sqlQuery.setForwardOnly(true);
+        bool ok;
+        if (query.params.isEmpty()) {
+            ok = DbMetrics::exec(sqlQuery, query.sql);
+        } else {
+            ok = sqlQuery.prepare(query.sql);
+            for (int i = 0; ok && i < query.params.size(); ++i) {
+                sqlQuery.bindValue(i, query.params[i]);
+            }
+            ok = ok && DbMetrics::exec(sqlQuery);
+        }
+
+        if (!ok) {
+            result.error = sqlQuery.lastError().text();
+        } else {
+            if (sqlQuery.isSelect()) {
+                QSqlRecord record = sqlQuery.record();
+                for (int i = 0; i < record.count(); ++i) {
+                    result.headers.append(record.fieldName(i));
+                }
+                while (sqlQuery.next()) {
+                    QVariantList row;
+                    row.reserve(record.count());
+                    for (int i = 0; i < record.count(); ++i) {
+                        row.append(sqlQuery.value(i));
+                    }
+                    addRow(std::move(row));
+                }
+            } else {
+                result.rowsAffected = sqlQuery.numRowsAffected();
+            }
+            result.ok = true;
+        }
+    }
+
+    result.elapsedNs = timer.nsecsElapsed();
+    if (result.ok) {
+        const QString &historySql = query.historySql.isEmpty() ? query.sql : query.historySql;
+        qint64 rows = result.headers.isEmpty() ? result.rowsAffected : result.rows.size();
+        QueryHistory::instance().record(historySql, result.elapsedNs, rows, bytes);
+    }
+    return result;
+}
+
+// Results are handed over on the owner's thread; if the batch is deleted
+// first, the pending calls are dropped with it.
+void QueryBatch::deliver(int index, const Result &result)
+{
+    QMetaObject::invokeMethod(this, [this, index, result]() {
+        emit queryFinished(index, result);
+        if (--remaining == 0) {
+            cancelTimer.stop();
+            emit finished();
+        }
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,77 @@
+#ifndef QUERYBATCH_H
+#define QUERYBATCH_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+#include <QStringList>
+#include <QVariantList>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "pgnative.h"
+
+// Runs several saved queries at once. Each of the `parallelism` pool
+// threads opens one worker connection and takes queries from the shared
+// list until it is empty, so no more connections are opened than queries
+// run concurrently. Results are delivered on the thread that owns the
+// batch as each query finishes.
+class QueryBatch : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Query {
+        QString sql;
+        QVariantList params;
+        // Statement the run is recorded under in the query history;
+        // sql when empty.
+        QString historySql;
+    };
+
+    struct Result {
+        bool ok = false;
+        bool stopped = false;
+        QString error;
+        QStringList headers;
+        QList<QVariantList> rows;
+        int rowsAffected = 0;
+        qint64 elapsedNs = 0;
+    };
+
+    // LIBRARY_QUERY_PARALLELISM, 4 by default.
+    static int defaultParallelism();
+
+    QueryBatch(const QList<Query> &queries, int parallelism, QObject *parent = nullptr);
+    ~QueryBatch();
+
+    void start();
+    // Running queries are cancelled on the server; they and the queries not
+    // yet started are reported as stopped. A statement sent just after the
+    // stop flag was checked would miss a single cancel, so the cancel is
+    // repeated until every slot has drained.
+    void stop();
+    bool isRunning() const { return remaining > 0; }
+
+signals:
+    void queryStarted(int index);
+    void queryFinished(int index, const QueryBatch::Result &result);
+    void finished();
+
+private:
+    void cancelRunning();
+    void runSlot(int slot, const QString &connectionName);
+    Result runQuery(const QSqlDatabase &connection, const Query &query);
+    void deliver(int index, const Result &result);
+
+    QList<Query> queries;
+    int parallelism;
+    int remaining;
+    std::vector<std::unique_ptr<PgCancelHandle>> cancellers;
+    QTimer cancelTimer;
+    QThreadPool pool;
+    std::atomic<int> nextIndex;
+    std::atomic<bool> stopped;
+};
+
+#endif
@@ -0,0 +1,168 @@
+#include "querybatchdialog.h"
+#include "databasemanager.h"
+#include "replicacache.h"
+#include "dbmetrics.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+
+namespace {
+enum SummaryColumn {
+    DescriptionColumn,
+    StatusColumn,
+    TimeColumn,
+    RowsColumn,
+    SummaryColumnCount
+};
+}
+
+QueryBatchDialog::QueryBatchDialog(const QStringList &descriptions, const QList<QueryBatch::Query> &queries,
+                                   int parallelism, QWidget *parent)
+    : QDialog(parent), descriptions(descriptions),
+      parallelism(qBound(1, parallelism, qMax(1, int(queries.size())))),
+      resultTabs(descriptions.size(), nullptr)
+{
+    setupUI();
+
+    batch = new QueryBatch(queries, parallelism, this);
+    connect(batch, &QueryBatch::queryStarted, this, &QueryBatchDialog::onQueryStarted);
+    connect(batch, &QueryBatch::queryFinished, this, &QueryBatchDialog::onQueryFinished);
+    connect(batch, &QueryBatch::finished, this, &QueryBatchDialog::onFinished);
+
+    timer.start();
+    batch->start();
+    updateProgress();
+}
+
+void QueryBatchDialog::setupUI()
+{
+    setWindowTitle(QString("Выполнение запросов (%1)").arg(descriptions.size()));
+    setMinimumSize(900, 550);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QHBoxLayout *statusLayout = new QHBoxLayout();
+    statusLabel = new QLabel(this);
+    stopButton = new QPushButton("Остановить", this);
+    connect(stopButton, &QPushButton::clicked, this, &QueryBatchDialog::onStop);
+    statusLayout->addWidget(statusLabel);
+    statusLayout->addStretch();
+    statusLayout->addWidget(stopButton);
+    mainLayout->addLayout(statusLayout);
+
+    tabWidget = new QTabWidget(this);
+
+    summaryTable = new QTableWidget(descriptions.size(), SummaryColumnCount, this);
+    summaryTable->setHorizontalHeaderLabels({"Запрос", "Статус", "Время, мс", "Строк"});
+    summaryTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    summaryTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    summaryTable->horizontalHeader()->setSectionResizeMode(DescriptionColumn, QHeaderView::Stretch);
+    for (int i = 0; i < descriptions.size(); ++i) {
+        summaryTable->setItem(i, DescriptionColumn, new QTableWidgetItem(descriptions[i]));
+        summaryTable->setItem(i, StatusColumn, new QTableWidgetItem("в очереди"));
+        summaryTable->setItem(i, TimeColumn, new QTableWidgetItem());
+        summaryTable->setItem(i, RowsColumn, new QTableWidgetItem());
+    }
+    connect(summaryTable, &QTableWidget::cellDoubleClicked, this, &QueryBatchDialog::onSummaryActivated);
+    tabWidget->addTab(summaryTable, "Сводка");
+
+    mainLayout->addWidget(tabWidget);
+}
+
+void QueryBatchDialog::setStatus(int index, const QString &status)
+{
+    summaryTable->item(index, StatusColumn)->setText(status);
+}
+
+void QueryBatchDialog::updateProgress()
+{
+    QString text = QString("Выполнено %1 из %2, параллельно: %3")
+                       .arg(finishedCount).arg(descriptions.size()).arg(parallelism);
+    if (failedCount > 0) {
+        text += QString(", с ошибкой: %1").arg(failedCount);
+    }
+    if (!batch || !batch->isRunning()) {
+        text += QString(". Общее время: %1 мс").arg(timer.elapsed());
+    }
+    statusLabel->setText(text);
+}
+
+void QueryBatchDialog::onQueryStarted(int index)
+{
+    setStatus(index, "выполняется");
+}
+
+void QueryBatchDialog::onQueryFinished(int index, const QueryBatch::Result &result)
+{
+    ++finishedCount;
+
+    if (result.stopped) {
+        setStatus(index, "отменён");
+        updateProgress();
+        return;
+    }
+
+    summaryTable->item(index, TimeColumn)->setText(QString::number(result.elapsedNs / 1e6, 'f', 1));
+    if (!result.ok) {
+        ++failedCount;
+        setStatus(index, "ошибка: " + result.error);
+        summaryTable->item(index, StatusColumn)->setToolTip(result.error);
+        updateProgress();
+        return;
+    }
+
+    if (result.headers.isEmpty()) {
+        DatabaseManager::instance().replicaCache()->invalidateAll();
+        setStatus(index, "готово");
+        summaryTable->item(index, RowsColumn)->setText(QString("%1 (изменено)").arg(result.rowsAffected));
+        updateProgress();
+        return;
+    }
+
+    setStatus(index, "готово");
+    summaryTable->item(index, RowsColumn)->setText(QString::number(result.rows.size()));
+
+    QWidget *tab = createResultTab(result);
+    resultTabs[index] = tab;
+    tabWidget->addTab(tab, descriptions[index]);
+    tabWidget->setTabToolTip(tabWidget->indexOf(tab), descriptions[index]);
+    updateProgress();
+}
+
+QWidget *QueryBatchDialog::createResultTab(const QueryBatch::Result &result)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::WidgetPopulation);
+
+    QTableWidget *table = new QTableWidget(result.rows.size(), result.headers.size(), tabWidget);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setHorizontalHeaderLabels(result.headers);
+    table->setUpdatesEnabled(false);
+    for (int row = 0; row < result.rows.size(); ++row) {
+        const QVariantList &rowData = result.rows[row];
+        for (int col = 0; col < rowData.size(); ++col) {
+            table->setItem(row, col, new QTableWidgetItem(rowData[col].toString()));
+        }
+    }
+    table->setUpdatesEnabled(true);
+    table->resizeColumnsToContents();
+    return table;
+}
+
+void QueryBatchDialog::onFinished()
+{
+    stopButton->hide();
+    updateProgress();
+}
+
+void QueryBatchDialog::onStop()
+{
+    batch->stop();
+    stopButton->setEnabled(false);
+}
+
+void QueryBatchDialog::onSummaryActivated(int row)
+{
+    if (resultTabs.value(row)) {
+        tabWidget->setCurrentWidget(resultTabs[row]);
+    }
+}
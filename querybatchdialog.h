@@ -0,0 +1,49 @@
+#ifndef QUERYBATCHDIALOG_H
+#define QUERYBATCHDIALOG_H
+
+#include <QDialog>
+#include <QTabWidget>
+#include <QTableWidget>
+#include <QPushButton>
+#include <QLabel>
+#include <QElapsedTimer>
+#include "querybatch.h"
+
+// Runs a batch of saved queries and shows a summary of per-query wall
+// time, rows and status; each result opens as its own tab when it arrives.
+class QueryBatchDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    QueryBatchDialog(const QStringList &descriptions, const QList<QueryBatch::Query> &queries,
+                     int parallelism, QWidget *parent = nullptr);
+
+private slots:
+    void onQueryStarted(int index);
+    void onQueryFinished(int index, const QueryBatch::Result &result);
+    void onFinished();
+    void onStop();
+    void onSummaryActivated(int row);
+
+private:
+    void setupUI();
+    void setStatus(int index, const QString &status);
+    QWidget *createResultTab(const QueryBatch::Result &result);
+    void updateProgress();
+
+    QStringList descriptions;
+    QueryBatch *batch = nullptr;
+    int parallelism;
+    int finishedCount = 0;
+    int failedCount = 0;
+    QElapsedTimer timer;
+    QList<QWidget *> resultTabs;
+
+    QTabWidget *tabWidget;
+    QTableWidget *summaryTable;
+    QLabel *statusLabel;
+    QPushButton *stopButton;
+};
+
+#endif
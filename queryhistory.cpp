@@ -0,0 +1,309 @@
+#include "queryhistory.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+const int maxRunsPerQuery = 200;
+const int maxQueries = 1000;
+const qint64 maxFileLines = 50000;
+const int minBaselineRuns = 5;
+const int baselineWindow = 20;
+const double minRegressionMs = 5.0;
+
+bool isWordChar(QChar c)
+{
+    return c.isLetterOrNumber() || c == '_' || c == '$' || c == '?' || c == '"';
+}
+
+QByteArray executionLine(const QString &fingerprint, const QueryHistory::Execution &execution)
+{
+    QJsonObject obj;
+    obj["fp"] = fingerprint;
+    obj["ts"] = execution.timestamp.toString(Qt::ISODateWithMs);
+    obj["us"] = execution.durationUs;
+    obj["rows"] = execution.rows;
+    obj["bytes"] = execution.bytes;
+    return QJsonDocument(obj).toJson(QJsonDocument::Compact) + '\n';
+}
+
+double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+}
+
+QueryHistory &QueryHistory::instance()
+{
+    static QueryHistory history;
+    return history;
+}
+
+// LIBRARY_QUERY_HISTORY overrides the file; set it empty to keep the
+// history in memory only.
+QueryHistory::QueryHistory()
+    : factor(qEnvironmentVariableIsSet("LIBRARY_REGRESSION_FACTOR")
+                 ? qEnvironmentVariable("LIBRARY_REGRESSION_FACTOR").toDouble() : 2.0)
+{
+    if (factor <= 1.0) factor = 2.0;
+
+    QString defaultPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/query_history.jsonl";
+    QString filePath = qEnvironmentVariable("LIBRARY_QUERY_HISTORY", defaultPath);
+    if (!filePath.isEmpty()) {
+        open(filePath);
+    }
+}
+
+// Literals become '?', comments are dropped, case is folded outside quoted
+// identifiers, whitespace is kept only where it separates words, and IN
+// lists of any length collapse to (?).
+QString QueryHistory::normalize(const QString &sql)
+{
+    static const QRegularExpression valueList("\\(\\?(?:,\\?)+\\)");
+
+    QString out;
+    out.reserve(sql.size());
+    bool pendingSpace = false;
+
+    auto put = [&](QChar c) {
+        if (pendingSpace && !out.isEmpty() && isWordChar(out.back()) && isWordChar(c)) {
+            out += ' ';
+        }
+        pendingSpace = false;
+        out += c;
+    };
+
+    const int n = sql.size();
+    int i = 0;
+    while (i < n) {
+        QChar c = sql[i];
+
+        if (c.isSpace()) {
+            pendingSpace = true;
+            ++i;
+        } else if (c == '-' && i + 1 < n && sql[i + 1] == '-') {
+            while (i < n && sql[i] != '\n') ++i;
+            pendingSpace = true;
+        } else if (c == '/' && i + 1 < n && sql[i + 1] == '*') {
+            int end = sql.indexOf("*/", i + 2);
+            i = end < 0 ? n : end + 2;
+            pendingSpace = true;
+        } else if (c == '\'') {
+            for (++i; i < n; ++i) {
+                if (sql[i] != '\'') continue;
+                if (i + 1 < n && sql[i + 1] == '\'') {
+                    ++i;
+                    continue;
+                }
+                ++i;
+                break;
+            }
+            put('?');
+        } else if (c == '"') {
+            int end = sql.indexOf('"', i + 1);
+            end = end < 0 ? n : end + 1;
+            put(c);
+            out += sql.mid(i + 1, end - i - 1);
+            i = end;
+        } else if (c.isDigit() && (pendingSpace || out.isEmpty() || !isWordChar(out.back()))) {
+            while (i < n && (sql[i].isLetterOrNumber() || sql[i] == '.')) {
+                bool exponent = (sql[i] == 'e' || sql[i] == 'E') && i + 1 < n
+                                && (sql[i + 1] == '+' || sql[i + 1] == '-');
+                i += exponent ? 2 : 1;
+            }
+            put('?');
+        } else {
+            put(c.toLower());
+            ++i;
+        }
+    }
+
+    while (out.endsWith(';')) out.chop(1);
+    out.replace(valueList, "(?)");
+    return out;
+}
+
+QString QueryHistory::fingerprint(const QString &sql)
+{
+    QByteArray hash = QCryptographicHash::hash(normalize(sql).toUtf8(), QCryptographicHash::Sha1);
+    return QString::fromLatin1(hash.toHex().left(16));
+}
+
+bool QueryHistory::open(const QString &filePath, QString *error)
+{
+    QMutexLocker locker(&mutex);
+    path = filePath;
+    history.clear();
+    fileLines = 0;
+
+    QFile file(path);
+    if (file.exists()) {
+        if (!file.open(QIODevice::ReadOnly)) {
+            if (error) *error = "Cannot open query history: " + file.errorString();
+            path.clear();
+            return false;
+        }
+        while (!file.atEnd()) {
+            QJsonObject obj = QJsonDocument::fromJson(file.readLine()).object();
+            QString fp = obj["fp"].toString();
+            if (fp.isEmpty()) continue;
+
+            Execution execution;
+            execution.timestamp = QDateTime::fromString(obj["ts"].toString(), Qt::ISODateWithMs);
+            execution.durationUs = obj["us"].toInteger();
+            execution.rows = obj["rows"].toInteger();
+            execution.bytes = obj["bytes"].toInteger();
+            history[fp].append(execution);
+        }
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    trim();
+    return rewrite(error);
+}
+
+QString QueryHistory::filePath() const
+{
+    QMutexLocker locker(&mutex);
+    return path;
+}
+
+// Keeps the last maxRunsPerQuery runs of the maxQueries most recently
+// executed queries.
+void QueryHistory::trim()
+{
+    for (auto it = history.begin(); it != history.end(); ++it) {
+        if (it->size() > maxRunsPerQuery) {
+            it->erase(it->begin(), it->end() - maxRunsPerQuery);
+        }
+    }
+
+    if (history.size() <= maxQueries) return;
+
+    QList<QPair<QDateTime, QString>> lastRun;
+    for (auto it = history.cbegin(); it != history.cend(); ++it) {
+        lastRun.append({it->last().timestamp, it.key()});
+    }
+    std::sort(lastRun.begin(), lastRun.end());
+    for (int i = 0; i < lastRun.size() - maxQueries; ++i) {
+        history.remove(lastRun[i].second);
+    }
+}
+
+bool QueryHistory::rewrite(QString *error)
+{
+    if (path.isEmpty()) return true;
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (error) *error = "Cannot write query history: " + file.errorString();
+        return false;
+    }
+
+    qint64 lines = 0;
+    for (auto it = history.cbegin(); it != history.cend(); ++it) {
+        for (const Execution &execution : *it) {
+            file.write(executionLine(it.key(), execution));
+            ++lines;
+        }
+    }
+    if (!file.commit()) {
+        if (error) *error = "Cannot write query history: " + file.errorString();
+        return false;
+    }
+    fileLines = lines;
+    return true;
+}
+
+void QueryHistory::record(const QString &sql, qint64 durationNs, qint64 rows, qint64 bytes)
+{
+    Execution execution;
+    execution.timestamp = QDateTime::currentDateTimeUtc();
+    execution.durationUs = durationNs / 1000;
+    execution.rows = rows;
+    execution.bytes = bytes;
+    QString fp = fingerprint(sql);
+
+    {
+        QMutexLocker locker(&mutex);
+        QList<Execution> &runs = history[fp];
+        runs.append(execution);
+        if (runs.size() > maxRunsPerQuery) runs.removeFirst();
+
+        if (!path.isEmpty()) {
+            QFile file(path);
+            if (file.open(QIODevice::Append)) {
+                file.write(executionLine(fp, execution));
+                ++fileLines;
+            }
+            if (fileLines > maxFileLines) {
+                trim();
+                rewrite(nullptr);
+            }
+        }
+    }
+
+    emit recorded(fp);
+}
+
+QueryHistory::Stats QueryHistory::stats(const QString &fingerprint) const
+{
+    QMutexLocker locker(&mutex);
+    Stats stats;
+    auto it = history.constFind(fingerprint);
+    if (it == history.cend() || it->isEmpty()) return stats;
+
+    std::vector<double> ms;
+    ms.reserve(it->size());
+    double total = 0;
+    for (const Execution &execution : *it) {
+        ms.push_back(execution.durationUs / 1000.0);
+        total += ms.back();
+    }
+
+    stats.count = int(ms.size());
+    stats.meanMs = total / stats.count;
+    stats.lastMs = ms.back();
+
+    std::vector<double> sorted = ms;
+    std::sort(sorted.begin(), sorted.end());
+    stats.p95Ms = sorted[size_t(std::ceil(0.95 * sorted.size())) - 1];
+
+    if (stats.count > minBaselineRuns) {
+        auto last = ms.end() - 1;
+        auto first = last - std::min<qsizetype>(baselineWindow, last - ms.begin());
+        stats.baselineMs = median(std::vector<double>(first, last));
+        stats.regressed = stats.lastMs > factor * stats.baselineMs
+                          && stats.lastMs - stats.baselineMs >= minRegressionMs;
+    }
+    return stats;
+}
+
+QList<QueryHistory::Execution> QueryHistory::executions(const QString &fingerprint) const
+{
+    QMutexLocker locker(&mutex);
+    return history.value(fingerprint);
+}
+
+double QueryHistory::regressionFactor() const
+{
+    QMutexLocker locker(&mutex);
+    return factor;
+}
+
+void QueryHistory::setRegressionFactor(double regressionFactor)
+{
+    QMutexLocker locker(&mutex);
+    factor = regressionFactor;
+}
@@ -0,0 +1,67 @@
+#ifndef QUERYHISTORY_H
+#define QUERYHISTORY_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+// Execution history keyed by a fingerprint of the normalized SQL (literals
+// replaced by '?', whitespace and case folded), so the same query with
+// different constants shares its statistics. Kept in a JSON lines file
+// that is compacted to the last executions of each query.
+class QueryHistory : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Execution {
+        QDateTime timestamp;
+        qint64 durationUs = 0;
+        qint64 rows = 0;
+        qint64 bytes = 0;
+    };
+
+    // baselineMs is the median of the runs before the last one; a query
+    // has regressed when the last run is regressionFactor() times slower.
+    struct Stats {
+        int count = 0;
+        double meanMs = 0;
+        double p95Ms = 0;
+        double lastMs = 0;
+        double baselineMs = 0;
+        bool regressed = false;
+    };
+
+    static QueryHistory &instance();
+    static QString normalize(const QString &sql);
+    static QString fingerprint(const QString &sql);
+
+    bool open(const QString &filePath, QString *error = nullptr);
+    QString filePath() const;
+
+    void record(const QString &sql, qint64 durationNs, qint64 rows, qint64 bytes);
+    Stats stats(const QString &fingerprint) const;
+    QList<Execution> executions(const QString &fingerprint) const;
+
+    double regressionFactor() const;
+    void setRegressionFactor(double factor);
+
+signals:
+    void recorded(const QString &fingerprint);
+
+private:
+    QueryHistory();
+    bool rewrite(QString *error);
+    void trim();
+
+    mutable QMutex mutex;
+    QHash<QString, QList<Execution>> history;
+    QString path;
+    qint64 fileLines = 0;
+    double factor;
+};
+
+#endif
@@ -1,16 +1,28 @@
 #include "querymanagementwindow.h"
 #include "createquerydialog.h"
 #include "queryresultdialog.h"
+#include "queryworker.h"
+#include "queryprofiledialog.h"
+#include "indexadvisordialog.h"
+#include "reportviewdialog.h"
+#include "reportviews.h"
+#include "queryparametersdialog.h"
+#include "querybatchdialog.h"
+#include "sqlparameters.h"
 #include "databasemanager.h"
+#include "dbmetrics.h"
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <qsqlrecord.h>
 
 QueryWidget::QueryWidget(const QueryInfo &query, QWidget *parent)
-    : QWidget(parent), query(query), originalDescription(query.description)
+    : QWidget(parent), query(query), originalDescription(query.description),
+      fingerprint(QueryHistory::fingerprint(query.sqlScript))
 {
     QHBoxLayout *layout = new QHBoxLayout(this);
     layout->setContentsMargins(5, 5, 5, 5);
@@ -30,8 +42,60 @@ QueryWidget::QueryWidget(const QueryInfo &query, QWidget *parent)
         emit executeRequested(query.sqlScript);
     });
 
+    profileButton = new QPushButton("Профиль", this);
+    connect(profileButton, &QPushButton::clicked, this, [this]() {
+        emit profileRequested(this->query.description, this->query.sqlScript);
+    });
+
+    reportViewButton = new QPushButton("Витрина", this);
+    connect(reportViewButton, &QPushButton::clicked, this, [this]() {
+        emit reportViewRequested(this->query.description, this->query.sqlScript);
+    });
+
+    statsLabel = new QLabel(this);
+    statsLabel->setMinimumWidth(260);
+
     layout->addWidget(descriptionEdit, 1);
+    layout->addWidget(statsLabel);
     layout->addWidget(executeButton);
+    layout->addWidget(profileButton);
+    layout->addWidget(reportViewButton);
+
+    setStats(QueryHistory::instance().stats(fingerprint));
+    setMaterialized(ReportViews::instance().isMaterialized(query.sqlScript));
+}
+
+void QueryWidget::setMaterialized(bool materialized)
+{
+    reportViewButton->setStyleSheet(materialized ? "QPushButton { font-weight: bold; }" : QString());
+    reportViewButton->setToolTip(materialized ? "Запрос выполняется из материализованного представления"
+                                              : "Запрос выполняется по исходным таблицам");
+}
+
+void QueryWidget::setStats(const QueryHistory::Stats &stats)
+{
+    if (stats.count == 0) {
+        statsLabel->setText("Не выполнялся");
+        statsLabel->setStyleSheet("QLabel { color: gray; }");
+        statsLabel->setToolTip(QString());
+        return;
+    }
+
+    statsLabel->setText(QString("%1 зап. · сред. %2 мс · p95 %3 мс · посл. %4 мс")
+                            .arg(stats.count)
+                            .arg(stats.meanMs, 0, 'f', 1)
+                            .arg(stats.p95Ms, 0, 'f', 1)
+                            .arg(stats.lastMs, 0, 'f', 1));
+
+    if (stats.regressed) {
+        statsLabel->setStyleSheet("QLabel { color: #c00000; font-weight: bold; }");
+        statsLabel->setToolTip(QString("Регрессия: последний запуск в %1 раза медленнее обычного (%2 мс)")
+                                   .arg(stats.lastMs / stats.baselineMs, 0, 'f', 1)
+                                   .arg(stats.baselineMs, 0, 'f', 1));
+    } else {
+        statsLabel->setStyleSheet(QString());
+        statsLabel->setToolTip(QString());
+    }
 }
 
 QString QueryWidget::getDescription() const
@@ -76,6 +140,10 @@ QueryManagementWindow::QueryManagementWindow(QWidget *parent)
     setupUI();
     loadDefaultQueries();
     refreshQueriesList();
+
+    connect(&QueryHistory::instance(), &QueryHistory::recorded, this, &QueryManagementWindow::onQueryRecorded);
+    connect(&ReportViews::instance(), &ReportViews::changed, this, &QueryManagementWindow::onReportViewChanged);
+    connect(&ReportViews::instance(), &ReportViews::materializeFailed, this, &QueryManagementWindow::onReportViewFailed);
 }
 
 QueryManagementWindow::~QueryManagementWindow()
@@ -98,17 +166,29 @@ void QueryManagementWindow::setupUI()
     deleteQueryButton = new QPushButton("Удалить запрос", this);
     importQueriesButton = new QPushButton("Импорт запроса", this);
     saveQueriesButton = new QPushButton("Сохранить запрос", this);
+    adviseIndexesButton = new QPushButton("Советник индексов", this);
+    runSelectedButton = new QPushButton("Выполнить выбранные", this);
+    parallelismSpin = new QSpinBox(this);
+    parallelismSpin->setRange(1, 32);
+    parallelismSpin->setValue(QueryBatch::defaultParallelism());
+    parallelismSpin->setPrefix("параллельно: ");
+    parallelismSpin->setToolTip("Число одновременно выполняемых запросов и открытых для них соединений");
 
     connect(createQueryButton, &QPushButton::clicked, this, &QueryManagementWindow::onCreateQuery);
     connect(deleteQueryButton, &QPushButton::clicked, this, &QueryManagementWindow::onDeleteQuery);
     connect(importQueriesButton, &QPushButton::clicked, this, &QueryManagementWindow::onImportQueries);
     connect(saveQueriesButton, &QPushButton::clicked, this, &QueryManagementWindow::onSaveQueries);
+    connect(adviseIndexesButton, &QPushButton::clicked, this, &QueryManagementWindow::onAdviseIndexes);
+    connect(runSelectedButton, &QPushButton::clicked, this, &QueryManagementWindow::onRunSelected);
 
     buttonsLayout->addWidget(createQueryButton);
     buttonsLayout->addWidget(deleteQueryButton);
     buttonsLayout->addWidget(importQueriesButton);
     buttonsLayout->addWidget(saveQueriesButton);
+    buttonsLayout->addWidget(adviseIndexesButton);
     buttonsLayout->addStretch();
+    buttonsLayout->addWidget(runSelectedButton);
+    buttonsLayout->addWidget(parallelismSpin);
 
     mainLayout->addLayout(buttonsLayout);
 
@@ -196,6 +276,8 @@ void QueryManagementWindow::refreshQueriesList()
     for (const auto &query : queries) {
         QueryWidget *queryWidget = new QueryWidget(query, this);
         connect(queryWidget, &QueryWidget::executeRequested, this, &QueryManagementWindow::onExecuteQuery);
+        connect(queryWidget, &QueryWidget::profileRequested, this, &QueryManagementWindow::onProfileQuery);
+        connect(queryWidget, &QueryWidget::reportViewRequested, this, &QueryManagementWindow::onReportView);
         connect(queryWidget, &QueryWidget::descriptionChanged, this, &QueryManagementWindow::onQueryDescriptionChanged);
         queriesLayout->addWidget(queryWidget);
         queryWidgets.append(queryWidget);
@@ -276,17 +358,38 @@ void QueryManagementWindow::onImportQueries()
 
     queries.clear();
     QJsonArray array = doc.array();
+    QStringList failed;
 
     for (const auto &value : array) {
         QJsonObject obj = value.toObject();
         QueryInfo info;
         info.description = obj["description"].toString();
         info.sqlScript = obj["sql"].toString();
+        info.profiles = obj["profiles"].toArray();
+        info.parameterValues = obj["parameters"].toObject().toVariantMap();
         queries.append(info);
+
+        // Existing views of the same query are reused, not rebuilt. Views are
+        // built in the background; failures are reported as they finish.
+        if (obj.contains("materialized")) {
+            QJsonObject materialized = obj["materialized"].toObject();
+            ReportViews::Schedule schedule;
+            schedule.intervalSec = materialized["refreshIntervalSec"].toInt();
+            schedule.changeThreshold = materialized["refreshAfterChanges"].toInteger();
+            QString error;
+            if (!ReportViews::instance().materialize(info.sqlScript, schedule, &error)) {
+                failed.append(info.description + ": " + error);
+            }
+        }
     }
 
     refreshQueriesList();
-    QMessageBox::information(this, "Успех", "Запросы успешно импортированы");
+    if (failed.isEmpty()) {
+        QMessageBox::information(this, "Успех", "Запросы успешно импортированы");
+    } else {
+        QMessageBox::warning(this, "Предупреждение",
+                             "Запросы импортированы, но не удалось создать витрины:\n" + failed.join("\n"));
+    }
 }
 
 void QueryManagementWindow::onSaveQueries()
@@ -300,6 +403,19 @@ void QueryManagementWindow::onSaveQueries()
         QJsonObject obj;
         obj["description"] = query.description;
         obj["sql"] = query.sqlScript;
+        if (!query.profiles.isEmpty()) {
+            obj["profiles"] = query.profiles;
+        }
+        if (!query.parameterValues.isEmpty()) {
+            obj["parameters"] = QJsonObject::fromVariantMap(query.parameterValues);
+        }
+        if (ReportViews::instance().isMaterialized(query.sqlScript)) {
+            ReportViews::Schedule schedule = ReportViews::instance().state(query.sqlScript).schedule;
+            QJsonObject materialized;
+            materialized["refreshIntervalSec"] = schedule.intervalSec;
+            materialized["refreshAfterChanges"] = schedule.changeThreshold;
+            obj["materialized"] = materialized;
+        }
         array.append(obj);
     }
 
@@ -314,45 +430,217 @@ void QueryManagementWindow::onSaveQueries()
     }
 }
 
-void QueryManagementWindow::onExecuteQuery(const QString &sql)
+void QueryManagementWindow::onExecuteQuery(const QString &savedSql)
 {
+    SqlParameters parameters = SqlParameters::parse(savedSql);
+    if (!parameters.isEmpty()) {
+        executeParameterized(savedSql, parameters);
+        return;
+    }
+
+    // Materialized reports are read from their view.
+    QString sql = ReportViews::instance().readQuery(savedSql);
+    if (sql.isEmpty()) sql = savedSql;
+
+    bool isSelect = sql.trimmed().toUpper().startsWith("SELECT") ||
+                    sql.trimmed().toUpper().startsWith("WITH");
+
+    DatabaseManager &dm = DatabaseManager::instance();
+    if (isSelect && dm.isConnected()) {
+        QueryResultDialog *resultDialog = new QueryResultDialog(new QueryWorker(sql, savedSql), this);
+        resultDialog->setAttribute(Qt::WA_DeleteOnClose);
+        return;
+    }
+
     QString error;
     bool ok;
-    QSqlQuery query = DatabaseManager::instance().executeQuery(sql, &ok, &error);
+    QElapsedTimer timer;
+    timer.start();
+    QSqlQuery query = dm.executeQuery(sql, &ok, &error);
 
     if (!ok) {
         QMessageBox::critical(this, "Ошибка выполнения запроса", error);
         return;
     }
 
-    if (sql.trimmed().toUpper().startsWith("SELECT") ||
-        sql.trimmed().toUpper().startsWith("WITH")) {
+    if (isSelect) {
         QList<QVariantList> data;
         QStringList headers;
+        qint64 bytes = 0;
 
-        QSqlRecord record = query.record();
-        for (int i = 0; i < record.count(); ++i) {
-            headers.append(record.fieldName(i));
-        }
+        {
+            DbMetrics::Scope metricsScope(DbMetrics::ResultConversion);
 
-        while (query.next()) {
-            QVariantList row;
+            QSqlRecord record = query.record();
             for (int i = 0; i < record.count(); ++i) {
-                row.append(query.value(i));
+                headers.append(record.fieldName(i));
+            }
+
+            while (query.next()) {
+                QVariantList row;
+                for (int i = 0; i < record.count(); ++i) {
+                    row.append(query.value(i));
+                }
+                qint64 rowBytes = DbMetrics::rowBytes(row);
+                DbMetrics::addTransfer(1, rowBytes);
+                bytes += rowBytes;
+                data.append(row);
             }
-            data.append(row);
         }
 
+        QueryHistory::instance().record(savedSql, timer.nsecsElapsed(), data.size(), bytes);
+
         QueryResultDialog *resultDialog = new QueryResultDialog(data, headers, this);
         resultDialog->setAttribute(Qt::WA_DeleteOnClose);
         resultDialog->show();
     } else {
         int rowsAffected = query.numRowsAffected();
+        QueryHistory::instance().record(savedSql, timer.nsecsElapsed(), rowsAffected, 0);
         QMessageBox::information(this, "Результат",
                                  QString("Запрос выполнен успешно. Затронуто строк: %1").arg(rowsAffected));
     }
 }
 
+// Values are sent separately from the statement text, which is prepared
+// once per connection and reused for every set of values.
+void QueryManagementWindow::executeParameterized(const QString &savedSql, const SqlParameters &parameters)
+{
+    int index = 0;
+    while (index < queries.size() && queries[index].sqlScript != savedSql) ++index;
+    if (index == queries.size()) return;
+
+    QueryParametersDialog dialog(queries[index].description, parameters, queries[index].parameterValues, this);
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    QVariantMap values = dialog.getValues();
+    queries[index].parameterValues = values;
+
+    QString error;
+    DatabaseManager::QueryResult result;
+    QElapsedTimer timer;
+    timer.start();
+    if (!DatabaseManager::instance().executePrepared(parameters.positionalSql(), parameters.bind(values),
+                                                     result, &error)) {
+        QMessageBox::critical(this, "Ошибка выполнения запроса", error);
+        return;
+    }
+
+    if (result.headers.isEmpty()) {
+        QueryHistory::instance().record(savedSql, timer.nsecsElapsed(), result.rowsAffected, 0);
+        QMessageBox::information(this, "Результат",
+                                 QString("Запрос выполнен успешно. Затронуто строк: %1").arg(result.rowsAffected));
+        return;
+    }
+
+    qint64 bytes = 0;
+    for (const QVariantList &row : result.rows) {
+        bytes += DbMetrics::rowBytes(row);
+    }
+    QueryHistory::instance().record(savedSql, timer.nsecsElapsed(), result.rows.size(), bytes);
+
+    QueryResultDialog *resultDialog = new QueryResultDialog(result.rows, result.headers, this);
+    resultDialog->setAttribute(Qt::WA_DeleteOnClose);
+    resultDialog->show();
+}
+
+// Parameterized queries ask for their values up front, so the batch runs
+// without further prompts.
+void QueryManagementWindow::onRunSelected()
+{
+    QList<QueryWidget*> selectedQueries = getSelectedQueries();
+
+    if (selectedQueries.isEmpty()) {
+        QMessageBox::warning(this, "Предупреждение", "Выберите запросы для выполнения (используйте чекбоксы)");
+        return;
+    }
+
+    QStringList descriptions;
+    QList<QueryBatch::Query> batchQueries;
+    for (auto widget : selectedQueries) {
+        QString savedSql = widget->getSqlScript();
+        int index = 0;
+        while (index < queries.size() && queries[index].sqlScript != savedSql) ++index;
+        if (index == queries.size()) continue;
+
+        QueryBatch::Query batchQuery;
+        SqlParameters parameters = SqlParameters::parse(savedSql);
+        if (!parameters.isEmpty()) {
+            QueryParametersDialog dialog(queries[index].description, parameters,
+                                         queries[index].parameterValues, this);
+            if (dialog.exec() != QDialog::Accepted) return;
+            queries[index].parameterValues = dialog.getValues();
+            batchQuery.sql = parameters.positionalSql();
+            batchQuery.params = parameters.bind(queries[index].parameterValues);
+            batchQuery.historySql = savedSql;
+        } else {
+            // Materialized reports are read from their view.
+            batchQuery.sql = ReportViews::instance().readQuery(savedSql);
+            if (batchQuery.sql.isEmpty()) batchQuery.sql = savedSql;
+            batchQuery.historySql = savedSql;
+        }
+
+        descriptions.append(queries[index].description);
+        batchQueries.append(batchQuery);
+    }
+
+    QueryBatchDialog *batchDialog = new QueryBatchDialog(descriptions, batchQueries,
+                                                         parallelismSpin->value(), this);
+    batchDialog->setAttribute(Qt::WA_DeleteOnClose);
+    batchDialog->show();
+}
+
+void QueryManagementWindow::onAdviseIndexes()
+{
+    QList<IndexAdvisor::Query> advisorQueries;
+    for (const auto &query : queries) {
+        advisorQueries.append({query.description, query.sqlScript});
+    }
+
+    IndexAdvisorDialog *advisorDialog = new IndexAdvisorDialog(advisorQueries, this);
+    advisorDialog->setAttribute(Qt::WA_DeleteOnClose);
+    advisorDialog->show();
+}
+
+void QueryManagementWindow::onProfileQuery(const QString &description, const QString &sql)
+{
+    QString error;
+    QJsonObject result = DatabaseManager::instance().explainAnalyze(sql, &error);
+
+    if (result.isEmpty()) {
+        QMessageBox::critical(this, "Ошибка профилирования запроса", error);
+        return;
+    }
+
+    QJsonObject profile;
+    profile["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    profile["planningTime"] = result["Planning Time"];
+    profile["executionTime"] = result["Execution Time"];
+    profile["plan"] = result["Plan"];
+
+    QJsonArray profiles;
+    for (int i = 0; i < queries.size(); ++i) {
+        if (queries[i].description == description) {
+            queries[i].profiles.append(profile);
+            profiles = queries[i].profiles;
+            break;
+        }
+    }
+    if (profiles.isEmpty()) {
+        profiles.append(profile);
+    }
+
+    QueryProfileDialog *profileDialog = new QueryProfileDialog(description, profiles, this);
+    profileDialog->setAttribute(Qt::WA_DeleteOnClose);
+    profileDialog->show();
+}
+
+void QueryManagementWindow::onReportView(const QString &description, const QString &sql)
+{
+    ReportViewDialog *reportViewDialog = new ReportViewDialog(description, sql, this);
+    reportViewDialog->setAttribute(Qt::WA_DeleteOnClose);
+    reportViewDialog->show();
+}
+
 void QueryManagementWindow::onQueryDescriptionChanged(const QString &oldDesc, const QString &newDesc)
 {
     for (int i = 0; i < queries.size(); ++i) {
@@ -362,3 +650,34 @@ void QueryManagementWindow::onQueryDescriptionChanged(const QString &oldDesc, co
         }
     }
 }
+
+void QueryManagementWindow::onQueryRecorded(const QString &fingerprint)
+{
+    QueryHistory::Stats stats = QueryHistory::instance().stats(fingerprint);
+    for (auto widget : queryWidgets) {
+        if (widget->getFingerprint() == fingerprint) {
+            widget->setStats(stats);
+        }
+    }
+}
+
+void QueryManagementWindow::onReportViewChanged(const QString &key)
+{
+    for (auto widget : queryWidgets) {
+        if (ReportViews::queryKey(widget->getSqlScript()) == key) {
+            widget->setMaterialized(ReportViews::instance().isMaterialized(widget->getSqlScript()));
+        }
+    }
+}
+
+void QueryManagementWindow::onReportViewFailed(const QString &key, const QString &error)
+{
+    QString description = key;
+    for (const auto &query : queries) {
+        if (ReportViews::queryKey(query.sqlScript) == key) {
+            description = query.description;
+            break;
+        }
+    }
+    QMessageBox::warning(this, "Ошибка", "Не удалось создать витрину:\n" + description + ": " + error);
+}
@@ -8,10 +8,19 @@
 #include <QLineEdit>
 #include <QCheckBox>
 #include <QVector>
+#include <QJsonArray>
+#include <QLabel>
+#include <QSpinBox>
+#include <QVariantMap>
+#include "queryhistory.h"
+
+class SqlParameters;
 
 struct QueryInfo {
     QString description;
     QString sqlScript;
+    QJsonArray profiles;
+    QVariantMap parameterValues;
 };
 
 class QueryWidget : public QWidget
@@ -25,9 +34,14 @@ public:
     void setDescription(const QString &desc);
     bool isSelected() const;
     void setSelected(bool selected);
+    QString getFingerprint() const { return fingerprint; }
+    void setStats(const QueryHistory::Stats &stats);
+    void setMaterialized(bool materialized);
 
 signals:
     void executeRequested(const QString &sql);
+    void profileRequested(const QString &description, const QString &sql);
+    void reportViewRequested(const QString &description, const QString &sql);
     void descriptionChanged(const QString &oldDesc, const QString &newDesc);
 
 private slots:
@@ -36,9 +50,13 @@ private slots:
 private:
     QueryInfo query;
     QString originalDescription;
+    QString fingerprint;
     QCheckBox *selectCheckBox;
     QLineEdit *descriptionEdit;
+    QLabel *statsLabel;
     QPushButton *executeButton;
+    QPushButton *profileButton;
+    QPushButton *reportViewButton;
 };
 
 class QueryManagementWindow : public QMainWindow
@@ -54,19 +72,30 @@ private slots:
     void onDeleteQuery();
     void onImportQueries();
     void onSaveQueries();
-    void onExecuteQuery(const QString &sql);
+    void onAdviseIndexes();
+    void onExecuteQuery(const QString &savedSql);
+    void onRunSelected();
+    void onProfileQuery(const QString &description, const QString &sql);
+    void onReportView(const QString &description, const QString &sql);
     void onQueryDescriptionChanged(const QString &oldDesc, const QString &newDesc);
+    void onQueryRecorded(const QString &fingerprint);
+    void onReportViewChanged(const QString &key);
+    void onReportViewFailed(const QString &key, const QString &error);
 
 private:
     void setupUI();
     void loadDefaultQueries();
     void refreshQueriesList();
     QList<QueryWidget*> getSelectedQueries();
+    void executeParameterized(const QString &savedSql, const SqlParameters &parameters);
 
     QPushButton *createQueryButton;
     QPushButton *deleteQueryButton;
     QPushButton *importQueriesButton;
     QPushButton *saveQueriesButton;
+    QPushButton *adviseIndexesButton;
+    QPushButton *runSelectedButton;
+    QSpinBox *parallelismSpin;
 
     QScrollArea *scrollArea;
     QWidget *queriesContainer;
@@ -0,0 +1,118 @@
+#include "queryparametersdialog.h"
+#include <QFormLayout>
+#include <QVBoxLayout>
+#include <QDialogButtonBox>
+#include <QPushButton>
+#include <QLabel>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QDateEdit>
+#include <QDateTimeEdit>
+#include <QDoubleValidator>
+#include <QRegularExpressionValidator>
+
+namespace {
+const QStringList integerTypes = {"smallint", "integer", "int", "bigint", "int2", "int4", "int8"};
+const QStringList decimalTypes = {"numeric", "decimal", "real", "double", "float4", "float8"};
+
+bool isTimestamp(const QString &type)
+{
+    return type.startsWith("timestamp");
+}
+}
+
+QueryParametersDialog::QueryParametersDialog(const QString &description, const SqlParameters &parameters,
+                                             const QVariantMap &lastValues, QWidget *parent)
+    : QDialog(parent), parameters(parameters)
+{
+    setupUI(description, lastValues);
+}
+
+void QueryParametersDialog::setupUI(const QString &description, const QVariantMap &lastValues)
+{
+    setWindowTitle("Параметры запроса: " + description);
+    setMinimumWidth(400);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    QFormLayout *formLayout = new QFormLayout();
+
+    for (const SqlParameters::Parameter &param : parameters.parameters()) {
+        QWidget *editor = createEditor(param, lastValues.value(param.name));
+        editors.append(editor);
+        formLayout->addRow(QString("%1 (%2):").arg(param.name, param.type), editor);
+    }
+    mainLayout->addLayout(formLayout);
+
+    QLabel *hintLabel = new QLabel("Пустое значение передаётся как NULL.", this);
+    mainLayout->addWidget(hintLabel);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+    buttons->button(QDialogButtonBox::Ok)->setText("Выполнить");
+    buttons->button(QDialogButtonBox::Cancel)->setText("Отмена");
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    mainLayout->addWidget(buttons);
+}
+
+QWidget *QueryParametersDialog::createEditor(const SqlParameters::Parameter &param, const QVariant &lastValue)
+{
+    if (param.type == "bool" || param.type == "boolean") {
+        QCheckBox *check = new QCheckBox(this);
+        check->setChecked(lastValue.toBool());
+        return check;
+    }
+    if (param.type == "date") {
+        QDateEdit *edit = new QDateEdit(this);
+        edit->setCalendarPopup(true);
+        edit->setDisplayFormat("dd.MM.yyyy");
+        QDate date = lastValue.toDate();
+        edit->setDate(date.isValid() ? date : QDate::currentDate());
+        return edit;
+    }
+    if (isTimestamp(param.type)) {
+        QDateTimeEdit *edit = new QDateTimeEdit(this);
+        edit->setCalendarPopup(true);
+        edit->setDisplayFormat("dd.MM.yyyy HH:mm:ss");
+        QDateTime dateTime = lastValue.toDateTime();
+        edit->setDateTime(dateTime.isValid() ? dateTime : QDateTime::currentDateTime());
+        return edit;
+    }
+
+    QLineEdit *edit = new QLineEdit(this);
+    if (integerTypes.contains(param.type)) {
+        edit->setValidator(new QRegularExpressionValidator(QRegularExpression("-?\\d{1,19}"), edit));
+    } else if (decimalTypes.contains(param.type)) {
+        QDoubleValidator *validator = new QDoubleValidator(edit);
+        validator->setLocale(QLocale::c());
+        edit->setValidator(validator);
+    }
+    edit->setText(lastValue.toString());
+    return edit;
+}
+
+// Values go to the server as text, so numbers are passed through as typed;
+// the server parses them against the statement's parameter types.
+QVariantMap QueryParametersDialog::getValues() const
+{
+    QVariantMap values;
+    const QList<SqlParameters::Parameter> &params = parameters.parameters();
+    for (int i = 0; i < params.size(); ++i) {
+        QWidget *editor = editors[i];
+        QVariant value;
+        if (auto check = qobject_cast<QCheckBox *>(editor)) {
+            value = check->isChecked();
+        } else if (auto dateTimeEdit = qobject_cast<QDateTimeEdit *>(editor)) {
+            if (qobject_cast<QDateEdit *>(editor)) {
+                value = dateTimeEdit->date();
+            } else {
+                value = dateTimeEdit->dateTime();
+            }
+        } else if (auto lineEdit = qobject_cast<QLineEdit *>(editor)) {
+            if (!lineEdit->text().isEmpty()) {
+                value = lineEdit->text();
+            }
+        }
+        values.insert(params[i].name, value);
+    }
+    return values;
+}
@@ -0,0 +1,30 @@
+#ifndef QUERYPARAMETERSDIALOG_H
+#define QUERYPARAMETERSDIALOG_H
+
+#include <QDialog>
+#include <QVariantMap>
+#include <QList>
+#include "sqlparameters.h"
+
+class QWidget;
+
+// Asks for the values of a query's named parameters, one input per
+// parameter chosen by its declared type.
+class QueryParametersDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    QueryParametersDialog(const QString &description, const SqlParameters &parameters,
+                          const QVariantMap &lastValues, QWidget *parent = nullptr);
+    QVariantMap getValues() const;
+
+private:
+    void setupUI(const QString &description, const QVariantMap &lastValues);
+    QWidget *createEditor(const SqlParameters::Parameter &param, const QVariant &lastValue);
+
+    SqlParameters parameters;
+    QList<QWidget *> editors;
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "queryprofiledialog.h"
+#include <QHeaderView>
+#include <QTreeWidgetItemIterator>
+#include <QDateTime>
+#include <algorithm>
+
+namespace {
+enum PlanColumn {
+    NodeColumn,
+    RelationColumn,
+    TotalTimeColumn,
+    SelfTimeColumn,
+    ActualRowsColumn,
+    PlanRowsColumn,
+    LoopsColumn,
+    SharedHitColumn,
+    SharedReadColumn,
+    ColumnCount
+};
+
+const double estimateMissFactor = 10.0;
+const int expensiveNodeCount = 3;
+}
+
+QueryProfileDialog::QueryProfileDialog(const QString &description, const QJsonArray &profiles, QWidget *parent)
+    : QDialog(parent), description(description), profiles(profiles)
+{
+    setupUI();
+
+    for (int i = 0; i < profiles.size(); ++i) {
+        QJsonObject profile = profiles[i].toObject();
+        QDateTime timestamp = QDateTime::fromString(profile["timestamp"].toString(), Qt::ISODate);
+        runCombo->addItem(QString("%1 — %2 мс")
+                              .arg(timestamp.toLocalTime().toString("dd.MM.yyyy HH:mm:ss"))
+                              .arg(profile["executionTime"].toDouble(), 0, 'f', 3));
+    }
+
+    if (!profiles.isEmpty()) {
+        runCombo->setCurrentIndex(profiles.size() - 1);
+    }
+}
+
+void QueryProfileDialog::setupUI()
+{
+    setWindowTitle("Профиль запроса: " + description);
+    setMinimumSize(1100, 600);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QHBoxLayout *runLayout = new QHBoxLayout();
+    QLabel *runLabel = new QLabel("Запуск:", this);
+    runCombo = new QComboBox(this);
+    connect(runCombo, &QComboBox::currentIndexChanged, this, &QueryProfileDialog::onRunSelected);
+    runLayout->addWidget(runLabel);
+    runLayout->addWidget(runCombo, 1);
+    mainLayout->addLayout(runLayout);
+
+    summaryLabel = new QLabel(this);
+    mainLayout->addWidget(summaryLabel);
+
+    planTree = new QTreeWidget(this);
+    planTree->setColumnCount(ColumnCount);
+    planTree->setHeaderLabels({"Узел", "Объект", "Время, мс", "Собств. время, мс",
+                               "Строки (факт)", "Строки (план)", "Циклы",
+                               "Буферы hit", "Буферы read"});
+    mainLayout->addWidget(planTree);
+
+    QLabel *legendLabel = new QLabel("Оранжевым выделены самые затратные узлы, красным — промахи оценки строк "
+                                     "(более чем в 10 раз)", this);
+    mainLayout->addWidget(legendLabel);
+}
+
+void QueryProfileDialog::onRunSelected(int index)
+{
+    planTree->clear();
+    if (index < 0 || index >= profiles.size()) return;
+
+    QJsonObject profile = profiles[index].toObject();
+    QString summary = QString("Планирование: %1 мс, выполнение: %2 мс")
+                          .arg(profile["planningTime"].toDouble(), 0, 'f', 3)
+                          .arg(profile["executionTime"].toDouble(), 0, 'f', 3);
+
+    if (index > 0) {
+        double previous = profiles[index - 1].toObject()["executionTime"].toDouble();
+        double current = profile["executionTime"].toDouble();
+        if (previous > 0) {
+            summary += QString(" (%1%2% к предыдущему запуску)")
+                           .arg(current >= previous ? "+" : "")
+                           .arg((current - previous) / previous * 100.0, 0, 'f', 1);
+        }
+    }
+    summaryLabel->setText(summary);
+
+    addPlanNode(profile["plan"].toObject(), nullptr);
+    highlightNodes();
+
+    planTree->expandAll();
+    for (int i = 0; i < ColumnCount; ++i) {
+        planTree->resizeColumnToContents(i);
+    }
+}
+
+double QueryProfileDialog::addPlanNode(const QJsonObject &plan, QTreeWidgetItem *parentItem)
+{
+    QTreeWidgetItem *item = parentItem ? new QTreeWidgetItem(parentItem) : new QTreeWidgetItem(planTree);
+
+    QString nodeType = plan["Node Type"].toString();
+    if (plan.contains("Join Type")) {
+        nodeType += " (" + plan["Join Type"].toString() + ")";
+    }
+    if (plan.contains("Parent Relationship") && plan["Parent Relationship"].toString() != "Outer"
+        && plan["Parent Relationship"].toString() != "Inner") {
+        nodeType += " [" + plan["Parent Relationship"].toString() + "]";
+    }
+
+    QString relation = plan["Relation Name"].toString();
+    if (plan.contains("Index Name")) {
+        relation += (relation.isEmpty() ? "" : " / ") + plan["Index Name"].toString();
+    }
+    if (plan.contains("Alias") && plan["Alias"].toString() != plan["Relation Name"].toString()) {
+        relation += " " + plan["Alias"].toString();
+    }
+
+    double loops = plan["Actual Loops"].toDouble();
+    double totalTime = plan["Actual Total Time"].toDouble() * loops;
+    double actualRows = plan["Actual Rows"].toDouble() * loops;
+    double planRows = plan["Plan Rows"].toDouble() * std::max(loops, 1.0);
+
+    double childrenTime = 0;
+    const QJsonArray children = plan["Plans"].toArray();
+    for (const auto &child : children) {
+        childrenTime += addPlanNode(child.toObject(), item);
+    }
+    double selfTime = std::max(totalTime - childrenTime, 0.0);
+
+    item->setText(NodeColumn, nodeType);
+    item->setText(RelationColumn, relation);
+    item->setText(TotalTimeColumn, QString::number(totalTime, 'f', 3));
+    item->setText(SelfTimeColumn, QString::number(selfTime, 'f', 3));
+    item->setText(ActualRowsColumn, QString::number(actualRows, 'f', 0));
+    item->setText(PlanRowsColumn, QString::number(planRows, 'f', 0));
+    item->setText(LoopsColumn, QString::number(loops, 'f', 0));
+    item->setText(SharedHitColumn, QString::number(plan["Shared Hit Blocks"].toInteger()));
+    item->setText(SharedReadColumn, QString::number(plan["Shared Read Blocks"].toInteger()));
+    item->setData(SelfTimeColumn, Qt::UserRole, selfTime);
+
+    const QStringList detailKeys = {"Filter", "Index Cond", "Hash Cond", "Merge Cond", "Join Filter", "Sort Key"};
+    QStringList details;
+    for (const QString &key : detailKeys) {
+        if (plan.contains(key)) {
+            QJsonValue value = plan[key];
+            QString text = value.isArray() ? value.toVariant().toStringList().join(", ") : value.toString();
+            details.append(key + ": " + text);
+        }
+    }
+    if (plan.contains("Rows Removed by Filter")) {
+        details.append(QString("Rows Removed by Filter: %1").arg(plan["Rows Removed by Filter"].toInteger()));
+    }
+    if (!details.isEmpty()) {
+        item->setToolTip(NodeColumn, details.join("\n"));
+    }
+
+    double low = std::max(std::min(actualRows, planRows), 1.0);
+    double high = std::max(actualRows, planRows);
+    if (loops > 0 && high / low >= estimateMissFactor) {
+        item->setForeground(ActualRowsColumn, QColor(200, 0, 0));
+        item->setForeground(PlanRowsColumn, QColor(200, 0, 0));
+        item->setToolTip(PlanRowsColumn, QString("Оценка ошиблась в %1 раз").arg(high / low, 0, 'f', 1));
+    }
+
+    return totalTime;
+}
+
+void QueryProfileDialog::highlightNodes()
+{
+    QList<QTreeWidgetItem*> items;
+    QTreeWidgetItemIterator it(planTree);
+    while (*it) {
+        items.append(*it);
+        ++it;
+    }
+
+    std::sort(items.begin(), items.end(), [](QTreeWidgetItem *a, QTreeWidgetItem *b) {
+        return a->data(SelfTimeColumn, Qt::UserRole).toDouble() > b->data(SelfTimeColumn, Qt::UserRole).toDouble();
+    });
+
+    for (int i = 0; i < items.size() && i < expensiveNodeCount; ++i) {
+        if (items[i]->data(SelfTimeColumn, Qt::UserRole).toDouble() <= 0) break;
+        for (int col = 0; col < ColumnCount; ++col) {
+            items[i]->setBackground(col, QColor(255, 220, 170));
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef QUERYPROFILEDIALOG_H
+#define QUERYPROFILEDIALOG_H
+
+#include <QDialog>
+#include <QTreeWidget>
+#include <QComboBox>
+#include <QLabel>
+#include <QVBoxLayout>
+#include <QJsonArray>
+#include <QJsonObject>
+
+class QueryProfileDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit QueryProfileDialog(const QString &description, const QJsonArray &profiles, QWidget *parent = nullptr);
+
+private slots:
+    void onRunSelected(int index);
+
+private:
+    void setupUI();
+    double addPlanNode(const QJsonObject &plan, QTreeWidgetItem *parentItem);
+    void highlightNodes();
+
+    QString description;
+    QJsonArray profiles;
+    QComboBox *runCombo;
+    QLabel *summaryLabel;
+    QTreeWidget *planTree;
+};
+
+#endif
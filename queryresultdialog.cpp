@@ -1,5 +1,8 @@
 #include "queryresultdialog.h"
+#include "queryworker.h"
 #include "databasemanager.h"
+#include "dbmetrics.h"
+#include "tracer.h"
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QHeaderView>
@@ -11,6 +14,37 @@ QueryResultDialog::QueryResultDialog(const QList<QVariantList> &data, const QStr
     loadData();
 }
 
+QueryResultDialog::QueryResultDialog(QueryWorker *worker, QWidget *parent)
+    : QDialog(parent), worker(worker)
+{
+    setupUI();
+
+    statusLabel = new QLabel("Загрузка...", this);
+    stopButton = new QPushButton("Остановить", this);
+    exportButton->setEnabled(false);
+
+    QHBoxLayout *statusLayout = new QHBoxLayout();
+    statusLayout->addWidget(statusLabel);
+    statusLayout->addStretch();
+    statusLayout->addWidget(stopButton);
+    static_cast<QVBoxLayout *>(layout())->insertLayout(1, statusLayout);
+
+    worker->setParent(this);
+    connect(stopButton, &QPushButton::clicked, this, &QueryResultDialog::onStop);
+    connect(worker, &QueryWorker::headersReady, this, &QueryResultDialog::onHeadersReady);
+    connect(worker, &QueryWorker::rowsReady, this, &QueryResultDialog::onRowsReady);
+    connect(worker, &QueryWorker::completed, this, &QueryResultDialog::onCompleted);
+    worker->start();
+}
+
+QueryResultDialog::~QueryResultDialog()
+{
+    if (worker) {
+        worker->stop();
+        worker->wait();
+    }
+}
+
 void QueryResultDialog::setupUI()
 {
     setWindowTitle("Результат запроса");
@@ -29,19 +63,92 @@ void QueryResultDialog::setupUI()
 
 void QueryResultDialog::loadData()
 {
-    resultTable->setRowCount(data.size());
     resultTable->setColumnCount(headers.size());
     resultTable->setHorizontalHeaderLabels(headers);
+    populateRows(0, data);
+    resultTable->resizeColumnsToContents();
+}
+
+void QueryResultDialog::populateRows(int firstRow, const QList<QVariantList> &rows)
+{
+    TraceSpan traceSpan("ui", "QueryResultDialog::populateRows");
+    traceSpan.addArg("rows", rows.size());
+    DbMetrics::Scope metricsScope(DbMetrics::WidgetPopulation);
+
+    resultTable->setUpdatesEnabled(false);
+    resultTable->setRowCount(firstRow + rows.size());
 
-    for (int row = 0; row < data.size(); ++row) {
-        const auto &rowData = data[row];
+    for (int row = 0; row < rows.size(); ++row) {
+        const auto &rowData = rows[row];
         for (int col = 0; col < rowData.size(); ++col) {
             QTableWidgetItem *item = new QTableWidgetItem(rowData[col].toString());
-            resultTable->setItem(row, col, item);
+            resultTable->setItem(firstRow + row, col, item);
         }
     }
 
-    resultTable->resizeColumnsToContents();
+    resultTable->setUpdatesEnabled(true);
+}
+
+void QueryResultDialog::onHeadersReady(const QStringList &headers)
+{
+    this->headers = headers;
+    resultTable->setColumnCount(headers.size());
+    resultTable->setHorizontalHeaderLabels(headers);
+}
+
+void QueryResultDialog::onRowsReady(const QList<QVariantList> &rows)
+{
+    int firstRow = data.size();
+    data.append(rows);
+    populateRows(firstRow, rows);
+
+    if (firstRowsMs < 0) {
+        qint64 elapsedNs = worker->elapsedNs();
+        DbMetrics::recordLatency(DbMetrics::TimeToFirstRow, elapsedNs);
+        firstRowsMs = elapsedNs / 1e6;
+
+        resultTable->resizeColumnsToContents();
+        show();
+    }
+
+    statusLabel->setText(QString("Загружено строк: %1...").arg(data.size()));
+}
+
+void QueryResultDialog::onCompleted(bool ok, const QString &error)
+{
+    bool stopped = worker->isStopped();
+    stopButton->hide();
+    exportButton->setEnabled(true);
+
+    if (!ok) {
+        if (!isVisible()) {
+            QMessageBox::critical(parentWidget(), "Ошибка выполнения запроса", error);
+            deleteLater();
+            return;
+        }
+        statusLabel->setText(QString("Загружено строк: %1. Ошибка: %2").arg(data.size()).arg(error));
+        return;
+    }
+
+    QString status = QString("Строк: %1").arg(data.size());
+    if (stopped) {
+        status += " (загрузка остановлена)";
+    }
+    if (firstRowsMs >= 0) {
+        status += QString(", первые строки через %1 мс").arg(firstRowsMs, 0, 'f', 0);
+    }
+    statusLabel->setText(status);
+
+    if (!isVisible()) {
+        show();
+    }
+}
+
+void QueryResultDialog::onStop()
+{
+    worker->stop();
+    stopButton->setEnabled(false);
+    statusLabel->setText(QString("Остановка... загружено строк: %1").arg(data.size()));
 }
 
 void QueryResultDialog::onExportResult()
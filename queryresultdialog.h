@@ -4,27 +4,43 @@
 #include <QDialog>
 #include <QTableWidget>
 #include <QPushButton>
+#include <QLabel>
 #include <QVBoxLayout>
 #include <QVariantList>
 
+class QueryWorker;
+
 class QueryResultDialog : public QDialog
 {
     Q_OBJECT
 
 public:
     explicit QueryResultDialog(const QList<QVariantList> &data, const QStringList &headers, QWidget *parent = nullptr);
+    // Takes ownership of the worker and starts it; the dialog shows itself
+    // once the first block of rows has been added.
+    explicit QueryResultDialog(QueryWorker *worker, QWidget *parent = nullptr);
+    ~QueryResultDialog();
 
 private slots:
     void onExportResult();
+    void onHeadersReady(const QStringList &headers);
+    void onRowsReady(const QList<QVariantList> &rows);
+    void onCompleted(bool ok, const QString &error);
+    void onStop();
 
 private:
     void setupUI();
     void loadData();
+    void populateRows(int firstRow, const QList<QVariantList> &rows);
 
     QList<QVariantList> data;
     QStringList headers;
     QTableWidget *resultTable;
     QPushButton *exportButton;
+    QPushButton *stopButton = nullptr;
+    QLabel *statusLabel = nullptr;
+    QueryWorker *worker = nullptr;
+    double firstRowsMs = -1;
 };
 
 #endif
@@ -0,0 +1,165 @@
+#include "queryworker.h"
+#include "databasemanager.h"
+#include "dbmetrics.h"
+#include "pgnative.h"
+#include "queryhistory.h"
+#include "tracer.h"
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+
+namespace {
+const int firstBlockRows = 200;
+const int blockRows = 5000;
+const int blockIntervalMs = 100;
+
+std::atomic<int> nextWorkerId(0);
+}
+
+QueryWorker::QueryWorker(const QString &sql, const QString &historySql, QObject *parent)
+    : QThread(parent), sql(sql), historySql(historySql.isEmpty() ? sql : historySql), stopped(false)
+{
+    timer.start();
+}
+
+// The server is asked to cancel as well, so a query that has not produced
+// rows yet does not keep wait() blocked.
+void QueryWorker::stop()
+{
+    stopped.store(true, std::memory_order_relaxed);
+    canceller.cancel();
+}
+
+bool QueryWorker::isStopped() const
+{
+    return stopped.load(std::memory_order_relaxed);
+}
+
+qint64 QueryWorker::elapsedNs() const
+{
+    return timer.nsecsElapsed();
+}
+
+void QueryWorker::run()
+{
+    Tracer::nameCurrentThread("QueryWorker");
+    DbMetrics::Scope metricsScope(DbMetrics::StreamQuery);
+
+    QString connectionName = QString("library_query_%1").arg(nextWorkerId.fetch_add(1));
+    QString error;
+    bool ok = false;
+    qint64 runNs = 0;
+
+    {
+        QSqlDatabase connection = DatabaseManager::instance().openWorkerConnection(connectionName, &error);
+        if (connection.isOpen()) {
+            canceller.attach(connection);
+            if (!isStopped()) {
+                // Connection setup is left out, as on the synchronous path.
+                QElapsedTimer runTimer;
+                runTimer.start();
+                ok = PgNativeResult::isAvailable(connection) ? runNative(connection, &error)
+                                                             : runQuery(connection, &error);
+                runNs = runTimer.nsecsElapsed();
+            }
+            canceller.detach();
+        }
+    }
+    DatabaseManager::closeWorkerConnection(connectionName);
+
+    flush();
+    if (isStopped()) {
+        ok = true;
+        error.clear();
+    } else if (ok) {
+        QueryHistory::instance().record(historySql, runNs, rowCount, byteCount);
+    }
+    emit completed(ok, error);
+}
+
+bool QueryWorker::runNative(const QSqlDatabase &connection, QString *error)
+{
+    return PgNativeResult::stream(connection, sql, firstBlockRows, [this](const PgNativeResult &chunk) {
+        if (!headersSent) {
+            QStringList headers;
+            for (int c = 0; c < chunk.columnCount(); ++c) {
+                headers.append(chunk.columnName(c));
+            }
+            emit headersReady(headers);
+            headersSent = true;
+        }
+
+        int columnCount = chunk.columnCount();
+        for (int r = 0; r < chunk.rowCount() && !isStopped(); ++r) {
+            QVariantList row;
+            row.reserve(columnCount);
+            for (int c = 0; c < columnCount; ++c) {
+                row.append(chunk.value(r, c));
+            }
+            addRow(std::move(row));
+        }
+        return !isStopped();
+    }, error);
+}
+
+// Forward-only QPSQL queries fetch rows in single-row mode, so next() hands
+// them over as the server sends them.
+bool QueryWorker::runQuery(const QSqlDatabase &connection, QString *error)
+{
+    QSqlQuery query(connection);
+    query.setForwardOnly(true);
+    if (!DbMetrics::exec(query, sql)) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+
+    QSqlRecord record = query.record();
+    QStringList headers;
+    for (int i = 0; i < record.count(); ++i) {
+        headers.append(record.fieldName(i));
+    }
+    emit headersReady(headers);
+    headersSent = true;
+
+    while (!isStopped() && query.next()) {
+        QVariantList row;
+        row.reserve(record.count());
+        for (int i = 0; i < record.count(); ++i) {
+            row.append(query.value(i));
+        }
+        addRow(std::move(row));
+    }
+
+    // An error raised mid-stream only ends next(); the rows so far are not
+    // the whole result.
+    if (!isStopped() && query.lastError().isValid()) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void QueryWorker::addRow(QVariantList row)
+{
+    qint64 bytes = DbMetrics::rowBytes(row);
+    DbMetrics::addTransfer(1, bytes);
+    ++rowCount;
+    byteCount += bytes;
+    pending.append(std::move(row));
+
+    if (!firstBlockSent) {
+        if (pending.size() >= firstBlockRows) flush();
+    } else if (pending.size() >= blockRows || sinceFlush.elapsed() >= blockIntervalMs) {
+        flush();
+    }
+}
+
+void QueryWorker::flush()
+{
+    if (pending.isEmpty()) return;
+
+    emit rowsReady(pending);
+    pending.clear();
+    firstBlockSent = true;
+    sinceFlush.start();
+}
@@ -0,0 +1,55 @@
+#ifndef QUERYWORKER_H
+#define QUERYWORKER_H
+
+#include <QThread>
+#include <QStringList>
+#include <QVariantList>
+#include <QElapsedTimer>
+#include <atomic>
+#include "pgnative.h"
+
+class QSqlDatabase;
+
+// Runs a SELECT on its own connection and hands rows to the GUI thread in
+// blocks: the first block as soon as it is read, the rest in larger batches.
+class QueryWorker : public QThread
+{
+    Q_OBJECT
+
+public:
+    // historySql is the text the run is recorded under in the query history
+    // when it differs from what is executed (a report read from its view).
+    explicit QueryWorker(const QString &sql, const QString &historySql = QString(), QObject *parent = nullptr);
+
+    void stop();
+    bool isStopped() const;
+    qint64 elapsedNs() const;
+
+signals:
+    void headersReady(const QStringList &headers);
+    void rowsReady(const QList<QVariantList> &rows);
+    void completed(bool ok, const QString &error);
+
+protected:
+    void run() override;
+
+private:
+    bool runNative(const QSqlDatabase &connection, QString *error);
+    bool runQuery(const QSqlDatabase &connection, QString *error);
+    void addRow(QVariantList row);
+    void flush();
+
+    QString sql;
+    QString historySql;
+    std::atomic<bool> stopped;
+    PgCancelHandle canceller;
+    QElapsedTimer timer;
+    QElapsedTimer sinceFlush;
+    QList<QVariantList> pending;
+    qint64 rowCount = 0;
+    qint64 byteCount = 0;
+    bool headersSent = false;
+    bool firstBlockSent = false;
+};
+
+#endif
@@ -0,0 +1,735 @@
+#include "replicacache.h"
+#include "dbmetrics.h"
+#include <QJsonDocument>
+#include <QFileInfo>
+#include <QDir>
+#include <algorithm>
+
+namespace {
+const char *const replicaConnectionName = "library_replica";
+const qint64 maxIncrementalXidAge = 1000000000;
+
+struct SyncGuard {
+    explicit SyncGuard(bool &flag) : flag(flag) { flag = true; }
+    ~SyncGuard() { flag = false; }
+    bool &flag;
+};
+
+QString quoted(const QString &identifier)
+{
+    QString escaped = identifier;
+    escaped.replace("\"", "\"\"");
+    return "\"" + escaped + "\"";
+}
+
+QString literal(const QString &value)
+{
+    QString escaped = value;
+    escaped.replace("'", "''");
+    return "'" + escaped + "'";
+}
+
+QString sqliteType(const QString &pgType)
+{
+    QString type = pgType.toLower();
+    if (type.contains("int") || type == "boolean") return "INTEGER";
+    if (type == "real" || type == "double precision") return "REAL";
+    if (type == "numeric") return "NUMERIC";
+    return "TEXT";
+}
+
+QVariant restoreValue(const QVariant &value, const QString &pgType)
+{
+    if (value.isNull()) return value;
+    if (pgType == "boolean") return value.toBool();
+    if (pgType == "date") return QDate::fromString(value.toString(), Qt::ISODate);
+    if (pgType.startsWith("timestamp")) return QDateTime::fromString(value.toString(), Qt::ISODateWithMs);
+    return value;
+}
+
+QString columnsToJson(const QList<DatabaseManager::ColumnInfo> &columns)
+{
+    QJsonArray array;
+    for (const auto &col : columns) {
+        QJsonObject obj;
+        obj["name"] = col.name;
+        obj["type"] = col.type;
+        obj["fullType"] = col.fullType;
+        obj["isPrimaryKey"] = col.isPrimaryKey;
+        obj["isIdentity"] = col.isIdentity;
+        obj["isNullable"] = col.isNullable;
+        obj["defaultValue"] = col.defaultValue;
+        array.append(obj);
+    }
+    return QString::fromUtf8(QJsonDocument(array).toJson(QJsonDocument::Compact));
+}
+
+QList<DatabaseManager::ColumnInfo> columnsFromJson(const QString &json)
+{
+    QList<DatabaseManager::ColumnInfo> columns;
+    for (const auto &value : QJsonDocument::fromJson(json.toUtf8()).array()) {
+        QJsonObject obj = value.toObject();
+        DatabaseManager::ColumnInfo col;
+        col.name = obj["name"].toString();
+        col.type = obj["type"].toString();
+        col.fullType = obj["fullType"].toString();
+        col.isPrimaryKey = obj["isPrimaryKey"].toBool();
+        col.isIdentity = obj["isIdentity"].toBool();
+        col.isNullable = obj["isNullable"].toBool();
+        col.defaultValue = obj["defaultValue"].toString();
+        columns.append(col);
+    }
+    return columns;
+}
+}
+
+ReplicaCache::ReplicaCache(DatabaseManager &manager)
+    : manager(manager)
+{
+}
+
+ReplicaCache::~ReplicaCache()
+{
+    close();
+}
+
+bool ReplicaCache::open(const QString &filePath, QString *error)
+{
+    close();
+
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+
+    replica = QSqlDatabase::addDatabase("QSQLITE", replicaConnectionName);
+    replica.setDatabaseName(filePath);
+    if (!replica.open()) {
+        if (error) *error = replica.lastError().text();
+        close();
+        return false;
+    }
+
+    const QStringList setup = {
+        "PRAGMA journal_mode = WAL",
+        "PRAGMA synchronous = NORMAL",
+        "PRAGMA case_sensitive_like = ON",
+        "CREATE TABLE IF NOT EXISTS __replica_tables ("
+        "table_name TEXT PRIMARY KEY, columns TEXT, row_count INTEGER, synced_at TEXT, "
+        "modification_count INTEGER, deletion_count INTEGER, sync_xmin INTEGER, schema_hash TEXT, "
+        "update_count INTEGER, storage_id TEXT)"
+    };
+
+    QSqlQuery query(replica);
+    for (const QString &statement : setup) {
+        if (!query.exec(statement)) {
+            if (error) *error = query.lastError().text();
+            close();
+            return false;
+        }
+    }
+
+    // Replica files written before update_count and storage_id existed; the
+    // ALTER fails harmlessly when the column is already there. Their empty
+    // storage id forces one snapshot per table on the next refresh.
+    query.exec("ALTER TABLE __replica_tables ADD COLUMN update_count INTEGER");
+    query.exec("ALTER TABLE __replica_tables ADD COLUMN storage_id TEXT");
+
+    path = filePath;
+    if (!loadMirrors(error)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ReplicaCache::close()
+{
+    mirrors.clear();
+    path.clear();
+
+    if (replica.isValid()) {
+        replica.close();
+        replica = QSqlDatabase();
+        QSqlDatabase::removeDatabase(replicaConnectionName);
+    }
+}
+
+bool ReplicaCache::isOpen() const
+{
+    return replica.isOpen();
+}
+
+QString ReplicaCache::filePath() const
+{
+    return path;
+}
+
+int ReplicaCache::maxStalenessMs() const
+{
+    return stalenessMs;
+}
+
+void ReplicaCache::setMaxStalenessMs(int ms)
+{
+    stalenessMs = ms;
+}
+
+bool ReplicaCache::loadMirrors(QString *error)
+{
+    QSqlQuery query(replica);
+    if (!query.exec("SELECT table_name, columns, row_count, synced_at, modification_count, "
+                    "deletion_count, sync_xmin, schema_hash, update_count, storage_id FROM __replica_tables")) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+
+    while (query.next()) {
+        Mirror mirror;
+        mirror.columns = columnsFromJson(query.value(1).toString());
+        mirror.rowCount = query.value(2).toLongLong();
+        mirror.syncedAt = QDateTime::fromString(query.value(3).toString(), Qt::ISODate);
+        mirror.modificationCount = query.value(4).toLongLong();
+        mirror.deletionCount = query.value(5).toLongLong();
+        mirror.syncXmin = query.value(6).toLongLong();
+        mirror.schemaHash = query.value(7).toString();
+        mirror.updateCount = query.value(8).toLongLong();
+        mirror.storageId = query.value(9).toString();
+        mirrors.insert(query.value(0).toString(), mirror);
+    }
+
+    return true;
+}
+
+bool ReplicaCache::saveMirror(const QString &tableName, const Mirror &mirror, QString *error)
+{
+    QSqlQuery query(replica);
+    query.prepare("INSERT OR REPLACE INTO __replica_tables (table_name, columns, row_count, synced_at, "
+                  "modification_count, deletion_count, sync_xmin, schema_hash, update_count, storage_id) "
+                  "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    query.addBindValue(tableName);
+    query.addBindValue(columnsToJson(mirror.columns));
+    query.addBindValue(mirror.rowCount);
+    query.addBindValue(mirror.syncedAt.toString(Qt::ISODate));
+    query.addBindValue(mirror.modificationCount);
+    query.addBindValue(mirror.deletionCount);
+    query.addBindValue(mirror.syncXmin);
+    query.addBindValue(mirror.schemaHash);
+    query.addBindValue(mirror.updateCount);
+    query.addBindValue(mirror.storageId);
+
+    if (!query.exec()) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+// pg_stat counters catch data changes made by other clients (they are
+// flushed with a short delay), the attribute hash catches DDL. Rows of a
+// partitioned table live in its leaves, so their counters are summed.
+// TRUNCATE does not touch the counters but gives every leaf a new
+// relfilenode, which is what the storage id tracks.
+bool ReplicaCache::fetchServerStates(const QStringList &tableNames, QHash<QString, Mirror> &states, QString *error)
+{
+    QStringList literals;
+    for (const QString &name : tableNames) {
+        literals.append(literal(name));
+    }
+
+    QString queryStr = QString(
+                           "SELECT c.relname, agg.modifications, agg.deletions, agg.updates, agg.storage_id, "
+                           "    (SELECT md5(string_agg(a.attname || ':' || format_type(a.atttypid, a.atttypmod), ',' "
+                           "                ORDER BY a.attnum)) "
+                           "     FROM pg_attribute a "
+                           "     WHERE a.attrelid = c.oid AND a.attnum > 0 AND NOT a.attisdropped) "
+                           "FROM pg_class c "
+                           "JOIN pg_namespace n ON n.oid = c.relnamespace "
+                           "CROSS JOIN LATERAL ( "
+                           "    SELECT COALESCE(SUM(s.n_tup_ins + s.n_tup_upd + s.n_tup_del), 0)::bigint AS modifications, "
+                           "        COALESCE(SUM(s.n_tup_del), 0)::bigint AS deletions, "
+                           "        COALESCE(SUM(s.n_tup_upd), 0)::bigint AS updates, "
+                           "        string_agg(l.relfilenode::text, ',' ORDER BY t.relid) AS storage_id "
+                           "    FROM pg_partition_tree(c.oid) t "
+                           "    JOIN pg_class l ON l.oid = t.relid "
+                           "    LEFT JOIN pg_stat_user_tables s ON s.relid = t.relid "
+                           ") agg "
+                           "WHERE n.nspname = %1 AND c.relname IN (%2)"
+                           ).arg(literal(manager.connectionSettings().schemaName), literals.join(", "));
+
+    QSqlQuery query(manager.getDatabase());
+    if (!DbMetrics::exec(query, queryStr)) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+
+    while (query.next()) {
+        Mirror state;
+        state.modificationCount = query.value(1).toLongLong();
+        state.deletionCount = query.value(2).toLongLong();
+        state.updateCount = query.value(3).toLongLong();
+        state.storageId = query.value(4).toString();
+        state.schemaHash = query.value(5).toString();
+        states.insert(query.value(0).toString(), state);
+    }
+    return true;
+}
+
+qint64 ReplicaCache::currentSnapshotXmin(QString *error)
+{
+    QSqlQuery query(manager.getDatabase());
+    if (!DbMetrics::exec(query, "SELECT txid_snapshot_xmin(txid_current_snapshot())") || !query.next()) {
+        if (error) *error = query.lastError().text();
+        return -1;
+    }
+    return query.value(0).toLongLong();
+}
+
+bool ReplicaCache::snapshotTable(const QString &tableName, Mirror &mirror, QString *error)
+{
+    QList<DatabaseManager::ColumnInfo> columns = manager.getTableColumns(tableName);
+    if (columns.isEmpty()) {
+        if (error) *error = "Table not found: " + tableName;
+        return false;
+    }
+
+    QHash<QString, Mirror> states;
+    if (!fetchServerStates({tableName}, states, error)) return false;
+    qint64 xmin = currentSnapshotXmin(error);
+    if (xmin < 0) return false;
+
+    QStringList columnNames;
+    QStringList definitions;
+    QStringList primaryKey;
+    QStringList placeholders;
+    for (const auto &col : columns) {
+        columnNames.append(col.name);
+        definitions.append(quoted(col.name) + " " + sqliteType(col.fullType));
+        if (col.isPrimaryKey) primaryKey.append(quoted(col.name));
+        placeholders.append("?");
+    }
+    if (!primaryKey.isEmpty()) {
+        definitions.append("PRIMARY KEY (" + primaryKey.join(", ") + ")");
+    }
+
+    QSqlQuery source(manager.getDatabase());
+    source.setForwardOnly(true);
+    if (!DbMetrics::exec(source, QString("SELECT %1 FROM %2").arg(columnNames.join(", "), tableName))) {
+        if (error) *error = source.lastError().text();
+        return false;
+    }
+
+    replica.transaction();
+
+    QSqlQuery target(replica);
+    if (!target.exec("DROP TABLE IF EXISTS " + quoted(tableName)) ||
+        !target.exec(QString("CREATE TABLE %1 (%2)").arg(quoted(tableName), definitions.join(", ")))) {
+        if (error) *error = target.lastError().text();
+        replica.rollback();
+        return false;
+    }
+
+    target.prepare(QString("INSERT OR REPLACE INTO %1 VALUES (%2)").arg(quoted(tableName), placeholders.join(", ")));
+
+    qint64 rows = 0;
+    while (source.next()) {
+        for (int i = 0; i < columns.size(); ++i) {
+            target.bindValue(i, source.value(i));
+        }
+        if (!target.exec()) {
+            if (error) *error = target.lastError().text();
+            replica.rollback();
+            return false;
+        }
+        ++rows;
+    }
+
+    if (source.lastError().isValid()) {
+        if (error) *error = source.lastError().text();
+        replica.rollback();
+        return false;
+    }
+
+    const Mirror state = states.value(tableName);
+    mirror.columns = columns;
+    mirror.rowCount = rows;
+    mirror.syncedAt = QDateTime::currentDateTime();
+    mirror.checkedAt = mirror.syncedAt;
+    mirror.modificationCount = state.modificationCount;
+    mirror.deletionCount = state.deletionCount;
+    mirror.updateCount = state.updateCount;
+    mirror.schemaHash = state.schemaHash;
+    mirror.storageId = state.storageId;
+    mirror.syncXmin = xmin;
+    mirror.stale = false;
+    mirror.needsSnapshot = false;
+
+    if (!saveMirror(tableName, mirror, error)) {
+        replica.rollback();
+        return false;
+    }
+
+    DbMetrics::addTransfer(rows, 0);
+    return replica.commit();
+}
+
+// Rows inserted or updated since the last sync carry an xmin at or after the
+// snapshot xmin recorded then; age() compares them modulo xid wraparound.
+bool ReplicaCache::applyChanges(const QString &tableName, Mirror &mirror, const Mirror &serverState, QString *error)
+{
+    qint64 xmin = currentSnapshotXmin(error);
+    if (xmin < 0) return false;
+    if (xmin - mirror.syncXmin > maxIncrementalXidAge) {
+        return snapshotTable(tableName, mirror, error);
+    }
+
+    QStringList columnNames;
+    QStringList placeholders;
+    for (const auto &col : mirror.columns) {
+        columnNames.append(col.name);
+        placeholders.append("?");
+    }
+
+    QSqlQuery source(manager.getDatabase());
+    source.setForwardOnly(true);
+    QString queryStr = QString("SELECT %1 FROM %2 WHERE age(xmin) <= age('%3'::xid)")
+                           .arg(columnNames.join(", "), tableName)
+                           .arg(mirror.syncXmin % (Q_INT64_C(1) << 32));
+    if (!DbMetrics::exec(source, queryStr)) {
+        if (error) *error = source.lastError().text();
+        return false;
+    }
+
+    replica.transaction();
+
+    QSqlQuery target(replica);
+    target.prepare(QString("INSERT OR REPLACE INTO %1 VALUES (%2)").arg(quoted(tableName), placeholders.join(", ")));
+
+    qint64 rows = 0;
+    while (source.next()) {
+        for (int i = 0; i < mirror.columns.size(); ++i) {
+            target.bindValue(i, source.value(i));
+        }
+        if (!target.exec()) {
+            if (error) *error = target.lastError().text();
+            replica.rollback();
+            return false;
+        }
+        ++rows;
+    }
+
+    if (source.lastError().isValid()) {
+        if (error) *error = source.lastError().text();
+        replica.rollback();
+        return false;
+    }
+
+    // An UPDATE may have changed a primary key, which the upsert above
+    // cannot see: the row under the old key would stay behind.
+    if (serverState.updateCount != mirror.updateCount && !removeVanishedKeys(tableName, mirror, error)) {
+        replica.rollback();
+        return false;
+    }
+
+    QSqlQuery count(replica);
+    if (count.exec("SELECT count(*) FROM " + quoted(tableName)) && count.next()) {
+        mirror.rowCount = count.value(0).toLongLong();
+    }
+
+    mirror.syncedAt = QDateTime::currentDateTime();
+    mirror.checkedAt = mirror.syncedAt;
+    mirror.modificationCount = serverState.modificationCount;
+    mirror.deletionCount = serverState.deletionCount;
+    mirror.updateCount = serverState.updateCount;
+    mirror.syncXmin = xmin;
+    mirror.stale = false;
+
+    if (!saveMirror(tableName, mirror, error)) {
+        replica.rollback();
+        return false;
+    }
+
+    DbMetrics::addTransfer(rows, 0);
+    return replica.commit();
+}
+
+// Anti-join on the primary key: only the key columns are read from the
+// server, into a temporary table, and local rows without a match go.
+bool ReplicaCache::removeVanishedKeys(const QString &tableName, const Mirror &mirror, QString *error)
+{
+    QStringList keyNames;
+    QStringList keyColumns;
+    QStringList keyDefinitions;
+    QStringList keyMatches;
+    QStringList placeholders;
+    for (const auto &col : mirror.columns) {
+        if (!col.isPrimaryKey) continue;
+        keyNames.append(col.name);
+        keyColumns.append(quoted(col.name));
+        keyDefinitions.append(quoted(col.name) + " " + sqliteType(col.fullType));
+        keyMatches.append(QString("k.%1 = %2.%1").arg(quoted(col.name), quoted(tableName)));
+        placeholders.append("?");
+    }
+
+    QSqlQuery source(manager.getDatabase());
+    source.setForwardOnly(true);
+    if (!DbMetrics::exec(source, QString("SELECT %1 FROM %2").arg(keyNames.join(", "), tableName))) {
+        if (error) *error = source.lastError().text();
+        return false;
+    }
+
+    QSqlQuery target(replica);
+    if (!target.exec("DROP TABLE IF EXISTS temp.__replica_keys") ||
+        !target.exec(QString("CREATE TEMP TABLE __replica_keys (%1, PRIMARY KEY (%2))")
+                         .arg(keyDefinitions.join(", "), keyColumns.join(", ")))) {
+        if (error) *error = target.lastError().text();
+        return false;
+    }
+
+    target.prepare(QString("INSERT OR IGNORE INTO temp.__replica_keys VALUES (%1)").arg(placeholders.join(", ")));
+    while (source.next()) {
+        for (int i = 0; i < keyNames.size(); ++i) {
+            target.bindValue(i, source.value(i));
+        }
+        if (!target.exec()) {
+            if (error) *error = target.lastError().text();
+            return false;
+        }
+    }
+    if (source.lastError().isValid()) {
+        if (error) *error = source.lastError().text();
+        return false;
+    }
+
+    QSqlQuery cleanup(replica);
+    if (!cleanup.exec(QString("DELETE FROM %1 WHERE NOT EXISTS (SELECT 1 FROM temp.__replica_keys k WHERE %2)")
+                          .arg(quoted(tableName), keyMatches.join(" AND "))) ||
+        !cleanup.exec("DROP TABLE temp.__replica_keys")) {
+        if (error) *error = cleanup.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool ReplicaCache::mirrorTable(const QString &tableName, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::ReplicaSync);
+
+    if (!isOpen()) {
+        if (error) *error = "Replica cache is not open";
+        return false;
+    }
+    if (!manager.isConnected()) {
+        if (error) *error = "Not connected to the server";
+        return false;
+    }
+
+    SyncGuard guard(syncing);
+    Mirror mirror;
+    if (!snapshotTable(tableName, mirror, error)) return false;
+    mirrors.insert(tableName, mirror);
+    return true;
+}
+
+bool ReplicaCache::removeTable(const QString &tableName, QString *error)
+{
+    if (!mirrors.contains(tableName)) return true;
+    mirrors.remove(tableName);
+
+    QSqlQuery query(replica);
+    query.prepare("DELETE FROM __replica_tables WHERE table_name = ?");
+    query.addBindValue(tableName);
+    if (!query.exec() || !query.exec("DROP TABLE IF EXISTS " + quoted(tableName))) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool ReplicaCache::isMirrored(const QString &tableName) const
+{
+    return mirrors.contains(tableName);
+}
+
+QStringList ReplicaCache::mirroredTables() const
+{
+    QStringList tables = mirrors.keys();
+    std::sort(tables.begin(), tables.end());
+    return tables;
+}
+
+bool ReplicaCache::checkForChanges(QString *error)
+{
+    if (!isOpen() || mirrors.isEmpty() || !manager.isConnected()) return true;
+
+    DbMetrics::Scope metricsScope(DbMetrics::ReplicaSync);
+
+    QHash<QString, Mirror> states;
+    if (!fetchServerStates(mirrors.keys(), states, error)) return false;
+
+    QDateTime now = QDateTime::currentDateTime();
+    for (auto it = mirrors.begin(); it != mirrors.end(); ++it) {
+        Mirror &mirror = it.value();
+        mirror.checkedAt = now;
+
+        auto state = states.constFind(it.key());
+        if (state == states.constEnd() || state->schemaHash != mirror.schemaHash ||
+            state->storageId != mirror.storageId || state->deletionCount != mirror.deletionCount) {
+            mirror.stale = true;
+            mirror.needsSnapshot = true;
+        } else if (state->modificationCount != mirror.modificationCount) {
+            mirror.stale = true;
+        }
+    }
+    return true;
+}
+
+bool ReplicaCache::refreshTable(const QString &tableName, QString *error)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::ReplicaSync);
+
+    auto it = mirrors.find(tableName);
+    if (it == mirrors.end()) {
+        if (error) *error = "Table is not mirrored: " + tableName;
+        return false;
+    }
+    if (!manager.isConnected()) {
+        if (error) *error = "Not connected to the server";
+        return false;
+    }
+
+    SyncGuard guard(syncing);
+
+    QHash<QString, Mirror> states;
+    if (!fetchServerStates({tableName}, states, error)) return false;
+
+    auto state = states.constFind(tableName);
+    if (state == states.constEnd()) {
+        removeTable(tableName);
+        if (error) *error = "Table no longer exists on the server: " + tableName;
+        return false;
+    }
+
+    Mirror &mirror = it.value();
+    bool hasPrimaryKey = std::any_of(mirror.columns.begin(), mirror.columns.end(),
+                                     [](const DatabaseManager::ColumnInfo &col) { return col.isPrimaryKey; });
+    if (mirror.needsSnapshot || !hasPrimaryKey || mirror.syncXmin <= 0 ||
+        state->schemaHash != mirror.schemaHash || state->storageId != mirror.storageId ||
+        state->deletionCount != mirror.deletionCount) {
+        return snapshotTable(tableName, mirror, error);
+    }
+
+    if (applyChanges(tableName, mirror, *state, error)) return true;
+    return snapshotTable(tableName, mirror, error);
+}
+
+bool ReplicaCache::refresh(QString *error)
+{
+    if (!checkForChanges(error)) return false;
+
+    bool ok = true;
+    for (const QString &tableName : mirroredTables()) {
+        if (!mirrors.value(tableName).stale) continue;
+        QString tableError;
+        if (!refreshTable(tableName, &tableError)) {
+            if (ok && error) *error = tableError;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+void ReplicaCache::invalidate(const QString &tableName, bool schemaChanged)
+{
+    auto it = mirrors.find(tableName);
+    if (it == mirrors.end()) return;
+    it->stale = true;
+    if (schemaChanged) it->needsSnapshot = true;
+}
+
+void ReplicaCache::invalidateAll()
+{
+    for (auto it = mirrors.begin(); it != mirrors.end(); ++it) {
+        it->stale = true;
+        it->checkedAt = QDateTime();
+    }
+}
+
+bool ReplicaCache::ensureFresh(const QString &tableName)
+{
+    if (syncing || !isOpen() || !mirrors.contains(tableName)) return false;
+
+    // Without a server the last snapshot is all there is; staleness is shown
+    // in the replica dialog.
+    if (!manager.isConnected()) return true;
+
+    const QDateTime checkedAt = mirrors.value(tableName).checkedAt;
+    if (!checkedAt.isValid() || checkedAt.msecsTo(QDateTime::currentDateTime()) > stalenessMs) {
+        if (!checkForChanges()) return false;
+    }
+
+    if (mirrors.value(tableName).stale && !refreshTable(tableName)) return false;
+    return !mirrors.value(tableName).stale;
+}
+
+bool ReplicaCache::ensureFreshSchema(const QString &tableName)
+{
+    if (syncing || !isOpen() || !mirrors.contains(tableName)) return false;
+    if (!manager.isConnected()) return true;
+
+    const QDateTime checkedAt = mirrors.value(tableName).checkedAt;
+    if (!checkedAt.isValid() || checkedAt.msecsTo(QDateTime::currentDateTime()) > stalenessMs) {
+        if (!checkForChanges()) return false;
+    }
+
+    return !mirrors.value(tableName).needsSnapshot;
+}
+
+QList<DatabaseManager::ColumnInfo> ReplicaCache::tableColumns(const QString &tableName) const
+{
+    return mirrors.value(tableName).columns;
+}
+
+QList<QVariantList> ReplicaCache::tableData(const QString &tableName, bool *ok)
+{
+    DbMetrics::Scope metricsScope(DbMetrics::ReplicaQuery);
+
+    QList<QVariantList> data;
+    const Mirror mirror = mirrors.value(tableName);
+
+    QStringList columnNames;
+    for (const auto &col : mirror.columns) {
+        columnNames.append(quoted(col.name));
+    }
+
+    QSqlQuery query(replica);
+    query.setForwardOnly(true);
+    if (!query.exec(QString("SELECT %1 FROM %2").arg(columnNames.join(", "), quoted(tableName)))) {
+        if (ok) *ok = false;
+        return data;
+    }
+
+    while (query.next()) {
+        QVariantList row;
+        for (int i = 0; i < mirror.columns.size(); ++i) {
+            row.append(restoreValue(query.value(i), mirror.columns[i].fullType));
+        }
+        data.append(row);
+    }
+
+    if (ok) *ok = true;
+    return data;
+}
+
+QList<ReplicaCache::TableState> ReplicaCache::tableStates() const
+{
+    QList<TableState> states;
+    for (const QString &tableName : mirroredTables()) {
+        const Mirror mirror = mirrors.value(tableName);
+        TableState state;
+        state.tableName = tableName;
+        state.rowCount = mirror.rowCount;
+        state.syncedAt = mirror.syncedAt;
+        state.checkedAt = mirror.checkedAt;
+        state.stale = mirror.stale;
+        states.append(state);
+    }
+    return states;
+}
@@ -0,0 +1,80 @@
+#ifndef REPLICACACHE_H
+#define REPLICACACHE_H
+
+#include "databasemanager.h"
+#include <QDateTime>
+#include <QHash>
+
+class ReplicaCache
+{
+public:
+    struct TableState {
+        QString tableName;
+        qint64 rowCount = 0;
+        QDateTime syncedAt;
+        QDateTime checkedAt;
+        bool stale = true;
+    };
+
+    explicit ReplicaCache(DatabaseManager &manager);
+    ~ReplicaCache();
+
+    bool open(const QString &filePath, QString *error = nullptr);
+    void close();
+    bool isOpen() const;
+    QString filePath() const;
+
+    int maxStalenessMs() const;
+    void setMaxStalenessMs(int ms);
+
+    bool mirrorTable(const QString &tableName, QString *error = nullptr);
+    bool removeTable(const QString &tableName, QString *error = nullptr);
+    bool isMirrored(const QString &tableName) const;
+    QStringList mirroredTables() const;
+
+    bool checkForChanges(QString *error = nullptr);
+    bool refreshTable(const QString &tableName, QString *error = nullptr);
+    bool refresh(QString *error = nullptr);
+    void invalidate(const QString &tableName, bool schemaChanged = false);
+    void invalidateAll();
+
+    bool ensureFresh(const QString &tableName);
+    bool ensureFreshSchema(const QString &tableName);
+    QList<DatabaseManager::ColumnInfo> tableColumns(const QString &tableName) const;
+    QList<QVariantList> tableData(const QString &tableName, bool *ok = nullptr);
+
+    QList<TableState> tableStates() const;
+
+private:
+    struct Mirror {
+        QList<DatabaseManager::ColumnInfo> columns;
+        qint64 rowCount = 0;
+        QDateTime syncedAt;
+        QDateTime checkedAt;
+        qint64 modificationCount = 0;
+        qint64 deletionCount = 0;
+        qint64 updateCount = 0;
+        qint64 syncXmin = 0;
+        QString schemaHash;
+        QString storageId;
+        bool stale = false;
+        bool needsSnapshot = false;
+    };
+
+    bool snapshotTable(const QString &tableName, Mirror &mirror, QString *error);
+    bool applyChanges(const QString &tableName, Mirror &mirror, const Mirror &serverState, QString *error);
+    bool removeVanishedKeys(const QString &tableName, const Mirror &mirror, QString *error);
+    bool saveMirror(const QString &tableName, const Mirror &mirror, QString *error);
+    bool loadMirrors(QString *error);
+    bool fetchServerStates(const QStringList &tableNames, QHash<QString, Mirror> &states, QString *error);
+    qint64 currentSnapshotXmin(QString *error);
+
+    DatabaseManager &manager;
+    QSqlDatabase replica;
+    QString path;
+    QHash<QString, Mirror> mirrors;
+    int stalenessMs = 5000;
+    bool syncing = false;
+};
+
+#endif
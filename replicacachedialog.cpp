@@ -0,0 +1,230 @@
+#include "replicacachedialog.h"
+#include "databasemanager.h"
+#include "replicacache.h"
+#include <QMessageBox>
+#include <QFileDialog>
+#include <QStandardPaths>
+#include <QHeaderView>
+#include <QLabel>
+#include <QApplication>
+#include <algorithm>
+
+namespace {
+QString formatLag(qint64 seconds)
+{
+    if (seconds < 60) return QString("%1 с").arg(seconds);
+    if (seconds < 3600) return QString("%1 мин").arg(seconds / 60);
+    if (seconds < 86400) return QString("%1 ч").arg(seconds / 3600);
+    return QString("%1 д").arg(seconds / 86400);
+}
+}
+
+ReplicaCacheDialog::ReplicaCacheDialog(QWidget *parent)
+    : QDialog(parent)
+{
+    if (DatabaseManager::instance().isConnected()) {
+        serverTables = DatabaseManager::instance().getTableNames();
+    }
+
+    setupUI();
+    updateControls();
+    onRefreshView();
+}
+
+void ReplicaCacheDialog::setupUI()
+{
+    setWindowTitle("Локальная копия данных");
+    setMinimumSize(800, 450);
+
+    ReplicaCache *replica = DatabaseManager::instance().replicaCache();
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QHBoxLayout *pathLayout = new QHBoxLayout();
+    pathLayout->addWidget(new QLabel("Файл SQLite:", this));
+    pathEdit = new QLineEdit(this);
+    pathEdit->setText(replica->isOpen()
+                          ? replica->filePath()
+                          : QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/replica.sqlite");
+    pathLayout->addWidget(pathEdit);
+    browseButton = new QPushButton("Обзор...", this);
+    connect(browseButton, &QPushButton::clicked, this, &ReplicaCacheDialog::onBrowse);
+    pathLayout->addWidget(browseButton);
+    openButton = new QPushButton(this);
+    connect(openButton, &QPushButton::clicked, this, &ReplicaCacheDialog::onOpenToggled);
+    pathLayout->addWidget(openButton);
+    mainLayout->addLayout(pathLayout);
+
+    QHBoxLayout *stalenessLayout = new QHBoxLayout();
+    stalenessLayout->addWidget(new QLabel("Проверять изменения на сервере не чаще, чем раз в (с):", this));
+    stalenessSpin = new QSpinBox(this);
+    stalenessSpin->setRange(0, 3600);
+    stalenessSpin->setValue(replica->maxStalenessMs() / 1000);
+    connect(stalenessSpin, &QSpinBox::valueChanged, this, &ReplicaCacheDialog::onStalenessChanged);
+    stalenessLayout->addWidget(stalenessSpin);
+    stalenessLayout->addStretch();
+    mainLayout->addLayout(stalenessLayout);
+
+    tablesTable = new QTableWidget(this);
+    tablesTable->setColumnCount(5);
+    tablesTable->setHorizontalHeaderLabels({"Таблица", "Строк", "Синхронизировано", "Отставание", "Состояние"});
+    tablesTable->setSelectionMode(QAbstractItemView::NoSelection);
+    tablesTable->horizontalHeader()->setStretchLastSection(true);
+    connect(tablesTable, &QTableWidget::itemChanged, this, &ReplicaCacheDialog::onItemChanged);
+    mainLayout->addWidget(tablesTable);
+
+    QHBoxLayout *buttonsLayout = new QHBoxLayout();
+    syncButton = new QPushButton("Синхронизировать", this);
+    QPushButton *closeButton = new QPushButton("Закрыть", this);
+    connect(syncButton, &QPushButton::clicked, this, &ReplicaCacheDialog::onSync);
+    connect(closeButton, &QPushButton::clicked, this, &QDialog::close);
+    buttonsLayout->addWidget(syncButton);
+    buttonsLayout->addStretch();
+    buttonsLayout->addWidget(closeButton);
+    mainLayout->addLayout(buttonsLayout);
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(1000);
+    connect(refreshTimer, &QTimer::timeout, this, &ReplicaCacheDialog::onRefreshView);
+    refreshTimer->start();
+}
+
+void ReplicaCacheDialog::updateControls()
+{
+    bool open = DatabaseManager::instance().replicaCache()->isOpen();
+    openButton->setText(open ? "Отключить" : "Включить");
+    pathEdit->setEnabled(!open);
+    browseButton->setEnabled(!open);
+    syncButton->setEnabled(open);
+    tablesTable->setEnabled(open);
+}
+
+void ReplicaCacheDialog::onBrowse()
+{
+    QString filePath = QFileDialog::getSaveFileName(this, "Файл локальной копии", pathEdit->text(),
+                                                    "SQLite Files (*.sqlite *.db)", nullptr,
+                                                    QFileDialog::DontConfirmOverwrite);
+    if (!filePath.isEmpty()) {
+        pathEdit->setText(filePath);
+    }
+}
+
+void ReplicaCacheDialog::onOpenToggled()
+{
+    ReplicaCache *replica = DatabaseManager::instance().replicaCache();
+
+    if (replica->isOpen()) {
+        replica->close();
+    } else {
+        QString error;
+        if (!replica->open(pathEdit->text(), &error)) {
+            QMessageBox::critical(this, "Ошибка", "Не удалось открыть локальную копию: " + error);
+        }
+    }
+
+    updateControls();
+    onRefreshView();
+}
+
+void ReplicaCacheDialog::onStalenessChanged(int seconds)
+{
+    DatabaseManager::instance().replicaCache()->setMaxStalenessMs(seconds * 1000);
+}
+
+void ReplicaCacheDialog::onItemChanged(QTableWidgetItem *item)
+{
+    if (item->column() != 0) return;
+
+    ReplicaCache *replica = DatabaseManager::instance().replicaCache();
+    QString tableName = item->text();
+    bool mirror = item->checkState() == Qt::Checked;
+    if (mirror == replica->isMirrored(tableName)) return;
+
+    QString error;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool ok = mirror ? replica->mirrorTable(tableName, &error) : replica->removeTable(tableName, &error);
+    QApplication::restoreOverrideCursor();
+
+    if (!ok) {
+        QMessageBox::critical(this, "Ошибка", QString("Не удалось обновить таблицу %1: %2").arg(tableName, error));
+    }
+
+    QTimer::singleShot(0, this, &ReplicaCacheDialog::onRefreshView);
+}
+
+void ReplicaCacheDialog::onSync()
+{
+    QString error;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool ok = DatabaseManager::instance().replicaCache()->refresh(&error);
+    QApplication::restoreOverrideCursor();
+
+    if (!ok) {
+        QMessageBox::critical(this, "Ошибка синхронизации", error);
+    }
+
+    onRefreshView();
+}
+
+void ReplicaCacheDialog::onRefreshView()
+{
+    DatabaseManager &dm = DatabaseManager::instance();
+    ReplicaCache *replica = dm.replicaCache();
+
+    QStringList tables = serverTables;
+    for (const QString &tableName : replica->mirroredTables()) {
+        if (!tables.contains(tableName)) tables.append(tableName);
+    }
+    std::sort(tables.begin(), tables.end());
+
+    QHash<QString, ReplicaCache::TableState> states;
+    for (const auto &state : replica->tableStates()) {
+        states.insert(state.tableName, state);
+    }
+
+    QSignalBlocker blocker(tablesTable);
+    tablesTable->setRowCount(tables.size());
+
+    QDateTime now = QDateTime::currentDateTime();
+    for (int row = 0; row < tables.size(); ++row) {
+        const QString &tableName = tables[row];
+        bool mirrored = states.contains(tableName);
+        const ReplicaCache::TableState state = states.value(tableName);
+        QDateTime lastCurrent = state.stale || !state.checkedAt.isValid() ? state.syncedAt : state.checkedAt;
+
+        QTableWidgetItem *nameItem = new QTableWidgetItem(tableName);
+        nameItem->setFlags(Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
+        nameItem->setCheckState(mirrored ? Qt::Checked : Qt::Unchecked);
+        tablesTable->setItem(row, 0, nameItem);
+
+        QString status;
+        QColor color;
+        if (!mirrored) {
+            status = "не зеркалируется";
+        } else if (!dm.isConnected()) {
+            status = "нет связи с сервером";
+            color = QColor(255, 220, 150);
+        } else if (state.stale) {
+            status = "устарела";
+            color = QColor(255, 220, 150);
+        } else {
+            status = "актуальна";
+            color = QColor(200, 240, 200);
+        }
+
+        QStringList cells = {
+            mirrored ? QString::number(state.rowCount) : QString(),
+            mirrored ? state.syncedAt.toString("dd.MM.yyyy HH:mm:ss") : QString(),
+            mirrored && lastCurrent.isValid() ? formatLag(lastCurrent.secsTo(now)) : QString(),
+            status
+        };
+        for (int col = 0; col < cells.size(); ++col) {
+            QTableWidgetItem *item = new QTableWidgetItem(cells[col]);
+            item->setFlags(Qt::ItemIsEnabled);
+            if (color.isValid()) item->setBackground(color);
+            tablesTable->setItem(row, col + 1, item);
+        }
+    }
+
+    tablesTable->resizeColumnsToContents();
+}
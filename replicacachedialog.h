@@ -0,0 +1,41 @@
+#ifndef REPLICACACHEDIALOG_H
+#define REPLICACACHEDIALOG_H
+
+#include <QDialog>
+#include <QTableWidget>
+#include <QPushButton>
+#include <QLineEdit>
+#include <QSpinBox>
+#include <QVBoxLayout>
+#include <QTimer>
+
+class ReplicaCacheDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit ReplicaCacheDialog(QWidget *parent = nullptr);
+
+private slots:
+    void onBrowse();
+    void onOpenToggled();
+    void onStalenessChanged(int seconds);
+    void onItemChanged(QTableWidgetItem *item);
+    void onSync();
+    void onRefreshView();
+
+private:
+    void setupUI();
+    void updateControls();
+
+    QLineEdit *pathEdit;
+    QPushButton *browseButton;
+    QPushButton *openButton;
+    QSpinBox *stalenessSpin;
+    QTableWidget *tablesTable;
+    QPushButton *syncButton;
+    QTimer *refreshTimer;
+    QStringList serverTables;
+};
+
+#endif
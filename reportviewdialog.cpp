@@ -0,0 +1,140 @@
+#include "reportviewdialog.h"
+#include "reportviews.h"
+#include <QMessageBox>
+#include <QGridLayout>
+#include <QApplication>
+
+ReportViewDialog::ReportViewDialog(const QString &description, const QString &sql, QWidget *parent)
+    : QDialog(parent), description(description), sql(sql)
+{
+    setupUI();
+    updateState();
+
+    connect(&ReportViews::instance(), &ReportViews::changed, this, &ReportViewDialog::onStateChanged);
+}
+
+void ReportViewDialog::setupUI()
+{
+    setWindowTitle("Витрина: " + description);
+    setMinimumWidth(520);
+
+    ReportViews::State state = ReportViews::instance().state(sql);
+    bool materialized = ReportViews::instance().isMaterialized(sql);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    materializeCheck = new QCheckBox("Материализовать: выполнять запрос из материализованного представления", this);
+    materializeCheck->setChecked(materialized);
+    mainLayout->addWidget(materializeCheck);
+
+    QGridLayout *scheduleLayout = new QGridLayout();
+    scheduleLayout->addWidget(new QLabel("Обновлять каждые (с):", this), 0, 0);
+    intervalSpin = new QSpinBox(this);
+    intervalSpin->setRange(0, 7 * 86400);
+    intervalSpin->setSpecialValueText("не обновлять по времени");
+    intervalSpin->setValue(materialized ? state.schedule.intervalSec : 300);
+    scheduleLayout->addWidget(intervalSpin, 0, 1);
+
+    scheduleLayout->addWidget(new QLabel("Обновлять после изменений строк:", this), 1, 0);
+    changesSpin = new QSpinBox(this);
+    changesSpin->setRange(0, 1000000000);
+    changesSpin->setSpecialValueText("не отслеживать");
+    changesSpin->setValue(materialized ? int(qMin<qint64>(state.schedule.changeThreshold, changesSpin->maximum())) : 1000);
+    scheduleLayout->addWidget(changesSpin, 1, 1);
+    mainLayout->addLayout(scheduleLayout);
+
+    stateLabel = new QLabel(this);
+    stateLabel->setWordWrap(true);
+    mainLayout->addWidget(stateLabel);
+
+    QHBoxLayout *buttonsLayout = new QHBoxLayout();
+    refreshButton = new QPushButton("Обновить сейчас", this);
+    applyButton = new QPushButton("Применить", this);
+    QPushButton *closeButton = new QPushButton("Закрыть", this);
+    connect(refreshButton, &QPushButton::clicked, this, &ReportViewDialog::onRefreshNow);
+    connect(applyButton, &QPushButton::clicked, this, &ReportViewDialog::onApply);
+    connect(closeButton, &QPushButton::clicked, this, &QDialog::close);
+    buttonsLayout->addWidget(refreshButton);
+    buttonsLayout->addStretch();
+    buttonsLayout->addWidget(applyButton);
+    buttonsLayout->addWidget(closeButton);
+    mainLayout->addLayout(buttonsLayout);
+}
+
+void ReportViewDialog::updateState()
+{
+    ReportViews &reportViews = ReportViews::instance();
+    ReportViews::State state = reportViews.state(sql);
+    if (state.building) {
+        stateLabel->setText("Создаётся представление...");
+        refreshButton->setEnabled(false);
+        return;
+    }
+    if (!reportViews.isMaterialized(sql)) {
+        QString text = "Запрос выполняется по исходным таблицам.";
+        if (!state.lastError.isEmpty()) {
+            text += "\nНе удалось создать представление: " + state.lastError;
+        }
+        stateLabel->setText(text);
+        refreshButton->setEnabled(false);
+        return;
+    }
+
+    QStringList lines;
+    lines.append("Представление: " + state.viewName);
+    lines.append("Исходные таблицы: " + (state.sourceTables.isEmpty() ? QString("—") : state.sourceTables.join(", ")));
+    lines.append(state.keyColumns.isEmpty()
+                     ? QString("Обновление: полное, чтение на это время блокируется")
+                     : QString("Обновление: только изменённые строки (ключ: %1)").arg(state.keyColumns.join(", ")));
+    lines.append(state.refreshedAt.isValid()
+                     ? QString("Обновлено: %1 (%2 с назад)")
+                           .arg(state.refreshedAt.toLocalTime().toString("dd.MM.yyyy HH:mm:ss"))
+                           .arg(state.refreshedAt.secsTo(QDateTime::currentDateTimeUtc()))
+                     : QString("Время обновления неизвестно"));
+    lines.append(QString("Изменений строк с последнего обновления: %1").arg(state.pendingChanges));
+    if (state.refreshing) {
+        lines.append("Идёт обновление...");
+    }
+    if (!state.lastError.isEmpty()) {
+        lines.append("Ошибка последнего обновления: " + state.lastError);
+    }
+
+    stateLabel->setText(lines.join("\n"));
+    refreshButton->setEnabled(!state.refreshing);
+}
+
+void ReportViewDialog::onApply()
+{
+    ReportViews &reportViews = ReportViews::instance();
+    ReportViews::Schedule schedule;
+    schedule.intervalSec = intervalSpin->value();
+    schedule.changeThreshold = changesSpin->value();
+
+    QString error;
+    bool ok = true;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    if (materializeCheck->isChecked()) {
+        ok = reportViews.materialize(sql, schedule, &error);
+    } else if (reportViews.isMaterialized(sql)) {
+        ok = reportViews.dematerialize(sql, &error);
+    }
+    QApplication::restoreOverrideCursor();
+
+    if (!ok) {
+        QMessageBox::critical(this, "Ошибка", "Не удалось изменить витрину: " + error);
+    }
+    updateState();
+}
+
+void ReportViewDialog::onRefreshNow()
+{
+    ReportViews::instance().refresh(sql);
+    updateState();
+}
+
+void ReportViewDialog::onStateChanged(const QString &key)
+{
+    if (key == ReportViews::queryKey(sql)) {
+        updateState();
+    }
+}
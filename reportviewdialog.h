@@ -0,0 +1,37 @@
+#ifndef REPORTVIEWDIALOG_H
+#define REPORTVIEWDIALOG_H
+
+#include <QDialog>
+#include <QCheckBox>
+#include <QSpinBox>
+#include <QLabel>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+class ReportViewDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    ReportViewDialog(const QString &description, const QString &sql, QWidget *parent = nullptr);
+
+private slots:
+    void onApply();
+    void onRefreshNow();
+    void onStateChanged(const QString &key);
+
+private:
+    void setupUI();
+    void updateState();
+
+    QString description;
+    QString sql;
+    QCheckBox *materializeCheck;
+    QSpinBox *intervalSpin;
+    QSpinBox *changesSpin;
+    QLabel *stateLabel;
+    QPushButton *refreshButton;
+    QPushButton *applyButton;
+};
+
+#endif
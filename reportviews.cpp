@@ -0,0 +1,566 @@
+#include "reportviews.h"
+#include "databasemanager.h"
+#include "dbmetrics.h"
+#include "pgpipeline.h"
+#include "sqlparameters.h"
+#include "tracer.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QThreadPool>
+#include <QTimer>
+#include <algorithm>
+#include <utility>
+
+namespace {
+// How often change counters and schedules are checked.
+const int checkIntervalMs = qEnvironmentVariableIsSet("LIBRARY_REPORT_CHECK_MS")
+                                ? qMax(100, qEnvironmentVariableIntValue("LIBRARY_REPORT_CHECK_MS")) : 5000;
+const int retryDelaySec = 60;
+
+QString quoted(const QString &identifier)
+{
+    QString escaped = identifier;
+    escaped.replace("\"", "\"\"");
+    return "\"" + escaped + "\"";
+}
+
+QString literal(const QString &value)
+{
+    QString escaped = value;
+    escaped.replace("'", "''");
+    return "'" + escaped + "'";
+}
+
+QString queryBody(const QString &sql)
+{
+    QString body = sql.trimmed();
+    while (body.endsWith(';')) {
+        body.chop(1);
+        body = body.trimmed();
+    }
+    return body;
+}
+
+// Upper plan nodes print expressions computed below them in parentheses,
+// so "(count(*))" and "count(*)" are the same output.
+QString bareExpression(QString expression)
+{
+    expression = expression.trimmed();
+    while (expression.startsWith('(') && expression.endsWith(')')) {
+        int depth = 0;
+        bool wraps = true;
+        for (int i = 1; i < expression.size() - 1 && wraps; ++i) {
+            if (expression[i] == '(') ++depth;
+            else if (expression[i] == ')' && --depth < 0) wraps = false;
+        }
+        if (!wraps) break;
+        expression = expression.mid(1, expression.size() - 2).trimmed();
+    }
+    return expression;
+}
+
+int outputPosition(const QStringList &outputs, const QString &expression)
+{
+    QString bare = bareExpression(expression);
+    for (int i = 0; i < outputs.size(); ++i) {
+        if (bareExpression(outputs[i]) == bare) return i;
+    }
+    return -1;
+}
+
+// What the top of the plan tells about the query output, as positions in
+// the top node's output list: the columns that are unique together and the
+// sort keys with their direction. Only nodes that keep the order of their
+// input are walked (Limit, Sort, Unique, Gather Merge and a sorted
+// aggregate), and their keys are matched against that list by text.
+struct OutputShape {
+    QList<int> key;
+    QList<QPair<int, QString>> order;
+};
+
+bool analyzeOutput(const QSqlDatabase &connection, const QString &body, OutputShape *shape, QString *error)
+{
+    static const QRegularExpression sortKeyPattern(
+        "^(.*?)((?:\\s+(?:ASC|DESC|USING\\s+\\S+))?(?:\\s+NULLS\\s+(?:FIRST|LAST))?)$");
+
+    QSqlQuery query(connection);
+    if (!DbMetrics::exec(query, "EXPLAIN (VERBOSE, FORMAT JSON) " + body) || !query.next()) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+
+    QJsonObject node = QJsonDocument::fromJson(query.value(0).toString().toUtf8())
+                           .array().at(0).toObject()["Plan"].toObject();
+    QStringList outputs;
+    for (const auto &value : node["Output"].toArray()) {
+        outputs.append(value.toString());
+    }
+
+    bool keyFound = false;
+    bool orderFound = false;
+    while (!node.isEmpty()) {
+        QString type = node["Node Type"].toString();
+        bool passThrough = type == "Limit" || type == "Sort" || type == "Incremental Sort" ||
+                           type == "Unique" || type == "Gather Merge";
+
+        if (!orderFound && node.contains("Sort Key")) {
+            orderFound = true;
+            for (const auto &value : node["Sort Key"].toArray()) {
+                QRegularExpressionMatch match = sortKeyPattern.match(value.toString());
+                int position = outputPosition(outputs, match.captured(1));
+                if (position < 0) {
+                    shape->order.clear();
+                    break;
+                }
+                shape->order.append({position, match.captured(2).trimmed()});
+            }
+        }
+
+        if (!keyFound && type == "Unique") {
+            keyFound = true;
+            for (int i = 0; i < outputs.size(); ++i) shape->key.append(i);
+        } else if (!keyFound && type == "Aggregate") {
+            keyFound = true;
+            for (const auto &value : node["Group Key"].toArray()) {
+                int position = outputPosition(outputs, value.toString());
+                if (position < 0) {
+                    shape->key.clear();
+                    break;
+                }
+                shape->key.append(position);
+            }
+            passThrough = node["Strategy"].toString() == "Sorted";
+        }
+
+        if (!passThrough) break;
+        node = node["Plans"].toArray().at(0).toObject();
+    }
+    return true;
+}
+}
+
+ReportViews &ReportViews::instance()
+{
+    static ReportViews reportViews;
+    return reportViews;
+}
+
+ReportViews::ReportViews()
+    : timer(new QTimer(this))
+{
+    timer->setInterval(checkIntervalMs);
+    connect(timer, &QTimer::timeout, this, &ReportViews::onTick);
+}
+
+// Keyed by the exact statement: fingerprints replace literals, so reports
+// that differ only in a constant would share one view.
+QString ReportViews::queryKey(const QString &sql)
+{
+    QByteArray hash = QCryptographicHash::hash(queryBody(sql).toUtf8(), QCryptographicHash::Sha1);
+    return QString::fromLatin1(hash.toHex().left(16));
+}
+
+QString ReportViews::viewName(const QString &sql)
+{
+    return "report_" + queryKey(sql);
+}
+
+// An existing view of the same query is adopted as is; its last refresh
+// time is kept in the view comment. Building runs on its own connection in
+// the global thread pool, like a refresh, since CREATE MATERIALIZED VIEW
+// takes as long as the query.
+bool ReportViews::materialize(const QString &sql, const Schedule &schedule, QString *error)
+{
+    if (!SqlParameters::parse(sql).isEmpty()) {
+        if (error) *error = "Parameterized queries cannot be materialized";
+        return false;
+    }
+
+    QString key = queryKey(sql);
+    if (views.contains(key)) {
+        setSchedule(sql, schedule);
+        return true;
+    }
+    bool started = building.contains(key);
+    building.insert(key, schedule);
+    buildErrors.remove(key);
+    emit changed(key);
+    if (started) return true;
+
+    QString name = viewName(sql);
+    QString body = queryBody(sql);
+    QThreadPool::globalInstance()->start([this, key, name, body]() {
+        DbMetrics::Scope metricsScope(DbMetrics::MaterializeReport);
+        TraceSpan traceSpan("report", "materialize");
+        traceSpan.addArg("view", name);
+
+        QString connectionName = "library_" + name;
+        QString error;
+        View view;
+        bool ok = false;
+        {
+            QSqlDatabase connection = DatabaseManager::instance().openWorkerConnection(connectionName, &error);
+            if (connection.isOpen()) {
+                ok = buildView(connection, name, body, view, &error);
+            }
+        }
+        DatabaseManager::closeWorkerConnection(connectionName);
+
+        QMetaObject::invokeMethod(this, [this, key, ok, error, view]() {
+            finishMaterialize(key, ok, error, view);
+        }, Qt::QueuedConnection);
+    });
+    return true;
+}
+
+bool ReportViews::buildView(const QSqlDatabase &connection, const QString &name, const QString &body,
+                            View &view, QString *error)
+{
+    QSqlQuery query(connection);
+    QString existsStr = QString("SELECT to_regclass(%1) IS NOT NULL, obj_description(to_regclass(%1), 'pg_class')")
+                            .arg(literal(name));
+    if (!DbMetrics::exec(query, existsStr) || !query.next()) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+    bool exists = query.value(0).toBool();
+    view.refreshedAt = QDateTime::fromString(query.value(1).toString(), Qt::ISODateWithMs);
+
+    OutputShape shape;
+    if (!analyzeOutput(connection, body, &shape, error)) {
+        return false;
+    }
+
+    if (!exists) {
+        view.refreshedAt = QDateTime::currentDateTimeUtc();
+        PgPipeline pipeline(connection);
+        pipeline.add(QString("CREATE MATERIALIZED VIEW %1 AS %2").arg(name, body));
+        pipeline.add(QString("COMMENT ON MATERIALIZED VIEW %1 IS %2")
+                         .arg(name, literal(view.refreshedAt.toString(Qt::ISODateWithMs))));
+        if (!pipeline.run(error)) {
+            if (pipeline.failedIndex() > 0) {
+                DbMetrics::exec(query, QString("DROP MATERIALIZED VIEW IF EXISTS %1").arg(name));
+            }
+            return false;
+        }
+    }
+
+    PgPipeline pipeline(connection);
+    pipeline.add(QString(
+                     "SELECT attname FROM pg_attribute "
+                     "WHERE attrelid = %1::regclass AND attnum > 0 AND NOT attisdropped "
+                     "ORDER BY attnum"
+                     ).arg(literal(name)));
+    pipeline.add(QString(
+                     "SELECT DISTINCT c.relname FROM pg_rewrite r "
+                     "JOIN pg_depend d ON d.classid = 'pg_rewrite'::regclass AND d.objid = r.oid "
+                     "JOIN pg_class c ON c.oid = d.refobjid "
+                     "WHERE r.ev_class = %1::regclass AND c.oid <> r.ev_class AND c.relkind IN ('r', 'p')"
+                     ).arg(literal(name)));
+    pipeline.add(QString(
+                     "SELECT a.attname FROM pg_index i "
+                     "JOIN pg_attribute a ON a.attrelid = i.indrelid AND a.attnum = ANY (i.indkey) "
+                     "WHERE i.indexrelid = to_regclass(%1) AND i.indisunique "
+                     "ORDER BY array_position(i.indkey, a.attnum)"
+                     ).arg(literal(name + "_key")));
+    if (!pipeline.run(error)) {
+        return false;
+    }
+
+    for (const QVariantList &row : pipeline.result(0).rows) {
+        view.columns.append(row.value(0).toString());
+    }
+    for (const QVariantList &row : pipeline.result(1).rows) {
+        view.sourceTables.append(row.value(0).toString());
+    }
+    for (const QVariantList &row : pipeline.result(2).rows) {
+        view.keyColumns.append(row.value(0).toString());
+    }
+
+    QStringList order;
+    for (const auto &key : shape.order) {
+        if (key.first >= view.columns.size()) {
+            order.clear();
+            break;
+        }
+        order.append((quoted(view.columns[key.first]) + " " + key.second).trimmed());
+    }
+    view.orderBy = order.join(", ");
+
+    // Without a key the view is still usable, only refreshed without
+    // CONCURRENTLY; an index that cannot be built (the data already has
+    // duplicates) leaves it that way.
+    if (view.keyColumns.isEmpty() && !shape.key.isEmpty()
+        && std::all_of(shape.key.begin(), shape.key.end(), [&](int position) { return position < view.columns.size(); })) {
+        QStringList keyColumns;
+        for (int position : shape.key) {
+            keyColumns.append(view.columns[position]);
+        }
+        QStringList quotedColumns;
+        for (const QString &column : keyColumns) {
+            quotedColumns.append(quoted(column));
+        }
+        if (DbMetrics::exec(query, QString("CREATE UNIQUE INDEX %1_key ON %1 (%2)")
+                                       .arg(name, quotedColumns.join(", ")))) {
+            view.keyColumns = keyColumns;
+        }
+    }
+    return true;
+}
+
+void ReportViews::finishMaterialize(const QString &key, bool ok, const QString &error, View view)
+{
+    auto it = building.find(key);
+    if (it == building.end()) return;
+    view.schedule = *it;
+    building.erase(it);
+
+    if (!ok) {
+        buildErrors.insert(key, error);
+        emit changed(key);
+        emit materializeFailed(key, error);
+        return;
+    }
+
+    QHash<QString, qint64> counts;
+    if (changeCounts(view.sourceTables, counts, nullptr)) {
+        view.baseline = changeTotal(view, counts);
+    }
+
+    views.insert(key, view);
+    timer->start();
+    emit changed(key);
+}
+
+bool ReportViews::dematerialize(const QString &sql, QString *error)
+{
+    QString key = queryKey(sql);
+    if (building.contains(key)) {
+        if (error) *error = "The view is being created";
+        return false;
+    }
+    auto it = views.find(key);
+    if (it != views.end() && it->refreshing) {
+        if (error) *error = "The view is being refreshed";
+        return false;
+    }
+
+    QSqlQuery query(DatabaseManager::instance().getDatabase());
+    if (!DbMetrics::exec(query, QString("DROP MATERIALIZED VIEW IF EXISTS %1").arg(viewName(sql)))) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+
+    views.remove(key);
+    if (views.isEmpty()) timer->stop();
+    emit changed(key);
+    return true;
+}
+
+bool ReportViews::isMaterialized(const QString &sql) const
+{
+    return views.contains(queryKey(sql));
+}
+
+void ReportViews::setSchedule(const QString &sql, const Schedule &schedule)
+{
+    QString key = queryKey(sql);
+    auto it = views.find(key);
+    if (it == views.end()) return;
+    it->schedule = schedule;
+    emit changed(key);
+}
+
+ReportViews::State ReportViews::state(const QString &sql) const
+{
+    State state;
+    QString key = queryKey(sql);
+    auto it = views.constFind(key);
+    if (it == views.cend()) {
+        state.building = building.contains(key);
+        state.schedule = building.value(key);
+        state.lastError = buildErrors.value(key);
+        return state;
+    }
+
+    state.viewName = viewName(sql);
+    state.schedule = it->schedule;
+    state.sourceTables = it->sourceTables;
+    state.keyColumns = it->keyColumns;
+    state.refreshedAt = it->refreshedAt;
+    state.pendingChanges = it->pendingChanges;
+    state.refreshing = it->refreshing;
+    state.lastError = it->lastError;
+    return state;
+}
+
+QString ReportViews::readQuery(const QString &sql) const
+{
+    auto it = views.constFind(queryKey(sql));
+    if (it == views.cend()) return QString();
+
+    QStringList columns;
+    for (const QString &column : it->columns) {
+        columns.append(quoted(column));
+    }
+    QString queryStr = QString("SELECT %1 FROM %2").arg(columns.join(", "), viewName(sql));
+    if (!it->orderBy.isEmpty()) {
+        queryStr += " ORDER BY " + it->orderBy;
+    }
+    return queryStr;
+}
+
+void ReportViews::refresh(const QString &sql)
+{
+    QString key = queryKey(sql);
+    if (views.contains(key) && !views[key].refreshing) {
+        startRefresh(key);
+    }
+}
+
+// Sum of row changes per table, over all leaf partitions of partitioned
+// tables.
+bool ReportViews::changeCounts(const QStringList &tables, QHash<QString, qint64> &counts, QString *error)
+{
+    if (tables.isEmpty()) return true;
+
+    QStringList literals;
+    for (const QString &table : tables) {
+        literals.append(literal(table));
+    }
+
+    QString queryStr = QString(
+                           "SELECT c.relname, COALESCE(SUM(s.n_tup_ins + s.n_tup_upd + s.n_tup_del), 0)::bigint "
+                           "FROM pg_class c "
+                           "JOIN pg_namespace n ON n.oid = c.relnamespace "
+                           "CROSS JOIN LATERAL pg_partition_tree(c.oid) t "
+                           "LEFT JOIN pg_stat_user_tables s ON s.relid = t.relid "
+                           "WHERE n.nspname = %1 AND c.relname IN (%2) "
+                           "GROUP BY c.relname"
+                           ).arg(literal(DatabaseManager::instance().connectionSettings().schemaName),
+                                literals.join(", "));
+
+    QSqlQuery query(DatabaseManager::instance().getDatabase());
+    if (!DbMetrics::exec(query, queryStr)) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+
+    while (query.next()) {
+        counts.insert(query.value(0).toString(), query.value(1).toLongLong());
+    }
+    return true;
+}
+
+qint64 ReportViews::changeTotal(const View &view, const QHash<QString, qint64> &counts)
+{
+    qint64 total = 0;
+    for (const QString &table : view.sourceTables) {
+        total += counts.value(table);
+    }
+    return total;
+}
+
+void ReportViews::onTick()
+{
+    if (views.isEmpty() || !DatabaseManager::instance().isConnected()) return;
+
+    QStringList tables;
+    for (const View &view : std::as_const(views)) {
+        for (const QString &table : view.sourceTables) {
+            if (!tables.contains(table)) tables.append(table);
+        }
+    }
+
+    QHash<QString, qint64> counts;
+    bool haveCounts = changeCounts(tables, counts, nullptr);
+    QDateTime now = QDateTime::currentDateTimeUtc();
+
+    for (auto it = views.begin(); it != views.end(); ++it) {
+        View &view = *it;
+
+        if (haveCounts) {
+            qint64 total = changeTotal(view, counts);
+            // Counters go back after a statistics reset.
+            if (view.baseline < 0 || total < view.baseline) view.baseline = total;
+            if (total - view.baseline != view.pendingChanges) {
+                view.pendingChanges = total - view.baseline;
+                emit changed(it.key());
+            }
+        }
+
+        if (view.refreshing) continue;
+        if (view.failedAt.isValid() && view.failedAt.secsTo(now) < retryDelaySec) continue;
+
+        bool due = (view.schedule.intervalSec > 0
+                    && (!view.refreshedAt.isValid() || view.refreshedAt.secsTo(now) >= view.schedule.intervalSec))
+                   || (view.schedule.changeThreshold > 0 && view.pendingChanges >= view.schedule.changeThreshold);
+        if (due) startRefresh(it.key());
+    }
+}
+
+// The refresh runs on its own connection in the global thread pool; the
+// result is applied on the thread that owns this object.
+void ReportViews::startRefresh(const QString &key)
+{
+    View &view = views[key];
+    view.refreshing = true;
+    qint64 baseline = view.baseline < 0 ? -1 : view.baseline + view.pendingChanges;
+    QString name = "report_" + key;
+    bool concurrently = !view.keyColumns.isEmpty();
+    emit changed(key);
+
+    QThreadPool::globalInstance()->start([this, key, name, baseline, concurrently]() {
+        DbMetrics::Scope metricsScope(DbMetrics::RefreshReport);
+        TraceSpan traceSpan("report", "refresh");
+        traceSpan.addArg("view", name);
+
+        QString connectionName = "library_" + name;
+        QDateTime refreshedAt = QDateTime::currentDateTimeUtc();
+        QString error;
+        bool ok = false;
+        {
+            QSqlDatabase connection = DatabaseManager::instance().openWorkerConnection(connectionName, &error);
+            if (connection.isOpen()) {
+                QSqlQuery query(connection);
+                ok = DbMetrics::exec(query, QString("REFRESH MATERIALIZED VIEW %1%2")
+                                                .arg(concurrently ? "CONCURRENTLY " : "", name));
+                if (ok) {
+                    DbMetrics::exec(query, QString("COMMENT ON MATERIALIZED VIEW %1 IS %2")
+                                               .arg(name, literal(refreshedAt.toString(Qt::ISODateWithMs))));
+                } else {
+                    error = query.lastError().text();
+                }
+            }
+        }
+        DatabaseManager::closeWorkerConnection(connectionName);
+
+        QMetaObject::invokeMethod(this, [this, key, ok, error, refreshedAt, baseline]() {
+            finishRefresh(key, ok, error, refreshedAt, baseline);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ReportViews::finishRefresh(const QString &key, bool ok, const QString &error,
+                                const QDateTime &refreshedAt, qint64 baseline)
+{
+    auto it = views.find(key);
+    if (it == views.end()) return;
+
+    it->refreshing = false;
+    it->lastError = error;
+    it->failedAt = ok ? QDateTime() : QDateTime::currentDateTimeUtc();
+    if (ok) {
+        it->refreshedAt = refreshedAt;
+        if (baseline >= 0) {
+            it->pendingChanges = qMax<qint64>(0, it->baseline + it->pendingChanges - baseline);
+            it->baseline = baseline;
+        }
+    }
+    emit changed(key);
+}
@@ -0,0 +1,101 @@
+#ifndef REPORTVIEWS_H
+#define REPORTVIEWS_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QStringList>
+
+class QTimer;
+class QSqlDatabase;
+
+// Saved queries served from materialized views. When the plan shows which
+// output columns are unique together (the GROUP BY or DISTINCT key), the
+// view gets a unique index on them and is refreshed CONCURRENTLY, so only
+// changed rows are rewritten and readers keep the old contents meanwhile;
+// other views are rebuilt by a plain refresh, which blocks readers. Views
+// are keyed by a hash of the query text, built and refreshed on worker
+// connections, periodically or once their source tables have seen enough
+// inserts, updates and deletes.
+class ReportViews : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Zero disables the respective trigger.
+    struct Schedule {
+        int intervalSec = 0;
+        qint64 changeThreshold = 0;
+    };
+
+    struct State {
+        QString viewName;
+        Schedule schedule;
+        QStringList sourceTables;
+        // Empty when the view has no unique key and is refreshed in full.
+        QStringList keyColumns;
+        QDateTime refreshedAt;
+        qint64 pendingChanges = 0;
+        bool refreshing = false;
+        bool building = false;
+        QString lastError;
+    };
+
+    static ReportViews &instance();
+    static QString queryKey(const QString &sql);
+    static QString viewName(const QString &sql);
+
+    // Starts building the view and returns; the outcome is reported through
+    // changed() and, on failure, materializeFailed(). Only errors found
+    // before anything is sent to the server are returned here.
+    bool materialize(const QString &sql, const Schedule &schedule, QString *error = nullptr);
+    bool dematerialize(const QString &sql, QString *error = nullptr);
+    bool isMaterialized(const QString &sql) const;
+    void setSchedule(const QString &sql, const Schedule &schedule);
+    State state(const QString &sql) const;
+
+    // SELECT over the view returning the original columns, in the original
+    // row order when the plan's sort keys are output columns; empty when the
+    // query is not materialized.
+    QString readQuery(const QString &sql) const;
+    void refresh(const QString &sql);
+
+signals:
+    void changed(const QString &key);
+    void materializeFailed(const QString &key, const QString &error);
+
+private slots:
+    void onTick();
+
+private:
+    struct View {
+        QStringList columns;
+        QStringList keyColumns;
+        QString orderBy;
+        QStringList sourceTables;
+        Schedule schedule;
+        QDateTime refreshedAt;
+        QDateTime failedAt;
+        qint64 baseline = -1;
+        qint64 pendingChanges = 0;
+        bool refreshing = false;
+        QString lastError;
+    };
+
+    ReportViews();
+    bool changeCounts(const QStringList &tables, QHash<QString, qint64> &counts, QString *error);
+    static qint64 changeTotal(const View &view, const QHash<QString, qint64> &counts);
+    static bool buildView(const QSqlDatabase &connection, const QString &name, const QString &body,
+                          View &view, QString *error);
+    void finishMaterialize(const QString &key, bool ok, const QString &error, View view);
+    void startRefresh(const QString &key);
+    void finishRefresh(const QString &key, bool ok, const QString &error,
+                       const QDateTime &refreshedAt, qint64 baseline);
+
+    QHash<QString, View> views;
+    QHash<QString, Schedule> building;
+    QHash<QString, QString> buildErrors;
+    QTimer *timer;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "sqlparameters.h"
+#include <QRegularExpression>
+
+namespace {
+bool isNameStart(QChar c)
+{
+    return c.isLetter() || c == '_';
+}
+
+bool isNameChar(QChar c)
+{
+    return c.isLetterOrNumber() || c == '_';
+}
+
+// End of the quoted literal starting at i; E'' strings allow backslash
+// escapes.
+int literalEnd(const QString &sql, int i, bool backslashEscapes)
+{
+    const int n = sql.size();
+    for (int end = i + 1; end < n; ++end) {
+        if (backslashEscapes && sql[end] == '\\') {
+            ++end;
+            continue;
+        }
+        if (sql[end] != '\'') continue;
+        if (end + 1 < n && sql[end + 1] == '\'') {
+            ++end;
+            continue;
+        }
+        return end + 1;
+    }
+    return n;
+}
+
+int blockCommentEnd(const QString &sql, int i)
+{
+    const int n = sql.size();
+    int depth = 1;
+    int end = i + 2;
+    while (end < n && depth > 0) {
+        if (sql[end] == '*' && end + 1 < n && sql[end + 1] == '/') {
+            --depth;
+            end += 2;
+        } else if (sql[end] == '/' && end + 1 < n && sql[end + 1] == '*') {
+            ++depth;
+            end += 2;
+        } else {
+            ++end;
+        }
+    }
+    return end;
+}
+}
+
+SqlParameters SqlParameters::parse(const QString &sql)
+{
+    static const QRegularExpression dollarTag("\\$(?:[A-Za-z_][A-Za-z0-9_]*)?\\$");
+    static const QRegularExpression castType("\\s*::\\s*([A-Za-z_][A-Za-z0-9_]*)");
+
+    SqlParameters result;
+    QString &out = result.positional;
+    out.reserve(sql.size());
+
+    const int n = sql.size();
+    int i = 0;
+    while (i < n) {
+        QChar c = sql[i];
+        QChar next = i + 1 < n ? sql[i + 1] : QChar();
+        bool afterName = i > 0 && isNameChar(sql[i - 1]);
+        int end = i + 1;
+
+        if (c == '\'') {
+            bool escapes = i > 0 && (sql[i - 1] == 'E' || sql[i - 1] == 'e')
+                           && (i == 1 || !isNameChar(sql[i - 2]));
+            end = literalEnd(sql, i, escapes);
+        } else if (c == '"') {
+            end = sql.indexOf('"', i + 1);
+            end = end < 0 ? n : end + 1;
+        } else if (c == '-' && next == '-') {
+            end = sql.indexOf('\n', i);
+            end = end < 0 ? n : end;
+        } else if (c == '/' && next == '*') {
+            end = blockCommentEnd(sql, i);
+        } else if (c == '$' && !afterName) {
+            auto match = dollarTag.match(sql, i, QRegularExpression::NormalMatch,
+                                         QRegularExpression::AnchorAtOffsetMatchOption);
+            if (match.hasMatch()) {
+                int close = sql.indexOf(match.captured(0), match.capturedEnd());
+                end = close < 0 ? n : close + match.capturedLength();
+            }
+        } else if (c == ':' && next == ':') {
+            end = i + 2;
+        } else if (c == ':' && isNameStart(next) && !afterName) {
+            end = i + 2;
+            while (end < n && isNameChar(sql[end])) ++end;
+            QString name = sql.mid(i + 1, end - i - 1);
+
+            int index = 0;
+            while (index < result.params.size() && result.params[index].name != name) ++index;
+            if (index == result.params.size()) {
+                result.params.append({name, QString()});
+            }
+
+            auto cast = castType.match(sql, end, QRegularExpression::NormalMatch,
+                                       QRegularExpression::AnchorAtOffsetMatchOption);
+            if (cast.hasMatch() && result.params[index].type.isEmpty()) {
+                result.params[index].type = cast.captured(1).toLower();
+            }
+
+            out += '$' + QString::number(index + 1);
+            i = end;
+            continue;
+        }
+
+        out += QStringView(sql).mid(i, end - i);
+        i = end;
+    }
+
+    for (Parameter &param : result.params) {
+        if (param.type.isEmpty()) param.type = "text";
+    }
+    return result;
+}
+
+// Missing values are bound as NULL.
+QVariantList SqlParameters::bind(const QVariantMap &values) const
+{
+    QVariantList bound;
+    for (const Parameter &param : params) {
+        bound.append(values.value(param.name));
+    }
+    return bound;
+}
@@ -0,0 +1,34 @@
+#ifndef SQLPARAMETERS_H
+#define SQLPARAMETERS_H
+
+#include <QList>
+#include <QString>
+#include <QVariantList>
+#include <QVariantMap>
+
+// Named parameters in saved queries: ":year" or ":pattern". A cast right
+// after the name (":year::integer") also gives the parameter its type;
+// without one it is text. parse() rewrites the names to $1, $2, ... in
+// order of first use, skipping literals, quoted identifiers, comments and
+// "::" casts.
+class SqlParameters
+{
+public:
+    struct Parameter {
+        QString name;
+        QString type;
+    };
+
+    static SqlParameters parse(const QString &sql);
+
+    bool isEmpty() const { return params.isEmpty(); }
+    const QList<Parameter> &parameters() const { return params; }
+    QString positionalSql() const { return positional; }
+    QVariantList bind(const QVariantMap &values) const;
+
+private:
+    QList<Parameter> params;
+    QString positional;
+};
+
+#endif
@@ -0,0 +1,321 @@
+#include "sqlscriptreader.h"
+#include <algorithm>
+
+namespace {
+const qint64 readChunkBytes = 256 * 1024;
+const qsizetype copyChunkBytes = 1 << 20;
+const qsizetype maxDollarTagBytes = 64;
+
+bool isIdentStart(uchar c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80;
+}
+
+bool isIdentChar(uchar c)
+{
+    return isIdentStart(c) || (c >= '0' && c <= '9') || c == '$';
+}
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f';
+}
+
+bool isCopyTerminator(QByteArrayView line)
+{
+    return line == "\\." || line == "\\.\r";
+}
+
+bool isCopyFromStdin(const QByteArray &sql)
+{
+    if (!sql.left(4).toUpper().startsWith("COPY") || sql.size() < 5 || !isSpace(sql[4])) return false;
+    QByteArray upper = sql.simplified().toUpper();
+    return upper.contains(" FROM STDIN");
+}
+}
+
+SqlScriptReader::SqlScriptReader(QIODevice *device)
+    : device(device)
+{
+}
+
+bool SqlScriptReader::ensure(qsizetype bytes)
+{
+    while (buffer.size() - pos < bytes) {
+        if (eof) return false;
+
+        buffer.remove(0, pos);
+        consumed += pos;
+        pos = 0;
+
+        QByteArray chunk = device->read(readChunkBytes);
+        if (chunk.isEmpty() && (device->atEnd() || !device->waitForReadyRead(-1))) {
+            eof = true;
+            return false;
+        }
+        buffer.append(chunk);
+    }
+    return true;
+}
+
+void SqlScriptReader::skipLine()
+{
+    while (ensure(1)) {
+        qsizetype end = buffer.indexOf('\n', pos);
+        if (end >= 0) {
+            pos = end + 1;
+            ++line;
+            return;
+        }
+        pos = buffer.size();
+    }
+}
+
+// Length of the $tag$ starting at pos, or 0 if '$' does not open one
+// (e.g. a $1 parameter).
+qsizetype SqlScriptReader::dollarTag() const
+{
+    qsizetype i = pos + 1;
+    if (i < buffer.size() && buffer[i] != '$') {
+        if (!isIdentStart(uchar(buffer[i]))) return 0;
+        ++i;
+        while (i < buffer.size() && buffer[i] != '$' && isIdentChar(uchar(buffer[i]))) ++i;
+    }
+    if (i < buffer.size() && buffer[i] == '$') return i + 1 - pos;
+    return 0;
+}
+
+bool SqlScriptReader::readQuoted(char quote, bool backslashEscapes, QByteArray &sql)
+{
+    qint64 startLine = line;
+    sql.append(quote);
+    ++pos;
+
+    while (true) {
+        if (!ensure(1)) {
+            error = quote == '"' ? QString("Unterminated quoted identifier starting at line %1").arg(startLine)
+                                 : QString("Unterminated string literal starting at line %1").arg(startLine);
+            return false;
+        }
+
+        // Copy everything up to the next quote (or backslash) in one go.
+        const char *begin = buffer.constData() + pos;
+        const char *end = buffer.constData() + buffer.size();
+        const char *stop = backslashEscapes
+            ? std::find_if(begin, end, [quote](char c) { return c == quote || c == '\\'; })
+            : std::find(begin, end, quote);
+        line += std::count(begin, stop, '\n');
+        sql.append(begin, stop - begin);
+        pos += stop - begin;
+        if (stop == end) continue;
+
+        if (*stop == '\\') {
+            if (ensure(2)) {
+                if (buffer[pos + 1] == '\n') ++line;
+                sql.append(buffer.constData() + pos, 2);
+                pos += 2;
+            } else {
+                sql.append('\\');
+                ++pos;
+            }
+            continue;
+        }
+
+        if (ensure(2) && buffer[pos + 1] == quote) {
+            sql.append(quote).append(quote);
+            pos += 2;
+            continue;
+        }
+        sql.append(quote);
+        ++pos;
+        return true;
+    }
+}
+
+bool SqlScriptReader::readDollarQuoted(qsizetype tagLength, QByteArray &sql)
+{
+    qint64 startLine = line;
+    QByteArray tag = buffer.mid(pos, tagLength);
+    sql.append(tag);
+    pos += tagLength;
+
+    while (true) {
+        qsizetype found = buffer.indexOf(tag, pos);
+        qsizetype end = found >= 0 ? found + tagLength : std::max(pos, buffer.size() - tagLength + 1);
+        line += std::count(buffer.constData() + pos, buffer.constData() + end, '\n');
+        sql.append(buffer.constData() + pos, end - pos);
+        pos = end;
+        if (found >= 0) return true;
+
+        // Keep a possible partial closing tag and read more.
+        if (!ensure(buffer.size() - pos + 1)) {
+            error = QString("Unterminated dollar-quoted string starting at line %1").arg(startLine);
+            return false;
+        }
+    }
+}
+
+bool SqlScriptReader::skipBlockComment()
+{
+    qint64 startLine = line;
+    int depth = 1;
+    pos += 2;
+
+    while (depth > 0) {
+        if (!ensure(1)) {
+            error = QString("Unterminated comment starting at line %1").arg(startLine);
+            return false;
+        }
+        char c = buffer[pos];
+        if (c == '*' && ensure(2) && buffer[pos + 1] == '/') {
+            --depth;
+            pos += 2;
+        } else if (c == '/' && ensure(2) && buffer[pos + 1] == '*') {
+            ++depth;
+            pos += 2;
+        } else {
+            if (c == '\n') ++line;
+            ++pos;
+        }
+    }
+    return true;
+}
+
+bool SqlScriptReader::readStatement(Statement &statement)
+{
+    statement = Statement();
+    if (hasError()) return false;
+
+    // Data the caller did not consume is skipped, never parsed as SQL.
+    QByteArray skipped;
+    while (readCopyData(skipped)) {
+    }
+
+    if (!started) {
+        started = true;
+        if (ensure(3) && buffer.mid(pos, 3) == "\xEF\xBB\xBF") pos += 3;
+    }
+
+    QByteArray &sql = statement.sql;
+    while (true) {
+        if (!ensure(1)) break;
+        char c = buffer[pos];
+
+        if (sql.isEmpty()) {
+            if (isSpace(c)) {
+                if (c == '\n') ++line;
+                ++pos;
+                continue;
+            }
+            if (c == '\\') {
+                skipLine();
+                continue;
+            }
+            statement.line = line;
+        }
+
+        if (c == ';') {
+            ++pos;
+            sql = sql.trimmed();
+            if (sql.isEmpty()) continue;
+            break;
+        }
+
+        if (c == '\'') {
+            bool escapes = !sql.isEmpty() && (sql.back() == 'E' || sql.back() == 'e')
+                           && (sql.size() == 1 || !isIdentChar(uchar(sql[sql.size() - 2])));
+            if (!readQuoted('\'', escapes, sql)) return false;
+            continue;
+        }
+        if (c == '"') {
+            if (!readQuoted('"', false, sql)) return false;
+            continue;
+        }
+        if (c == '-' && ensure(2) && buffer[pos + 1] == '-') {
+            qsizetype end;
+            while ((end = buffer.indexOf('\n', pos)) < 0) {
+                pos = buffer.size();
+                if (!ensure(1)) break;
+            }
+            if (end >= 0) pos = end;
+            continue;
+        }
+        if (c == '/' && ensure(2) && buffer[pos + 1] == '*') {
+            if (!skipBlockComment()) return false;
+            if (!sql.isEmpty()) sql.append(' ');
+            continue;
+        }
+        if (c == '$' && (sql.isEmpty() || !isIdentChar(uchar(sql.back())))) {
+            ensure(maxDollarTagBytes);
+            qsizetype tagLength = dollarTag();
+            if (tagLength > 0) {
+                if (!readDollarQuoted(tagLength, sql)) return false;
+                continue;
+            }
+        }
+
+        if (c == '\n') ++line;
+        sql.append(c);
+        ++pos;
+    }
+
+    sql = sql.trimmed();
+    if (sql.isEmpty()) return false;
+
+    if (isCopyFromStdin(sql)) {
+        statement.copyFromStdin = true;
+        inCopy = true;
+        skipLine();
+    }
+    return true;
+}
+
+bool SqlScriptReader::readCopyData(QByteArray &data)
+{
+    data.clear();
+
+    while (inCopy && data.size() < copyChunkBytes) {
+        // A dump cut off inside the data must not load as a shorter table.
+        if (!ensure(1)) {
+            error = QString("Unexpected end of file in COPY data (line %1)").arg(line);
+            inCopy = false;
+            break;
+        }
+
+        // Take all complete lines in the buffer up to the terminator.
+        qsizetype runStart = pos;
+        qsizetype scan = pos;
+        bool terminated = false;
+        while (data.size() + (scan - runStart) < copyChunkBytes) {
+            qsizetype end = buffer.indexOf('\n', scan);
+            if (end < 0) break;
+            ++line;
+            if (isCopyTerminator(QByteArrayView(buffer.constData() + scan, end - scan))) {
+                terminated = true;
+                data.append(buffer.constData() + runStart, scan - runStart);
+                pos = end + 1;
+                break;
+            }
+            scan = end + 1;
+        }
+        if (terminated) {
+            inCopy = false;
+            break;
+        }
+
+        data.append(buffer.constData() + runStart, scan - runStart);
+        pos = scan;
+
+        if (scan == runStart && !ensure(buffer.size() - pos + 1)) {
+            // Last line without a newline; only the terminator may end there.
+            QByteArrayView rest(buffer.constData() + pos, buffer.size() - pos);
+            if (!isCopyTerminator(rest)) {
+                error = QString("Unexpected end of file in COPY data (line %1)").arg(line);
+            }
+            pos = buffer.size();
+            inCopy = false;
+        }
+    }
+
+    return !data.isEmpty();
+}
@@ -0,0 +1,50 @@
+#ifndef SQLSCRIPTREADER_H
+#define SQLSCRIPTREADER_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QString>
+
+// Splits a SQL script into statements while streaming it from a device.
+// Semicolons inside string literals, quoted identifiers, dollar-quoted
+// bodies and comments do not end a statement. After a COPY ... FROM stdin
+// statement the following data section is returned by readCopyData() in
+// bounded chunks, up to the terminating "\." line. psql meta-commands
+// (lines starting with a backslash) are skipped.
+class SqlScriptReader
+{
+public:
+    struct Statement {
+        QByteArray sql;
+        qint64 line = 0;
+        bool copyFromStdin = false;
+    };
+
+    explicit SqlScriptReader(QIODevice *device);
+
+    bool readStatement(Statement &statement);
+    bool readCopyData(QByteArray &data);
+    qint64 bytesRead() const { return consumed + pos; }
+    bool hasError() const { return !error.isEmpty(); }
+    QString errorString() const { return error; }
+
+private:
+    bool ensure(qsizetype bytes);
+    void skipLine();
+    qsizetype dollarTag() const;
+    bool readQuoted(char quote, bool backslashEscapes, QByteArray &sql);
+    bool readDollarQuoted(qsizetype tagLength, QByteArray &sql);
+    bool skipBlockComment();
+
+    QIODevice *device;
+    QByteArray buffer;
+    qsizetype pos = 0;
+    qint64 consumed = 0;
+    bool eof = false;
+    bool started = false;
+    bool inCopy = false;
+    qint64 line = 1;
+    QString error;
+};
+
+#endif
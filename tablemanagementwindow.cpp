@@ -1,10 +1,60 @@
 #include "tablemanagementwindow.h"
 #include "addtabledialog.h"
+#include "dbmetrics.h"
+#include "tracer.h"
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QJsonDocument>
 #include <QHeaderView>
 #include <QInputDialog>
+#include <QProgressDialog>
+#include <QCoreApplication>
+#include <QLocale>
+
+namespace {
+const int pageRows = 1000;
+const qint64 fullLoadMaxBytes = 64 << 20;
+
+// Tables estimated above this many rows are opened page by page.
+const double fullLoadMaxRows = qEnvironmentVariableIsSet("LIBRARY_FULL_LOAD_MAX_ROWS")
+                                   ? qEnvironmentVariable("LIBRARY_FULL_LOAD_MAX_ROWS").toDouble() : 50000;
+
+// Range partitions are kept this many intervals ahead of today.
+const int partitionPremake = qEnvironmentVariableIsSet("LIBRARY_PARTITION_PREMAKE")
+                                 ? qEnvironmentVariableIntValue("LIBRARY_PARTITION_PREMAKE") : 3;
+
+QString formatSize(qint64 bytes)
+{
+    return QLocale::system().formattedDataSize(bytes, 1, QLocale::DataSizeTraditionalFormat);
+}
+
+QString formatRows(double rows)
+{
+    return rows < 0 ? QString("н/д") : QLocale::system().toString(qint64(rows));
+}
+
+QString formatTime(const QDateTime &time)
+{
+    return time.isValid() ? time.toLocalTime().toString("dd.MM.yyyy HH:mm") : QString("никогда");
+}
+
+// Shows formatted text but sorts by the raw value.
+class NumericItem : public QTableWidgetItem
+{
+public:
+    NumericItem(const QString &text, double value)
+        : QTableWidgetItem(text)
+    {
+        setData(Qt::UserRole, value);
+        setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    }
+
+    bool operator<(const QTableWidgetItem &other) const override
+    {
+        return data(Qt::UserRole).toDouble() < other.data(Qt::UserRole).toDouble();
+    }
+};
+}
 
 CollapsibleTableWidget::CollapsibleTableWidget(const QString &tableName, QWidget *parent)
     : QWidget(parent), tableName(tableName), isCollapsed(true)
@@ -23,7 +73,7 @@ void CollapsibleTableWidget::setupUI()
     selectCheckBox = new QCheckBox(this);
     headerLayout->addWidget(selectCheckBox);
 
-    headerButton = new QPushButton(tableName + " ▼", this);
+    headerButton = new QPushButton(headerTitle() + " ▼", this);
     headerButton->setMinimumHeight(40);
     headerButton->setStyleSheet("QPushButton { text-align: left; padding-left: 10px; font-size: 13px; }");
     connect(headerButton, &QPushButton::clicked, this, &CollapsibleTableWidget::toggleCollapse);
@@ -61,9 +111,48 @@ void CollapsibleTableWidget::setupUI()
             this, &CollapsibleTableWidget::onHeaderDoubleClicked);
     contentLayout->addWidget(tableWidget);
 
+    QHBoxLayout *pageLayout = new QHBoxLayout();
+    pageLabel = new QLabel(this);
+    loadMoreButton = new QPushButton(QString("Загрузить ещё %1").arg(pageRows), this);
+    connect(loadMoreButton, &QPushButton::clicked, this, &CollapsibleTableWidget::onLoadMore);
+    pageLayout->addWidget(pageLabel);
+    pageLayout->addStretch();
+    pageLayout->addWidget(loadMoreButton);
+    contentLayout->addLayout(pageLayout);
+    pageLabel->hide();
+    loadMoreButton->hide();
+
+    QHBoxLayout *stateLayout = new QHBoxLayout();
     saveStateButton = new QPushButton("Сохранить состояние таблицы", this);
     connect(saveStateButton, &QPushButton::clicked, this, &CollapsibleTableWidget::onSaveTableState);
-    contentLayout->addWidget(saveStateButton);
+    stateLayout->addWidget(saveStateButton, 1);
+
+    importCsvButton = new QPushButton("Импорт CSV", this);
+    connect(importCsvButton, &QPushButton::clicked, this, &CollapsibleTableWidget::onImportCsv);
+    stateLayout->addWidget(importCsvButton);
+    contentLayout->addLayout(stateLayout);
+
+    QHBoxLayout *indexButtonsLayout = new QHBoxLayout();
+    indexButtonsLayout->addWidget(new QLabel("Индексы:", this));
+    createIndexButton = new QPushButton("Создать индекс", this);
+    dropIndexButton = new QPushButton("Удалить индекс", this);
+    connect(createIndexButton, &QPushButton::clicked, this, &CollapsibleTableWidget::onCreateIndex);
+    connect(dropIndexButton, &QPushButton::clicked, this, &CollapsibleTableWidget::onDropIndex);
+    indexButtonsLayout->addWidget(createIndexButton);
+    indexButtonsLayout->addWidget(dropIndexButton);
+    indexButtonsLayout->addStretch();
+    contentLayout->addLayout(indexButtonsLayout);
+
+    indexesTable = new QTableWidget(this);
+    indexesTable->setColumnCount(9);
+    indexesTable->setHorizontalHeaderLabels({"Имя", "Метод", "Столбцы", "INCLUDE", "Условие",
+                                             "Размер", "Сканирований", "Прочитано строк", "Состояние"});
+    indexesTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    indexesTable->setSelectionMode(QAbstractItemView::SingleSelection);
+    indexesTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    indexesTable->horizontalHeader()->setStretchLastSection(true);
+    indexesTable->setMinimumHeight(120);
+    contentLayout->addWidget(indexesTable);
 
     mainLayout->addWidget(contentWidget);
     contentWidget->hide();
@@ -91,23 +180,56 @@ void CollapsibleTableWidget::toggleCollapse()
 
     if (isCollapsed) {
         contentWidget->hide();
-        headerButton->setText(tableName + " ▼");
+        headerButton->setText(headerTitle() + " ▼");
     } else {
         loadTableData();
+        loadIndexes();
         contentWidget->show();
-        headerButton->setText(tableName + " ▲");
+        headerButton->setText(headerTitle() + " ▲");
     }
 }
 
+void CollapsibleTableWidget::setStats(const DatabaseManager::TableStats &tableStats)
+{
+    stats = tableStats;
+    hasStats = true;
+    headerButton->setText(headerTitle() + (isCollapsed ? " ▼" : " ▲"));
+    headerButton->setToolTip(QString("Данные: %1, индексы: %2, TOAST: %3")
+                                 .arg(formatSize(stats.heapBytes), formatSize(stats.indexBytes),
+                                      formatSize(stats.toastBytes)));
+}
+
+QString CollapsibleTableWidget::headerTitle() const
+{
+    if (!hasStats) return tableName;
+    return QString("%1   (~%2 строк, %3)").arg(tableName, formatRows(stats.estimatedRows), formatSize(stats.totalBytes));
+}
+
+// Without an estimate (never analyzed) the heap size decides.
+bool CollapsibleTableWidget::shouldPage() const
+{
+    if (!hasStats) return false;
+    if (stats.estimatedRows >= 0) return stats.estimatedRows > fullLoadMaxRows;
+    return stats.heapBytes > fullLoadMaxBytes;
+}
+
 void CollapsibleTableWidget::loadTableData()
 {
+    TraceSpan traceSpan("ui", "CollapsibleTableWidget::loadTableData");
+    traceSpan.addArg("table", tableName);
+    DbMetrics::Scope metricsScope(DbMetrics::WidgetPopulation);
     tableWidget->blockSignals(true);
 
     columns = DatabaseManager::instance().getTableColumns(tableName);
-    auto data = DatabaseManager::instance().getTableData(tableName);
+    paged = shouldPage();
+    traceSpan.addArg("paged", paged);
+    pageCursor = DatabaseManager::TablePageCursor();
+    QString error;
+    auto data = paged ? DatabaseManager::instance().getTableDataPage(tableName, pageRows, &pageCursor, &error)
+                      : DatabaseManager::instance().getTableData(tableName);
 
     tableWidget->clear();
-    tableWidget->setRowCount(data.size());
+    tableWidget->setRowCount(0);
     tableWidget->setColumnCount(columns.size());
 
     QStringList headers;
@@ -120,6 +242,22 @@ void CollapsibleTableWidget::loadTableData()
     }
     tableWidget->setHorizontalHeaderLabels(headers);
 
+    appendRows(data);
+
+    tableWidget->resizeColumnsToContents();
+    tableWidget->blockSignals(false);
+    updatePageControls();
+
+    if (!error.isEmpty()) {
+        QMessageBox::warning(this, "Ошибка", "Не удалось загрузить данные: " + error);
+    }
+}
+
+void CollapsibleTableWidget::appendRows(const QList<QVariantList> &data)
+{
+    int firstRow = tableWidget->rowCount();
+    tableWidget->setRowCount(firstRow + data.size());
+
     for (int row = 0; row < data.size(); ++row) {
         const auto &rowData = data[row];
         for (int col = 0; col < rowData.size(); ++col) {
@@ -131,12 +269,39 @@ void CollapsibleTableWidget::loadTableData()
                 item->setForeground(QColor(80, 80, 80));
             }
 
-            tableWidget->setItem(row, col, item);
+            tableWidget->setItem(firstRow + row, col, item);
         }
     }
+}
 
-    tableWidget->resizeColumnsToContents();
+void CollapsibleTableWidget::updatePageControls()
+{
+    pageLabel->setVisible(paged);
+    loadMoreButton->setVisible(paged);
+    if (!paged) return;
+
+    pageLabel->setText(QString("Загружено строк: %1 из ~%2")
+                           .arg(tableWidget->rowCount()).arg(formatRows(stats.estimatedRows)));
+    loadMoreButton->setEnabled(!pageCursor.atEnd);
+}
+
+void CollapsibleTableWidget::onLoadMore()
+{
+    TraceSpan traceSpan("ui", "CollapsibleTableWidget::onLoadMore");
+    traceSpan.addArg("table", tableName);
+    DbMetrics::Scope metricsScope(DbMetrics::WidgetPopulation);
+
+    QString error;
+    auto data = DatabaseManager::instance().getTableDataPage(tableName, pageRows, &pageCursor, &error);
+    if (!error.isEmpty()) {
+        QMessageBox::warning(this, "Ошибка", "Не удалось загрузить данные: " + error);
+        return;
+    }
+
+    tableWidget->blockSignals(true);
+    appendRows(data);
     tableWidget->blockSignals(false);
+    updatePageControls();
 }
 
 QStringList CollapsibleTableWidget::getPrimaryKeyColumns()
@@ -313,7 +478,7 @@ void CollapsibleTableWidget::onAddColumn()
                                           ).arg(tableName, constraintName, colName);
 
             QSqlQuery query(DatabaseManager::instance().getDatabase());
-            if (!query.exec(constraintQuery)) {
+            if (!DbMetrics::exec(query, constraintQuery)) {
                 QMessageBox::warning(this, "Предупреждение",
                                      "Столбец добавлен, но не удалось добавить ограничение: " + query.lastError().text());
             }
@@ -474,6 +639,183 @@ void CollapsibleTableWidget::onSaveTableState()
     }
 }
 
+void CollapsibleTableWidget::onImportCsv()
+{
+    QString filePath = QFileDialog::getOpenFileName(this, "Импорт CSV", "", "CSV Files (*.csv);;All Files (*)");
+
+    if (filePath.isEmpty()) return;
+
+    QStringList delimiters = {"; (точка с запятой)", ", (запятая)", "Табуляция"};
+    bool ok = false;
+    QString choice = QInputDialog::getItem(this, "Импорт CSV", "Разделитель:", delimiters, 0, false, &ok);
+    if (!ok) return;
+
+    CsvReader::Dialect dialect;
+    if (choice == delimiters[1]) dialect.delimiter = ',';
+    if (choice == delimiters[2]) dialect.delimiter = '\t';
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QMessageBox::critical(this, "Ошибка", "Не удалось открыть файл");
+        return;
+    }
+
+    DatabaseManager::CsvImportReport report;
+    QString error;
+    bool imported = DatabaseManager::instance().importTableFromCsv(tableName, &file, dialect, &report, &error);
+    file.close();
+
+    if (!imported) {
+        QMessageBox::critical(this, "Ошибка", "Не удалось импортировать CSV: " + error);
+        return;
+    }
+
+    loadTableData();
+
+    QString message = QString("Прочитано строк: %1\nЗагружено: %2\nОтклонено: %3")
+                          .arg(report.rowsRead).arg(report.rowsImported).arg(report.rowsRejected);
+    if (!report.ignoredColumns.isEmpty()) {
+        message += "\n\nПропущены столбцы: " + report.ignoredColumns.join(", ");
+    }
+    if (!report.rejected.isEmpty()) {
+        message += "\n\nОтклонённые строки:";
+        for (int i = 0; i < report.rejected.size() && i < 20; ++i) {
+            message += QString("\nстрока %1: %2").arg(report.rejected[i].line).arg(report.rejected[i].reason);
+        }
+        if (report.rowsRejected > 20) {
+            message += QString("\n... и ещё %1").arg(report.rowsRejected - 20);
+        }
+    }
+
+    if (report.rowsRejected > 0) {
+        QMessageBox::warning(this, "Импорт CSV", message);
+    } else {
+        QMessageBox::information(this, "Импорт CSV", message);
+    }
+}
+
+void CollapsibleTableWidget::loadIndexes()
+{
+    QString error;
+    auto indexes = DatabaseManager::instance().getTableIndexes(tableName, &error);
+    if (!error.isEmpty()) {
+        QMessageBox::warning(this, "Ошибка", "Не удалось загрузить индексы: " + error);
+    }
+
+    indexesTable->setRowCount(indexes.size());
+    for (int row = 0; row < indexes.size(); ++row) {
+        const auto &index = indexes[row];
+
+        QString method = index.method;
+        if (index.isPrimary) {
+            method += " (PK)";
+        } else if (index.isUnique) {
+            method += " (unique)";
+        }
+
+        QStringList cells = {
+            index.name,
+            method,
+            index.columns.join(", "),
+            index.includeColumns.join(", "),
+            index.predicate,
+            formatSize(index.sizeBytes),
+            QString::number(index.scans),
+            QString::number(index.tuplesRead),
+            index.isValid ? "готов" : "недействителен"
+        };
+        for (int col = 0; col < cells.size(); ++col) {
+            QTableWidgetItem *item = new QTableWidgetItem(cells[col]);
+            item->setToolTip(index.definition);
+            if (!index.isValid) {
+                item->setBackground(QColor(255, 220, 150));
+            } else if (index.scans == 0 && !index.isPrimary) {
+                item->setForeground(QColor(140, 140, 140));
+            }
+            indexesTable->setItem(row, col, item);
+        }
+    }
+
+    indexesTable->resizeColumnsToContents();
+}
+
+void CollapsibleTableWidget::onCreateIndex()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("Создать индекс");
+    dialog.setMinimumWidth(800);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+
+    IndexInputWidget *indexInput = new IndexInputWidget(&dialog);
+    layout->addWidget(indexInput);
+
+    QCheckBox *concurrentlyCheck = new QCheckBox("CONCURRENTLY (не блокировать запись в таблицу)", &dialog);
+    concurrentlyCheck->setChecked(true);
+    layout->addWidget(concurrentlyCheck);
+
+    QHBoxLayout *buttonsLayout = new QHBoxLayout();
+    QPushButton *okButton = new QPushButton("OK", &dialog);
+    QPushButton *cancelButton = new QPushButton("Отмена", &dialog);
+    connect(okButton, &QPushButton::clicked, &dialog, &QDialog::accept);
+    connect(cancelButton, &QPushButton::clicked, &dialog, &QDialog::reject);
+    buttonsLayout->addWidget(okButton);
+    buttonsLayout->addWidget(cancelButton);
+    layout->addLayout(buttonsLayout);
+
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    DatabaseManager::IndexSpec spec = indexInput->getSpec();
+    spec.concurrently = concurrentlyCheck->isChecked();
+
+    TraceSpan traceSpan("ui", "CollapsibleTableWidget::onCreateIndex");
+    traceSpan.addArg("table", tableName);
+
+    QProgressDialog progressDialog("Создание индекса...", "Отмена", 0, 1000, this);
+    progressDialog.setWindowModality(Qt::WindowModal);
+    progressDialog.setMinimumDuration(500);
+
+    QString error;
+    bool ok = DatabaseManager::instance().createIndex(tableName, spec,
+        [&](const DatabaseManager::IndexBuildProgress &progress) {
+            if (progress.blocksTotal > 0) {
+                progressDialog.setValue(int(progress.blocksDone * 1000 / progress.blocksTotal));
+            } else if (progress.tuplesTotal > 0) {
+                progressDialog.setValue(int(progress.tuplesDone * 1000 / progress.tuplesTotal));
+            }
+            if (!progress.phase.isEmpty()) {
+                progressDialog.setLabelText("Создание индекса... " + progress.phase);
+            }
+            QCoreApplication::processEvents();
+            return !progressDialog.wasCanceled();
+        }, &error);
+    progressDialog.close();
+
+    if (!ok) {
+        QMessageBox::critical(this, "Ошибка", "Не удалось создать индекс: " + error);
+    }
+    loadIndexes();
+}
+
+void CollapsibleTableWidget::onDropIndex()
+{
+    int row = indexesTable->currentRow();
+    if (row < 0) {
+        QMessageBox::warning(this, "Ошибка", "Выберите индекс для удаления");
+        return;
+    }
+
+    QString indexName = indexesTable->item(row, 0)->text();
+    auto reply = QMessageBox::question(this, "Удаление индекса",
+                                       QString("Удалить индекс \"%1\"?").arg(indexName));
+    if (reply != QMessageBox::Yes) return;
+
+    QString error;
+    if (!DatabaseManager::instance().dropIndex(indexName, true, &error)) {
+        QMessageBox::critical(this, "Ошибка", "Не удалось удалить индекс: " + error);
+    }
+    loadIndexes();
+}
+
 void CollapsibleTableWidget::onCellChanged(int row, int column)
 {
     if (row < 0 || column < 0 || column >= columns.size()) return;
@@ -530,27 +872,27 @@ void CollapsibleTableWidget::onCellChanged(int row, int column)
         }
 
         QSqlQuery tx(DatabaseManager::instance().getDatabase());
-        if (!tx.exec("BEGIN")) {
+        if (!DbMetrics::exec(tx, "BEGIN")) {
             QMessageBox::critical(this, "Ошибка транзакции", tx.lastError().text());
             loadTableData();
             return;
         }
 
         if (!DatabaseManager::instance().insertRow(tableName, newRowValues, &error)) {
-            tx.exec("ROLLBACK");
+            DbMetrics::exec(tx, "ROLLBACK");
             QMessageBox::critical(this, "Ошибка", "Не удалось вставить новую строку при изменении PK: " + error);
             loadTableData();
             return;
         }
 
         if (!DatabaseManager::instance().deleteRow(tableName, oldPkValues, &error)) {
-            tx.exec("ROLLBACK");
+            DbMetrics::exec(tx, "ROLLBACK");
             QMessageBox::critical(this, "Ошибка", "Не удалось удалить старую строку при изменении PK: " + error);
             loadTableData();
             return;
         }
 
-        if (!tx.exec("COMMIT")) {
+        if (!DbMetrics::exec(tx, "COMMIT")) {
             QMessageBox::critical(this, "Ошибка транзакции", tx.lastError().text());
             loadTableData();
             return;
@@ -566,6 +908,11 @@ TableManagementWindow::TableManagementWindow(QWidget *parent)
 {
     if (!DatabaseManager::instance().connectToDatabase()) {
         QMessageBox::critical(this, "Ошибка", "Не удалось подключиться к базе данных");
+    } else {
+        QString error;
+        if (!DatabaseManager::instance().maintainPartitions(partitionPremake, &error)) {
+            QMessageBox::warning(this, "Предупреждение", "Не удалось создать секции заранее:\n" + error);
+        }
     }
 
     setupUI();
@@ -593,12 +940,26 @@ void TableManagementWindow::setupUI()
     saveDatabaseButton = new QPushButton("Сохранить состояние БД", this);
     restoreDatabaseButton = new QPushButton("Восстановить БД", this);
     restoreTableButton = new QPushButton("Восстановить таблицу", this);
+    statsButton = new QPushButton("Статистика таблиц", this);
+    statsButton->setCheckable(true);
 
     connect(deleteTableButton, &QPushButton::clicked, this, &TableManagementWindow::onDeleteTable);
     connect(addTableButton, &QPushButton::clicked, this, &TableManagementWindow::onAddTable);
     connect(saveDatabaseButton, &QPushButton::clicked, this, &TableManagementWindow::onSaveDatabase);
     connect(restoreDatabaseButton, &QPushButton::clicked, this, &TableManagementWindow::onRestoreDatabase);
     connect(restoreTableButton, &QPushButton::clicked, this, &TableManagementWindow::onRestoreTable);
+    connect(statsButton, &QPushButton::toggled, this, [this](bool checked) {
+        statsTable->setVisible(checked);
+        if (checked) {
+            auto stats = DatabaseManager::instance().getTableStats();
+            for (auto widget : tableWidgets) {
+                for (const auto &table : stats) {
+                    if (table.tableName == widget->getTableName()) widget->setStats(table);
+                }
+            }
+            showTableStats(stats);
+        }
+    });
 
     topButtonsLayout->addWidget(deleteTableButton);
     topButtonsLayout->addWidget(addTableButton);
@@ -606,9 +967,21 @@ void TableManagementWindow::setupUI()
     topButtonsLayout->addWidget(restoreDatabaseButton);
     topButtonsLayout->addWidget(restoreTableButton);
     topButtonsLayout->addStretch();
+    topButtonsLayout->addWidget(statsButton);
 
     mainLayout->addLayout(topButtonsLayout);
 
+    statsTable = new QTableWidget(this);
+    statsTable->setColumnCount(11);
+    statsTable->setHorizontalHeaderLabels({"Таблица", "Строк (оценка)", "Всего", "Данные", "Индексы", "TOAST",
+                                           "Мёртвых строк", "VACUUM", "ANALYZE", "Seq scan", "Index scan"});
+    statsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    statsTable->setSelectionMode(QAbstractItemView::NoSelection);
+    statsTable->setSortingEnabled(true);
+    statsTable->setMaximumHeight(220);
+    statsTable->hide();
+    mainLayout->addWidget(statsTable);
+
     scrollArea = new QScrollArea(this);
     scrollArea->setWidgetResizable(true);
     scrollArea->setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
@@ -630,15 +1003,58 @@ void TableManagementWindow::loadTables()
     tableWidgets.clear();
 
     QStringList tableNames = DatabaseManager::instance().getTableNames();
+    auto stats = DatabaseManager::instance().getTableStats();
+    QHash<QString, DatabaseManager::TableStats> statsByTable;
+    for (const auto &table : stats) {
+        statsByTable.insert(table.tableName, table);
+    }
 
     for (const QString &tableName : tableNames) {
         CollapsibleTableWidget *tableWidget = new CollapsibleTableWidget(tableName, this);
+        if (statsByTable.contains(tableName)) {
+            tableWidget->setStats(statsByTable[tableName]);
+        }
         connect(tableWidget, &CollapsibleTableWidget::needsRefresh, this, &TableManagementWindow::refreshTablesList);
         tablesLayout->addWidget(tableWidget);
         tableWidgets.append(tableWidget);
     }
 
     tablesLayout->addStretch();
+    showTableStats(stats);
+}
+
+void TableManagementWindow::showTableStats(const QList<DatabaseManager::TableStats> &stats)
+{
+    statsTable->setSortingEnabled(false);
+    statsTable->setRowCount(stats.size());
+
+    for (int row = 0; row < stats.size(); ++row) {
+        const auto &table = stats[row];
+
+        auto numberItem = [](const QString &text, double value) {
+            return new NumericItem(text, value);
+        };
+
+        statsTable->setItem(row, 0, new QTableWidgetItem(table.tableName));
+        statsTable->setItem(row, 1, numberItem(formatRows(table.estimatedRows), table.estimatedRows));
+        statsTable->setItem(row, 2, numberItem(formatSize(table.totalBytes), table.totalBytes));
+        statsTable->setItem(row, 3, numberItem(formatSize(table.heapBytes), table.heapBytes));
+        statsTable->setItem(row, 4, numberItem(formatSize(table.indexBytes), table.indexBytes));
+        statsTable->setItem(row, 5, numberItem(formatSize(table.toastBytes), table.toastBytes));
+        statsTable->setItem(row, 6, numberItem(QString::number(table.deadTuples), table.deadTuples));
+        statsTable->setItem(row, 7, new QTableWidgetItem(formatTime(table.lastVacuum)));
+        statsTable->setItem(row, 8, new QTableWidgetItem(formatTime(table.lastAnalyze)));
+        statsTable->setItem(row, 9, numberItem(QString::number(table.seqScans), table.seqScans));
+        statsTable->setItem(row, 10, numberItem(QString::number(table.indexScans), table.indexScans));
+
+        // Mostly sequential access to a large table usually means a missing index.
+        if (table.estimatedRows > fullLoadMaxRows && table.seqScans > table.indexScans) {
+            statsTable->item(row, 9)->setBackground(QColor(255, 220, 150));
+        }
+    }
+
+    statsTable->setSortingEnabled(true);
+    statsTable->resizeColumnsToContents();
 }
 
 QList<CollapsibleTableWidget*> TableManagementWindow::getSelectedTables()
@@ -705,17 +1121,30 @@ void TableManagementWindow::onSaveDatabase()
     if (filePath.isEmpty()) return;
 
     if (filePath.endsWith(".sql")) {
+        const QStringList formats = {"COPY (быстрое восстановление)", "INSERT (пакетами)"};
+        bool ok = false;
+        QString format = QInputDialog::getItem(this, "Сохранить БД", "Формат данных:", formats, 0, false, &ok);
+        if (!ok) return;
+
+        DatabaseManager::SqlDumpOptions options;
+        if (format == formats[1]) {
+            options.format = DatabaseManager::SqlDumpOptions::Inserts;
+        }
+
         QString error;
-        if (DatabaseManager::instance().exportDatabaseToSql(filePath, &error)) {
+        if (DatabaseManager::instance().exportDatabaseToSql(filePath, options, &error)) {
             QMessageBox::information(this, "Успех", "База данных успешно экспортирована в SQL файл");
         } else {
             QMessageBox::critical(this, "Ошибка", "Не удалось экспортировать БД: " + error);
         }
     } else {
+        TraceSpan traceSpan("ui", "TableManagementWindow::onSaveDatabase");
+        traceSpan.addArg("file", filePath);
         QJsonArray dbJson = DatabaseManager::instance().exportDatabaseToJson();
 
         QFile file(filePath);
         if (file.open(QIODevice::WriteOnly)) {
+            TraceSpan writeSpan("export", "write JSON");
             QJsonDocument doc(dbJson);
             file.write(doc.toJson());
             file.close();
@@ -728,28 +1157,59 @@ void TableManagementWindow::onSaveDatabase()
 
 void TableManagementWindow::onRestoreDatabase()
 {
-    QString filePath = QFileDialog::getOpenFileName(this, "Восстановить БД", "", "JSON Files (*.json)");
+    QString filePath = QFileDialog::getOpenFileName(this, "Восстановить БД", "", "SQL Files (*.sql);;JSON Files (*.json)");
 
     if (filePath.isEmpty()) return;
 
+    if (filePath.endsWith(".sql")) {
+        QString error;
+        bool ok = restoreFromSql(filePath, &error);
+        loadTables();
+        if (ok) {
+            QMessageBox::information(this, "Успех", "БД успешно восстановлена");
+        } else {
+            QMessageBox::critical(this, "Ошибка", "Не удалось восстановить БД: " + error);
+        }
+        return;
+    }
+
     QFile file(filePath);
     if (!file.open(QIODevice::ReadOnly)) {
         QMessageBox::critical(this, "Ошибка", "Не удалось открыть файл");
         return;
     }
 
-    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-    file.close();
+    TraceSpan traceSpan("ui", "TableManagementWindow::onRestoreDatabase");
+    traceSpan.addArg("file", filePath);
+
+    QJsonDocument doc;
+    {
+        TraceSpan parseSpan("restore", "parse JSON");
+        doc = QJsonDocument::fromJson(file.readAll());
+        file.close();
+    }
 
     if (!doc.isArray()) {
         QMessageBox::critical(this, "Ошибка", "Неверный формат файла");
         return;
     }
 
+    const QStringList modes = {"Обычный", "Быстрый (UNLOGGED, synchronous_commit = off)"};
+    bool modeOk = false;
+    QString mode = QInputDialog::getItem(this, "Восстановить БД", "Режим восстановления:", modes, 0, false, &modeOk);
+    if (!modeOk) return;
+
+    DatabaseManager::RestoreOptions options;
+    options.fast = mode == modes[1];
+    DatabaseManager::RestoreReport report;
+
     QString error;
-    if (DatabaseManager::instance().importDatabaseFromJson(doc.array(), &error)) {
+    if (DatabaseManager::instance().importDatabaseFromJson(doc.array(), options, &report, &error)) {
+        TraceSpan reloadSpan("ui", "reload tables");
         loadTables();
-        QMessageBox::information(this, "Успех", "БД успешно восстановлена");
+        QString wal = report.walBytes >= 0 ? QString::number(report.walBytes / 1048576.0, 'f', 1) + " МБ" : "н/д";
+        QMessageBox::information(this, "Успех", QString("БД успешно восстановлена\nВремя: %1 мс\nОбъём WAL: %2")
+                                                    .arg(report.elapsedMs).arg(wal));
     } else {
         QMessageBox::critical(this, "Ошибка", "Не удалось восстановить БД: " + error);
     }
@@ -784,6 +1244,33 @@ void TableManagementWindow::onRestoreTable()
     }
 }
 
+bool TableManagementWindow::restoreFromSql(const QString &filePath, QString *error)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) *error = "Cannot open file";
+        return false;
+    }
+
+    TraceSpan traceSpan("ui", "TableManagementWindow::restoreFromSql");
+    traceSpan.addArg("file", filePath);
+
+    QProgressDialog progressDialog("Восстановление из SQL...", "Отмена", 0, 1000, this);
+    progressDialog.setWindowModality(Qt::WindowModal);
+    progressDialog.setMinimumDuration(500);
+
+    DatabaseManager::SqlRestoreOptions options;
+    return DatabaseManager::instance().restoreDatabaseFromSql(&file, options,
+        [&](const DatabaseManager::SqlRestoreProgress &progress) {
+            if (progress.totalBytes > 0) {
+                progressDialog.setValue(int(progress.bytesRead * 1000 / progress.totalBytes));
+            }
+            progressDialog.setLabelText(QString("Восстановление из SQL... выполнено запросов: %1").arg(progress.statements));
+            QCoreApplication::processEvents();
+            return !progressDialog.wasCanceled();
+        }, error);
+}
+
 void TableManagementWindow::refreshTablesList()
 {
     loadTables();
@@ -21,6 +21,7 @@ public:
     QString getTableName() const { return tableName; }
     bool isSelected() const;
     void setSelected(bool selected);
+    void setStats(const DatabaseManager::TableStats &stats);
 
 signals:
     void needsRefresh();
@@ -32,12 +33,21 @@ private slots:
     void onDeleteRow();
     void onDeleteColumn();
     void onSaveTableState();
+    void onImportCsv();
+    void onCreateIndex();
+    void onDropIndex();
+    void onLoadMore();
     void onCellChanged(int row, int column);
     void onHeaderDoubleClicked(int index);
     void onBeforeEdit(int row, int column);
 
 private:
     void loadTableData();
+    void appendRows(const QList<QVariantList> &data);
+    void updatePageControls();
+    bool shouldPage() const;
+    QString headerTitle() const;
+    void loadIndexes();
     void setupUI();
     QStringList getPrimaryKeyColumns();
     QVariantList getRowPrimaryKeyValues(int row);
@@ -47,12 +57,22 @@ private:
     QPushButton *headerButton;
     QWidget *contentWidget;
     QTableWidget *tableWidget;
+    QLabel *pageLabel;
+    QPushButton *loadMoreButton;
     QPushButton *addRowButton;
     QPushButton *addColumnButton;
     QPushButton *deleteRowButton;
     QPushButton *deleteColumnButton;
     QPushButton *saveStateButton;
+    QPushButton *importCsvButton;
+    QTableWidget *indexesTable;
+    QPushButton *createIndexButton;
+    QPushButton *dropIndexButton;
     bool isCollapsed;
+    bool hasStats = false;
+    bool paged = false;
+    DatabaseManager::TableStats stats;
+    DatabaseManager::TablePageCursor pageCursor;
     QList<DatabaseManager::ColumnInfo> columns;
     QMap<int, QVariantList> oldPkByRow;
 };
@@ -75,6 +95,8 @@ private slots:
 private:
     void setupUI();
     void loadTables();
+    void showTableStats(const QList<DatabaseManager::TableStats> &stats);
+    bool restoreFromSql(const QString &filePath, QString *error);
     QList<CollapsibleTableWidget*> getSelectedTables();
 
     QScrollArea *scrollArea;
@@ -85,6 +107,8 @@ private:
     QPushButton *saveDatabaseButton;
     QPushButton *restoreDatabaseButton;
     QPushButton *restoreTableButton;
+    QPushButton *statsButton;
+    QTableWidget *statsTable;
 
     QList<CollapsibleTableWidget*> tableWidgets;
 };
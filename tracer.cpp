@@ -0,0 +1,191 @@
+#include "tracer.h"
+#include <QCoreApplication>
+#include <QThread>
+#include <QMutex>
+#include <QFile>
+#include <QJsonDocument>
+#include <QDebug>
+#include <chrono>
+#include <vector>
+
+std::atomic<bool> Tracer::enabled(!qEnvironmentVariableIsEmpty("LIBRARY_TRACE"));
+
+namespace {
+const size_t maxEventsPerThread = 1000000;
+
+struct TraceEvent {
+    const char *category;
+    QString name;
+    qint64 startUs;
+    qint64 durationUs;
+    QJsonObject args;
+};
+
+struct ThreadBuffer {
+    QMutex mutex;
+    int tid = 0;
+    QString threadName;
+    std::vector<TraceEvent> events;
+    quint64 dropped = 0;
+};
+
+QMutex registryMutex;
+std::vector<ThreadBuffer*> registeredBuffers;
+std::atomic<int> nextTid(1);
+const auto traceEpoch = std::chrono::steady_clock::now();
+
+thread_local ThreadBuffer *localBuffer = nullptr;
+
+ThreadBuffer &buffer()
+{
+    if (!localBuffer) {
+        localBuffer = new ThreadBuffer();
+        localBuffer->tid = nextTid.fetch_add(1);
+
+        QThread *thread = QThread::currentThread();
+        if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+            localBuffer->threadName = "main";
+        } else if (thread && !thread->objectName().isEmpty()) {
+            localBuffer->threadName = thread->objectName();
+        } else {
+            localBuffer->threadName = QString("thread %1").arg(localBuffer->tid);
+        }
+
+        QMutexLocker locker(&registryMutex);
+        registeredBuffers.push_back(localBuffer);
+    }
+    return *localBuffer;
+}
+
+QByteArray eventJson(const QJsonObject &event)
+{
+    return QJsonDocument(event).toJson(QJsonDocument::Compact);
+}
+}
+
+void Tracer::setEnabled(bool on)
+{
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+qint64 Tracer::nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+void Tracer::addCompleteEvent(const char *category, const QString &name,
+                              qint64 startUs, qint64 durationUs, const QJsonObject &args)
+{
+    ThreadBuffer &b = buffer();
+    QMutexLocker locker(&b.mutex);
+    if (b.events.size() >= maxEventsPerThread) {
+        ++b.dropped;
+        return;
+    }
+    b.events.push_back({category, name, startUs, durationUs, args});
+}
+
+void Tracer::nameCurrentThread(const QString &name)
+{
+    ThreadBuffer &b = buffer();
+    QMutexLocker locker(&b.mutex);
+    b.threadName = name;
+}
+
+int Tracer::eventCount()
+{
+    QMutexLocker registryLocker(&registryMutex);
+    int count = 0;
+    for (ThreadBuffer *b : registeredBuffers) {
+        QMutexLocker locker(&b->mutex);
+        count += int(b->events.size());
+    }
+    return count;
+}
+
+void Tracer::clear()
+{
+    QMutexLocker registryLocker(&registryMutex);
+    for (ThreadBuffer *b : registeredBuffers) {
+        QMutexLocker locker(&b->mutex);
+        b->events.clear();
+        b->dropped = 0;
+    }
+}
+
+bool Tracer::writeToFile(const QString &filePath, QString *error)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (error) *error = "Cannot open file for writing";
+        return false;
+    }
+
+    qint64 pid = QCoreApplication::applicationPid();
+    bool first = true;
+    auto writeEvent = [&](const QJsonObject &event) {
+        file.write(first ? "\n" : ",\n");
+        file.write(eventJson(event));
+        first = false;
+    };
+
+    file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    QMutexLocker registryLocker(&registryMutex);
+    for (ThreadBuffer *b : registeredBuffers) {
+        QMutexLocker locker(&b->mutex);
+
+        QJsonObject threadName;
+        threadName["ph"] = "M";
+        threadName["name"] = "thread_name";
+        threadName["pid"] = pid;
+        threadName["tid"] = b->tid;
+        threadName["args"] = QJsonObject{{"name", b->threadName}};
+        writeEvent(threadName);
+
+        for (const auto &e : b->events) {
+            QJsonObject event;
+            event["ph"] = "X";
+            event["cat"] = e.category;
+            event["name"] = e.name;
+            event["ts"] = e.startUs;
+            event["dur"] = e.durationUs;
+            event["pid"] = pid;
+            event["tid"] = b->tid;
+            if (!e.args.isEmpty()) {
+                event["args"] = e.args;
+            }
+            writeEvent(event);
+        }
+
+        if (b->dropped > 0) {
+            qWarning() << "Tracer: dropped" << b->dropped << "events on thread" << b->threadName;
+        }
+    }
+
+    file.write("\n]}\n");
+    file.close();
+    return true;
+}
+
+TraceSpan::TraceSpan(const char *category, const QString &name, qint64 minimumDurationUs)
+    : category(category), startUs(0), minimumDurationUs(minimumDurationUs), active(Tracer::isEnabled())
+{
+    if (!active) return;
+    this->name = name;
+    startUs = Tracer::nowUs();
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (!active) return;
+    qint64 durationUs = Tracer::nowUs() - startUs;
+    if (durationUs < minimumDurationUs) return;
+    Tracer::addCompleteEvent(category, name, startUs, durationUs, args);
+}
+
+void TraceSpan::addArg(const QString &key, const QJsonValue &value)
+{
+    if (active) args[key] = value;
+}
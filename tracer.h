@@ -0,0 +1,46 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QString>
+#include <QJsonObject>
+#include <atomic>
+
+class Tracer
+{
+public:
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool on);
+
+    static qint64 nowUs();
+    static void addCompleteEvent(const char *category, const QString &name,
+                                 qint64 startUs, qint64 durationUs,
+                                 const QJsonObject &args = QJsonObject());
+    static void nameCurrentThread(const QString &name);
+    static int eventCount();
+    static void clear();
+    static bool writeToFile(const QString &filePath, QString *error = nullptr);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+class TraceSpan
+{
+public:
+    TraceSpan(const char *category, const QString &name, qint64 minimumDurationUs = 0);
+    ~TraceSpan();
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void addArg(const QString &key, const QJsonValue &value);
+
+private:
+    const char *category;
+    QString name;
+    QJsonObject args;
+    qint64 startUs;
+    qint64 minimumDurationUs;
+    bool active;
+};
+
+#endif
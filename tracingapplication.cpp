@@ -0,0 +1,30 @@
+#include "tracingapplication.h"
+#include "tracer.h"
+#include <QMetaEnum>
+
+namespace {
+const qint64 minimumDispatchDurationUs = 500;
+}
+
+TracingApplication::TracingApplication(int &argc, char **argv)
+    : QApplication(argc, argv)
+{
+}
+
+bool TracingApplication::notify(QObject *receiver, QEvent *event)
+{
+    if (!Tracer::isEnabled()) {
+        return QApplication::notify(receiver, event);
+    }
+
+    const char *eventName = QMetaEnum::fromType<QEvent::Type>().valueToKey(event->type());
+    TraceSpan span("ui", QString("%1::%2")
+                             .arg(receiver->metaObject()->className(),
+                                  eventName ? eventName : QString::number(int(event->type()))),
+                   minimumDispatchDurationUs);
+    if (!receiver->objectName().isEmpty()) {
+        span.addArg("objectName", receiver->objectName());
+    }
+
+    return QApplication::notify(receiver, event);
+}
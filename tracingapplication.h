@@ -0,0 +1,16 @@
+#ifndef TRACINGAPPLICATION_H
+#define TRACINGAPPLICATION_H
+
+#include <QApplication>
+
+class TracingApplication : public QApplication
+{
+    Q_OBJECT
+
+public:
+    TracingApplication(int &argc, char **argv);
+
+    bool notify(QObject *receiver, QEvent *event) override;
+};
+
+#endif